@@ -0,0 +1,182 @@
+#include "backend.hpp"
+
+#include <sys/types.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "exception.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace vt::bench {
+
+namespace {
+
+constexpr size_t direct_alignment = 4096;
+
+auto error_text() -> std::string {
+  return std::strerror(errno);  // NOLINT(concurrency-mt-unsafe)
+}
+
+class libc_backend : public backend {
+public:
+  explicit libc_backend(bool direct) : direct_(direct) {
+  }
+
+  [[nodiscard]] auto name() const -> std::string_view override {
+    return direct_ ? "direct" : "libc";
+  }
+
+  [[nodiscard]] auto alignment() const -> size_t override {
+    return direct_ ? direct_alignment : 1;
+  }
+
+  auto open(const std::string& path) -> int override {
+    const int flags = O_RDWR | (direct_ ? O_DIRECT : 0);
+    const int fd = ::open(path.c_str(), flags);  // NOLINT
+    if (fd < 0) {
+      throw vt::exception() << "failed to open " << path << " for " << name()
+                            << ": " << error_text();
+    }
+    return fd;
+  }
+
+  void read(int fd, char* buffer, size_t count, off_t offset) override {
+    size_t done = 0;
+    while (done < count) {
+      const off_t at = offset + static_cast<off_t>(done);
+      const ssize_t n = ::pread(fd, buffer + done, count - done, at);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n < 0) {
+        throw vt::exception() << "pread failed: " << error_text();
+      }
+      if (n == 0) {
+        break;
+      }
+      done += static_cast<size_t>(n);
+    }
+  }
+
+  void write(int fd, const char* buffer, size_t count, off_t offset) override {
+    size_t done = 0;
+    while (done < count) {
+      const off_t at = offset + static_cast<off_t>(done);
+      const ssize_t n = ::pwrite(fd, buffer + done, count - done, at);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n < 0) {
+        throw vt::exception() << "pwrite failed: " << error_text();
+      }
+      done += static_cast<size_t>(n);
+    }
+  }
+
+  void sync(int fd) override {
+    if (::fsync(fd) == -1) {
+      throw vt::exception() << "fsync failed: " << error_text();
+    }
+  }
+
+  void close(int fd) override {
+    ::close(fd);
+  }
+
+private:
+  bool direct_;
+};
+
+class vtpc_backend : public backend {
+public:
+  [[nodiscard]] auto name() const -> std::string_view override {
+    return "vtpc";
+  }
+
+  auto open(const std::string& path) -> int override {
+    const int fd = vtpc_open(path.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+      throw vt::exception() << "failed to open " << path
+                            << " for vtpc: " << error_text();
+    }
+    return fd;
+  }
+
+  void read(int fd, char* buffer, size_t count, off_t offset) override {
+    size_t done = 0;
+    while (done < count) {
+      const off_t at = offset + static_cast<off_t>(done);
+      const ssize_t n = vtpc_pread(fd, buffer + done, count - done, at);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n < 0) {
+        throw vt::exception() << "vtpc_pread failed: " << error_text();
+      }
+      if (n == 0) {
+        break;
+      }
+      done += static_cast<size_t>(n);
+    }
+  }
+
+  void write(int fd, const char* buffer, size_t count, off_t offset) override {
+    size_t done = 0;
+    while (done < count) {
+      const off_t at = offset + static_cast<off_t>(done);
+      const ssize_t n = vtpc_pwrite(fd, buffer + done, count - done, at);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n < 0) {
+        throw vt::exception() << "vtpc_pwrite failed: " << error_text();
+      }
+      done += static_cast<size_t>(n);
+    }
+  }
+
+  void sync(int fd) override {
+    if (vtpc_fsync(fd) == -1) {
+      throw vt::exception() << "vtpc_fsync failed: " << error_text();
+    }
+  }
+
+  void close(int fd) override {
+    vtpc_close(fd);
+  }
+
+  [[nodiscard]] auto counters() const
+      -> std::optional<cache_counters> override {
+    struct vtpc_stats stats = {};
+    vtpc_stats(&stats);
+    return cache_counters{.hits = stats.hits, .misses = stats.misses};
+  }
+};
+
+}  // namespace
+
+auto backend::libc() -> std::unique_ptr<backend> {
+  return std::make_unique<libc_backend>(/*direct=*/false);
+}
+
+auto backend::libc_direct() -> std::unique_ptr<backend> {
+  return std::make_unique<libc_backend>(/*direct=*/true);
+}
+
+auto backend::vtpc() -> std::unique_ptr<backend> {
+  return std::make_unique<vtpc_backend>();
+}
+
+}  // namespace vt::bench
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace vt::bench {
+
+struct cache_counters {
+  uint64_t hits;
+  uint64_t misses;
+};
+
+/*
+ * A way to do positioned I/O on a file. Every thread opens the file on its
+ * own, so a backend has no state of its own beyond the descriptors.
+ */
+class backend {
+public:
+  virtual ~backend() = default;
+
+  [[nodiscard]] virtual auto name() const -> std::string_view = 0;
+
+  /* Buffers passed to read and write must be aligned to this many bytes. */
+  [[nodiscard]] virtual auto alignment() const -> size_t {
+    return 1;
+  }
+
+  virtual auto open(const std::string& path) -> int = 0;
+  virtual void read(int fd, char* buffer, size_t count, off_t offset) = 0;
+  virtual void write(
+      int fd, const char* buffer, size_t count, off_t offset
+  ) = 0;
+  virtual void sync(int fd) = 0;
+  virtual void close(int fd) = 0;
+
+  /* The hits and misses of the cache so far, if the backend keeps count. */
+  [[nodiscard]] virtual auto counters() const -> std::optional<cache_counters> {
+    return std::nullopt;
+  }
+
+  static auto libc() -> std::unique_ptr<backend>;
+  static auto libc_direct() -> std::unique_ptr<backend>;
+  static auto vtpc() -> std::unique_ptr<backend>;
+};
+
+}  // namespace vt::bench
@@ -0,0 +1,94 @@
+#include "histogram.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace vt::bench {
+
+namespace {
+
+/* 2048 sub-buckets keep three significant digits within every bucket. */
+constexpr unsigned sub_bits = 11;
+constexpr unsigned half_bits = sub_bits - 1;
+constexpr uint64_t sub_mask = (1ULL << sub_bits) - 1;
+constexpr uint64_t half_count = 1ULL << half_bits;
+
+constexpr unsigned value_bits = 44;
+constexpr uint64_t highest = (1ULL << value_bits) - 1;
+constexpr size_t buckets = value_bits - sub_bits + 1;
+
+}  // namespace
+
+histogram::histogram() : counts_((buckets + 1) * half_count) {
+}
+
+auto histogram::index_of(uint64_t value) -> size_t {
+  value = std::min(value, highest);
+  const unsigned bucket =
+      static_cast<unsigned>(std::bit_width(value | sub_mask)) - sub_bits;
+  const uint64_t sub = value >> bucket;
+  return ((bucket + 1ULL) << half_bits) + sub - half_count;
+}
+
+auto histogram::highest_of(size_t index) -> uint64_t {
+  uint64_t bucket = index >> half_bits;
+  uint64_t sub = (index & (half_count - 1)) + half_count;
+  if (bucket == 0) {
+    sub -= half_count;
+  } else {
+    bucket -= 1;
+  }
+  return (sub << bucket) + (1ULL << bucket) - 1;
+}
+
+void histogram::record(uint64_t value) {
+  counts_[index_of(value)] += 1;
+  count_ += 1;
+  max_ = std::max(max_, value);
+  sum_ += static_cast<double>(value);
+}
+
+void histogram::merge(const histogram& other) {
+  for (size_t i = 0; i < counts_.size(); ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  count_ += other.count_;
+  max_ = std::max(max_, other.max_);
+  sum_ += other.sum_;
+}
+
+auto histogram::count() const -> uint64_t {
+  return count_;
+}
+
+auto histogram::max() const -> uint64_t {
+  return max_;
+}
+
+auto histogram::mean() const -> double {
+  return (count_ == 0) ? 0.0 : sum_ / static_cast<double>(count_);
+}
+
+auto histogram::percentile(double percent) const -> uint64_t {
+  if (count_ == 0) {
+    return 0;
+  }
+
+  const auto rank = static_cast<uint64_t>(
+      std::ceil(percent / 100.0 * static_cast<double>(count_))  // NOLINT
+  );
+  const uint64_t target = std::clamp<uint64_t>(rank, 1, count_);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < counts_.size(); ++i) {
+    seen += counts_[i];
+    if (seen >= target) {
+      return std::min(highest_of(i), max_);
+    }
+  }
+  return max_;
+}
+
+}  // namespace vt::bench
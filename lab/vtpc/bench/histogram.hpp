@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vt::bench {
+
+/*
+ * A high dynamic range histogram of latencies in nanoseconds, keeping three
+ * significant digits from one nanosecond up to about four hours. Values are
+ * grouped into buckets of doubling width, each split into the same number of
+ * linear sub-buckets, so memory stays fixed while the relative error stays
+ * under 0.1% at any scale.
+ */
+class histogram {
+public:
+  histogram();
+
+  void record(uint64_t value);
+  void merge(const histogram& other);
+
+  [[nodiscard]] auto count() const -> uint64_t;
+  [[nodiscard]] auto max() const -> uint64_t;
+  [[nodiscard]] auto mean() const -> double;
+
+  /* Returns the highest value equivalent to the given percentile. */
+  [[nodiscard]] auto percentile(double percent) const -> uint64_t;
+
+private:
+  static auto index_of(uint64_t value) -> size_t;
+  static auto highest_of(size_t index) -> uint64_t;
+
+  std::vector<uint64_t> counts_;
+  uint64_t count_ = 0;
+  uint64_t max_ = 0;
+  double sum_ = 0;
+};
+
+}  // namespace vt::bench
@@ -0,0 +1,313 @@
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "backend.hpp"
+#include "exception.hpp"
+#include "report.hpp"
+#include "run.hpp"
+#include "trace.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <getopt.h>
+}
+
+namespace {
+
+using vt::bench::backend;
+
+constexpr std::string_view usage =
+    "usage: vtpc_bench [options]\n"
+    "  -w, --workload NAME     seq, uniform, zipf, hotcold or scan\n"
+    "  -r, --read-ratio X      share of reads among ops, from 0 to 1\n"
+    "  -b, --block SIZE        bytes per op, with an optional K, M or G\n"
+    "  -s, --size SIZE         file size\n"
+    "  -t, --threads N         threads, each with its own descriptor\n"
+    "  -n, --ops N             ops per thread\n"
+    "      --seed N            seed of the trace\n"
+    "      --theta X           skew of the zipf workload\n"
+    "      --hot-fraction X    share of blocks in the hot set\n"
+    "      --hot-ratio X       share of hotcold ops that go to the hot set\n"
+    "      --scan-interval N   hot ops between two scans\n"
+    "      --scan-length N     blocks per scan\n"
+    "  -B, --backends LIST     comma-separated libc, direct and vtpc\n"
+    "  -f, --file PATH         file to run on, /tmp/vtpc_bench by default\n"
+    "  -j, --json PATH         write JSON to PATH, or to stdout for -\n"
+    "  -T, --trace PATH        also record the ops as a trace for vtpc_sim\n"
+    "\n"
+    "The vtpc cache is configured by the VTPC_* environment variables.\n";
+
+enum long_only : int {
+  seed_option = 256,
+  theta_option,
+  hot_fraction_option,
+  hot_ratio_option,
+  scan_interval_option,
+  scan_length_option,
+};
+
+struct options {
+  vt::bench::workload workload;
+  std::vector<std::string> backends = {"libc", "direct", "vtpc"};
+  std::string file = "/tmp/vtpc_bench";
+  std::string json;
+  std::string trace;
+};
+
+auto parse_size(std::string_view text) -> size_t {
+  size_t shift = 0;
+  if (!text.empty()) {
+    switch (text.back()) {
+      case 'K':
+      case 'k':
+        shift = 10;  // NOLINT
+        break;
+      case 'M':
+      case 'm':
+        shift = 20;  // NOLINT
+        break;
+      case 'G':
+      case 'g':
+        shift = 30;  // NOLINT
+        break;
+      default:
+        break;
+    }
+  }
+  if (shift != 0) {
+    text.remove_suffix(1);
+  }
+
+  size_t value = 0;
+  std::istringstream in{std::string(text)};
+  if (!(in >> value) || !in.eof()) {
+    throw vt::exception() << "invalid size '" << text << "'";
+  }
+  return value << shift;
+}
+
+auto parse_double(std::string_view text) -> double {
+  double value = 0;
+  std::istringstream in{std::string(text)};
+  if (!(in >> value) || !in.eof()) {
+    throw vt::exception() << "invalid number '" << text << "'";
+  }
+  return value;
+}
+
+auto split(std::string_view text) -> std::vector<std::string> {
+  std::vector<std::string> parts;
+  while (!text.empty()) {
+    const size_t comma = text.find(',');
+    parts.emplace_back(text.substr(0, comma));
+    text = (comma == std::string_view::npos) ? "" : text.substr(comma + 1);
+  }
+  return parts;
+}
+
+auto parse(int argc, char** argv) -> options {
+  static const std::vector<option> longs = {
+      {"workload", required_argument, nullptr, 'w'},
+      {"read-ratio", required_argument, nullptr, 'r'},
+      {"block", required_argument, nullptr, 'b'},
+      {"size", required_argument, nullptr, 's'},
+      {"threads", required_argument, nullptr, 't'},
+      {"ops", required_argument, nullptr, 'n'},
+      {"seed", required_argument, nullptr, seed_option},
+      {"theta", required_argument, nullptr, theta_option},
+      {"hot-fraction", required_argument, nullptr, hot_fraction_option},
+      {"hot-ratio", required_argument, nullptr, hot_ratio_option},
+      {"scan-interval", required_argument, nullptr, scan_interval_option},
+      {"scan-length", required_argument, nullptr, scan_length_option},
+      {"backends", required_argument, nullptr, 'B'},
+      {"file", required_argument, nullptr, 'f'},
+      {"json", required_argument, nullptr, 'j'},
+      {"trace", required_argument, nullptr, 'T'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0},
+  };
+
+  options options;
+  auto& workload = options.workload;
+  int option = 0;
+  while ((option = getopt_long(  // NOLINT(concurrency-mt-unsafe)
+              argc, argv, "w:r:b:s:t:n:B:f:j:T:h", longs.data(), nullptr
+          )) != -1) {
+    const std::string_view value = (optarg != nullptr) ? optarg : "";
+    switch (option) {
+      case 'w': {
+        const auto pattern = vt::bench::parse_pattern(value);
+        if (!pattern) {
+          throw vt::exception() << "unknown workload '" << value << "'";
+        }
+        workload.pattern = *pattern;
+        break;
+      }
+      case 'r':
+        workload.read_ratio = parse_double(value);
+        break;
+      case 'b':
+        workload.block_size = parse_size(value);
+        break;
+      case 's':
+        workload.file_size = parse_size(value);
+        break;
+      case 't':
+        workload.threads = parse_size(value);
+        break;
+      case 'n':
+        workload.ops = parse_size(value);
+        break;
+      case seed_option:
+        workload.seed = parse_size(value);
+        break;
+      case theta_option:
+        workload.theta = parse_double(value);
+        break;
+      case hot_fraction_option:
+        workload.hot_fraction = parse_double(value);
+        break;
+      case hot_ratio_option:
+        workload.hot_ratio = parse_double(value);
+        break;
+      case scan_interval_option:
+        workload.scan_interval = parse_size(value);
+        break;
+      case scan_length_option:
+        workload.scan_length = parse_size(value);
+        break;
+      case 'B':
+        options.backends = split(value);
+        break;
+      case 'f':
+        options.file = value;
+        break;
+      case 'j':
+        options.json = value;
+        break;
+      case 'T':
+        options.trace = value;
+        break;
+      case 'h':
+        std::cout << usage;
+        std::exit(0);  // NOLINT(concurrency-mt-unsafe)
+      default:
+        std::cerr << usage;
+        std::exit(2);  // NOLINT(concurrency-mt-unsafe)
+    }
+  }
+
+  if (workload.block_size == 0 || workload.threads == 0 ||
+      workload.file_size < workload.block_size) {
+    throw vt::exception() << "the file must hold at least one block";
+  }
+  if (workload.read_ratio < 0 || workload.read_ratio > 1) {
+    throw vt::exception() << "the read ratio must be between 0 and 1";
+  }
+  if (workload.theta <= 0 || workload.theta >= 1) {
+    throw vt::exception() << "theta must be between 0 and 1";
+  }
+  return options;
+}
+
+auto make_backend(const std::string& name) -> std::unique_ptr<backend> {
+  if (name == "libc") {
+    return backend::libc();
+  }
+  if (name == "direct") {
+    return backend::libc_direct();
+  }
+  if (name == "vtpc") {
+    return backend::vtpc();
+  }
+  throw vt::exception() << "unknown backend '" << name << "'";
+}
+
+/* O_DIRECT needs aligned blocks and a file system that supports it. */
+auto supported(backend& backend, const options& options) -> bool {
+  if (options.workload.block_size % backend.alignment() != 0) {
+    std::cerr << "skipping " << backend.name() << ": the block is not a "
+              << "multiple of " << backend.alignment() << " bytes\n";
+    return false;
+  }
+  try {
+    backend.close(backend.open(options.file));
+  } catch (const std::exception& e) {
+    std::cerr << "skipping " << backend.name() << ": " << e.what() << '\n';
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Records the ops of all threads, taking one of every thread in turn, so the
+ * simulator sees the accesses of the workload without a backend.
+ */
+void record(
+    const vt::bench::workload& workload,
+    const std::vector<std::vector<vt::bench::op>>& ops,
+    const std::string& path
+) {
+  const auto trace = vt::trace::create(path, workload.threads * workload.ops);
+  for (size_t i = 0; i < workload.ops; ++i) {
+    for (const auto& thread : ops) {
+      if (i < thread.size()) {
+        const auto& op = thread[i];
+        trace->append(
+            op.write ? vt::trace_op::write : vt::trace_op::read,
+            op.offset,
+            workload.block_size
+        );
+      }
+    }
+  }
+}
+
+}  // namespace
+
+auto main(int argc, char** argv) -> int try {
+  const options options = parse(argc, argv);
+  const auto& workload = options.workload;
+
+  std::vector<std::unique_ptr<backend>> backends;
+  for (const auto& name : options.backends) {
+    backends.push_back(make_backend(name));
+  }
+
+  const auto trace = vt::bench::generate(workload);
+  if (!options.trace.empty()) {
+    record(workload, trace, options.trace);
+  }
+  vt::bench::prepare(workload, options.file);
+
+  std::vector<vt::bench::result> results;
+  for (const auto& backend : backends) {
+    if (supported(*backend, options)) {
+      results.push_back(
+          vt::bench::run(*backend, workload, trace, options.file)
+      );
+    }
+  }
+
+  if (options.json.empty()) {
+    vt::bench::print_table(std::cout, workload, results);
+  } else if (options.json == "-") {
+    vt::bench::print_json(std::cout, workload, results);
+  } else {
+    std::ofstream out(options.json);
+    vt::bench::print_json(out, workload, results);
+    vt::bench::print_table(std::cout, workload, results);
+  }
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,111 @@
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "cmp_file.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+#include "trace.hpp"
+#include "trace_file.hpp"
+
+extern "C" {
+#include <getopt.h>
+}
+
+namespace {
+
+constexpr std::string_view usage =
+    "usage: vtpc_replay [options] TRACE\n"
+    "  -b, --backend NAME   libc, vtpc, or cmp to check vtpc against libc\n"
+    "  -f, --file PATH      file to replay on, /tmp/vtpc_replay by default;\n"
+    "                       cmp also uses PATH.vtpc\n"
+    "  -t, --timing         keep the original time between ops\n"
+    "\n"
+    "The vtpc cache is configured by the VTPC_* environment variables, so\n"
+    "VTPC_POLICY and VTPC_STATS=1 compare policies on the same trace.\n";
+
+auto open_backend(std::string_view backend, const std::string& path)
+    -> std::unique_ptr<vt::file> {
+  if (backend == "libc") {
+    return vt::file::open_libc(path);
+  }
+  if (backend == "vtpc") {
+    return vt::file::open_vtpc(path);
+  }
+  if (backend == "cmp") {
+    auto libc = vt::file::open_libc(path);
+    auto vtpc = vt::file::open_vtpc(path + ".vtpc");
+    return std::make_unique<vt::cmp_file>(std::move(libc), std::move(vtpc));
+  }
+  throw vt::exception() << "unknown backend '" << backend << "'";
+}
+
+}  // namespace
+
+auto main(int argc, char** argv) -> int try {
+  static const std::vector<option> longs = {
+      {"backend", required_argument, nullptr, 'b'},
+      {"file", required_argument, nullptr, 'f'},
+      {"timing", no_argument, nullptr, 't'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0},
+  };
+
+  std::string backend = "vtpc";
+  std::string path = "/tmp/vtpc_replay";
+  auto timing = vt::replay_timing::fast;
+  int option = 0;
+  while ((option = getopt_long(  // NOLINT(concurrency-mt-unsafe)
+              argc, argv, "b:f:th", longs.data(), nullptr
+          )) != -1) {
+    switch (option) {
+      case 'b':
+        backend = optarg;
+        break;
+      case 'f':
+        path = optarg;
+        break;
+      case 't':
+        timing = vt::replay_timing::original;
+        break;
+      case 'h':
+        std::cout << usage;
+        return 0;
+      default:
+        std::cerr << usage;
+        return 2;
+    }
+  }
+  if (optind + 1 != argc) {
+    std::cerr << usage;
+    return 2;
+  }
+
+  const auto trace = vt::trace::open(argv[optind]);  // NOLINT
+  const auto records = trace->records();
+
+  const auto start = std::chrono::steady_clock::now();
+  vt::replay_result result;
+  {
+    auto file = open_backend(backend, path);
+    result = vt::replay(records, *file, timing);
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::cout << "replayed " << result.ops << " ops on " << backend << " in "
+            << elapsed.count() << " s, "
+            << static_cast<double>(result.ops) / elapsed.count()
+            << " ops/s, " << result.failed << " failed, " << result.mismatched
+            << " mismatched, " << trace->dropped() << " dropped\n";
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
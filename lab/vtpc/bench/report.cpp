@@ -0,0 +1,121 @@
+#include "report.hpp"
+
+#include <cstdint>
+#include <iomanip>
+#include <ios>
+#include <ostream>
+#include <vector>
+
+#include "run.hpp"
+#include "workload.hpp"
+
+namespace vt::bench {
+
+namespace {
+
+constexpr double mib = 1024.0 * 1024.0;
+constexpr double microsecond = 1000.0;
+constexpr double p50 = 50;
+constexpr double p99 = 99;
+constexpr double p999 = 99.9;
+
+auto ops_per_second(const result& result) -> double {
+  return (result.seconds == 0)
+             ? 0.0
+             : static_cast<double>(result.ops) / result.seconds;
+}
+
+auto mib_per_second(const result& result) -> double {
+  return (result.seconds == 0)
+             ? 0.0
+             : static_cast<double>(result.bytes) / mib / result.seconds;
+}
+
+auto micros(uint64_t nanos) -> double {
+  return static_cast<double>(nanos) / microsecond;
+}
+
+}  // namespace
+
+void print_table(
+    std::ostream& out,
+    const workload& workload,
+    const std::vector<result>& results
+) {
+  out << "workload " << pattern_name(workload.pattern) << ", read ratio "
+      << workload.read_ratio << ", block " << workload.block_size << ", file "
+      << workload.file_size << ", " << workload.threads << " threads, "
+      << workload.ops << " ops per thread\n";
+
+  out << std::left << std::setw(8) << "backend" << std::right  // NOLINT
+      << std::setw(12) << "ops/s" << std::setw(10) << "MiB/s"  // NOLINT
+      << std::setw(10) << "p50 us" << std::setw(10) << "p99 us"  // NOLINT
+      << std::setw(10) << "p999 us" << std::setw(8) << "hit %"  // NOLINT
+      << std::setw(10) << "syscalls" << '\n';                   // NOLINT
+
+  for (const auto& result : results) {
+    out << std::left << std::setw(8) << result.backend << std::right  // NOLINT
+        << std::fixed << std::setprecision(0) << std::setw(12)        // NOLINT
+        << ops_per_second(result) << std::setprecision(1)
+        << std::setw(10) << mib_per_second(result)                    // NOLINT
+        << std::setw(10) << micros(result.latency.percentile(p50))    // NOLINT
+        << std::setw(10) << micros(result.latency.percentile(p99))    // NOLINT
+        << std::setw(10) << micros(result.latency.percentile(p999))   // NOLINT
+        << std::setw(8);                                              // NOLINT
+    if (result.hit_ratio) {
+      out << *result.hit_ratio * 100;  // NOLINT
+    } else {
+      out << "-";
+    }
+    out << std::setw(10) << result.syscalls << '\n';  // NOLINT
+  }
+  out << std::defaultfloat;
+}
+
+void print_json(
+    std::ostream& out,
+    const workload& workload,
+    const std::vector<result>& results
+) {
+  out << "{\n"
+      << "  \"workload\": {\n"
+      << "    \"pattern\": \"" << pattern_name(workload.pattern) << "\",\n"
+      << "    \"read_ratio\": " << workload.read_ratio << ",\n"
+      << "    \"block_size\": " << workload.block_size << ",\n"
+      << "    \"file_size\": " << workload.file_size << ",\n"
+      << "    \"threads\": " << workload.threads << ",\n"
+      << "    \"ops\": " << workload.ops << ",\n"
+      << "    \"seed\": " << workload.seed << "\n"
+      << "  },\n"
+      << "  \"results\": [";
+
+  const char* separator = "\n";
+  for (const auto& result : results) {
+    const auto& latency = result.latency;
+    out << separator << "    {\n"
+        << "      \"backend\": \"" << result.backend << "\",\n"
+        << "      \"ops\": " << result.ops << ",\n"
+        << "      \"bytes\": " << result.bytes << ",\n"
+        << "      \"seconds\": " << result.seconds << ",\n"
+        << "      \"ops_per_second\": " << ops_per_second(result) << ",\n"
+        << "      \"mib_per_second\": " << mib_per_second(result) << ",\n"
+        << "      \"latency_ns\": {\"p50\": " << latency.percentile(p50)
+        << ", \"p99\": " << latency.percentile(p99)
+        << ", \"p999\": " << latency.percentile(p999)
+        << ", \"max\": " << latency.max() << ", \"mean\": " << latency.mean()
+        << "},\n"
+        << "      \"hit_ratio\": ";
+    if (result.hit_ratio) {
+      out << *result.hit_ratio;
+    } else {
+      out << "null";
+    }
+    out << ",\n"
+        << "      \"syscalls\": " << result.syscalls << "\n"
+        << "    }";
+    separator = ",\n";
+  }
+  out << "\n  ]\n}\n";
+}
+
+}  // namespace vt::bench
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+#include "run.hpp"
+#include "workload.hpp"
+
+namespace vt::bench {
+
+void print_table(
+    std::ostream& out,
+    const workload& workload,
+    const std::vector<result>& results
+);
+
+void print_json(
+    std::ostream& out,
+    const workload& workload,
+    const std::vector<result>& results
+);
+
+}  // namespace vt::bench
@@ -0,0 +1,188 @@
+#include "run.hpp"
+
+#include <sys/types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "backend.hpp"
+#include "exception.hpp"
+#include "histogram.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+}
+
+namespace vt::bench {
+
+namespace {
+
+using std::chrono::steady_clock;
+
+struct aligned_free {
+  void operator()(char* buffer) const {
+    std::free(buffer);  // NOLINT
+  }
+};
+
+using buffer = std::unique_ptr<char, aligned_free>;
+
+auto allocate(size_t size, size_t alignment) -> buffer {
+  const size_t rounded = (size + alignment - 1) / alignment * alignment;
+  auto* memory = static_cast<char*>(std::aligned_alloc(alignment, rounded));
+  if (memory == nullptr) {
+    throw vt::exception() << "failed to allocate " << rounded << " bytes";
+  }
+  return buffer(memory);
+}
+
+auto syscalls() -> uint64_t {
+  std::ifstream io("/proc/self/io");
+  uint64_t total = 0;
+  std::string key;
+  uint64_t value = 0;
+  while (io >> key >> value) {
+    if (key == "syscr:" || key == "syscw:") {
+      total += value;
+    }
+  }
+  return total;
+}
+
+/* Evicts the file from the kernel page cache, so every run starts cold. */
+void evict(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);  // NOLINT
+  if (fd < 0) {
+    return;
+  }
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  ::close(fd);
+}
+
+}  // namespace
+
+void prepare(const workload& workload, const std::string& path) {
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+  const int fd = ::open(path.c_str(), flags, 0644);  // NOLINT
+  if (fd < 0) {
+    throw vt::exception() << "failed to create " << path;
+  }
+
+  const std::string chunk(1U << 20U, 'x');
+  size_t done = 0;
+  while (done < workload.file_size) {
+    const size_t count = std::min(chunk.size(), workload.file_size - done);
+    const ssize_t n = ::write(fd, chunk.data(), count);
+    if (n <= 0) {
+      ::close(fd);
+      throw vt::exception() << "failed to fill " << path;
+    }
+    done += static_cast<size_t>(n);
+  }
+  ::fsync(fd);
+  ::close(fd);
+}
+
+auto run(
+    backend& backend,
+    const workload& workload,
+    const std::vector<std::vector<op>>& trace,
+    const std::string& path
+) -> result {
+  evict(path);
+
+  std::vector<int> fds;
+  for (size_t i = 0; i < trace.size(); ++i) {
+    fds.push_back(backend.open(path));
+  }
+
+  const auto counters = backend.counters();
+  const uint64_t calls = syscalls();
+
+  std::vector<buffer> buffers;
+  for (size_t i = 0; i < trace.size(); ++i) {
+    buffers.push_back(allocate(workload.block_size, backend.alignment()));
+    std::fill_n(buffers.back().get(), workload.block_size, 'a' + (i % 26));
+  }
+
+  std::vector<histogram> latencies(trace.size());
+  std::mutex mutex;
+  std::exception_ptr error;
+  std::latch start(static_cast<std::ptrdiff_t>(trace.size()) + 1);
+
+  steady_clock::time_point begin;
+  {
+    std::vector<std::jthread> workers;
+    for (size_t i = 0; i < trace.size(); ++i) {
+      workers.emplace_back([&, i] {
+        start.arrive_and_wait();
+        const int fd = fds[i];
+        char* data = buffers[i].get();
+        const size_t size = workload.block_size;
+        try {
+          for (const op& op : trace[i]) {
+            const auto before = steady_clock::now();
+            if (op.write) {
+              backend.write(fd, data, size, op.offset);
+            } else {
+              backend.read(fd, data, size, op.offset);
+            }
+            const auto elapsed = steady_clock::now() - before;
+            latencies[i].record(static_cast<uint64_t>(
+                std::chrono::nanoseconds(elapsed).count()
+            ));
+          }
+          backend.sync(fd);
+        } catch (...) {
+          const std::lock_guard lock(mutex);
+          error = std::current_exception();
+        }
+      });
+    }
+    begin = steady_clock::now();
+    start.count_down();
+  }
+  const auto end = steady_clock::now();
+
+  result result;
+  result.backend = backend.name();
+  result.seconds = std::chrono::duration<double>(end - begin).count();
+  result.syscalls = syscalls() - calls;
+  for (const auto& latency : latencies) {
+    result.latency.merge(latency);
+  }
+  result.ops = result.latency.count();
+  result.bytes = result.ops * workload.block_size;
+
+  if (const auto after = backend.counters(); counters && after) {
+    const uint64_t hits = after->hits - counters->hits;
+    const uint64_t misses = after->misses - counters->misses;
+    if (hits + misses != 0) {
+      result.hit_ratio =
+          static_cast<double>(hits) / static_cast<double>(hits + misses);
+    }
+  }
+
+  for (const int fd : fds) {
+    backend.close(fd);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return result;
+}
+
+}  // namespace vt::bench
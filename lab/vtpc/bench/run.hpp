@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "backend.hpp"
+#include "histogram.hpp"
+#include "workload.hpp"
+
+namespace vt::bench {
+
+struct result {
+  std::string backend;
+  uint64_t ops = 0;
+  uint64_t bytes = 0;
+  double seconds = 0;
+  histogram latency;
+  std::optional<double> hit_ratio;
+
+  /* Read and write system calls of the whole process, from /proc/self/io. */
+  uint64_t syscalls = 0;
+};
+
+/* Creates the file at path filled up to the size of the workload. */
+void prepare(const workload& workload, const std::string& path);
+
+/*
+ * Replays the trace against the backend with one thread per trace, timing
+ * every op. The clock stops once every thread has synced its descriptor, so
+ * write-back is part of the throughput.
+ */
+auto run(
+    backend& backend,
+    const workload& workload,
+    const std::vector<std::vector<op>>& trace,
+    const std::string& path
+) -> result;
+
+}  // namespace vt::bench
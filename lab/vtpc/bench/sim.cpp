@@ -0,0 +1,250 @@
+#include "sim.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "exception.hpp"
+#include "trace.hpp"
+
+extern "C" {
+#include "list.h"
+#include "policy.h"
+}
+
+namespace vt::bench {
+
+namespace {
+
+constexpr uint64_t sample_bits = 24;
+constexpr uint64_t sample_mask = (1ULL << sample_bits) - 1;
+constexpr uint64_t never = UINT64_MAX;
+
+auto mix(uint64_t page) -> uint64_t {
+  uint64_t key = page * 0x9E3779B97F4A7C15ULL;  // NOLINT
+  key ^= key >> 33U;                            // NOLINT
+  key *= 0xFF51AFD7ED558CCDULL;                 // NOLINT
+  key ^= key >> 33U;                            // NOLINT
+  return key;
+}
+
+/* Counts marked positions, one per page at the time of its last access. */
+class fenwick {
+public:
+  explicit fenwick(size_t size) : tree_(size + 1) {
+  }
+
+  void add(size_t index, int32_t delta) {
+    for (size_t i = index + 1; i < tree_.size(); i += i & (~i + 1)) {
+      tree_[i] += delta;
+    }
+  }
+
+  /* Returns the number of marks at positions below index. */
+  [[nodiscard]] auto below(size_t index) const -> int64_t {
+    int64_t sum = 0;
+    for (size_t i = index; i > 0; i -= i & (~i + 1)) {
+      sum += tree_[i];
+    }
+    return sum;
+  }
+
+private:
+  std::vector<int32_t> tree_;
+};
+
+struct policy_deleter {
+  void operator()(vtpc_policy* policy) const {
+    vtpc_policy_destroy(policy);
+  }
+};
+
+}  // namespace
+
+auto page_accesses(
+    const std::vector<trace_record>& records, size_t page_size
+) -> std::vector<uint64_t> {
+  std::vector<uint64_t> pages;
+  for (const auto& record : records) {
+    if (record.op == trace_op::seek || record.op == trace_op::sync ||
+        record.size == 0 || record.offset < 0) {
+      continue;
+    }
+    const auto offset = static_cast<uint64_t>(record.offset);
+    const uint64_t last = (offset + record.size - 1) / page_size;
+    for (uint64_t page = offset / page_size; page <= last; ++page) {
+      pages.push_back(page);
+    }
+  }
+  return pages;
+}
+
+auto sample(const std::vector<uint64_t>& pages, double rate)
+    -> std::vector<uint64_t> {
+  if (rate >= 1.0) {
+    return pages;
+  }
+  const auto threshold = static_cast<uint64_t>(
+      rate * static_cast<double>(sample_mask + 1)
+  );
+  std::vector<uint64_t> sampled;
+  for (const uint64_t page : pages) {
+    if ((mix(page) & sample_mask) < threshold) {
+      sampled.push_back(page);
+    }
+  }
+  return sampled;
+}
+
+auto miss_ratio(uint64_t misses, uint64_t accesses, double rate) -> double {
+  const double expected = static_cast<double>(accesses) * std::min(rate, 1.0);
+  if (expected == 0) {
+    return 0.0;
+  }
+  return std::min(static_cast<double>(misses) / expected, 1.0);
+}
+
+auto miss_ratio_curve(const std::vector<uint64_t>& pages, double rate)
+    -> curve {
+  const std::vector<uint64_t> sampled = sample(pages, rate);
+  rate = std::min(rate, 1.0);
+
+  curve result;
+  result.accesses = pages.size();
+  result.sampled = sampled.size();
+
+  fenwick marks(result.sampled);
+  std::unordered_map<uint64_t, size_t> last;
+  std::vector<uint64_t> distances;
+  size_t time = 0;
+  for (const uint64_t page : sampled) {
+    const auto [it, inserted] = last.try_emplace(page, time);
+    if (!inserted) {
+      const size_t previous = it->second;
+      const auto distance = static_cast<size_t>(
+          marks.below(time) - marks.below(previous + 1) + 1
+      );
+      if (distances.size() <= distance) {
+        distances.resize(distance + 1);
+      }
+      distances[distance] += 1;
+      marks.add(previous, -1);
+      it->second = time;
+    }
+    marks.add(time, 1);
+    time += 1;
+  }
+  result.unique = static_cast<uint64_t>(
+      std::ceil(static_cast<double>(last.size()) / rate)
+  );
+
+  result.points.push_back({
+      .pages = 0,
+      .miss_ratio = miss_ratio(result.sampled, result.accesses, rate),
+  });
+  uint64_t hits = 0;
+  for (size_t distance = 1; distance < distances.size(); ++distance) {
+    if (distances[distance] == 0) {
+      continue;
+    }
+    hits += distances[distance];
+    result.points.push_back({
+        .pages = static_cast<uint64_t>(
+            std::ceil(static_cast<double>(distance) / rate)
+        ),
+        .miss_ratio =
+            miss_ratio(result.sampled - hits, result.accesses, rate),
+    });
+  }
+  return result;
+}
+
+auto simulate(
+    std::string_view policy,
+    const std::vector<uint64_t>& pages,
+    size_t capacity,
+    const sim_config& config
+) -> simulation {
+  const std::string name(policy);
+  const vtpc_policy_ops* ops = vtpc_policy_find(name.c_str());
+  if (ops == nullptr) {
+    throw vt::exception() << "unknown policy '" << name << "'";
+  }
+  if (capacity == 0 || capacity >= VTPC_NIL) {
+    throw vt::exception() << "invalid capacity " << capacity;
+  }
+  const std::unique_ptr<vtpc_policy, policy_deleter> instance(
+      config.admission ? vtpc_policy_admit(ops, capacity, nullptr, nullptr)
+                       : vtpc_policy_create(ops, capacity, nullptr, nullptr)
+  );
+  if (!instance) {
+    throw vt::exception() << "failed to create policy '" << name << "'";
+  }
+
+  /* Belady needs the time of the next access to every page. */
+  const bool optimal = (ops == &vtpc_policy_optimal);
+  std::vector<uint64_t> next;
+  if (optimal) {
+    next.assign(pages.size(), never);
+    std::unordered_map<uint64_t, uint64_t> seen;
+    for (size_t i = pages.size(); i-- > 0;) {
+      const auto [it, inserted] = seen.try_emplace(pages[i], i);
+      if (!inserted) {
+        next[i] = it->second;
+        it->second = i;
+      }
+    }
+  }
+
+  simulation result{
+      .policy = config.admission ? name + "+tinylfu" : name,
+      .capacity = capacity,
+      .accesses = pages.size(),
+      .misses = 0,
+  };
+  std::vector<uint64_t> frames(capacity);
+  std::unordered_map<uint64_t, uint32_t> cached;
+  cached.reserve(capacity);
+  uint32_t used = 0;
+
+  for (size_t i = 0; i < pages.size(); ++i) {
+    const uint64_t page = pages[i];
+    const uint64_t key = mix(page);
+    const bool hot = (page < config.hot);
+    result.hot_accesses += hot ? 1 : 0;
+    uint32_t frame = 0;
+    if (const auto it = cached.find(page); it != cached.end()) {
+      frame = it->second;
+      vtpc_policy_hit(instance.get(), frame);
+    } else {
+      result.misses += 1;
+      result.hot_misses += hot ? 1 : 0;
+      vtpc_policy_miss(instance.get(), key);
+      if (used < capacity) {
+        frame = used++;
+      } else {
+        frame = vtpc_policy_evict(instance.get());
+        if (frame == VTPC_NIL) {
+          throw vt::exception() << name << " found no victim";
+        }
+        cached.erase(frames[frame]);
+      }
+      vtpc_policy_insert(instance.get(), frame, key);
+      frames[frame] = page;
+      cached.emplace(page, frame);
+    }
+
+    if (optimal && next[i] != never) {
+      vtpc_policy_advise(instance.get(), frame, key, next[i]);
+    }
+  }
+  return result;
+}
+
+}  // namespace vt::bench
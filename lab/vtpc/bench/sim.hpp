@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "trace.hpp"
+
+namespace vt::bench {
+
+/* Splits the reads, writes and maps of a trace into the pages they touch. */
+auto page_accesses(
+    const std::vector<trace_record>& records, size_t page_size
+) -> std::vector<uint64_t>;
+
+/*
+ * Keeps the accesses to the pages whose hash falls into the given share of
+ * the hash space, so every page is either followed fully or not at all.
+ */
+auto sample(const std::vector<uint64_t>& pages, double rate)
+    -> std::vector<uint64_t>;
+
+/*
+ * Estimates the miss ratio of all accesses from the misses of a sample. The
+ * share of accesses that falls into a sample varies with the popularity of
+ * its pages, so the misses are divided by the expected size of the sample
+ * rather than the actual one, as SHARDS-adj does.
+ */
+auto miss_ratio(uint64_t misses, uint64_t accesses, double rate) -> double;
+
+struct curve_point {
+  uint64_t pages;
+  double miss_ratio;
+};
+
+struct curve {
+  uint64_t accesses = 0;
+  uint64_t sampled = 0;
+  uint64_t unique = 0;
+
+  /* The miss ratio of LRU at every size where it changes. */
+  std::vector<curve_point> points;
+};
+
+/*
+ * Computes the LRU miss-ratio curve from stack distances (Mattson et al.)
+ * in one pass. A rate below 1 only follows a sample of the pages and scales
+ * their distances up (SHARDS, Waldspurger et al.), which trades a small
+ * error for time and memory on large traces.
+ */
+auto miss_ratio_curve(const std::vector<uint64_t>& pages, double rate)
+    -> curve;
+
+struct sim_config {
+  /* Puts the TinyLFU admission filter of vtpc in front of the policy. */
+  bool admission = false;
+
+  /* Pages below this one form the hot set, whose misses are counted apart. */
+  uint64_t hot = 0;
+};
+
+struct simulation {
+  std::string policy;
+  size_t capacity = 0;
+  uint64_t accesses = 0;
+  uint64_t misses = 0;
+  uint64_t hot_accesses = 0;
+  uint64_t hot_misses = 0;
+};
+
+/*
+ * Runs the accesses through a single vtpc policy instance of the given
+ * capacity. The optimal policy is given the next access of every page as a
+ * hint, so it behaves as Belady's algorithm.
+ */
+auto simulate(
+    std::string_view policy,
+    const std::vector<uint64_t>& pages,
+    size_t capacity,
+    const sim_config& config = {}
+) -> simulation;
+
+}  // namespace vt::bench
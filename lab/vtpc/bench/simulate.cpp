@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "exception.hpp"
+#include "sim.hpp"
+#include "trace.hpp"
+
+extern "C" {
+#include <getopt.h>
+}
+
+namespace {
+
+/* Above this many accesses the curve is sampled unless a rate is given. */
+constexpr double exact_limit = 1U << 21U;
+
+constexpr std::string_view usage =
+    "usage: vtpc_sim [options] TRACE\n"
+    "  -p, --policies LIST   policies to simulate, all of them by default\n"
+    "  -s, --sizes LIST      cache sizes in pages to simulate them at,\n"
+    "                        by default 1/8, 1/4, 1/2 and all of the pages\n"
+    "  -r, --rate X          share of pages the LRU curve follows, 1 is\n"
+    "                        exact; large traces are sampled by default\n"
+    "  -P, --page-size N     page size, 4096 by default\n"
+    "  -a, --admission       also simulate every policy behind the TinyLFU\n"
+    "                        admission filter, as 'POLICY+tinylfu'\n"
+    "  -H, --hot PAGES       pages below PAGES are the hot set; adds 'hot'\n"
+    "                        rows with the miss ratio of its accesses\n"
+    "  -o, --output PATH     write the CSV to PATH instead of stdout\n"
+    "\n"
+    "Prints CSV rows 'kind,policy,pages,accesses,misses,miss_ratio', where\n"
+    "kind is 'curve' for the LRU miss-ratio curve, 'sim' for a policy run\n"
+    "at one size and 'hot' for the accesses of that run to the hot set. The cache is simulated without shards, and a sampled\n"
+    "run simulates the policies on the sample with a scaled-down cache.\n";
+
+auto split(std::string_view text) -> std::vector<std::string> {
+  std::vector<std::string> parts;
+  while (!text.empty()) {
+    const size_t comma = text.find(',');
+    parts.emplace_back(text.substr(0, comma));
+    text = (comma == std::string_view::npos) ? "" : text.substr(comma + 1);
+  }
+  return parts;
+}
+
+template <class T>
+auto parse(std::string_view text) -> T {
+  T value{};
+  std::istringstream in{std::string(text)};
+  if (!(in >> value) || !in.eof()) {
+    throw vt::exception() << "invalid number '" << text << "'";
+  }
+  return value;
+}
+
+void print_row(
+    std::ostream& out,
+    std::string_view kind,
+    std::string_view policy,
+    uint64_t pages,
+    uint64_t accesses,
+    double ratio
+) {
+  const auto misses = static_cast<uint64_t>(
+      std::llround(ratio * static_cast<double>(accesses))
+  );
+  out << kind << ',' << policy << ',' << pages << ',' << accesses << ','
+      << misses << ',' << ratio << '\n';
+}
+
+/* Returns the miss ratio the curve predicts for LRU at the capacity. */
+auto curve_ratio(const vt::bench::curve& curve, uint64_t capacity) -> double {
+  const auto after = std::upper_bound(
+      curve.points.begin(),
+      curve.points.end(),
+      capacity,
+      [](uint64_t pages, const auto& point) { return pages < point.pages; }
+  );
+  return std::prev(after)->miss_ratio;
+}
+
+}  // namespace
+
+auto main(int argc, char** argv) -> int try {
+  static const std::vector<option> longs = {
+      {"policies", required_argument, nullptr, 'p'},
+      {"sizes", required_argument, nullptr, 's'},
+      {"rate", required_argument, nullptr, 'r'},
+      {"page-size", required_argument, nullptr, 'P'},
+      {"output", required_argument, nullptr, 'o'},
+      {"admission", no_argument, nullptr, 'a'},
+      {"hot", required_argument, nullptr, 'H'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0},
+  };
+
+  std::vector<std::string> policies = {
+      "lru", "clock", "2q", "arc", "lru-k", "optimal",
+  };
+  std::vector<size_t> sizes;
+  double rate = 0;
+  size_t page_size = 4096;  // NOLINT
+  std::string output;
+  bool admission = false;
+  uint64_t hot = 0;
+
+  int option = 0;
+  while ((option = getopt_long(  // NOLINT(concurrency-mt-unsafe)
+              argc, argv, "p:s:r:P:o:aH:h", longs.data(), nullptr
+          )) != -1) {
+    const std::string_view value = (optarg != nullptr) ? optarg : "";
+    switch (option) {
+      case 'p':
+        policies = split(value);
+        break;
+      case 's':
+        for (const auto& size : split(value)) {
+          sizes.push_back(parse<size_t>(size));
+        }
+        break;
+      case 'r':
+        rate = parse<double>(value);
+        if (rate <= 0 || rate > 1) {
+          throw vt::exception() << "the rate must be in (0, 1]";
+        }
+        break;
+      case 'P':
+        page_size = parse<size_t>(value);
+        if (page_size == 0) {
+          throw vt::exception() << "the page size must be positive";
+        }
+        break;
+      case 'o':
+        output = value;
+        break;
+      case 'a':
+        admission = true;
+        break;
+      case 'H':
+        hot = parse<uint64_t>(value);
+        break;
+      case 'h':
+        std::cout << usage;
+        return 0;
+      default:
+        std::cerr << usage;
+        return 2;
+    }
+  }
+  if (optind + 1 != argc) {
+    std::cerr << usage;
+    return 2;
+  }
+
+  const auto trace = vt::trace::open(argv[optind]);  // NOLINT
+  const auto pages = vt::bench::page_accesses(trace->records(), page_size);
+  if (rate == 0) {
+    rate = std::min(1.0, exact_limit / static_cast<double>(pages.size()));
+  }
+
+  const auto curve = vt::bench::miss_ratio_curve(pages, rate);
+  if (sizes.empty()) {
+    for (const uint64_t share : {8, 4, 2, 1}) {
+      sizes.push_back(std::max<uint64_t>(curve.unique / share, 1));
+    }
+  }
+
+  std::ofstream file;
+  if (!output.empty()) {
+    file.open(output);
+  }
+  std::ostream& out = output.empty() ? std::cout : file;
+
+  out << "kind,policy,pages,accesses,misses,miss_ratio\n";
+  for (const auto& point : curve.points) {
+    print_row(
+        out, "curve", "lru", point.pages, curve.accesses, point.miss_ratio
+    );
+  }
+
+  const auto hot_accesses = static_cast<uint64_t>(std::ranges::count_if(
+      pages, [hot](uint64_t page) { return page < hot; }
+  ));
+  std::vector<vt::bench::sim_config> configs = {{.hot = hot}};
+  if (admission) {
+    configs.push_back({.admission = true, .hot = hot});
+  }
+
+  /* Sampled policies run on the same sample with the cache scaled down. */
+  const auto sampled = vt::bench::sample(pages, rate);
+  for (const size_t size : sizes) {
+    const auto scaled = std::max<size_t>(
+        static_cast<size_t>(std::llround(static_cast<double>(size) * rate)), 1
+    );
+    for (const auto& config : configs) {
+      for (const auto& policy : policies) {
+        const auto result =
+            vt::bench::simulate(policy, sampled, scaled, config);
+        const double ratio =
+            vt::bench::miss_ratio(result.misses, pages.size(), rate);
+        print_row(out, "sim", result.policy, size, pages.size(), ratio);
+        if (hot != 0) {
+          const double hot_ratio = vt::bench::miss_ratio(
+              result.hot_misses, result.hot_accesses, 1.0
+          );
+          print_row(out, "hot", result.policy, size, hot_accesses, hot_ratio);
+        }
+
+        /* Without sampling the curve is exact, so LRU must agree with it. */
+        if (rate >= 1.0 && result.policy == "lru" &&
+            ratio != curve_ratio(curve, size)) {
+          throw vt::exception() << "lru simulated at " << size
+                                << " pages has a miss ratio of " << ratio
+                                << ", the curve " << curve_ratio(curve, size);
+        }
+      }
+    }
+  }
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,184 @@
+#include "workload.hpp"
+
+#include <sys/types.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace vt::bench {
+
+namespace {
+
+constexpr std::array<std::pair<std::string_view, pattern>, 5> patterns = {{
+    {"seq", pattern::sequential},
+    {"uniform", pattern::uniform},
+    {"zipf", pattern::zipf},
+    {"hotcold", pattern::hotcold},
+    {"scan", pattern::scan},
+}};
+
+/*
+ * Draws ranks of a Zipfian distribution over [0, n) in constant time, as in
+ * Gray et al., "Quickly Generating Billion-Record Synthetic Databases".
+ */
+class zipf_distribution {
+public:
+  zipf_distribution(size_t n, double theta)
+      : n_(n),
+        theta_(theta),
+        alpha_(1.0 / (1.0 - theta)),
+        zeta_(zeta(n, theta)),
+        eta_(
+            (1.0 - std::pow(2.0 / static_cast<double>(n), 1.0 - theta)) /
+            (1.0 - zeta(2, theta) / zeta_)
+        ) {
+  }
+
+  auto operator()(std::mt19937_64& random) const -> size_t {
+    const double u = std::uniform_real_distribution<double>(0, 1)(random);
+    const double uz = u * zeta_;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + std::pow(0.5, theta_)) {  // NOLINT
+      return 1;
+    }
+    const auto rank = static_cast<size_t>(
+        static_cast<double>(n_) * std::pow(eta_ * u - eta_ + 1.0, alpha_)
+    );
+    return std::min(rank, n_ - 1);
+  }
+
+private:
+  static auto zeta(size_t n, double theta) -> double {
+    double sum = 0;
+    for (size_t i = 1; i <= n; ++i) {
+      sum += 1.0 / std::pow(static_cast<double>(i), theta);
+    }
+    return sum;
+  }
+
+  size_t n_;
+  double theta_;
+  double alpha_;
+  double zeta_;
+  double eta_;
+};
+
+/* Spreads the popular ranks over the file, so they are not all adjacent. */
+auto scramble(size_t rank, size_t n) -> size_t {
+  uint64_t hash = 14695981039346656037ULL;  // NOLINT
+  for (size_t i = 0; i < sizeof(rank); ++i) {
+    hash ^= (rank >> (8 * i)) & 0xFFU;  // NOLINT
+    hash *= 1099511628211ULL;           // NOLINT
+  }
+  return hash % n;
+}
+
+}  // namespace
+
+auto pattern_name(pattern pattern) -> std::string_view {
+  for (const auto& [name, value] : patterns) {
+    if (value == pattern) {
+      return name;
+    }
+  }
+  return "unknown";
+}
+
+auto parse_pattern(std::string_view name) -> std::optional<pattern> {
+  for (const auto& [known, value] : patterns) {
+    if (known == name) {
+      return value;
+    }
+  }
+  return std::nullopt;
+}
+
+auto generate(const workload& workload) -> std::vector<std::vector<op>> {
+  const size_t blocks = std::max<size_t>(workload.blocks(), 1);
+  const size_t hot = std::clamp<size_t>(
+      static_cast<size_t>(
+          workload.hot_fraction * static_cast<double>(blocks)
+      ),
+      1,
+      blocks
+  );
+  const size_t cold = std::max<size_t>(blocks - hot, 1);
+  const size_t scan_length =
+      (workload.scan_length != 0) ? workload.scan_length
+                                  : std::max<size_t>(cold / 4, 1);
+
+  std::optional<zipf_distribution> zipf;
+  if (workload.pattern == pattern::zipf) {
+    zipf.emplace(blocks, workload.theta);
+  }
+
+  std::vector<std::vector<op>> trace(workload.threads);
+  for (size_t thread = 0; thread < workload.threads; ++thread) {
+    std::mt19937_64 random(workload.seed + thread);
+    std::uniform_real_distribution<double> chance(0, 1);
+    std::uniform_int_distribution<size_t> any(0, blocks - 1);
+    std::uniform_int_distribution<size_t> hot_dist(0, hot - 1);
+    std::uniform_int_distribution<size_t> cold_dist(0, cold - 1);
+
+    const size_t slice = std::max<size_t>(blocks / workload.threads, 1);
+    size_t cursor = (thread * slice) % blocks;
+    size_t scan_cursor = cold_dist(random);
+    size_t scanned = 0;
+    size_t since_scan = 0;
+
+    auto& ops = trace[thread];
+    ops.reserve(workload.ops);
+    for (size_t i = 0; i < workload.ops; ++i) {
+      size_t block = 0;
+      switch (workload.pattern) {
+        case pattern::sequential:
+          block = cursor;
+          cursor = (cursor + 1) % blocks;
+          break;
+        case pattern::uniform:
+          block = any(random);
+          break;
+        case pattern::zipf:
+          block = scramble((*zipf)(random), blocks);
+          break;
+        case pattern::hotcold:
+          block = (chance(random) < workload.hot_ratio)
+                      ? hot_dist(random)
+                      : std::min(hot + cold_dist(random), blocks - 1);
+          break;
+        case pattern::scan:
+          if (since_scan < workload.scan_interval) {
+            block = hot_dist(random);
+            since_scan += 1;
+            break;
+          }
+          block = std::min(hot + scan_cursor, blocks - 1);
+          scan_cursor = (scan_cursor + 1) % cold;
+          scanned += 1;
+          if (scanned == scan_length) {
+            scanned = 0;
+            since_scan = 0;
+          }
+          break;
+      }
+
+      ops.push_back({
+          .offset = static_cast<off_t>(block * workload.block_size),
+          .write = chance(random) >= workload.read_ratio,
+      });
+    }
+  }
+  return trace;
+}
+
+}  // namespace vt::bench
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace vt::bench {
+
+enum class pattern : uint8_t {
+  sequential,
+  uniform,
+  zipf,
+  hotcold,
+  scan,
+};
+
+auto pattern_name(pattern pattern) -> std::string_view;
+auto parse_pattern(std::string_view name) -> std::optional<pattern>;
+
+struct workload {
+  enum pattern pattern = pattern::uniform;
+  double read_ratio = 1.0;
+  size_t block_size = 4096;
+  size_t file_size = 64ULL << 20U;
+  size_t threads = 1;
+  size_t ops = 100000;
+  uint64_t seed = 1;
+
+  /* The skew of the Zipfian distribution, below 1. */
+  double theta = 0.99;
+
+  /* The share of blocks that form the hot set and the share of hot ops. */
+  double hot_fraction = 0.1;
+  double hot_ratio = 0.9;
+
+  /* Every scan_interval hot ops one scan reads scan_length cold blocks. */
+  size_t scan_interval = 1000;
+  size_t scan_length = 0;
+
+  [[nodiscard]] auto blocks() const -> size_t {
+    return file_size / block_size;
+  }
+};
+
+struct op {
+  off_t offset;
+  bool write;
+};
+
+/*
+ * Generates the ops of every thread. The trace only depends on the workload,
+ * so every backend replays the very same accesses.
+ */
+auto generate(const workload& workload) -> std::vector<std::vector<op>>;
+
+}  // namespace vt::bench
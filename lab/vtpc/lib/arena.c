@@ -0,0 +1,65 @@
+#include "arena.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+static void* vtpc_arena_map(size_t size, int flags) {
+  return mmap(
+      NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags,
+      -1, 0
+  );
+}
+
+int vtpc_arena_init(
+    struct vtpc_arena* arena, size_t size, enum vtpc_huge huge
+) {
+  *arena = (struct vtpc_arena){.huge = VTPC_HUGE_NONE};
+  if (huge != VTPC_HUGE_NONE) {
+    size = (size + VTPC_HUGE_PAGE_SIZE - 1) & ~(VTPC_HUGE_PAGE_SIZE - 1);
+  }
+
+  void* base = MAP_FAILED;
+  if (huge == VTPC_HUGE_TLB) {
+    base = vtpc_arena_map(size, MAP_HUGETLB);
+    if (base != MAP_FAILED) {
+      arena->huge = VTPC_HUGE_TLB;
+    }
+  }
+  if (base == MAP_FAILED) {
+    base = vtpc_arena_map(size, 0);
+    if (base == MAP_FAILED) {
+      errno = ENOMEM;
+      return -1;
+    }
+    /* Without THP support the arena simply stays on normal pages. */
+    if (huge != VTPC_HUGE_NONE && madvise(base, size, MADV_HUGEPAGE) == 0) {
+      arena->huge = VTPC_HUGE_THP;
+    }
+  }
+
+  arena->base = base;
+  arena->size = size;
+  return 0;
+}
+
+void vtpc_arena_destroy(struct vtpc_arena* arena) {
+  if (arena->base != NULL) {
+    munmap(arena->base, arena->size);
+  }
+  *arena = (struct vtpc_arena){0};
+}
+
+void* vtpc_arena_alloc(struct vtpc_arena* arena, size_t size, size_t align) {
+  const uintptr_t start = (uintptr_t)arena->base + arena->used;
+  const uintptr_t aligned = (start + align - 1) & ~(uintptr_t)(align - 1);
+  const size_t end = (size_t)(aligned - (uintptr_t)arena->base) + size;
+  if (end > arena->size) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  arena->used = end;
+  return (void*)aligned;
+}
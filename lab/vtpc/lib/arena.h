@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Size of the huge pages the arena is rounded up to. */
+#define VTPC_HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+
+/* What kind of huge pages back an arena. */
+enum vtpc_huge {
+  VTPC_HUGE_NONE,
+  VTPC_HUGE_THP,
+  VTPC_HUGE_TLB,
+};
+
+/*
+ * A zeroed region mapped once that memory is carved from by bumping an
+ * offset. Nothing is freed until the whole arena is, so everything carved
+ * from it must live as long as the arena. Huge says what it is actually
+ * backed by: TLB pages may be unavailable, in which case the arena falls
+ * back to transparent huge pages.
+ */
+struct vtpc_arena {
+  char* base;
+  size_t size;
+  size_t used;
+  enum vtpc_huge huge;
+};
+
+int vtpc_arena_init(struct vtpc_arena* arena, size_t size, enum vtpc_huge huge);
+void vtpc_arena_destroy(struct vtpc_arena* arena);
+
+/*
+ * Returns size bytes aligned to align, which must be a power of two, or
+ * NULL if the arena is out of room.
+ */
+void* vtpc_arena_alloc(struct vtpc_arena* arena, size_t size, size_t align);
+
+/* Returns how many bytes a carve of size bytes may take with its padding. */
+static inline size_t vtpc_arena_span(size_t size, size_t align) {
+  return size + align - 1;
+}
@@ -0,0 +1,1284 @@
+#include "cache.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "checksum.h"
+#include "crc32c.h"
+#include "dirty.h"
+#include "file.h"
+#include "io.h"
+#include "list.h"
+#include "policy.h"
+#include "stats.h"
+
+static size_t vtpc_hash(const struct vtpc_file* file, uint64_t page) {
+  uint64_t key = (uint64_t)(uintptr_t)file ^ (page * 0x9E3779B97F4A7C15ULL);
+  key ^= key >> 33U;
+  key *= 0xFF51AFD7ED558CCDULL;
+  key ^= key >> 33U;
+  return (size_t)key;
+}
+
+static uint64_t vtpc_key(const struct vtpc_frame* frame) {
+  return vtpc_hash(frame->file, frame->page);
+}
+
+static struct vtpc_shard* vtpc_cache_shard(
+    struct vtpc_cache* cache, const struct vtpc_file* file, uint64_t page
+) {
+  const size_t hash = vtpc_hash(file, page / VTPC_SHARD_EXTENT);
+  return &cache->shards[hash % cache->count];
+}
+
+static struct vtpc_file_shard* vtpc_file_shard(
+    struct vtpc_file* file, const struct vtpc_shard* shard
+) {
+  return &file->shards[shard->index];
+}
+
+static uint32_t vtpc_shard_index(
+    const struct vtpc_shard* shard, const struct vtpc_frame* frame
+) {
+  return (uint32_t)(frame - shard->frames);
+}
+
+static bool vtpc_frame_idle(const struct vtpc_frame* frame) {
+  return !(frame->flags & VTPC_FRAME_BUSY) && frame->pins == 0;
+}
+
+static bool vtpc_shard_evictable(void* ctx, uint32_t index) {
+  const struct vtpc_shard* shard = ctx;
+  return vtpc_frame_idle(&shard->frames[index]);
+}
+
+static uint32_t* vtpc_bucket(
+    struct vtpc_shard* shard, const struct vtpc_file* file, uint64_t page
+) {
+  return &shard->buckets[vtpc_hash(file, page) & shard->mask];
+}
+
+static uint32_t vtpc_shard_find(
+    struct vtpc_shard* shard, const struct vtpc_file* file, uint64_t page
+) {
+  uint32_t i = *vtpc_bucket(shard, file, page);
+  while (i != VTPC_NIL &&
+         (shard->frames[i].file != file || shard->frames[i].page != page)) {
+    i = shard->frames[i].next;
+  }
+  return i;
+}
+
+static size_t vtpc_shard_buckets(size_t capacity) {
+  size_t buckets = 1;
+  while (buckets < capacity) {
+    buckets <<= 1U;
+  }
+  return buckets;
+}
+
+static int vtpc_shard_init(
+    struct vtpc_shard* shard,
+    struct vtpc_arena* arena,
+    struct vtpc_frame* frames,
+    size_t capacity,
+    const struct vtpc_policy_ops* policy,
+    bool admission
+) {
+  const size_t buckets = vtpc_shard_buckets(capacity);
+
+  shard->frames = frames;
+  shard->capacity = capacity;
+  shard->buckets =
+      vtpc_arena_alloc(arena, buckets * sizeof(uint32_t), _Alignof(uint32_t));
+  shard->mask = buckets - 1;
+  shard->free = 0;
+  shard->policy =
+      admission
+          ? vtpc_policy_admit(policy, capacity, vtpc_shard_evictable, shard)
+          : vtpc_policy_create(policy, capacity, vtpc_shard_evictable, shard);
+  if (shard->buckets == NULL || shard->policy == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  for (size_t i = 0; i < buckets; ++i) {
+    shard->buckets[i] = VTPC_NIL;
+  }
+  for (size_t i = 0; i < capacity; ++i) {
+    frames[i].next = (i + 1 < capacity) ? (uint32_t)(i + 1) : VTPC_NIL;
+  }
+
+  pthread_mutex_init(&shard->lock, NULL);
+  pthread_cond_init(&shard->idle, NULL);
+  return 0;
+}
+
+static void vtpc_shard_destroy(struct vtpc_shard* shard) {
+  if (shard->policy != NULL) {
+    vtpc_policy_destroy(shard->policy);
+    pthread_mutex_destroy(&shard->lock);
+    pthread_cond_destroy(&shard->idle);
+  }
+}
+
+static size_t vtpc_shard_size(size_t capacity, size_t shards, size_t i) {
+  return (capacity / shards) + (i < capacity % shards ? 1 : 0);
+}
+
+/* Bounds the arena taken by the page data, frames, shards and buckets. */
+static size_t vtpc_cache_arena_size(size_t capacity, size_t shards) {
+  size_t size = vtpc_arena_span(capacity * VTPC_PAGE_SIZE, VTPC_PAGE_SIZE) +
+                vtpc_arena_span(
+                    capacity * sizeof(struct vtpc_frame),
+                    _Alignof(struct vtpc_frame)
+                ) +
+                vtpc_arena_span(
+                    shards * sizeof(struct vtpc_shard),
+                    _Alignof(struct vtpc_shard)
+                );
+  for (size_t i = 0; i < shards; ++i) {
+    const size_t buckets =
+        vtpc_shard_buckets(vtpc_shard_size(capacity, shards, i));
+    size += vtpc_arena_span(buckets * sizeof(uint32_t), _Alignof(uint32_t));
+  }
+  return size;
+}
+
+int vtpc_cache_init(
+    struct vtpc_cache* cache,
+    size_t capacity,
+    size_t shards,
+    const struct vtpc_policy_ops* policy,
+    bool admission,
+    enum vtpc_huge huge
+) {
+  if (capacity == 0 || capacity >= VTPC_NIL || shards == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (shards > capacity) {
+    shards = capacity;
+  }
+
+  /* The page data goes first, so it starts at a (huge) page boundary. */
+  *cache = (struct vtpc_cache){.capacity = capacity, .count = shards};
+  if (vtpc_arena_init(
+          &cache->arena, vtpc_cache_arena_size(capacity, shards), huge
+      ) == -1) {
+    return -1;
+  }
+  struct vtpc_arena* arena = &cache->arena;
+  cache->memory =
+      vtpc_arena_alloc(arena, capacity * VTPC_PAGE_SIZE, VTPC_PAGE_SIZE);
+  cache->frames = vtpc_arena_alloc(
+      arena, capacity * sizeof(struct vtpc_frame), _Alignof(struct vtpc_frame)
+  );
+  cache->shards = vtpc_arena_alloc(
+      arena, shards * sizeof(struct vtpc_shard), _Alignof(struct vtpc_shard)
+  );
+  for (size_t i = 0; i < capacity; ++i) {
+    cache->frames[i].data = cache->memory + (i * VTPC_PAGE_SIZE);
+  }
+  vtpc_io_init(cache->memory, capacity * VTPC_PAGE_SIZE);
+
+  size_t first = 0;
+  for (size_t i = 0; i < shards; ++i) {
+    const size_t size = vtpc_shard_size(capacity, shards, i);
+    cache->shards[i].index = i;
+    if (vtpc_shard_init(
+            &cache->shards[i],
+            arena,
+            cache->frames + first,
+            size,
+            policy,
+            admission
+        ) == -1) {
+      vtpc_cache_destroy(cache);
+      errno = ENOMEM;
+      return -1;
+    }
+    first += size;
+  }
+
+  return 0;
+}
+
+void vtpc_cache_destroy(struct vtpc_cache* cache) {
+  if (cache->shards != NULL) {
+    for (size_t i = 0; i < cache->count; ++i) {
+      vtpc_shard_destroy(&cache->shards[i]);
+    }
+  }
+  vtpc_arena_destroy(&cache->arena);
+  cache->memory = NULL;
+  cache->shards = NULL;
+  cache->frames = NULL;
+}
+
+int vtpc_cache_attach(struct vtpc_cache* cache, struct vtpc_file* file) {
+  file->shards = calloc(cache->count, sizeof(struct vtpc_file_shard));
+  if (file->shards == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+  return 0;
+}
+
+void vtpc_cache_detach(struct vtpc_cache* cache, struct vtpc_file* file) {
+  if (file->shards == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < cache->count; ++i) {
+    vtpc_dirty_destroy(&file->shards[i].dirty);
+  }
+  free(file->shards);
+  file->shards = NULL;
+}
+
+static off_t vtpc_page_offset(uint64_t page) {
+  return (off_t)(page * VTPC_PAGE_SIZE);
+}
+
+static int vtpc_page_read(struct vtpc_frame* frame) {
+  struct vtpc_file* file = frame->file;
+  const off_t offset = vtpc_page_offset(frame->page);
+
+  size_t total = 0;
+  if (offset < atomic_load(&file->disk_size)) {
+    struct iovec iov = {.iov_base = frame->data, .iov_len = VTPC_PAGE_SIZE};
+    struct vtpc_io io = {
+        .fd = file->fd,
+        .offset = offset,
+        .iov = &iov,
+        .count = 1,
+    };
+    if (vtpc_io_submit(&io, 1) == -1) {
+      return -1;
+    }
+    total = (size_t)io.result;
+  }
+
+  memset(frame->data + total, 0, VTPC_PAGE_SIZE - total);
+  return (total != 0) ? vtpc_cache_verify(file, &frame, 1, NULL) : 0;
+}
+
+/* Describes a write of pages starting from the given one. */
+static struct vtpc_io vtpc_file_run(
+    struct vtpc_file* file, struct iovec* iov, size_t count, uint64_t first
+) {
+  return (struct vtpc_io){
+      .fd = file->fd,
+      .write = true,
+      .offset = vtpc_page_offset(first),
+      .iov = iov,
+      .count = count,
+  };
+}
+
+/* Stores the checksums of the pages of a written run. */
+static int vtpc_file_checksum(
+    struct vtpc_file* file, const struct vtpc_io* io
+) {
+  uint32_t crcs[VTPC_RUN_MAX];
+  for (size_t i = 0; i < io->count; ++i) {
+    crcs[i] = vtpc_crc32c(0, io->iov[i].iov_base, VTPC_PAGE_SIZE);
+  }
+  const uint64_t first = (uint64_t)io->offset / VTPC_PAGE_SIZE;
+  return vtpc_checksums_store(file->checksums, first, io->count, crcs);
+}
+
+/*
+ * Writes a batch of runs and grows the size on disk past the written ones. A
+ * run whose checksums cannot be stored fails, so its pages stay dirty.
+ */
+static int vtpc_file_write(
+    struct vtpc_file* file, struct vtpc_io* batch, size_t count
+) {
+  pthread_rwlock_rdlock(&file->io);
+  const uint64_t start = vtpc_stats_now();
+  int status = vtpc_io_submit(batch, count);
+  int error = errno;
+  vtpc_stats_time(file->stats, VTPC_TIMER_FLUSH, start);
+  for (size_t i = 0; i < count; ++i) {
+    if (batch[i].result < 0) {
+      continue;
+    }
+    vtpc_stats_add(
+        file->stats, VTPC_COUNTER_WRITTEN_BYTES, (uint64_t)batch[i].result
+    );
+    const off_t end = batch[i].offset + (off_t)batch[i].result;
+    off_t size = atomic_load(&file->disk_size);
+    while (size < end &&
+           !atomic_compare_exchange_weak(&file->disk_size, &size, end)) {
+    }
+    if (file->checksums != NULL && vtpc_file_checksum(file, &batch[i]) == -1) {
+      batch[i].result = -1;
+      batch[i].error = errno;
+      if (status == 0) {
+        status = -1;
+        error = errno;
+      }
+    }
+  }
+  pthread_rwlock_unlock(&file->io);
+  errno = error;
+  return status;
+}
+
+/* Cuts off the tail of the last page written past the logical size. */
+static int vtpc_file_trim(struct vtpc_file* file) {
+  int status = 0;
+  pthread_rwlock_wrlock(&file->io);
+  const off_t size = atomic_load(&file->size);
+  if (atomic_load(&file->disk_size) > size) {
+    status = ftruncate(file->fd, size);
+    if (status == 0) {
+      atomic_store(&file->disk_size, size);
+    }
+  }
+  pthread_rwlock_unlock(&file->io);
+  return status;
+}
+
+static void vtpc_shard_mark_dirty(
+    struct vtpc_cache* cache, struct vtpc_shard* shard, struct vtpc_frame* frame
+) {
+  if (!(frame->flags & VTPC_FRAME_DIRTY)) {
+    frame->flags |= VTPC_FRAME_DIRTY;
+    vtpc_dirty_insert(&vtpc_file_shard(frame->file, shard)->dirty, frame->page);
+    shard->dirty += 1;
+    atomic_fetch_add(&cache->dirty, 1);
+  }
+}
+
+static bool vtpc_shard_adjacent(
+    struct vtpc_shard* shard,
+    struct vtpc_file* file,
+    const struct vtpc_dirty* dirty,
+    size_t from,
+    size_t to
+) {
+  const uint64_t lhs = dirty->pages[from < to ? from : to];
+  const uint64_t rhs = dirty->pages[from < to ? to : from];
+  if (lhs + 1 != rhs) {
+    return false;
+  }
+  const uint32_t index = vtpc_shard_find(shard, file, dirty->pages[to]);
+  return vtpc_frame_idle(&shard->frames[index]);
+}
+
+/*
+ * Finds the run of consecutive dirty pages of the file with idle frames
+ * around the one at the given position, looking back only if asked to.
+ * Returns the position of the first page and stores the length in count.
+ */
+static size_t vtpc_shard_run(
+    struct vtpc_shard* shard,
+    struct vtpc_file* file,
+    size_t at,
+    bool back,
+    size_t* count
+) {
+  const struct vtpc_dirty* dirty = &vtpc_file_shard(file, shard)->dirty;
+
+  size_t first = at;
+  while (back && first > 0 && at - first + 1 < VTPC_RUN_MAX &&
+         vtpc_shard_adjacent(shard, file, dirty, first, first - 1)) {
+    first -= 1;
+  }
+
+  size_t last = at;
+  while (last + 1 < dirty->size && last - first + 1 < VTPC_RUN_MAX &&
+         vtpc_shard_adjacent(shard, file, dirty, last, last + 1)) {
+    last += 1;
+  }
+
+  *count = last - first + 1;
+  return first;
+}
+
+/* Collects the frames of dirty pages [at, at + count) of the file. */
+static void vtpc_shard_prepare(
+    struct vtpc_shard* shard,
+    struct vtpc_file* file,
+    size_t at,
+    size_t count,
+    struct vtpc_frame** frames,
+    struct iovec* iov
+) {
+  const struct vtpc_dirty* dirty = &vtpc_file_shard(file, shard)->dirty;
+  for (size_t i = 0; i < count; ++i) {
+    const uint32_t index = vtpc_shard_find(shard, file, dirty->pages[at + i]);
+    frames[i] = &shard->frames[index];
+    iov[i] = (struct iovec){
+        .iov_base = frames[i]->data,
+        .iov_len = VTPC_PAGE_SIZE,
+    };
+  }
+}
+
+/* Takes dirty pages [at, at + count) of the file out of the dirty set. */
+static void vtpc_shard_clean(
+    struct vtpc_cache* cache,
+    struct vtpc_shard* shard,
+    struct vtpc_file* file,
+    size_t at,
+    size_t count,
+    struct vtpc_frame** frames
+) {
+  for (size_t i = 0; i < count; ++i) {
+    frames[i]->flags &= ~VTPC_FRAME_DIRTY;
+  }
+  vtpc_dirty_erase(&vtpc_file_shard(file, shard)->dirty, at, count);
+  shard->dirty -= count;
+  atomic_fetch_sub(&cache->dirty, count);
+}
+
+/*
+ * Writes a batch of runs of dirty pages of the file, the one of each io
+ * starting at its position in runs, with the frames and iovecs of all of
+ * them in a row. The lock is dropped during the write: the pages leave the
+ * dirty set marked WRITEBACK, which writers wait for, and go back to it if
+ * their run fails.
+ */
+static int vtpc_shard_write(
+    struct vtpc_cache* cache,
+    struct vtpc_shard* shard,
+    struct vtpc_file* file,
+    struct vtpc_io* batch,
+    const size_t* runs,
+    size_t count,
+    struct vtpc_frame** frames,
+    const struct iovec* iov
+) {
+  struct vtpc_file_shard* state = vtpc_file_shard(file, shard);
+  size_t pages = 0;
+  /* Erasing from the back keeps the positions of earlier runs valid. */
+  for (size_t i = count; i-- > 0;) {
+    struct vtpc_frame** run = frames + (batch[i].iov - iov);
+    vtpc_shard_clean(cache, shard, file, runs[i], batch[i].count, run);
+    for (size_t j = 0; j < batch[i].count; ++j) {
+      run[j]->flags |= VTPC_FRAME_WRITEBACK;
+    }
+    pages += batch[i].count;
+  }
+  state->writeback += pages;
+
+  pthread_mutex_unlock(&shard->lock);
+  const int status = vtpc_file_write(file, batch, count);
+  const int error = errno;
+  pthread_mutex_lock(&shard->lock);
+
+  for (size_t i = 0; i < count; ++i) {
+    struct vtpc_frame** run = frames + (batch[i].iov - iov);
+    for (size_t j = 0; j < batch[i].count; ++j) {
+      run[j]->flags &= ~VTPC_FRAME_WRITEBACK;
+      if (batch[i].result < 0) {
+        vtpc_shard_mark_dirty(cache, shard, run[j]);
+      }
+    }
+    if (batch[i].result >= 0) {
+      vtpc_stats_add(file->stats, VTPC_COUNTER_WRITES, 1);
+      vtpc_stats_add(file->stats, VTPC_COUNTER_WRITTEN, batch[i].count);
+    }
+  }
+  state->writeback -= pages;
+  pthread_cond_broadcast(&shard->idle);
+
+  errno = error;
+  return status;
+}
+
+/* Writes the run of dirty pages around the one of the frame. */
+static int vtpc_shard_write_run(
+    struct vtpc_cache* cache, struct vtpc_shard* shard, struct vtpc_frame* frame
+) {
+  struct vtpc_file* file = frame->file;
+  const struct vtpc_dirty* dirty = &vtpc_file_shard(file, shard)->dirty;
+  const size_t at = vtpc_dirty_find(dirty, frame->page);
+  size_t count = 0;
+  const size_t run = vtpc_shard_run(shard, file, at, true, &count);
+
+  struct vtpc_frame* frames[VTPC_RUN_MAX];
+  struct iovec iov[VTPC_RUN_MAX];
+  vtpc_shard_prepare(shard, file, run, count, frames, iov);
+  struct vtpc_io io = vtpc_file_run(file, iov, count, dirty->pages[run]);
+  return vtpc_shard_write(cache, shard, file, &io, &run, 1, frames, iov);
+}
+
+static void vtpc_shard_unlink(struct vtpc_shard* shard, uint32_t index) {
+  struct vtpc_frame* frame = &shard->frames[index];
+  uint32_t* link = vtpc_bucket(shard, frame->file, frame->page);
+  while (*link != index) {
+    link = &shard->frames[*link].next;
+  }
+  *link = frame->next;
+}
+
+static void vtpc_shard_release(struct vtpc_shard* shard, uint32_t index) {
+  struct vtpc_frame* frame = &shard->frames[index];
+  vtpc_file_shard(frame->file, shard)->frames -= 1;
+  atomic_fetch_sub(&frame->file->pages, 1);
+  vtpc_shard_unlink(shard, index);
+  frame->file = NULL;
+  frame->flags = 0;
+  frame->pins = 0;
+  frame->borrows = 0;
+  frame->next = shard->free;
+  shard->free = index;
+}
+
+/*
+ * Evicts the victim of the policy. A dirty victim is written first, with the
+ * lock dropped and the victim marked EVICTING, so that whoever looks its page
+ * up waits until it is gone. Returns 1 if the lock was dropped.
+ */
+static int vtpc_shard_evict(
+    struct vtpc_cache* cache, struct vtpc_shard* shard
+) {
+  const uint32_t victim = vtpc_policy_evict(shard->policy);
+  if (victim == VTPC_NIL) {
+    errno = ENOBUFS;
+    return -1;
+  }
+
+  struct vtpc_frame* frame = &shard->frames[victim];
+  const bool dirty = (frame->flags & VTPC_FRAME_DIRTY) != 0;
+  if (dirty) {
+    frame->flags |= VTPC_FRAME_EVICTING;
+    const int status = vtpc_shard_write_run(cache, shard, frame);
+    frame->flags &= ~VTPC_FRAME_EVICTING;
+    if (status == -1) {
+      const int error = errno;
+      vtpc_policy_insert(shard->policy, victim, vtpc_key(frame));
+      errno = error;
+      return -1;
+    }
+  }
+
+  if (frame->flags & VTPC_FRAME_PREFETCHED) {
+    vtpc_stats_add(frame->file->stats, VTPC_COUNTER_PREFETCH_WASTED, 1);
+  }
+  vtpc_stats_add(frame->file->stats, VTPC_COUNTER_EVICTIONS, 1);
+  vtpc_shard_release(shard, victim);
+  return dirty ? 1 : 0;
+}
+
+/*
+ * Takes a free frame for the page, evicting one if there is none. Fails
+ * with EEXIST if the page was cached by someone else while the lock was
+ * dropped to write the victim.
+ */
+static uint32_t vtpc_shard_alloc(
+    struct vtpc_cache* cache,
+    struct vtpc_shard* shard,
+    struct vtpc_file* file,
+    uint64_t page,
+    uint32_t flags
+) {
+  if (shard->free == VTPC_NIL) {
+    const int evicted = vtpc_shard_evict(cache, shard);
+    if (evicted == -1) {
+      return VTPC_NIL;
+    }
+    if (evicted == 1 && vtpc_shard_find(shard, file, page) != VTPC_NIL) {
+      errno = EEXIST;
+      return VTPC_NIL;
+    }
+  }
+
+  struct vtpc_file_shard* state = vtpc_file_shard(file, shard);
+  if (vtpc_dirty_reserve(&state->dirty, state->frames + 1) == -1) {
+    return VTPC_NIL;
+  }
+
+  const uint32_t index = shard->free;
+  struct vtpc_frame* frame = &shard->frames[index];
+  shard->free = frame->next;
+
+  uint32_t* bucket = vtpc_bucket(shard, file, page);
+  state->frames += 1;
+  atomic_fetch_add(&file->pages, 1);
+  frame->file = file;
+  frame->page = page;
+  frame->flags = flags;
+  frame->pins = 0;
+  frame->borrows = 0;
+  frame->next = *bucket;
+  *bucket = index;
+  vtpc_policy_insert(shard->policy, index, vtpc_key(frame));
+  return index;
+}
+
+/* Tells whether some frame of the shard is going to become idle soon. */
+static bool vtpc_shard_busy(const struct vtpc_shard* shard) {
+  for (size_t i = 0; i < shard->capacity; ++i) {
+    const struct vtpc_frame* frame = &shard->frames[i];
+    if ((frame->flags & VTPC_FRAME_BUSY) || frame->pins > frame->borrows) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Finds the page, waiting while it is being read, or written back if the
+ * caller is going to change it. On a miss allocates a frame with the given
+ * flags; if there is no frame to evict because all of them are in use,
+ * waits for them. Unless block is set, fails with EAGAIN instead of waiting.
+ */
+static uint32_t vtpc_shard_acquire(
+    struct vtpc_cache* cache,
+    struct vtpc_shard* shard,
+    struct vtpc_file* file,
+    uint64_t page,
+    uint32_t wait,
+    uint32_t flags,
+    bool block,
+    bool* hit
+) {
+  bool missed = false;
+  for (;;) {
+    const uint32_t cached = vtpc_shard_find(shard, file, page);
+    if (cached != VTPC_NIL && (shard->frames[cached].flags & wait)) {
+      if (!block) {
+        errno = EAGAIN;
+        return VTPC_NIL;
+      }
+      pthread_cond_wait(&shard->idle, &shard->lock);
+      continue;
+    }
+
+    *hit = (cached != VTPC_NIL);
+    if (cached != VTPC_NIL) {
+      return cached;
+    }
+
+    if (!missed) {
+      vtpc_stats_add(file->stats, VTPC_COUNTER_MISSES, 1);
+      vtpc_policy_miss(shard->policy, vtpc_hash(file, page));
+      missed = true;
+    }
+    const uint32_t index = vtpc_shard_alloc(cache, shard, file, page, flags);
+    if (index == VTPC_NIL && errno == EEXIST) {
+      continue;
+    }
+    if (index != VTPC_NIL || errno != ENOBUFS || !vtpc_shard_busy(shard)) {
+      return index;
+    }
+    if (!block) {
+      errno = EAGAIN;
+      return VTPC_NIL;
+    }
+    pthread_cond_wait(&shard->idle, &shard->lock);
+  }
+}
+
+/*
+ * Pins the page without reading it: a missed page is left LOADING for the
+ * caller to read, or FILLING for it to overwrite whole. Unless block is set,
+ * fails with EAGAIN where it would wait.
+ */
+static struct vtpc_frame* vtpc_shard_take(
+    struct vtpc_cache* cache,
+    struct vtpc_shard* shard,
+    struct vtpc_file* file,
+    uint64_t page,
+    enum vtpc_access access,
+    bool borrow,
+    bool block,
+    bool* hit
+) {
+  const uint32_t wait = (access == VTPC_ACCESS_READ)
+                            ? VTPC_FRAME_LOADING | VTPC_FRAME_EVICTING |
+                                  VTPC_FRAME_FILLING
+                            : VTPC_FRAME_BUSY;
+  const uint32_t flags = (access == VTPC_ACCESS_OVERWRITE)
+                             ? VTPC_FRAME_FILLING
+                             : VTPC_FRAME_LOADING;
+  const uint32_t index =
+      vtpc_shard_acquire(cache, shard, file, page, wait, flags, block, hit);
+  if (index == VTPC_NIL) {
+    return NULL;
+  }
+
+  struct vtpc_frame* frame = &shard->frames[index];
+  frame->pins += 1;
+  frame->borrows += borrow ? 1 : 0;
+  if (*hit) {
+    if (frame->flags & VTPC_FRAME_PREFETCHED) {
+      frame->flags &= ~VTPC_FRAME_PREFETCHED;
+      vtpc_stats_add(file->stats, VTPC_COUNTER_PREFETCH_HITS, 1);
+    }
+    vtpc_policy_hit(shard->policy, index);
+    vtpc_stats_add(file->stats, VTPC_COUNTER_HITS, 1);
+  }
+  return frame;
+}
+
+static struct vtpc_frame* vtpc_shard_pin(
+    struct vtpc_cache* cache,
+    struct vtpc_shard* shard,
+    struct vtpc_file* file,
+    uint64_t page,
+    enum vtpc_access access,
+    bool borrow,
+    bool* hit
+) {
+  struct vtpc_frame* frame =
+      vtpc_shard_take(cache, shard, file, page, access, borrow, true, hit);
+  if (frame == NULL || *hit || !(frame->flags & VTPC_FRAME_LOADING)) {
+    return frame;
+  }
+
+  pthread_mutex_unlock(&shard->lock);
+  const uint64_t start = vtpc_stats_now();
+  const int status = vtpc_page_read(frame);
+  const int error = errno;
+  vtpc_stats_time(file->stats, VTPC_TIMER_MISS, start);
+  pthread_mutex_lock(&shard->lock);
+
+  frame->flags &= ~VTPC_FRAME_LOADING;
+  frame->flags |= VTPC_FRAME_VALID;
+  pthread_cond_broadcast(&shard->idle);
+  if (status == -1) {
+    const uint32_t index = vtpc_shard_index(shard, frame);
+    vtpc_policy_remove(shard->policy, index);
+    vtpc_shard_release(shard, index);
+    errno = error;
+    return NULL;
+  }
+  return frame;
+}
+
+static struct vtpc_frame* vtpc_cache_take(
+    struct vtpc_cache* cache,
+    struct vtpc_file* file,
+    uint64_t page,
+    enum vtpc_access access,
+    bool borrow,
+    bool* hit
+) {
+  struct vtpc_shard* shard = vtpc_cache_shard(cache, file, page);
+  bool cached = false;
+
+  pthread_mutex_lock(&shard->lock);
+  struct vtpc_frame* frame =
+      vtpc_shard_pin(cache, shard, file, page, access, borrow, &cached);
+  pthread_mutex_unlock(&shard->lock);
+
+  if (hit != NULL) {
+    *hit = cached;
+  }
+  return frame;
+}
+
+static void vtpc_cache_put(
+    struct vtpc_cache* cache, struct vtpc_frame* frame, bool dirty, bool borrow
+) {
+  struct vtpc_shard* shard = vtpc_cache_shard(cache, frame->file, frame->page);
+
+  pthread_mutex_lock(&shard->lock);
+  if (dirty) {
+    vtpc_shard_mark_dirty(cache, shard, frame);
+  }
+  frame->pins -= 1;
+  frame->borrows -= borrow ? 1 : 0;
+  /* The writer of a page that was filling has copied it in by now. */
+  if (frame->flags & VTPC_FRAME_FILLING) {
+    frame->flags &= ~VTPC_FRAME_FILLING;
+    frame->flags |= VTPC_FRAME_VALID;
+    pthread_cond_broadcast(&shard->idle);
+  } else if (frame->pins == 0) {
+    pthread_cond_broadcast(&shard->idle);
+  }
+  pthread_mutex_unlock(&shard->lock);
+}
+
+struct vtpc_frame* vtpc_cache_pin(
+    struct vtpc_cache* cache,
+    struct vtpc_file* file,
+    uint64_t page,
+    enum vtpc_access access,
+    bool* hit
+) {
+  return vtpc_cache_take(cache, file, page, access, false, hit);
+}
+
+void vtpc_cache_unpin(
+    struct vtpc_cache* cache, struct vtpc_frame* frame, bool dirty
+) {
+  vtpc_cache_put(cache, frame, dirty, false);
+}
+
+struct vtpc_frame* vtpc_cache_borrow(
+    struct vtpc_cache* cache,
+    struct vtpc_file* file,
+    uint64_t page,
+    enum vtpc_access access,
+    bool* hit
+) {
+  return vtpc_cache_take(cache, file, page, access, true, hit);
+}
+
+void vtpc_cache_return(
+    struct vtpc_cache* cache, struct vtpc_frame* frame, bool dirty
+) {
+  vtpc_cache_put(cache, frame, dirty, true);
+}
+
+int vtpc_cache_verify(
+    struct vtpc_file* file,
+    struct vtpc_frame* const* frames,
+    size_t count,
+    bool* bad
+) {
+  if (file->checksums == NULL) {
+    return 0;
+  }
+
+  uint32_t crcs[VTPC_RUN_MAX];
+  size_t errors = 0;
+  size_t i = 0;
+  while (i < count) {
+    /* One load covers the frames within VTPC_RUN_MAX pages of the first. */
+    const uint64_t first = frames[i]->page;
+    size_t end = i + 1;
+    while (end < count && frames[end]->page - first < VTPC_RUN_MAX) {
+      end += 1;
+    }
+    const size_t span = frames[end - 1]->page - first + 1;
+    if (vtpc_checksums_load(file->checksums, first, span, crcs) == -1) {
+      return -1;
+    }
+
+    for (; i < end; ++i) {
+      const uint32_t expected = crcs[frames[i]->page - first];
+      const bool mismatch =
+          expected != 0 &&
+          vtpc_crc32c(0, frames[i]->data, VTPC_PAGE_SIZE) != expected;
+      if (bad != NULL) {
+        bad[i] = mismatch;
+      }
+      errors += mismatch ? 1 : 0;
+    }
+  }
+
+  if (errors != 0) {
+    vtpc_stats_add(file->stats, VTPC_COUNTER_CHECKSUM_ERRORS, errors);
+    errno = EIO;
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Reads the missed pages of a range with one batch, a run per stretch of
+ * consecutive pages, and zero-fills them past the end of the file on disk.
+ * The frames are in the order of their pages.
+ */
+static int vtpc_range_read(
+    struct vtpc_file* file, struct vtpc_frame* const* frames, size_t count
+) {
+  struct iovec iov[VTPC_RUN_MAX];
+  struct vtpc_io batch[VTPC_RUN_MAX];
+  const off_t disk_size = atomic_load(&file->disk_size);
+
+  size_t stored = 0;
+  size_t runs = 0;
+  for (; stored < count; ++stored) {
+    const struct vtpc_frame* frame = frames[stored];
+    if (vtpc_page_offset(frame->page) >= disk_size) {
+      break;
+    }
+    iov[stored] = (struct iovec){
+        .iov_base = frame->data,
+        .iov_len = VTPC_PAGE_SIZE,
+    };
+    if (stored == 0 || frame->page != frames[stored - 1]->page + 1) {
+      batch[runs++] = (struct vtpc_io){
+          .fd = file->fd,
+          .offset = vtpc_page_offset(frame->page),
+          .iov = &iov[stored],
+          .count = 0,
+      };
+    }
+    batch[runs - 1].count += 1;
+  }
+  if (runs > 0 && vtpc_io_submit(batch, runs) == -1) {
+    return -1;
+  }
+
+  for (size_t i = 0; i < runs; ++i) {
+    const struct vtpc_io* io = &batch[i];
+    size_t done = (size_t)io->result;
+    for (size_t j = 0; j < io->count; ++j) {
+      const size_t got = (done < VTPC_PAGE_SIZE) ? done : VTPC_PAGE_SIZE;
+      memset((char*)io->iov[j].iov_base + got, 0, VTPC_PAGE_SIZE - got);
+      done -= got;
+    }
+  }
+  for (size_t i = stored; i < count; ++i) {
+    memset(frames[i]->data, 0, VTPC_PAGE_SIZE);
+  }
+  return vtpc_cache_verify(file, frames, stored, NULL);
+}
+
+ssize_t vtpc_cache_pin_range(
+    struct vtpc_cache* cache,
+    struct vtpc_file* file,
+    off_t offset,
+    size_t size,
+    bool write,
+    struct vtpc_frame** frames,
+    bool* hits
+) {
+  const uint64_t first = (uint64_t)offset / VTPC_PAGE_SIZE;
+  const uint64_t last = ((uint64_t)offset + size - 1) / VTPC_PAGE_SIZE;
+  struct vtpc_shard* shard = vtpc_cache_shard(cache, file, first);
+  size_t count = last - first + 1;
+  if (count > VTPC_SHARD_EXTENT - (first % VTPC_SHARD_EXTENT)) {
+    count = VTPC_SHARD_EXTENT - (first % VTPC_SHARD_EXTENT);
+  }
+  if (count > shard->capacity / 2) {
+    count = (shard->capacity > 1) ? shard->capacity / 2 : 1;
+  }
+
+  struct vtpc_frame* missed[VTPC_RUN_MAX];
+  size_t misses = 0;
+  size_t pinned = 0;
+  pthread_mutex_lock(&shard->lock);
+  for (; pinned < count; ++pinned) {
+    const uint64_t page = first + pinned;
+    const off_t start = vtpc_page_offset(page);
+    enum vtpc_access access = VTPC_ACCESS_READ;
+    if (write) {
+      const bool whole = start >= offset &&
+                         start + VTPC_PAGE_SIZE <= offset + (off_t)size;
+      access = whole ? VTPC_ACCESS_OVERWRITE : VTPC_ACCESS_WRITE;
+    }
+
+    /* Waiting with unread frames pinned could wait for this very thread. */
+    bool hit = false;
+    struct vtpc_frame* frame = vtpc_shard_take(
+        cache, shard, file, page, access, false, pinned == 0, &hit
+    );
+    if (frame == NULL) {
+      break;
+    }
+    frames[pinned] = frame;
+    hits[pinned] = hit;
+    if (!hit && (frame->flags & VTPC_FRAME_LOADING)) {
+      missed[misses++] = frame;
+    }
+  }
+  const int failure = errno;
+  pthread_mutex_unlock(&shard->lock);
+  if (pinned == 0) {
+    errno = failure;
+    return -1;
+  }
+  if (misses == 0) {
+    return (ssize_t)pinned;
+  }
+
+  const uint64_t start = vtpc_stats_now();
+  const int status = vtpc_range_read(file, missed, misses);
+  const int error = errno;
+  for (size_t i = 0; i < misses; ++i) {
+    vtpc_stats_time(file->stats, VTPC_TIMER_MISS, start);
+  }
+
+  pthread_mutex_lock(&shard->lock);
+  for (size_t i = 0; i < pinned; ++i) {
+    struct vtpc_frame* frame = frames[i];
+    if (!hits[i] && (frame->flags & VTPC_FRAME_LOADING)) {
+      frame->flags &= ~VTPC_FRAME_LOADING;
+      frame->flags |= VTPC_FRAME_VALID;
+    }
+    if (status == -1) {
+      frame->pins -= 1;
+      /* A missed page holds no data, but others may have it pinned. */
+      if (!hits[i] && frame->pins == 0) {
+        const uint32_t index = vtpc_shard_index(shard, frame);
+        vtpc_policy_remove(shard->policy, index);
+        vtpc_shard_release(shard, index);
+      }
+    }
+  }
+  pthread_cond_broadcast(&shard->idle);
+  pthread_mutex_unlock(&shard->lock);
+
+  if (status == -1) {
+    errno = error;
+    return -1;
+  }
+  return (ssize_t)pinned;
+}
+
+struct vtpc_frame* vtpc_cache_frame(
+    struct vtpc_cache* cache, const void* data
+) {
+  const char* address = data;
+  if (cache->memory == NULL || address < cache->memory ||
+      address >= cache->memory + (cache->capacity * VTPC_PAGE_SIZE)) {
+    return NULL;
+  }
+
+  const size_t offset = (size_t)(address - cache->memory);
+  if (offset % VTPC_PAGE_SIZE != 0) {
+    return NULL;
+  }
+  return &cache->frames[offset / VTPC_PAGE_SIZE];
+}
+
+struct vtpc_frame* vtpc_cache_reserve(
+    struct vtpc_cache* cache, struct vtpc_file* file, uint64_t page
+) {
+  struct vtpc_shard* shard = vtpc_cache_shard(cache, file, page);
+  struct vtpc_frame* frame = NULL;
+
+  pthread_mutex_lock(&shard->lock);
+  if (vtpc_shard_find(shard, file, page) == VTPC_NIL) {
+    const uint32_t index = vtpc_shard_alloc(
+        cache, shard, file, page, VTPC_FRAME_LOADING | VTPC_FRAME_PREFETCHED
+    );
+    if (index != VTPC_NIL) {
+      frame = &shard->frames[index];
+      vtpc_stats_add(file->stats, VTPC_COUNTER_PREFETCHED, 1);
+    }
+  }
+  pthread_mutex_unlock(&shard->lock);
+  return frame;
+}
+
+void vtpc_cache_complete(
+    struct vtpc_cache* cache, struct vtpc_frame* frame, bool ok
+) {
+  struct vtpc_shard* shard = vtpc_cache_shard(cache, frame->file, frame->page);
+
+  pthread_mutex_lock(&shard->lock);
+  frame->flags &= ~VTPC_FRAME_LOADING;
+  frame->flags |= VTPC_FRAME_VALID;
+  if (!ok) {
+    const uint32_t index = vtpc_shard_index(shard, frame);
+    vtpc_policy_remove(shard->policy, index);
+    vtpc_shard_release(shard, index);
+  }
+  pthread_cond_broadcast(&shard->idle);
+  pthread_mutex_unlock(&shard->lock);
+}
+
+int vtpc_cache_advise(
+    struct vtpc_cache* cache,
+    struct vtpc_file* file,
+    uint64_t page,
+    uint64_t when
+) {
+  struct vtpc_shard* shard = vtpc_cache_shard(cache, file, page);
+
+  pthread_mutex_lock(&shard->lock);
+  uint32_t frame = vtpc_shard_find(shard, file, page);
+  /* A page being evicted has already left the policy. */
+  if (frame != VTPC_NIL && (shard->frames[frame].flags & VTPC_FRAME_EVICTING)) {
+    frame = VTPC_NIL;
+  }
+  const int status =
+      vtpc_policy_advise(shard->policy, frame, vtpc_hash(file, page), when);
+  pthread_mutex_unlock(&shard->lock);
+  return status;
+}
+
+/*
+ * Writes the idle dirty pages of the file, submitting runs together in
+ * batches of up to VTPC_RUN_MAX pages. The lock is dropped during each
+ * batch, so the pages are walked by number rather than by position: those
+ * dirtied behind the ones written meanwhile are left to the next flush.
+ */
+static int vtpc_shard_flush(
+    struct vtpc_cache* cache, struct vtpc_shard* shard, struct vtpc_file* file
+) {
+  struct vtpc_file_shard* state = vtpc_file_shard(file, shard);
+  while (state->writeback != 0) {
+    pthread_cond_wait(&shard->idle, &shard->lock);
+  }
+
+  struct vtpc_frame* frames[VTPC_RUN_MAX];
+  struct iovec iov[VTPC_RUN_MAX];
+  struct vtpc_io batch[VTPC_RUN_MAX];
+  size_t runs[VTPC_RUN_MAX];
+
+  uint64_t next = 0;
+  size_t at = 0;
+  while ((at = vtpc_dirty_find(&state->dirty, next)) < state->dirty.size) {
+    size_t pages = 0;
+    size_t count = 0;
+    while (at < state->dirty.size && pages < VTPC_RUN_MAX) {
+      const uint32_t index =
+          vtpc_shard_find(shard, file, state->dirty.pages[at]);
+      if (!vtpc_frame_idle(&shard->frames[index])) {
+        at += 1;
+        continue;
+      }
+
+      size_t length = 0;
+      vtpc_shard_run(shard, file, at, false, &length);
+      if (length > VTPC_RUN_MAX - pages) {
+        length = VTPC_RUN_MAX - pages;
+      }
+      vtpc_shard_prepare(
+          shard, file, at, length, frames + pages, iov + pages
+      );
+      batch[count] =
+          vtpc_file_run(file, iov + pages, length, state->dirty.pages[at]);
+      runs[count] = at;
+      count += 1;
+      pages += length;
+      at += length;
+    }
+    next = state->dirty.pages[at - 1] + 1;
+
+    if (count == 0) {
+      continue;
+    }
+    const int status =
+        vtpc_shard_write(cache, shard, file, batch, runs, count, frames, iov);
+    if (status == -1) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int vtpc_cache_flush(struct vtpc_cache* cache, struct vtpc_file* file) {
+  for (size_t i = 0; i < cache->count; ++i) {
+    struct vtpc_shard* shard = &cache->shards[i];
+    pthread_mutex_lock(&shard->lock);
+    const int status = vtpc_shard_flush(cache, shard, file);
+    pthread_mutex_unlock(&shard->lock);
+    if (status == -1) {
+      return -1;
+    }
+  }
+  return vtpc_file_trim(file);
+}
+
+/* Tells whether a page of the file in the shard is pinned or busy. */
+static bool vtpc_shard_used(
+    const struct vtpc_shard* shard, const struct vtpc_file* file
+) {
+  for (size_t i = 0; i < shard->capacity; ++i) {
+    const struct vtpc_frame* frame = &shard->frames[i];
+    if (frame->file == file && !vtpc_frame_idle(frame)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void vtpc_cache_drop(struct vtpc_cache* cache, struct vtpc_file* file) {
+  for (size_t i = 0; i < cache->count; ++i) {
+    struct vtpc_shard* shard = &cache->shards[i];
+    struct vtpc_file_shard* state = vtpc_file_shard(file, shard);
+    pthread_mutex_lock(&shard->lock);
+    while (state->writeback != 0 || vtpc_shard_used(shard, file)) {
+      pthread_cond_wait(&shard->idle, &shard->lock);
+    }
+
+    const size_t dirty = state->dirty.size;
+    vtpc_dirty_erase(&state->dirty, 0, dirty);
+    shard->dirty -= dirty;
+    atomic_fetch_sub(&cache->dirty, dirty);
+    for (size_t j = 0; j < shard->capacity; ++j) {
+      if (shard->frames[j].file == file) {
+        vtpc_policy_remove(shard->policy, (uint32_t)j);
+        vtpc_shard_release(shard, (uint32_t)j);
+      }
+    }
+    pthread_mutex_unlock(&shard->lock);
+  }
+}
+
+static uint32_t vtpc_shard_next_dirty(struct vtpc_shard* shard) {
+  for (size_t i = 0; i < shard->capacity; ++i) {
+    const size_t index = (shard->hand + i) % shard->capacity;
+    const struct vtpc_frame* frame = &shard->frames[index];
+    if ((frame->flags & VTPC_FRAME_DIRTY) && vtpc_frame_idle(frame)) {
+      shard->hand = (index + 1) % shard->capacity;
+      return (uint32_t)index;
+    }
+  }
+  return VTPC_NIL;
+}
+
+int vtpc_cache_writeback(struct vtpc_cache* cache) {
+  const size_t start = atomic_fetch_add(&cache->hand, 1);
+  for (size_t i = 0; i < cache->count; ++i) {
+    struct vtpc_shard* shard = &cache->shards[(start + i) % cache->count];
+
+    pthread_mutex_lock(&shard->lock);
+    const uint32_t index =
+        (shard->dirty != 0) ? vtpc_shard_next_dirty(shard) : VTPC_NIL;
+    const int status =
+        (index != VTPC_NIL)
+            ? vtpc_shard_write_run(cache, shard, &shard->frames[index])
+            : 0;
+    pthread_mutex_unlock(&shard->lock);
+
+    if (index != VTPC_NIL) {
+      return status;
+    }
+  }
+  errno = ENODATA;
+  return -1;
+}
+
+void vtpc_cache_stats(struct vtpc_cache* cache, struct vtpc_stats* stats) {
+  vtpc_stats_global(stats);
+  stats->dirty = atomic_load(&cache->dirty);
+}
+
+/* Counts the dirty pages of the file over all shards. */
+static uint64_t vtpc_cache_file_dirty(
+    struct vtpc_cache* cache, struct vtpc_file* file
+) {
+  uint64_t dirty = 0;
+  for (size_t i = 0; i < cache->count; ++i) {
+    struct vtpc_shard* shard = &cache->shards[i];
+    pthread_mutex_lock(&shard->lock);
+    dirty += vtpc_file_shard(file, shard)->dirty.size;
+    pthread_mutex_unlock(&shard->lock);
+  }
+  return dirty;
+}
+
+void vtpc_cache_file_stats(
+    struct vtpc_cache* cache, struct vtpc_file* file, struct vtpc_stats* stats
+) {
+  vtpc_stats_file(file->stats, stats);
+  stats->dirty = vtpc_cache_file_dirty(cache, file);
+}
+
+void vtpc_cache_usage(
+    struct vtpc_cache* cache, struct vtpc_file* file, struct vtpc_usage* usage
+) {
+  struct vtpc_stats stats;
+  vtpc_stats_file(file->stats, &stats);
+  *usage = (struct vtpc_usage){
+      .pages = atomic_load(&file->pages),
+      .dirty = vtpc_cache_file_dirty(cache, file),
+      .hits = stats.hits,
+      .misses = stats.misses,
+  };
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "arena.h"
+#include "file.h"
+#include "policy.h"
+#include "vtpc.h"
+
+#define VTPC_PAGE_SIZE 4096
+#define VTPC_DEFAULT_CAPACITY 1024
+#define VTPC_DEFAULT_SHARDS 8
+
+/* Longest run of pages read or written with a single syscall. */
+#define VTPC_RUN_MAX 256
+
+/*
+ * Pages are spread over shards by extents of this many pages, so runs of
+ * consecutive pages mostly stay within one shard.
+ */
+#define VTPC_SHARD_EXTENT VTPC_RUN_MAX
+
+enum {
+  VTPC_FRAME_VALID = 1U << 0U,
+  VTPC_FRAME_DIRTY = 1U << 1U,
+  VTPC_FRAME_LOADING = 1U << 2U,
+  VTPC_FRAME_PREFETCHED = 1U << 3U,
+  VTPC_FRAME_WRITEBACK = 1U << 4U,
+  VTPC_FRAME_EVICTING = 1U << 5U,
+  VTPC_FRAME_FILLING = 1U << 6U,
+  VTPC_FRAME_BUSY = VTPC_FRAME_LOADING | VTPC_FRAME_WRITEBACK |
+                    VTPC_FRAME_EVICTING | VTPC_FRAME_FILLING,
+};
+
+/*
+ * A pinned frame cannot be evicted, so its data may be copied without the
+ * shard lock. Frames that are being read or written without the lock are
+ * marked LOADING or WRITEBACK, a missed page that is going to be overwritten
+ * whole FILLING until its writer unpins it, and a dirty victim that is
+ * written before it is evicted EVICTING; whoever needs such a frame waits on
+ * the idle condition of the shard. Borrows are pins held by vtpc_map until
+ * the user lets go of the page, so nobody waits for them to go away.
+ */
+struct vtpc_frame {
+  struct vtpc_file* file;
+  uint64_t page;
+  uint32_t next;
+  uint32_t flags;
+  uint32_t pins;
+  uint32_t borrows;
+  char* data;
+};
+
+/*
+ * A part of the cache with its own frames, page table and policy instance,
+ * all protected by its lock. Frame indices are local to the shard.
+ */
+struct vtpc_shard {
+  pthread_mutex_t lock;
+  pthread_cond_t idle;
+  struct vtpc_frame* frames;
+  size_t capacity;
+  size_t index;
+  uint32_t* buckets;
+  size_t mask;
+  uint32_t free;
+  struct vtpc_policy* policy;
+  size_t dirty;
+  size_t hand;
+};
+
+/*
+ * The page data, frames, shards and page tables are all carved from one
+ * arena mapped at init, so the cache never allocates once it is set up. The
+ * data of all frames is one region, so it can be registered for I/O.
+ */
+struct vtpc_cache {
+  struct vtpc_arena arena;
+  struct vtpc_frame* frames;
+  char* memory;
+  size_t capacity;
+  struct vtpc_shard* shards;
+  size_t count;
+  atomic_size_t dirty;
+  atomic_size_t hand;
+  atomic_uint_fast64_t clock;
+};
+
+/* How a pinned page is going to be used. */
+enum vtpc_access {
+  VTPC_ACCESS_READ,
+  VTPC_ACCESS_WRITE,
+  VTPC_ACCESS_OVERWRITE,
+};
+
+/* Admission puts a TinyLFU filter in front of the policy of every shard. */
+int vtpc_cache_init(
+    struct vtpc_cache* cache,
+    size_t capacity,
+    size_t shards,
+    const struct vtpc_policy_ops* policy,
+    bool admission,
+    enum vtpc_huge huge
+);
+void vtpc_cache_destroy(struct vtpc_cache* cache);
+
+/* Sets up and tears down the per-shard state of a file. */
+int vtpc_cache_attach(struct vtpc_cache* cache, struct vtpc_file* file);
+void vtpc_cache_detach(struct vtpc_cache* cache, struct vtpc_file* file);
+
+/*
+ * Returns the pinned frame holding the given page of the file, reading it
+ * from disk on a miss unless the whole page is going to be overwritten. If
+ * hit is not NULL, it is set to whether the page was already cached.
+ */
+struct vtpc_frame* vtpc_cache_pin(
+    struct vtpc_cache* cache,
+    struct vtpc_file* file,
+    uint64_t page,
+    enum vtpc_access access,
+    bool* hit
+);
+
+/* Releases a pinned frame, marking it dirty if its data was changed. */
+void vtpc_cache_unpin(
+    struct vtpc_cache* cache, struct vtpc_frame* frame, bool dirty
+);
+
+/*
+ * Pins a frame like vtpc_cache_pin for as long as the user holds it. Fails
+ * with ENOBUFS instead of waiting when the shard has no frame left that is
+ * not borrowed.
+ */
+struct vtpc_frame* vtpc_cache_borrow(
+    struct vtpc_cache* cache,
+    struct vtpc_file* file,
+    uint64_t page,
+    enum vtpc_access access,
+    bool* hit
+);
+void vtpc_cache_return(
+    struct vtpc_cache* cache, struct vtpc_frame* frame, bool dirty
+);
+
+/*
+ * Pins the frames of the consecutive pages holding up to size bytes from
+ * offset, which must be at least one, in one pass under the shard lock, and
+ * reads all the missed ones with one batch. Pages a write covers whole are
+ * not read. The pass ends at the end of the shard extent, at half of the
+ * shard, or, once it holds a page, at one it would have to wait for. Stores
+ * the frames and whether each page was cached and returns how many there
+ * are, at most VTPC_RUN_MAX.
+ */
+ssize_t vtpc_cache_pin_range(
+    struct vtpc_cache* cache,
+    struct vtpc_file* file,
+    off_t offset,
+    size_t size,
+    bool write,
+    struct vtpc_frame** frames,
+    bool* hits
+);
+
+/*
+ * Checks the data read into the frames, in the order of their pages, against
+ * the checksums stored for them, if the file has any. Fails with EIO if any
+ * of them does not match, counting those in the stats and setting them in
+ * bad unless it is NULL.
+ */
+int vtpc_cache_verify(
+    struct vtpc_file* file,
+    struct vtpc_frame* const* frames,
+    size_t count,
+    bool* bad
+);
+
+/* Returns the frame whose data starts at the given address, or NULL. */
+struct vtpc_frame* vtpc_cache_frame(
+    struct vtpc_cache* cache, const void* data
+);
+
+/*
+ * Allocates a LOADING frame for a page that is going to be read ahead.
+ * Returns NULL if the page is already cached or no frame can be evicted.
+ */
+struct vtpc_frame* vtpc_cache_reserve(
+    struct vtpc_cache* cache, struct vtpc_file* file, uint64_t page
+);
+
+/* Finishes the read of a reserved frame and wakes up waiters. */
+void vtpc_cache_complete(
+    struct vtpc_cache* cache, struct vtpc_frame* frame, bool ok
+);
+
+/* Tells the policy when the page is going to be accessed next. */
+int vtpc_cache_advise(
+    struct vtpc_cache* cache,
+    struct vtpc_file* file,
+    uint64_t page,
+    uint64_t when
+);
+
+/*
+ * Writes all dirty pages of the file, one pwritev per run of consecutive
+ * pages, after waiting for the background writeback of the file.
+ */
+int vtpc_cache_flush(struct vtpc_cache* cache, struct vtpc_file* file);
+
+/*
+ * Forgets all pages of the file, dirty ones included, once its background
+ * writeback is over and the readers still using some of them are done.
+ */
+void vtpc_cache_drop(struct vtpc_cache* cache, struct vtpc_file* file);
+
+/*
+ * Writes back one run of dirty pages of any file without holding the shard
+ * lock during the write. Returns -1 if there is nothing to write or the
+ * write failed.
+ */
+int vtpc_cache_writeback(struct vtpc_cache* cache);
+
+/* Sums the counters of all threads and counts the dirty pages. */
+void vtpc_cache_stats(struct vtpc_cache* cache, struct vtpc_stats* stats);
+
+/* Sums the counters of the file and counts its dirty pages. */
+void vtpc_cache_file_stats(
+    struct vtpc_cache* cache, struct vtpc_file* file, struct vtpc_stats* stats
+);
+
+/* Reports the pages of the file in the cache and its hits and misses. */
+void vtpc_cache_usage(
+    struct vtpc_cache* cache, struct vtpc_file* file, struct vtpc_usage* usage
+);
@@ -0,0 +1,221 @@
+#include "checksum.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define VTPC_CHECKSUMS_MAGIC 0x43524356U
+
+/*
+ * The header of a sidecar. A clean one holds the size and modification time
+ * the file had when it was closed, which tell whether the file has been
+ * written without the checksums since.
+ */
+struct vtpc_checksums_header {
+  uint32_t magic;
+  uint32_t clean;
+  int64_t size;
+  int64_t sec;
+  int64_t nsec;
+};
+
+struct vtpc_checksums {
+  int fd;
+  bool writable;
+};
+
+static off_t vtpc_checksums_offset(uint64_t page) {
+  return (off_t)(sizeof(struct vtpc_checksums_header) +
+                 (page * sizeof(uint32_t)));
+}
+
+static char* vtpc_checksums_path(const char* path) {
+  const size_t length = strlen(path);
+  char* name = malloc(length + sizeof(VTPC_CHECKSUM_SUFFIX));
+  if (name == NULL) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  memcpy(name, path, length);
+  memcpy(name + length, VTPC_CHECKSUM_SUFFIX, sizeof(VTPC_CHECKSUM_SUFFIX));
+  return name;
+}
+
+/* Reads or writes all of count bytes at the position. */
+static int vtpc_checksums_io(
+    int fd, bool write, void* buf, size_t count, off_t at, size_t* done
+) {
+  size_t total = 0;
+  while (total < count) {
+    char* data = (char*)buf + total;
+    const ssize_t n = write ? pwrite(fd, data, count - total, at)
+                            : pread(fd, data, count - total, at);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n == -1) {
+      return -1;
+    }
+    if (n == 0) {
+      break;
+    }
+    total += (size_t)n;
+    at += n;
+  }
+  if (done != NULL) {
+    *done = total;
+  }
+  return 0;
+}
+
+/* Writes the header, stamped with the file if it is clean. */
+static int vtpc_checksums_mark(int fd, const struct stat* st) {
+  struct vtpc_checksums_header header = {.magic = VTPC_CHECKSUMS_MAGIC};
+  if (st != NULL) {
+    header.clean = 1;
+    header.size = st->st_size;
+    header.sec = st->st_mtim.tv_sec;
+    header.nsec = st->st_mtim.tv_nsec;
+  }
+  return vtpc_checksums_io(fd, true, &header, sizeof(header), 0, NULL);
+}
+
+/* Tells whether the sidecar was closed cleanly with the file as it is. */
+static int vtpc_checksums_clean(int fd, const struct stat* st, bool* clean) {
+  struct vtpc_checksums_header header = {0};
+  size_t got = 0;
+  if (vtpc_checksums_io(fd, false, &header, sizeof(header), 0, &got) == -1) {
+    return -1;
+  }
+  *clean = (got == sizeof(header) && header.magic == VTPC_CHECKSUMS_MAGIC &&
+            header.clean != 0 && header.size == st->st_size &&
+            header.sec == st->st_mtim.tv_sec &&
+            header.nsec == st->st_mtim.tv_nsec);
+  return 0;
+}
+
+/*
+ * Marks a writable sidecar as not matching the file, on the disk before the
+ * file is written, and starts it over unless it was closed cleanly.
+ */
+static int vtpc_checksums_begin(int fd, const struct stat* st) {
+  bool clean = false;
+  if (vtpc_checksums_clean(fd, st, &clean) == -1 ||
+      (!clean && ftruncate(fd, 0) == -1) ||
+      vtpc_checksums_mark(fd, NULL) == -1) {
+    return -1;
+  }
+  return fdatasync(fd);
+}
+
+/* Fails with ENOENT unless a read-only sidecar can be trusted. */
+static int vtpc_checksums_check(int fd, const struct stat* st) {
+  bool clean = false;
+  if (vtpc_checksums_clean(fd, st, &clean) == -1) {
+    return -1;
+  }
+  if (!clean) {
+    errno = ENOENT;
+    return -1;
+  }
+  return 0;
+}
+
+struct vtpc_checksums* vtpc_checksums_open(
+    const char* path, bool writable, const struct stat* st
+) {
+  char* name = vtpc_checksums_path(path);
+  if (name == NULL) {
+    return NULL;
+  }
+  const int fd = writable ? open(name, O_RDWR | O_CREAT, 0600)
+                          : open(name, O_RDONLY);
+  const int error = errno;
+  free(name);
+  if (fd == -1) {
+    errno = error;
+    return NULL;
+  }
+
+  struct vtpc_checksums* checksums = malloc(sizeof(struct vtpc_checksums));
+  if (checksums == NULL) {
+    close(fd);
+    errno = ENOMEM;
+    return NULL;
+  }
+  *checksums = (struct vtpc_checksums){.fd = fd, .writable = writable};
+
+  const int status = writable ? vtpc_checksums_begin(fd, st)
+                              : vtpc_checksums_check(fd, st);
+  if (status == -1) {
+    const int failure = errno;
+    close(fd);
+    free(checksums);
+    errno = failure;
+    return NULL;
+  }
+  return checksums;
+}
+
+int vtpc_checksums_close(
+    struct vtpc_checksums* checksums, const struct stat* st
+) {
+  int status = 0;
+  if (checksums->writable && st != NULL &&
+      (fdatasync(checksums->fd) == -1 ||
+       vtpc_checksums_mark(checksums->fd, st) == -1)) {
+    status = -1;
+  }
+  const int error = errno;
+  if (close(checksums->fd) == -1 && status == 0) {
+    status = -1;
+  } else {
+    errno = error;
+  }
+  free(checksums);
+  return status;
+}
+
+int vtpc_checksums_load(
+    struct vtpc_checksums* checksums,
+    uint64_t first,
+    size_t count,
+    uint32_t* crcs
+) {
+  const size_t size = count * sizeof(uint32_t);
+  size_t got = 0;
+  if (vtpc_checksums_io(
+          checksums->fd, false, crcs, size, vtpc_checksums_offset(first), &got
+      ) == -1) {
+    return -1;
+  }
+  memset((char*)crcs + got, 0, size - got);
+  return 0;
+}
+
+int vtpc_checksums_store(
+    struct vtpc_checksums* checksums,
+    uint64_t first,
+    size_t count,
+    const uint32_t* crcs
+) {
+  return vtpc_checksums_io(
+      checksums->fd,
+      true,
+      (void*)crcs,
+      count * sizeof(uint32_t),
+      vtpc_checksums_offset(first),
+      NULL
+  );
+}
+
+int vtpc_checksums_reset(struct vtpc_checksums* checksums) {
+  return ftruncate(checksums->fd, vtpc_checksums_offset(0));
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+/* The checksums of a file live next to it, named after it with this suffix. */
+#define VTPC_CHECKSUM_SUFFIX ".vtpc-crc"
+
+/*
+ * The CRC32C of every page of a file as it was last written back, kept in a
+ * sidecar file: a header, then one checksum per page. A checksum of 0 stands
+ * for none, as for holes and pages written before checksums were enabled.
+ *
+ * The sidecar and the file are not updated atomically, so the header tells
+ * whether the sidecar matches the file. Opening it for writing marks it as
+ * not matching until it is closed after the file has been synced, stamped
+ * with the size and modification time of the file. A sidecar open for
+ * writing, left behind by a crash or older than the file is not used for
+ * reading and starts over on the next open for writing.
+ */
+struct vtpc_checksums;
+
+/*
+ * Opens the checksums of the file at path with the given status, creating
+ * them if writable. Fails with ENOENT if there are none to use for a
+ * read-only file.
+ */
+struct vtpc_checksums* vtpc_checksums_open(
+    const char* path, bool writable, const struct stat* st
+);
+
+/*
+ * Closes the checksums. Given the status of the file, which the caller has
+ * synced with all its writes, marks those of a writable file as matching it.
+ */
+int vtpc_checksums_close(
+    struct vtpc_checksums* checksums, const struct stat* st
+);
+
+/*
+ * Loads the checksums of count pages starting with first; those of pages
+ * past the end of the sidecar are 0.
+ */
+int vtpc_checksums_load(
+    struct vtpc_checksums* checksums,
+    uint64_t first,
+    size_t count,
+    uint32_t* crcs
+);
+
+/* Stores the checksums of count pages starting with first. */
+int vtpc_checksums_store(
+    struct vtpc_checksums* checksums,
+    uint64_t first,
+    size_t count,
+    const uint32_t* crcs
+);
+
+/* Forgets all checksums when the file is emptied. */
+int vtpc_checksums_reset(struct vtpc_checksums* checksums);
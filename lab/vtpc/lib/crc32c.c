@@ -0,0 +1,141 @@
+#include "crc32c.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define VTPC_CRC32C_HARDWARE
+#endif
+
+/* The reflected Castagnoli polynomial. */
+#define VTPC_CRC32C_POLY 0x82F63B78U
+
+/*
+ * The hardware path splits the data into blocks of three stripes of this
+ * many bytes and runs the CRC of each stripe as a separate dependency
+ * chain, so the crc32 instructions overlap in the pipeline. A 4 KiB page is
+ * one block and 16 bytes.
+ */
+#define VTPC_CRC32C_STRIPE 1360
+
+static uint32_t table[256];
+static pthread_once_t table_once = PTHREAD_ONCE_INIT;
+static bool hardware;
+
+/* The checksums of a stripe and of two, moved past one and two stripes. */
+static uint32_t stripe_shift;
+static uint32_t block_shift;
+
+/*
+ * Multiplies two polynomials modulo the CRC polynomial, in the reflected
+ * order where the top bit is the coefficient of x^0.
+ */
+static uint32_t vtpc_crc32c_multiply(uint32_t lhs, uint32_t rhs) {
+  uint32_t product = 0;
+  for (uint32_t bit = 1U << 31U; bit != 0; bit >>= 1U) {
+    if (lhs & bit) {
+      product ^= rhs;
+    }
+    rhs = (rhs & 1U) ? (rhs >> 1U) ^ VTPC_CRC32C_POLY : rhs >> 1U;
+  }
+  return product;
+}
+
+/* Returns x^(8 * size) modulo the polynomial, which shifts a CRC by size. */
+static uint32_t vtpc_crc32c_shift(uint64_t size) {
+  uint32_t result = 1U << 31U;
+  uint32_t square = 1U << 30U;
+  for (uint64_t exponent = 8 * size; exponent != 0; exponent >>= 1U) {
+    if (exponent & 1U) {
+      result = vtpc_crc32c_multiply(square, result);
+    }
+    square = vtpc_crc32c_multiply(square, square);
+  }
+  return result;
+}
+
+static void vtpc_crc32c_init(void) {
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc & 1U) ? (crc >> 1U) ^ VTPC_CRC32C_POLY : crc >> 1U;
+    }
+    table[i] = crc;
+  }
+  stripe_shift = vtpc_crc32c_shift(VTPC_CRC32C_STRIPE);
+  block_shift = vtpc_crc32c_shift(2 * VTPC_CRC32C_STRIPE);
+#ifdef VTPC_CRC32C_HARDWARE
+  hardware = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+static uint32_t vtpc_crc32c_software(
+    uint32_t state, const unsigned char* bytes, size_t size
+) {
+  for (size_t i = 0; i < size; ++i) {
+    state = table[(state ^ bytes[i]) & 0xFFU] ^ (state >> 8U);
+  }
+  return state;
+}
+
+#ifdef VTPC_CRC32C_HARDWARE
+static uint64_t vtpc_crc32c_load(const unsigned char* bytes) {
+  uint64_t word = 0;
+  memcpy(&word, bytes, sizeof(word));
+  return word;
+}
+
+__attribute__((target("sse4.2"))) static uint32_t vtpc_crc32c_hardware(
+    uint32_t state, const unsigned char* bytes, size_t size
+) {
+  while (size >= 3 * VTPC_CRC32C_STRIPE) {
+    uint64_t first = state;
+    uint64_t second = 0;
+    uint64_t third = 0;
+    for (size_t i = 0; i < VTPC_CRC32C_STRIPE; i += 8) {
+      first = _mm_crc32_u64(first, vtpc_crc32c_load(bytes + i));
+      second = _mm_crc32_u64(
+          second, vtpc_crc32c_load(bytes + VTPC_CRC32C_STRIPE + i)
+      );
+      third = _mm_crc32_u64(
+          third, vtpc_crc32c_load(bytes + (2 * VTPC_CRC32C_STRIPE) + i)
+      );
+    }
+    /* The CRC of a concatenation is that of its parts shifted into place. */
+    state = vtpc_crc32c_multiply(block_shift, (uint32_t)first) ^
+            vtpc_crc32c_multiply(stripe_shift, (uint32_t)second) ^
+            (uint32_t)third;
+    bytes += 3 * VTPC_CRC32C_STRIPE;
+    size -= 3 * VTPC_CRC32C_STRIPE;
+  }
+
+  uint64_t wide = state;
+  for (; size >= 8; bytes += 8, size -= 8) {
+    wide = _mm_crc32_u64(wide, vtpc_crc32c_load(bytes));
+  }
+  state = (uint32_t)wide;
+  for (; size > 0; ++bytes, --size) {
+    state = _mm_crc32_u8(state, *bytes);
+  }
+  return state;
+}
+#endif
+
+uint32_t vtpc_crc32c(uint32_t crc, const void* data, size_t size) {
+  pthread_once(&table_once, vtpc_crc32c_init);
+#ifdef VTPC_CRC32C_HARDWARE
+  if (hardware) {
+    return ~vtpc_crc32c_hardware(~crc, data, size);
+  }
+#endif
+  return ~vtpc_crc32c_software(~crc, data, size);
+}
+
+const char* vtpc_crc32c_backend(void) {
+  pthread_once(&table_once, vtpc_crc32c_init);
+  return hardware ? "sse4.2" : "table";
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Extends a CRC32C (Castagnoli) checksum with size more bytes. Start with 0;
+ * the checksum of a buffer is the same however it is split into calls.
+ */
+uint32_t vtpc_crc32c(uint32_t crc, const void* data, size_t size);
+
+/* Returns the implementation in use, "sse4.2" or "table". */
+const char* vtpc_crc32c_backend(void);
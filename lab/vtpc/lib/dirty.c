@@ -0,0 +1,70 @@
+#include "dirty.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+void vtpc_dirty_destroy(struct vtpc_dirty* dirty) {
+  free(dirty->pages);
+  *dirty = (struct vtpc_dirty){0};
+}
+
+int vtpc_dirty_reserve(struct vtpc_dirty* dirty, size_t capacity) {
+  if (capacity <= dirty->capacity) {
+    return 0;
+  }
+
+  size_t grown = (dirty->capacity == 0) ? 16 : dirty->capacity;
+  while (grown < capacity) {
+    grown *= 2;
+  }
+
+  uint64_t* pages = realloc(dirty->pages, grown * sizeof(uint64_t));
+  if (pages == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+  dirty->pages = pages;
+  dirty->capacity = grown;
+  return 0;
+}
+
+size_t vtpc_dirty_find(const struct vtpc_dirty* dirty, uint64_t page) {
+  size_t lo = 0;
+  size_t hi = dirty->size;
+  while (lo < hi) {
+    const size_t mid = lo + ((hi - lo) / 2);
+    if (dirty->pages[mid] < page) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+void vtpc_dirty_insert(struct vtpc_dirty* dirty, uint64_t page) {
+  const size_t at = vtpc_dirty_find(dirty, page);
+  if (at < dirty->size && dirty->pages[at] == page) {
+    return;
+  }
+
+  memmove(
+      dirty->pages + at + 1,
+      dirty->pages + at,
+      (dirty->size - at) * sizeof(uint64_t)
+  );
+  dirty->pages[at] = page;
+  dirty->size += 1;
+}
+
+void vtpc_dirty_erase(struct vtpc_dirty* dirty, size_t at, size_t count) {
+  memmove(
+      dirty->pages + at,
+      dirty->pages + at + count,
+      (dirty->size - at - count) * sizeof(uint64_t)
+  );
+  dirty->size -= count;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Sorted set of dirty pages of a file. Keeping the pages ordered lets
+ * neighbouring dirty pages be found by looking at adjacent entries, so they
+ * can be written back as one contiguous run.
+ */
+struct vtpc_dirty {
+  uint64_t* pages;
+  size_t size;
+  size_t capacity;
+};
+
+void vtpc_dirty_destroy(struct vtpc_dirty* dirty);
+
+/* Makes room for the given number of pages, so inserts cannot fail. */
+int vtpc_dirty_reserve(struct vtpc_dirty* dirty, size_t capacity);
+
+/* Returns the position of the first page not less than the given one. */
+size_t vtpc_dirty_find(const struct vtpc_dirty* dirty, uint64_t page);
+
+/* Inserts a page; room for it must have been reserved. */
+void vtpc_dirty_insert(struct vtpc_dirty* dirty, uint64_t page);
+void vtpc_dirty_erase(struct vtpc_dirty* dirty, size_t at, size_t count);
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "checksum.h"
+#include "dirty.h"
+#include "journal.h"
+#include "stats.h"
+
+/*
+ * Sequential stream state of a file: the last page read, the last readahead
+ * window and the page whose access triggers the next window.
+ */
+struct vtpc_stream {
+  uint64_t prev;
+  uint64_t start;
+  size_t size;
+  uint64_t marker;
+};
+
+/*
+ * Dirty pages of a file that live in one cache shard, the number of them
+ * being written back and the number of pages of the file in the shard, which
+ * the dirty set always has room for, so any of them can turn dirty without
+ * an allocation. Protected by the lock of the shard.
+ */
+struct vtpc_file_shard {
+  struct vtpc_dirty dirty;
+  size_t writeback;
+  size_t frames;
+};
+
+struct vtpc_handle;
+
+/* A page borrowed by vtpc_map and the handle it was borrowed through. */
+struct vtpc_borrow {
+  const void* page;
+  struct vtpc_handle* handle;
+};
+
+/*
+ * The pages of a file borrowed by vtpc_map, which keep the file from being
+ * truncated and their handles from being closed. Protected by its own lock.
+ */
+struct vtpc_maps {
+  pthread_mutex_t lock;
+  struct vtpc_borrow* borrows;
+  size_t count;
+  size_t capacity;
+};
+
+/*
+ * A file shared by all its open handles, found by device and inode. The lock
+ * is held shared by writes and maps, from the journal record to the last
+ * page copied, and exclusively to truncate the file or empty its journal;
+ * reads do not take it. The io lock is held shared while pages are written
+ * and exclusively while the file is truncated back to its logical size, so a
+ * truncation cannot cut off a page written concurrently by another thread.
+ * The handle count and the list link are protected by the table lock of
+ * vtpc.c; the page count and the counters are updated by the cache. The
+ * checksums, if pages are checksummed, are stored as pages are written and
+ * checked as they are read; those of a read-only file opened for writing are
+ * retired rather than closed, as readers may still be checking pages against
+ * them.
+ */
+struct vtpc_file {
+  pthread_rwlock_t lock;
+  pthread_rwlock_t io;
+  int fd;
+  bool writable;
+  dev_t dev;
+  ino_t ino;
+  size_t refs;
+  struct vtpc_file* next;
+  _Atomic(off_t) size;
+  _Atomic(off_t) disk_size;
+  struct vtpc_file_shard* shards;
+  struct vtpc_maps maps;
+  atomic_size_t pages;
+  struct vtpc_stripe* stats;
+  struct vtpc_journal* journal;
+  _Atomic(struct vtpc_checksums*) checksums;
+  struct vtpc_checksums* retired;
+};
+
+/*
+ * An open descriptor of a file with its own mode, offset and stream. The
+ * lock protects the offset and is held through the reads, writes and seeks
+ * that use it, while positional ones leave it alone. The stream lock is only
+ * held while the stream is updated. Users counts the operations in flight,
+ * along with a high bit that close sets before it waits for them to be done.
+ * Maps counts the pages borrowed through the handle and is protected by the
+ * lock of the maps of the file.
+ */
+struct vtpc_handle {
+  struct vtpc_file* file;
+  int flags;
+  pthread_mutex_t lock;
+  off_t offset;
+  pthread_mutex_t stream_lock;
+  struct vtpc_stream stream;
+  atomic_size_t users;
+  size_t maps;
+};
+
+static inline bool vtpc_handle_readable(const struct vtpc_handle* handle) {
+  return (handle->flags & O_ACCMODE) != O_WRONLY;
+}
+
+static inline bool vtpc_handle_writable(const struct vtpc_handle* handle) {
+  return (handle->flags & O_ACCMODE) != O_RDONLY;
+}
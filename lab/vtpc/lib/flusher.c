@@ -0,0 +1,75 @@
+#include "flusher.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cache.h"
+
+static struct {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wakeup;
+  bool enabled;
+  bool poked;
+  size_t high;
+  size_t low;
+} flusher = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wakeup = PTHREAD_COND_INITIALIZER,
+};
+
+static void* vtpc_flusher_main(void* arg) {
+  struct vtpc_cache* cache = arg;
+
+  for (;;) {
+    pthread_mutex_lock(&flusher.lock);
+    while (!flusher.poked) {
+      pthread_cond_wait(&flusher.wakeup, &flusher.lock);
+    }
+    flusher.poked = false;
+    pthread_mutex_unlock(&flusher.lock);
+
+    /* After a failed write, retry only when a new write pokes the flusher. */
+    while (atomic_load(&cache->dirty) > flusher.low &&
+           vtpc_cache_writeback(cache) == 0) {
+    }
+  }
+  return NULL;
+}
+
+int vtpc_flusher_init(struct vtpc_cache* cache, unsigned ratio) {
+  if (ratio == 0) {
+    return 0;
+  }
+  if (ratio > 100) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  flusher.high = cache->capacity * ratio / 100;
+  flusher.low = flusher.high / 2;
+
+  const int error =
+      pthread_create(&flusher.thread, NULL, vtpc_flusher_main, cache);
+  if (error != 0) {
+    errno = error;
+    return -1;
+  }
+  pthread_detach(flusher.thread);
+  flusher.enabled = true;
+  return 0;
+}
+
+void vtpc_flusher_poke(struct vtpc_cache* cache) {
+  if (!flusher.enabled || atomic_load(&cache->dirty) <= flusher.high) {
+    return;
+  }
+
+  pthread_mutex_lock(&flusher.lock);
+  flusher.poked = true;
+  pthread_cond_signal(&flusher.wakeup);
+  pthread_mutex_unlock(&flusher.lock);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "cache.h"
+
+/*
+ * Background writeback. Once dirty pages exceed the dirty ratio (a percentage
+ * of the cache capacity), a thread writes runs of them back until they drop
+ * to half of it, so fsync and eviction find little left to write.
+ */
+
+/* Starts the flusher thread. A dirty ratio of 0 disables it. */
+int vtpc_flusher_init(struct vtpc_cache* cache, unsigned ratio);
+
+/* Wakes up the flusher if there are too many dirty pages. */
+void vtpc_flusher_poke(struct vtpc_cache* cache);
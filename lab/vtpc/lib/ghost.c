@@ -0,0 +1,107 @@
+#include "ghost.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "list.h"
+
+static uint32_t* vtpc_ghost_bucket(
+    const struct vtpc_ghost* ghost, uint64_t key
+) {
+  return &ghost->buckets[(key ^ (key >> 29U)) & ghost->mask];
+}
+
+int vtpc_ghost_init(struct vtpc_ghost* ghost, size_t capacity) {
+  if (capacity == 0) {
+    capacity = 1;
+  }
+
+  size_t buckets = 1;
+  while (buckets < capacity) {
+    buckets <<= 1U;
+  }
+
+  *ghost = (struct vtpc_ghost){
+      .keys = malloc(capacity * sizeof(uint64_t)),
+      .values = malloc(capacity * sizeof(uint64_t)),
+      .links = malloc(capacity * sizeof(struct vtpc_link)),
+      .chain = malloc(capacity * sizeof(uint32_t)),
+      .buckets = malloc(buckets * sizeof(uint32_t)),
+      .mask = buckets - 1,
+      .capacity = capacity,
+      .free = 0,
+  };
+  vtpc_list_init(&ghost->lru);
+
+  if (ghost->keys == NULL || ghost->values == NULL || ghost->links == NULL ||
+      ghost->chain == NULL || ghost->buckets == NULL) {
+    vtpc_ghost_destroy(ghost);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  for (size_t i = 0; i < buckets; ++i) {
+    ghost->buckets[i] = VTPC_NIL;
+  }
+  for (size_t i = 0; i < capacity; ++i) {
+    ghost->chain[i] = (i + 1 < capacity) ? (uint32_t)(i + 1) : VTPC_NIL;
+  }
+  return 0;
+}
+
+void vtpc_ghost_destroy(struct vtpc_ghost* ghost) {
+  free(ghost->keys);
+  free(ghost->values);
+  free(ghost->links);
+  free(ghost->chain);
+  free(ghost->buckets);
+  *ghost = (struct vtpc_ghost){0};
+}
+
+uint32_t vtpc_ghost_find(const struct vtpc_ghost* ghost, uint64_t key) {
+  uint32_t node = *vtpc_ghost_bucket(ghost, key);
+  while (node != VTPC_NIL && ghost->keys[node] != key) {
+    node = ghost->chain[node];
+  }
+  return node;
+}
+
+void vtpc_ghost_push(struct vtpc_ghost* ghost, uint64_t key, uint64_t value) {
+  const uint32_t existing = vtpc_ghost_find(ghost, key);
+  if (existing != VTPC_NIL) {
+    vtpc_ghost_erase(ghost, existing);
+  }
+  if (ghost->free == VTPC_NIL) {
+    vtpc_ghost_pop(ghost);
+  }
+
+  const uint32_t node = ghost->free;
+  ghost->free = ghost->chain[node];
+
+  uint32_t* bucket = vtpc_ghost_bucket(ghost, key);
+  ghost->keys[node] = key;
+  ghost->values[node] = value;
+  ghost->chain[node] = *bucket;
+  *bucket = node;
+  vtpc_list_push_front(&ghost->lru, ghost->links, node);
+}
+
+void vtpc_ghost_erase(struct vtpc_ghost* ghost, uint32_t node) {
+  uint32_t* link = vtpc_ghost_bucket(ghost, ghost->keys[node]);
+  while (*link != node) {
+    link = &ghost->chain[*link];
+  }
+  *link = ghost->chain[node];
+
+  vtpc_list_remove(&ghost->lru, ghost->links, node);
+  ghost->chain[node] = ghost->free;
+  ghost->free = node;
+}
+
+void vtpc_ghost_pop(struct vtpc_ghost* ghost) {
+  if (ghost->lru.tail != VTPC_NIL) {
+    vtpc_ghost_erase(ghost, ghost->lru.tail);
+  }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "list.h"
+
+/*
+ * Bounded LRU set of keys of pages that are no longer cached, with one value
+ * attached to each key. Used by policies that remember recently evicted pages.
+ */
+struct vtpc_ghost {
+  uint64_t* keys;
+  uint64_t* values;
+  struct vtpc_link* links;
+  uint32_t* chain;
+  uint32_t* buckets;
+  size_t mask;
+  size_t capacity;
+  uint32_t free;
+  struct vtpc_list lru;
+};
+
+int vtpc_ghost_init(struct vtpc_ghost* ghost, size_t capacity);
+void vtpc_ghost_destroy(struct vtpc_ghost* ghost);
+
+uint32_t vtpc_ghost_find(const struct vtpc_ghost* ghost, uint64_t key);
+void vtpc_ghost_push(struct vtpc_ghost* ghost, uint64_t key, uint64_t value);
+void vtpc_ghost_erase(struct vtpc_ghost* ghost, uint32_t node);
+void vtpc_ghost_pop(struct vtpc_ghost* ghost);
+
+static inline size_t vtpc_ghost_size(const struct vtpc_ghost* ghost) {
+  return ghost->lru.size;
+}
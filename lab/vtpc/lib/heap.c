@@ -0,0 +1,106 @@
+#include "heap.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "list.h"
+
+static void vtpc_heap_place(struct vtpc_heap* heap, size_t at, uint32_t frame) {
+  heap->items[at] = frame;
+  heap->positions[frame] = (uint32_t)at;
+}
+
+static void vtpc_heap_up(struct vtpc_heap* heap, size_t at) {
+  const uint32_t frame = heap->items[at];
+  const uint64_t key = heap->keys[frame];
+  while (at > 0) {
+    const size_t parent = (at - 1) / 2;
+    if (heap->keys[heap->items[parent]] <= key) {
+      break;
+    }
+    vtpc_heap_place(heap, at, heap->items[parent]);
+    at = parent;
+  }
+  vtpc_heap_place(heap, at, frame);
+}
+
+static void vtpc_heap_down(struct vtpc_heap* heap, size_t at) {
+  const uint32_t frame = heap->items[at];
+  const uint64_t key = heap->keys[frame];
+  for (;;) {
+    size_t child = (2 * at) + 1;
+    if (child >= heap->size) {
+      break;
+    }
+    if (child + 1 < heap->size &&
+        heap->keys[heap->items[child + 1]] < heap->keys[heap->items[child]]) {
+      child += 1;
+    }
+    if (key <= heap->keys[heap->items[child]]) {
+      break;
+    }
+    vtpc_heap_place(heap, at, heap->items[child]);
+    at = child;
+  }
+  vtpc_heap_place(heap, at, frame);
+}
+
+int vtpc_heap_init(struct vtpc_heap* heap, size_t capacity) {
+  *heap = (struct vtpc_heap){
+      .items = malloc(capacity * sizeof(uint32_t)),
+      .positions = malloc(capacity * sizeof(uint32_t)),
+      .keys = malloc(capacity * sizeof(uint64_t)),
+      .size = 0,
+      .capacity = capacity,
+  };
+  if (heap->items == NULL || heap->positions == NULL || heap->keys == NULL) {
+    vtpc_heap_destroy(heap);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  for (size_t i = 0; i < capacity; ++i) {
+    heap->positions[i] = VTPC_NIL;
+  }
+  return 0;
+}
+
+void vtpc_heap_destroy(struct vtpc_heap* heap) {
+  free(heap->items);
+  free(heap->positions);
+  free(heap->keys);
+  *heap = (struct vtpc_heap){0};
+}
+
+void vtpc_heap_push(struct vtpc_heap* heap, uint32_t frame, uint64_t key) {
+  heap->keys[frame] = key;
+  vtpc_heap_place(heap, heap->size, frame);
+  heap->size += 1;
+  vtpc_heap_up(heap, heap->size - 1);
+}
+
+void vtpc_heap_update(struct vtpc_heap* heap, uint32_t frame, uint64_t key) {
+  const uint64_t old = heap->keys[frame];
+  heap->keys[frame] = key;
+  if (key < old) {
+    vtpc_heap_up(heap, heap->positions[frame]);
+  } else {
+    vtpc_heap_down(heap, heap->positions[frame]);
+  }
+}
+
+void vtpc_heap_erase(struct vtpc_heap* heap, uint32_t frame) {
+  const size_t at = heap->positions[frame];
+  heap->positions[frame] = VTPC_NIL;
+  heap->size -= 1;
+  if (at == heap->size) {
+    return;
+  }
+
+  const uint32_t last = heap->items[heap->size];
+  vtpc_heap_place(heap, at, last);
+  vtpc_heap_up(heap, at);
+  vtpc_heap_down(heap, heap->positions[last]);
+}
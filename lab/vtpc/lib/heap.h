@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "list.h"
+
+/*
+ * Indexed binary min-heap of frames ordered by a 64-bit key. The position of
+ * every frame is tracked, so its key can be changed or the frame removed in
+ * O(log n).
+ */
+struct vtpc_heap {
+  uint32_t* items;
+  uint32_t* positions;
+  uint64_t* keys;
+  size_t size;
+  size_t capacity;
+};
+
+int vtpc_heap_init(struct vtpc_heap* heap, size_t capacity);
+void vtpc_heap_destroy(struct vtpc_heap* heap);
+
+void vtpc_heap_push(struct vtpc_heap* heap, uint32_t frame, uint64_t key);
+void vtpc_heap_update(struct vtpc_heap* heap, uint32_t frame, uint64_t key);
+void vtpc_heap_erase(struct vtpc_heap* heap, uint32_t frame);
+
+static inline bool vtpc_heap_contains(
+    const struct vtpc_heap* heap, uint32_t frame
+) {
+  return heap->positions[frame] != VTPC_NIL;
+}
+
+static inline uint32_t vtpc_heap_top(const struct vtpc_heap* heap) {
+  return (heap->size == 0) ? VTPC_NIL : heap->items[0];
+}
@@ -0,0 +1,103 @@
+#include "io.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifdef VTPC_IO_URING
+#include "uring.h"
+#endif
+
+/* Runs are never longer than IOV_MAX pages. */
+ssize_t vtpc_io_sync(const struct vtpc_io* io, size_t done) {
+  struct iovec iov[IOV_MAX];
+  const size_t count = io->count;
+  for (size_t i = 0; i < count; ++i) {
+    iov[i] = io->iov[i];
+  }
+
+  size_t total = 0;
+  size_t first = 0;
+  size_t moved = done;
+  for (;;) {
+    total += moved;
+    while (first < count && moved >= iov[first].iov_len) {
+      moved -= iov[first].iov_len;
+      first += 1;
+    }
+    if (first == count) {
+      break;
+    }
+    iov[first].iov_base = (char*)iov[first].iov_base + moved;
+    iov[first].iov_len -= moved;
+
+    const off_t offset = io->offset + (off_t)total;
+    const int left = (int)(count - first);
+    const ssize_t n = io->write ? pwritev(io->fd, iov + first, left, offset)
+                                : preadv(io->fd, iov + first, left, offset);
+    if (n < 0 && errno == EINTR) {
+      moved = 0;
+      continue;
+    }
+    if (n < 0) {
+      return -1;
+    }
+    if (n == 0) {
+      break;
+    }
+    moved = (size_t)n;
+  }
+
+  if (io->write && first < count) {
+    errno = EIO;
+    return -1;
+  }
+  return (ssize_t)total;
+}
+
+void vtpc_io_init(void* memory, size_t size) {
+#ifdef VTPC_IO_URING
+  vtpc_uring_init(memory, size);
+#else
+  (void)memory;
+  (void)size;
+#endif
+}
+
+int vtpc_io_submit(struct vtpc_io* batch, size_t count) {
+#ifdef VTPC_IO_URING
+  const bool done = (vtpc_uring_submit(batch, count) == 0);
+#else
+  const bool done = false;
+#endif
+
+  int error = 0;
+  for (size_t i = 0; i < count; ++i) {
+    struct vtpc_io* io = &batch[i];
+    if (!done) {
+      io->result = vtpc_io_sync(io, 0);
+      io->error = (io->result < 0) ? errno : 0;
+    }
+    if (io->result < 0 && error == 0) {
+      error = io->error;
+    }
+  }
+
+  if (error != 0) {
+    errno = error;
+    return -1;
+  }
+  return 0;
+}
+
+const char* vtpc_io_backend(void) {
+#ifdef VTPC_IO_URING
+  if (vtpc_uring_available()) {
+    return "io_uring";
+  }
+#endif
+  return "sync";
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/*
+ * A run of pages read or written at consecutive offsets of a file. Once the
+ * batch is done, result holds the number of bytes transferred from the start
+ * of the run, which is short only for reads that hit the end of the file, or
+ * -1 with the error in error.
+ */
+struct vtpc_io {
+  int fd;
+  bool write;
+  off_t offset;
+  struct iovec* iov;
+  size_t count;
+  ssize_t result;
+  int error;
+};
+
+/*
+ * Sets up the I/O backend for buffers within the given memory, which the
+ * io_uring backend registers as a fixed buffer.
+ */
+void vtpc_io_init(void* memory, size_t size);
+
+/*
+ * Performs a batch of runs and waits for all of them. Returns -1 with errno of
+ * the first failed run if any of them failed.
+ */
+int vtpc_io_submit(struct vtpc_io* batch, size_t count);
+
+/*
+ * Does a run with preadv or pwritev from the given byte of it on, as the
+ * rest of one cut short. Returns the bytes of the run done in all, or -1.
+ */
+ssize_t vtpc_io_sync(const struct vtpc_io* io, size_t done);
+
+/* Returns the name of the backend, "io_uring" or "sync". */
+const char* vtpc_io_backend(void);
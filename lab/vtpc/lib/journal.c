@@ -0,0 +1,378 @@
+#include "journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "crc32c.h"
+
+#define VTPC_JOURNAL_MAGIC 0x4C4E524AU
+
+/* Records of writes from up to this many buffers take a single call. */
+#define VTPC_JOURNAL_VECTORS 16
+
+/*
+ * The header of a record, followed by count bytes of data. The checksum
+ * covers the rest of the header and the data.
+ */
+struct vtpc_journal_record {
+  uint32_t magic;
+  uint32_t crc;
+  uint64_t offset;
+  uint64_t count;
+  uint64_t size;
+};
+
+/*
+ * Positions count the bytes ever appended; base is the position the journal
+ * file starts at since the last reset. The lock protects the positions and
+ * the file; a commit syncs outside of it, flagged by syncing, so writers can
+ * append the records of the next commit meanwhile.
+ */
+struct vtpc_journal {
+  pthread_mutex_t lock;
+  pthread_cond_t synced;
+  int fd;
+  enum vtpc_journal_mode mode;
+  char* path;
+  uint64_t base;
+  uint64_t appended;
+  uint64_t durable;
+  bool syncing;
+  int error;
+};
+
+int vtpc_journal_find(const char* name) {
+  if (strcmp(name, "none") == 0) {
+    return VTPC_JOURNAL_NONE;
+  }
+  if (strcmp(name, "append") == 0) {
+    return VTPC_JOURNAL_APPEND;
+  }
+  if (strcmp(name, "sync") == 0) {
+    return VTPC_JOURNAL_SYNC;
+  }
+  return -1;
+}
+
+static char* vtpc_journal_path(const char* path) {
+  const size_t length = strlen(path);
+  char* journal = malloc(length + sizeof(VTPC_JOURNAL_SUFFIX));
+  if (journal == NULL) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  memcpy(journal, path, length);
+  memcpy(journal + length, VTPC_JOURNAL_SUFFIX, sizeof(VTPC_JOURNAL_SUFFIX));
+  return journal;
+}
+
+static uint32_t vtpc_journal_crc(
+    const struct vtpc_journal_record* record,
+    const struct iovec* iov,
+    int count
+) {
+  const size_t skip = offsetof(struct vtpc_journal_record, offset);
+  uint32_t crc =
+      vtpc_crc32c(0, (const char*)record + skip, sizeof(*record) - skip);
+  for (int i = 0; i < count; ++i) {
+    crc = vtpc_crc32c(crc, iov[i].iov_base, iov[i].iov_len);
+  }
+  return crc;
+}
+
+struct vtpc_journal* vtpc_journal_open(
+    const char* path, enum vtpc_journal_mode mode
+) {
+  struct vtpc_journal* journal = calloc(1, sizeof(struct vtpc_journal));
+  if (journal == NULL) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  journal->path = vtpc_journal_path(path);
+  if (journal->path == NULL) {
+    free(journal);
+    return NULL;
+  }
+  journal->fd = open(journal->path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (journal->fd == -1) {
+    const int error = errno;
+    free(journal->path);
+    free(journal);
+    errno = error;
+    return NULL;
+  }
+
+  pthread_mutex_init(&journal->lock, NULL);
+  pthread_cond_init(&journal->synced, NULL);
+  journal->mode = mode;
+  return journal;
+}
+
+int vtpc_journal_close(struct vtpc_journal* journal, bool discard) {
+  int status = close(journal->fd);
+  int error = errno;
+  if (discard && unlink(journal->path) == -1 && status == 0) {
+    status = -1;
+    error = errno;
+  }
+  pthread_cond_destroy(&journal->synced);
+  pthread_mutex_destroy(&journal->lock);
+  free(journal->path);
+  free(journal);
+  errno = error;
+  return status;
+}
+
+/*
+ * Writes all of the vectors at the position, resuming after short writes,
+ * and the rest of a vector written partly on its own.
+ */
+static int vtpc_journal_write(
+    int fd, const struct iovec* iov, int count, off_t at
+) {
+  size_t skip = 0;
+  while (count > 0) {
+    const ssize_t written =
+        (skip > 0)
+            ? pwrite(fd, (char*)iov->iov_base + skip, iov->iov_len - skip, at)
+            : pwritev(fd, iov, (count < IOV_MAX) ? count : IOV_MAX, at);
+    if (written == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    at += written;
+    size_t left = skip + (size_t)written;
+    while (count > 0 && left >= iov->iov_len) {
+      left -= iov->iov_len;
+      iov += 1;
+      count -= 1;
+    }
+    skip = left;
+  }
+  return 0;
+}
+
+/* Writes the header of a record along with its data, with one call if few. */
+static int vtpc_journal_write_record(
+    int fd,
+    struct vtpc_journal_record* record,
+    const struct iovec* iov,
+    int count,
+    off_t at
+) {
+  struct iovec vectors[VTPC_JOURNAL_VECTORS];
+  vectors[0] = (struct iovec){.iov_base = record, .iov_len = sizeof(*record)};
+  if (count < VTPC_JOURNAL_VECTORS) {
+    memcpy(&vectors[1], iov, (size_t)count * sizeof(*iov));
+    return vtpc_journal_write(fd, vectors, count + 1, at);
+  }
+  if (vtpc_journal_write(fd, vectors, 1, at) == -1) {
+    return -1;
+  }
+  return vtpc_journal_write(fd, iov, count, at + (off_t)sizeof(*record));
+}
+
+int vtpc_journal_append(
+    struct vtpc_journal* journal,
+    off_t offset,
+    const struct iovec* iov,
+    int iovcnt,
+    size_t count,
+    off_t size,
+    uint64_t* lsn
+) {
+  struct vtpc_journal_record record = {
+      .magic = VTPC_JOURNAL_MAGIC,
+      .offset = (uint64_t)offset,
+      .count = count,
+      .size = (uint64_t)size,
+  };
+  record.crc = vtpc_journal_crc(&record, iov, iovcnt);
+
+  pthread_mutex_lock(&journal->lock);
+  const off_t at = (off_t)(journal->appended - journal->base);
+  const int status =
+      vtpc_journal_write_record(journal->fd, &record, iov, iovcnt, at);
+  if (status == 0) {
+    journal->appended += sizeof(record) + count;
+    *lsn = journal->appended;
+  } else {
+    /* A partial record would hide the ones after it from replay. */
+    const int error = errno;
+    (void)ftruncate(journal->fd, at);
+    errno = error;
+  }
+  pthread_mutex_unlock(&journal->lock);
+  return status;
+}
+
+int vtpc_journal_commit(struct vtpc_journal* journal, uint64_t lsn) {
+  if (journal->mode != VTPC_JOURNAL_SYNC) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&journal->lock);
+  while (journal->durable < lsn && journal->error == 0) {
+    if (journal->syncing) {
+      pthread_cond_wait(&journal->synced, &journal->lock);
+      continue;
+    }
+
+    journal->syncing = true;
+    const uint64_t target = journal->appended;
+    pthread_mutex_unlock(&journal->lock);
+    const int status = fdatasync(journal->fd);
+    const int error = errno;
+    pthread_mutex_lock(&journal->lock);
+    journal->syncing = false;
+    if (status == -1) {
+      journal->error = error;
+    } else if (target > journal->durable) {
+      journal->durable = target;
+    }
+    pthread_cond_broadcast(&journal->synced);
+  }
+  const int error = journal->error;
+  pthread_mutex_unlock(&journal->lock);
+
+  if (error != 0) {
+    errno = error;
+    return -1;
+  }
+  return 0;
+}
+
+uint64_t vtpc_journal_size(struct vtpc_journal* journal) {
+  pthread_mutex_lock(&journal->lock);
+  const uint64_t size = journal->appended - journal->base;
+  pthread_mutex_unlock(&journal->lock);
+  return size;
+}
+
+int vtpc_journal_reset(struct vtpc_journal* journal) {
+  pthread_mutex_lock(&journal->lock);
+  const int status = ftruncate(journal->fd, 0);
+  if (status == 0) {
+    journal->base = journal->appended;
+    journal->durable = journal->appended;
+    pthread_cond_broadcast(&journal->synced);
+  }
+  pthread_mutex_unlock(&journal->lock);
+  return status;
+}
+
+/* Reads up to count bytes, fewer only at the end of the file. */
+static ssize_t vtpc_journal_read(int fd, void* buf, size_t count) {
+  size_t total = 0;
+  while (total < count) {
+    const ssize_t n = read(fd, (char*)buf + total, count - total);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n == -1) {
+      return -1;
+    }
+    if (n == 0) {
+      break;
+    }
+    total += (size_t)n;
+  }
+  return (ssize_t)total;
+}
+
+/*
+ * Applies the valid records of the journal to the file in order and returns
+ * the largest size of the file after any of them, -1 if there was none or -2
+ * if the file could not be written. Concurrent writers may log their records
+ * in another order than they grew the file in.
+ */
+static off_t vtpc_journal_apply(int journal, int fd, off_t end) {
+  off_t size = -1;
+  off_t at = 0;
+  char* data = NULL;
+  size_t capacity = 0;
+  for (;;) {
+    struct vtpc_journal_record record;
+    const ssize_t n = vtpc_journal_read(journal, &record, sizeof(record));
+    if (n != (ssize_t)sizeof(record) || record.magic != VTPC_JOURNAL_MAGIC ||
+        record.count > (uint64_t)(end - at) - sizeof(record)) {
+      break;
+    }
+    if (record.count > capacity) {
+      char* grown = realloc(data, record.count);
+      if (grown == NULL) {
+        free(data);
+        errno = ENOMEM;
+        return -2;
+      }
+      data = grown;
+      capacity = record.count;
+    }
+    const struct iovec vector = {.iov_base = data, .iov_len = record.count};
+    if (vtpc_journal_read(journal, data, record.count) !=
+            (ssize_t)record.count ||
+        vtpc_journal_crc(&record, &vector, 1) != record.crc) {
+      break;
+    }
+    if (vtpc_journal_write(fd, &vector, 1, (off_t)record.offset) == -1) {
+      free(data);
+      return -2;
+    }
+    at += (off_t)(sizeof(record) + record.count);
+    if ((off_t)record.size > size) {
+      size = (off_t)record.size;
+    }
+  }
+  free(data);
+  return size;
+}
+
+int vtpc_journal_replay(const char* path) {
+  char* name = vtpc_journal_path(path);
+  if (name == NULL) {
+    return -1;
+  }
+  const int journal = open(name, O_RDONLY);
+  if (journal == -1) {
+    const int error = errno;
+    free(name);
+    if (error == ENOENT) {
+      return 0;
+    }
+    errno = error;
+    return -1;
+  }
+
+  int status = -1;
+  struct stat st;
+  const int fd = open(path, O_WRONLY);
+  if (fd != -1 && fstat(journal, &st) == 0) {
+    const off_t size = vtpc_journal_apply(journal, fd, st.st_size);
+    /* Writeback may have left a whole page past the end of the file. */
+    status = (size < -1 || (size >= 0 && ftruncate(fd, size) == -1) ||
+              fsync(fd) == -1)
+                 ? -1
+                 : unlink(name);
+  }
+  const int error = errno;
+  if (fd != -1) {
+    close(fd);
+  }
+  close(journal);
+  free(name);
+  errno = error;
+  return status;
+}
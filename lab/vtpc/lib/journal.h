@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/* The journal of a file lives next to it, named after it with this suffix. */
+#define VTPC_JOURNAL_SUFFIX ".vtpc-journal"
+
+/* Past this many bytes a write checkpoints the file to empty its journal. */
+#define VTPC_JOURNAL_LIMIT (64UL * 1024 * 1024)
+
+/*
+ * How far a write is made durable before vtpc_write returns: not at all,
+ * into the journal, which survives the death of the process, or onto the
+ * disk, which survives a crash of the machine.
+ */
+enum vtpc_journal_mode {
+  VTPC_JOURNAL_NONE,
+  VTPC_JOURNAL_APPEND,
+  VTPC_JOURNAL_SYNC,
+};
+
+/*
+ * An intent log of the writes to a file since it was last synced. Every
+ * write call appends one record with its offset, its bytes and the size of
+ * the file after it, so a write is either replayed whole or not at all.
+ * Records are checksummed; replay stops at the first torn or damaged one.
+ * Pages written through vtpc_map are not logged.
+ */
+struct vtpc_journal;
+
+/* Returns the mode with the given name or -1 if there is none. */
+int vtpc_journal_find(const char* name);
+
+/* Opens the journal of the file at path, creating it empty. */
+struct vtpc_journal* vtpc_journal_open(
+    const char* path, enum vtpc_journal_mode mode
+);
+
+/*
+ * Closes the journal. Discard removes it, which is only safe once the file
+ * has been synced; otherwise it is kept for the next open to replay.
+ */
+int vtpc_journal_close(struct vtpc_journal* journal, bool discard);
+
+/*
+ * Appends the record of a write of count bytes gathered from the vectors and
+ * stores the position just past it in lsn. Positions grow over the life of
+ * the journal, resets included.
+ */
+int vtpc_journal_append(
+    struct vtpc_journal* journal,
+    off_t offset,
+    const struct iovec* iov,
+    int iovcnt,
+    size_t count,
+    off_t size,
+    uint64_t* lsn
+);
+
+/*
+ * Waits until the journal is durable up to lsn. In sync mode, one of the
+ * waiting threads syncs the journal for all records appended so far while
+ * the others wait for it, so concurrent writers share a disk flush.
+ */
+int vtpc_journal_commit(struct vtpc_journal* journal, uint64_t lsn);
+
+/* Returns the bytes appended since the last reset. */
+uint64_t vtpc_journal_size(struct vtpc_journal* journal);
+
+/* Empties the journal once the file has been synced with all its records. */
+int vtpc_journal_reset(struct vtpc_journal* journal);
+
+/*
+ * Applies the journal left behind for the file at path by a process that
+ * died with the file open, syncs the file and removes the journal. Does
+ * nothing if there is no journal.
+ */
+int vtpc_journal_replay(const char* path);
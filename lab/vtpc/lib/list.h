@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define VTPC_NIL UINT32_MAX
+
+/*
+ * Intrusive doubly linked list over frame indices. Links live in an array
+ * owned by the user of the list, so a node can be moved in O(1) and no memory
+ * is allocated per operation.
+ */
+
+struct vtpc_link {
+  uint32_t prev;
+  uint32_t next;
+};
+
+struct vtpc_list {
+  uint32_t head;
+  uint32_t tail;
+  size_t size;
+};
+
+static inline void vtpc_list_init(struct vtpc_list* list) {
+  *list = (struct vtpc_list){.head = VTPC_NIL, .tail = VTPC_NIL, .size = 0};
+}
+
+static inline void vtpc_list_push_front(
+    struct vtpc_list* list, struct vtpc_link* links, uint32_t index
+) {
+  links[index] = (struct vtpc_link){.prev = VTPC_NIL, .next = list->head};
+  if (list->head != VTPC_NIL) {
+    links[list->head].prev = index;
+  } else {
+    list->tail = index;
+  }
+  list->head = index;
+  list->size += 1;
+}
+
+static inline void vtpc_list_remove(
+    struct vtpc_list* list, struct vtpc_link* links, uint32_t index
+) {
+  const struct vtpc_link link = links[index];
+  if (link.prev != VTPC_NIL) {
+    links[link.prev].next = link.next;
+  } else {
+    list->head = link.next;
+  }
+  if (link.next != VTPC_NIL) {
+    links[link.next].prev = link.prev;
+  } else {
+    list->tail = link.prev;
+  }
+  list->size -= 1;
+}
+
+static inline void vtpc_list_move_front(
+    struct vtpc_list* list, struct vtpc_link* links, uint32_t index
+) {
+  if (list->head != index) {
+    vtpc_list_remove(list, links, index);
+    vtpc_list_push_front(list, links, index);
+  }
+}
@@ -0,0 +1,72 @@
+#include "policy.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "heap.h"
+#include "list.h"
+
+static const struct vtpc_policy_ops* const policies[] = {
+    &vtpc_policy_lru,
+    &vtpc_policy_clock,
+    &vtpc_policy_2q,
+    &vtpc_policy_arc,
+    &vtpc_policy_lruk,
+    &vtpc_policy_optimal,
+};
+
+const struct vtpc_policy_ops* vtpc_policy_find(const char* name) {
+  for (size_t i = 0; i < sizeof(policies) / sizeof(*policies); ++i) {
+    if (strcmp(policies[i]->name, name) == 0) {
+      return policies[i];
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Searches the subtree at the index for an evictable frame with a smaller key
+ * than the best one so far. The key of a node bounds its subtree, so the
+ * search stops at the first evictable frame of every path.
+ */
+static uint32_t vtpc_policy_heap_search(
+    const struct vtpc_policy* policy,
+    const struct vtpc_heap* heap,
+    size_t index,
+    uint32_t best
+) {
+  if (index >= heap->size) {
+    return best;
+  }
+  const uint32_t frame = heap->items[index];
+  if (best != VTPC_NIL && heap->keys[frame] >= heap->keys[best]) {
+    return best;
+  }
+  if (vtpc_policy_evictable(policy, frame)) {
+    return frame;
+  }
+  best = vtpc_policy_heap_search(policy, heap, (2 * index) + 1, best);
+  return vtpc_policy_heap_search(policy, heap, (2 * index) + 2, best);
+}
+
+uint32_t vtpc_policy_heap_victim(
+    const struct vtpc_policy* policy, const struct vtpc_heap* heap
+) {
+  return vtpc_policy_heap_search(policy, heap, 0, VTPC_NIL);
+}
+
+struct vtpc_policy* vtpc_policy_create(
+    const struct vtpc_policy_ops* ops,
+    size_t capacity,
+    vtpc_evictable_fn evictable,
+    void* ctx
+) {
+  struct vtpc_policy* policy = ops->create(capacity);
+  if (policy != NULL) {
+    policy->ops = ops;
+    policy->evictable = evictable;
+    policy->ctx = ctx;
+  }
+  return policy;
+}
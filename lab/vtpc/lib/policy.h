@@ -0,0 +1,151 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "list.h"
+
+/*
+ * Eviction policy interface. The cache core reports every access to the
+ * policy and asks it for a victim when no free frame is left. Frames are
+ * identified by their index, pages by a 64-bit key that stays the same while
+ * the page is not cached, so policies can remember evicted pages.
+ *
+ * On a miss the core calls miss(key) first, then evict() if the cache is
+ * full, then insert(frame, key). A frame dropped without eviction (its file is
+ * closed) is reported with remove(frame). Policies that use access hints
+ * also get advise(frame, key, when), where frame is VTPC_NIL if the page is
+ * not cached. peek() returns the frame evict() would take without taking it,
+ * so the TinyLFU filter in front of the policy can weigh the victim first;
+ * the filter itself has none.
+ */
+
+struct vtpc_heap;
+struct vtpc_policy;
+
+typedef bool (*vtpc_evictable_fn)(void* ctx, uint32_t frame);
+
+struct vtpc_policy_ops {
+  const char* name;
+  struct vtpc_policy* (*create)(size_t capacity);
+  void (*destroy)(struct vtpc_policy* policy);
+  void (*hit)(struct vtpc_policy* policy, uint32_t frame);
+  void (*miss)(struct vtpc_policy* policy, uint64_t key);
+  void (*insert)(struct vtpc_policy* policy, uint32_t frame, uint64_t key);
+  uint32_t (*evict)(struct vtpc_policy* policy);
+  uint32_t (*peek)(struct vtpc_policy* policy);
+  void (*remove)(struct vtpc_policy* policy, uint32_t frame);
+  int (*advise)(
+      struct vtpc_policy* policy, uint32_t frame, uint64_t key, uint64_t when
+  );
+};
+
+struct vtpc_policy {
+  const struct vtpc_policy_ops* ops;
+  vtpc_evictable_fn evictable;
+  void* ctx;
+};
+
+extern const struct vtpc_policy_ops vtpc_policy_lru;
+extern const struct vtpc_policy_ops vtpc_policy_clock;
+extern const struct vtpc_policy_ops vtpc_policy_2q;
+extern const struct vtpc_policy_ops vtpc_policy_arc;
+extern const struct vtpc_policy_ops vtpc_policy_lruk;
+extern const struct vtpc_policy_ops vtpc_policy_optimal;
+
+/* Returns the policy with the given name or NULL. */
+const struct vtpc_policy_ops* vtpc_policy_find(const char* name);
+
+struct vtpc_policy* vtpc_policy_create(
+    const struct vtpc_policy_ops* ops,
+    size_t capacity,
+    vtpc_evictable_fn evictable,
+    void* ctx
+);
+
+/*
+ * Creates the policy behind a TinyLFU admission filter, which only lets a
+ * new page displace a cached one if it has been accessed more often lately.
+ */
+struct vtpc_policy* vtpc_policy_admit(
+    const struct vtpc_policy_ops* ops,
+    size_t capacity,
+    vtpc_evictable_fn evictable,
+    void* ctx
+);
+
+static inline void vtpc_policy_destroy(struct vtpc_policy* policy) {
+  policy->ops->destroy(policy);
+}
+
+static inline bool vtpc_policy_evictable(
+    const struct vtpc_policy* policy, uint32_t frame
+) {
+  return policy->evictable == NULL || policy->evictable(policy->ctx, frame);
+}
+
+static inline void vtpc_policy_hit(struct vtpc_policy* policy, uint32_t frame) {
+  policy->ops->hit(policy, frame);
+}
+
+static inline void vtpc_policy_miss(struct vtpc_policy* policy, uint64_t key) {
+  if (policy->ops->miss != NULL) {
+    policy->ops->miss(policy, key);
+  }
+}
+
+static inline void vtpc_policy_insert(
+    struct vtpc_policy* policy, uint32_t frame, uint64_t key
+) {
+  policy->ops->insert(policy, frame, key);
+}
+
+/* Returns the frame to evict, or VTPC_NIL if every frame is in use. */
+static inline uint32_t vtpc_policy_evict(struct vtpc_policy* policy) {
+  return policy->ops->evict(policy);
+}
+
+/*
+ * Returns the frame the next evict would take, or VTPC_NIL, and leaves the
+ * policy as it is.
+ */
+static inline uint32_t vtpc_policy_peek(struct vtpc_policy* policy) {
+  return policy->ops->peek(policy);
+}
+
+static inline void vtpc_policy_remove(
+    struct vtpc_policy* policy, uint32_t frame
+) {
+  policy->ops->remove(policy, frame);
+}
+
+static inline int vtpc_policy_advise(
+    struct vtpc_policy* policy, uint32_t frame, uint64_t key, uint64_t when
+) {
+  if (policy->ops->advise == NULL) {
+    return 0;
+  }
+  return policy->ops->advise(policy, frame, key, when);
+}
+
+/*
+ * Returns the evictable frame with the smallest key in the heap, without
+ * changing it.
+ */
+uint32_t vtpc_policy_heap_victim(
+    const struct vtpc_policy* policy, const struct vtpc_heap* heap
+);
+
+/* Returns the least recently used evictable frame of the list. */
+static inline uint32_t vtpc_policy_victim(
+    const struct vtpc_policy* policy,
+    const struct vtpc_list* list,
+    const struct vtpc_link* links
+) {
+  uint32_t frame = list->tail;
+  while (frame != VTPC_NIL && !vtpc_policy_evictable(policy, frame)) {
+    frame = links[frame].prev;
+  }
+  return frame;
+}
@@ -0,0 +1,145 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ghost.h"
+#include "list.h"
+#include "policy.h"
+
+/*
+ * Full 2Q (Johnson & Shasha): new pages enter the FIFO A1in, pages evicted
+ * from A1in are remembered in the ghost queue A1out, and a page that is
+ * missed again while in A1out is promoted to the LRU queue Am.
+ */
+
+enum vtpc_2q_queue {
+  VTPC_2Q_NONE,
+  VTPC_2Q_A1IN,
+  VTPC_2Q_AM,
+};
+
+struct vtpc_2q {
+  struct vtpc_policy base;
+  struct vtpc_link* links;
+  uint64_t* keys;
+  uint8_t* queues;
+  struct vtpc_list a1in;
+  struct vtpc_list am;
+  struct vtpc_ghost a1out;
+  size_t kin;
+  bool promote;
+};
+
+static struct vtpc_2q* vtpc_2q(struct vtpc_policy* policy) {
+  return (struct vtpc_2q*)policy;
+}
+
+static void vtpc_2q_destroy(struct vtpc_policy* policy) {
+  struct vtpc_2q* q = vtpc_2q(policy);
+  free(q->links);
+  free(q->keys);
+  free(q->queues);
+  vtpc_ghost_destroy(&q->a1out);
+  free(q);
+}
+
+static struct vtpc_policy* vtpc_2q_create(size_t capacity) {
+  struct vtpc_2q* q = calloc(1, sizeof(struct vtpc_2q));
+  if (q == NULL) {
+    return NULL;
+  }
+
+  q->links = malloc(capacity * sizeof(struct vtpc_link));
+  q->keys = malloc(capacity * sizeof(uint64_t));
+  q->queues = calloc(capacity, sizeof(uint8_t));
+  if (q->links == NULL || q->keys == NULL || q->queues == NULL ||
+      vtpc_ghost_init(&q->a1out, (capacity / 2) + 1) == -1) {
+    vtpc_2q_destroy(&q->base);
+    return NULL;
+  }
+
+  vtpc_list_init(&q->a1in);
+  vtpc_list_init(&q->am);
+  q->kin = (capacity / 4) + 1;
+  return &q->base;
+}
+
+static struct vtpc_list* vtpc_2q_list(struct vtpc_2q* q, uint32_t frame) {
+  return (q->queues[frame] == VTPC_2Q_AM) ? &q->am : &q->a1in;
+}
+
+static void vtpc_2q_hit(struct vtpc_policy* policy, uint32_t frame) {
+  struct vtpc_2q* q = vtpc_2q(policy);
+  if (q->queues[frame] == VTPC_2Q_AM) {
+    vtpc_list_move_front(&q->am, q->links, frame);
+  }
+}
+
+static void vtpc_2q_miss(struct vtpc_policy* policy, uint64_t key) {
+  struct vtpc_2q* q = vtpc_2q(policy);
+  const uint32_t node = vtpc_ghost_find(&q->a1out, key);
+  q->promote = (node != VTPC_NIL);
+  if (q->promote) {
+    vtpc_ghost_erase(&q->a1out, node);
+  }
+}
+
+static void vtpc_2q_insert(
+    struct vtpc_policy* policy, uint32_t frame, uint64_t key
+) {
+  struct vtpc_2q* q = vtpc_2q(policy);
+  q->keys[frame] = key;
+  q->queues[frame] = q->promote ? VTPC_2Q_AM : VTPC_2Q_A1IN;
+  vtpc_list_push_front(vtpc_2q_list(q, frame), q->links, frame);
+  q->promote = false;
+}
+
+static void vtpc_2q_remove(struct vtpc_policy* policy, uint32_t frame) {
+  struct vtpc_2q* q = vtpc_2q(policy);
+  vtpc_list_remove(vtpc_2q_list(q, frame), q->links, frame);
+  q->queues[frame] = VTPC_2Q_NONE;
+}
+
+static uint32_t vtpc_2q_peek(struct vtpc_policy* policy) {
+  struct vtpc_2q* q = vtpc_2q(policy);
+
+  uint32_t frame = VTPC_NIL;
+  if (q->a1in.size > q->kin || q->am.size == 0) {
+    frame = vtpc_policy_victim(policy, &q->a1in, q->links);
+  }
+  if (frame == VTPC_NIL) {
+    frame = vtpc_policy_victim(policy, &q->am, q->links);
+  }
+  if (frame == VTPC_NIL) {
+    frame = vtpc_policy_victim(policy, &q->a1in, q->links);
+  }
+  return frame;
+}
+
+static uint32_t vtpc_2q_evict(struct vtpc_policy* policy) {
+  struct vtpc_2q* q = vtpc_2q(policy);
+  const uint32_t frame = vtpc_2q_peek(policy);
+  if (frame == VTPC_NIL) {
+    return VTPC_NIL;
+  }
+
+  if (q->queues[frame] == VTPC_2Q_A1IN) {
+    vtpc_ghost_push(&q->a1out, q->keys[frame], 0);
+  }
+  vtpc_2q_remove(policy, frame);
+  return frame;
+}
+
+const struct vtpc_policy_ops vtpc_policy_2q = {
+    .name = "2q",
+    .create = vtpc_2q_create,
+    .destroy = vtpc_2q_destroy,
+    .hit = vtpc_2q_hit,
+    .miss = vtpc_2q_miss,
+    .insert = vtpc_2q_insert,
+    .evict = vtpc_2q_evict,
+    .peek = vtpc_2q_peek,
+    .remove = vtpc_2q_remove,
+    .advise = NULL,
+};
@@ -0,0 +1,192 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ghost.h"
+#include "list.h"
+#include "policy.h"
+
+/*
+ * ARC (Megiddo & Modha): T1 holds pages seen once, T2 pages seen at least
+ * twice, B1 and B2 remember pages recently evicted from them. A miss that hits
+ * a ghost list moves the target size p of T1 towards the list that would have
+ * kept the page.
+ */
+
+enum vtpc_arc_list {
+  VTPC_ARC_NONE,
+  VTPC_ARC_T1,
+  VTPC_ARC_T2,
+};
+
+enum vtpc_arc_ghost {
+  VTPC_ARC_GHOST_NONE,
+  VTPC_ARC_GHOST_B1,
+  VTPC_ARC_GHOST_B2,
+};
+
+struct vtpc_arc {
+  struct vtpc_policy base;
+  struct vtpc_link* links;
+  uint64_t* keys;
+  uint8_t* lists;
+  struct vtpc_list t1;
+  struct vtpc_list t2;
+  struct vtpc_ghost b1;
+  struct vtpc_ghost b2;
+  size_t capacity;
+  size_t p;
+  enum vtpc_arc_ghost ghost;
+  bool forget;
+};
+
+static struct vtpc_arc* vtpc_arc(struct vtpc_policy* policy) {
+  return (struct vtpc_arc*)policy;
+}
+
+static size_t vtpc_arc_max(size_t lhs, size_t rhs) {
+  return lhs > rhs ? lhs : rhs;
+}
+
+static void vtpc_arc_destroy(struct vtpc_policy* policy) {
+  struct vtpc_arc* arc = vtpc_arc(policy);
+  free(arc->links);
+  free(arc->keys);
+  free(arc->lists);
+  vtpc_ghost_destroy(&arc->b1);
+  vtpc_ghost_destroy(&arc->b2);
+  free(arc);
+}
+
+static struct vtpc_policy* vtpc_arc_create(size_t capacity) {
+  struct vtpc_arc* arc = calloc(1, sizeof(struct vtpc_arc));
+  if (arc == NULL) {
+    return NULL;
+  }
+
+  arc->links = malloc(capacity * sizeof(struct vtpc_link));
+  arc->keys = malloc(capacity * sizeof(uint64_t));
+  arc->lists = calloc(capacity, sizeof(uint8_t));
+  if (arc->links == NULL || arc->keys == NULL || arc->lists == NULL ||
+      vtpc_ghost_init(&arc->b1, capacity) == -1 ||
+      vtpc_ghost_init(&arc->b2, capacity) == -1) {
+    vtpc_arc_destroy(&arc->base);
+    return NULL;
+  }
+
+  vtpc_list_init(&arc->t1);
+  vtpc_list_init(&arc->t2);
+  arc->capacity = capacity;
+  return &arc->base;
+}
+
+static struct vtpc_list* vtpc_arc_list(struct vtpc_arc* arc, uint32_t frame) {
+  return (arc->lists[frame] == VTPC_ARC_T2) ? &arc->t2 : &arc->t1;
+}
+
+static void vtpc_arc_remove(struct vtpc_policy* policy, uint32_t frame) {
+  struct vtpc_arc* arc = vtpc_arc(policy);
+  vtpc_list_remove(vtpc_arc_list(arc, frame), arc->links, frame);
+  arc->lists[frame] = VTPC_ARC_NONE;
+}
+
+static void vtpc_arc_hit(struct vtpc_policy* policy, uint32_t frame) {
+  struct vtpc_arc* arc = vtpc_arc(policy);
+  vtpc_list_remove(vtpc_arc_list(arc, frame), arc->links, frame);
+  vtpc_list_push_front(&arc->t2, arc->links, frame);
+  arc->lists[frame] = VTPC_ARC_T2;
+}
+
+static void vtpc_arc_miss(struct vtpc_policy* policy, uint64_t key) {
+  struct vtpc_arc* arc = vtpc_arc(policy);
+  const size_t b1 = vtpc_ghost_size(&arc->b1);
+  const size_t b2 = vtpc_ghost_size(&arc->b2);
+
+  arc->forget = false;
+  uint32_t node = vtpc_ghost_find(&arc->b1, key);
+  if (node != VTPC_NIL) {
+    const size_t delta = vtpc_arc_max(b2 / b1, 1);
+    arc->p = (arc->p + delta < arc->capacity) ? arc->p + delta : arc->capacity;
+    arc->ghost = VTPC_ARC_GHOST_B1;
+    vtpc_ghost_erase(&arc->b1, node);
+    return;
+  }
+
+  node = vtpc_ghost_find(&arc->b2, key);
+  if (node != VTPC_NIL) {
+    const size_t delta = vtpc_arc_max(b1 / b2, 1);
+    arc->p = (arc->p > delta) ? arc->p - delta : 0;
+    arc->ghost = VTPC_ARC_GHOST_B2;
+    vtpc_ghost_erase(&arc->b2, node);
+    return;
+  }
+
+  arc->ghost = VTPC_ARC_GHOST_NONE;
+  if (arc->t1.size + b1 >= arc->capacity) {
+    if (b1 > 0) {
+      vtpc_ghost_pop(&arc->b1);
+    } else {
+      arc->forget = true;
+    }
+  } else if (arc->t1.size + arc->t2.size + b1 + b2 >= 2 * arc->capacity) {
+    vtpc_ghost_pop(&arc->b2);
+  }
+}
+
+static void vtpc_arc_insert(
+    struct vtpc_policy* policy, uint32_t frame, uint64_t key
+) {
+  struct vtpc_arc* arc = vtpc_arc(policy);
+  const bool seen = (arc->ghost != VTPC_ARC_GHOST_NONE);
+  arc->keys[frame] = key;
+  arc->lists[frame] = seen ? VTPC_ARC_T2 : VTPC_ARC_T1;
+  vtpc_list_push_front(vtpc_arc_list(arc, frame), arc->links, frame);
+  arc->ghost = VTPC_ARC_GHOST_NONE;
+  arc->forget = false;
+}
+
+static uint32_t vtpc_arc_peek(struct vtpc_policy* policy) {
+  struct vtpc_arc* arc = vtpc_arc(policy);
+  const bool from_t1 =
+      arc->t1.size > 0 &&
+      (arc->t1.size > arc->p ||
+       (arc->ghost == VTPC_ARC_GHOST_B2 && arc->t1.size == arc->p));
+
+  struct vtpc_list* first = from_t1 ? &arc->t1 : &arc->t2;
+  struct vtpc_list* second = from_t1 ? &arc->t2 : &arc->t1;
+  uint32_t frame = vtpc_policy_victim(policy, first, arc->links);
+  if (frame == VTPC_NIL) {
+    frame = vtpc_policy_victim(policy, second, arc->links);
+  }
+  return frame;
+}
+
+static uint32_t vtpc_arc_evict(struct vtpc_policy* policy) {
+  struct vtpc_arc* arc = vtpc_arc(policy);
+  const uint32_t frame = vtpc_arc_peek(policy);
+  if (frame == VTPC_NIL) {
+    return VTPC_NIL;
+  }
+
+  if (arc->lists[frame] == VTPC_ARC_T2) {
+    vtpc_ghost_push(&arc->b2, arc->keys[frame], 0);
+  } else if (!arc->forget) {
+    vtpc_ghost_push(&arc->b1, arc->keys[frame], 0);
+  }
+  vtpc_arc_remove(policy, frame);
+  return frame;
+}
+
+const struct vtpc_policy_ops vtpc_policy_arc = {
+    .name = "arc",
+    .create = vtpc_arc_create,
+    .destroy = vtpc_arc_destroy,
+    .hit = vtpc_arc_hit,
+    .miss = vtpc_arc_miss,
+    .insert = vtpc_arc_insert,
+    .evict = vtpc_arc_evict,
+    .peek = vtpc_arc_peek,
+    .remove = vtpc_arc_remove,
+    .advise = NULL,
+};
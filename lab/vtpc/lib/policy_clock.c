@@ -0,0 +1,124 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "policy.h"
+
+/*
+ * CLOCK (second chance): frames are arranged in a ring by index, a hit only
+ * sets the reference bit, and the hand clears reference bits until it finds
+ * an unreferenced frame.
+ */
+
+enum {
+  VTPC_CLOCK_PRESENT = 1U << 0U,
+  VTPC_CLOCK_REFERENCED = 1U << 1U,
+};
+
+struct vtpc_clock {
+  struct vtpc_policy base;
+  uint8_t* bits;
+  size_t capacity;
+  size_t hand;
+};
+
+static struct vtpc_clock* vtpc_clock(struct vtpc_policy* policy) {
+  return (struct vtpc_clock*)policy;
+}
+
+static void vtpc_clock_destroy(struct vtpc_policy* policy) {
+  struct vtpc_clock* clock = vtpc_clock(policy);
+  free(clock->bits);
+  free(clock);
+}
+
+static struct vtpc_policy* vtpc_clock_create(size_t capacity) {
+  struct vtpc_clock* clock = calloc(1, sizeof(struct vtpc_clock));
+  if (clock == NULL) {
+    return NULL;
+  }
+
+  clock->bits = calloc(capacity, sizeof(uint8_t));
+  if (clock->bits == NULL) {
+    free(clock);
+    return NULL;
+  }
+  clock->capacity = capacity;
+  return &clock->base;
+}
+
+static void vtpc_clock_hit(struct vtpc_policy* policy, uint32_t frame) {
+  vtpc_clock(policy)->bits[frame] |= VTPC_CLOCK_REFERENCED;
+}
+
+static void vtpc_clock_insert(
+    struct vtpc_policy* policy, uint32_t frame, uint64_t key
+) {
+  (void)key;
+  vtpc_clock(policy)->bits[frame] = VTPC_CLOCK_PRESENT;
+}
+
+/*
+ * The frame the hand stops at: the first unreferenced one, or the first one
+ * at all if every frame is referenced, since the hand clears them all on its
+ * way around.
+ */
+static uint32_t vtpc_clock_peek(struct vtpc_policy* policy) {
+  struct vtpc_clock* clock = vtpc_clock(policy);
+  uint32_t first = VTPC_NIL;
+  for (size_t step = 0; step < clock->capacity; ++step) {
+    const uint32_t frame =
+        (uint32_t)((clock->hand + step) % clock->capacity);
+    const uint8_t bits = clock->bits[frame];
+    if (!(bits & VTPC_CLOCK_PRESENT) ||
+        !vtpc_policy_evictable(policy, frame)) {
+      continue;
+    }
+    if (!(bits & VTPC_CLOCK_REFERENCED)) {
+      return frame;
+    }
+    if (first == VTPC_NIL) {
+      first = frame;
+    }
+  }
+  return first;
+}
+
+static uint32_t vtpc_clock_evict(struct vtpc_policy* policy) {
+  struct vtpc_clock* clock = vtpc_clock(policy);
+  for (size_t step = 0; step < 2 * clock->capacity; ++step) {
+    const uint32_t frame = (uint32_t)clock->hand;
+    clock->hand = (clock->hand + 1) % clock->capacity;
+
+    uint8_t* bits = &clock->bits[frame];
+    if (!(*bits & VTPC_CLOCK_PRESENT) ||
+        !vtpc_policy_evictable(policy, frame)) {
+      continue;
+    }
+    if (*bits & VTPC_CLOCK_REFERENCED) {
+      *bits &= ~VTPC_CLOCK_REFERENCED;
+      continue;
+    }
+
+    *bits = 0;
+    return frame;
+  }
+  return VTPC_NIL;
+}
+
+static void vtpc_clock_remove(struct vtpc_policy* policy, uint32_t frame) {
+  vtpc_clock(policy)->bits[frame] = 0;
+}
+
+const struct vtpc_policy_ops vtpc_policy_clock = {
+    .name = "clock",
+    .create = vtpc_clock_create,
+    .destroy = vtpc_clock_destroy,
+    .hit = vtpc_clock_hit,
+    .miss = NULL,
+    .insert = vtpc_clock_insert,
+    .evict = vtpc_clock_evict,
+    .peek = vtpc_clock_peek,
+    .remove = vtpc_clock_remove,
+    .advise = NULL,
+};
@@ -0,0 +1,82 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "list.h"
+#include "policy.h"
+
+struct vtpc_lru {
+  struct vtpc_policy base;
+  struct vtpc_link* links;
+  struct vtpc_list list;
+};
+
+static struct vtpc_lru* vtpc_lru(struct vtpc_policy* policy) {
+  return (struct vtpc_lru*)policy;
+}
+
+static void vtpc_lru_destroy(struct vtpc_policy* policy) {
+  struct vtpc_lru* lru = vtpc_lru(policy);
+  free(lru->links);
+  free(lru);
+}
+
+static struct vtpc_policy* vtpc_lru_create(size_t capacity) {
+  struct vtpc_lru* lru = calloc(1, sizeof(struct vtpc_lru));
+  if (lru == NULL) {
+    return NULL;
+  }
+
+  lru->links = malloc(capacity * sizeof(struct vtpc_link));
+  if (lru->links == NULL) {
+    free(lru);
+    return NULL;
+  }
+  vtpc_list_init(&lru->list);
+  return &lru->base;
+}
+
+static void vtpc_lru_hit(struct vtpc_policy* policy, uint32_t frame) {
+  struct vtpc_lru* lru = vtpc_lru(policy);
+  vtpc_list_move_front(&lru->list, lru->links, frame);
+}
+
+static void vtpc_lru_insert(
+    struct vtpc_policy* policy, uint32_t frame, uint64_t key
+) {
+  (void)key;
+  struct vtpc_lru* lru = vtpc_lru(policy);
+  vtpc_list_push_front(&lru->list, lru->links, frame);
+}
+
+static uint32_t vtpc_lru_peek(struct vtpc_policy* policy) {
+  struct vtpc_lru* lru = vtpc_lru(policy);
+  return vtpc_policy_victim(policy, &lru->list, lru->links);
+}
+
+static uint32_t vtpc_lru_evict(struct vtpc_policy* policy) {
+  struct vtpc_lru* lru = vtpc_lru(policy);
+  const uint32_t frame = vtpc_lru_peek(policy);
+  if (frame != VTPC_NIL) {
+    vtpc_list_remove(&lru->list, lru->links, frame);
+  }
+  return frame;
+}
+
+static void vtpc_lru_remove(struct vtpc_policy* policy, uint32_t frame) {
+  struct vtpc_lru* lru = vtpc_lru(policy);
+  vtpc_list_remove(&lru->list, lru->links, frame);
+}
+
+const struct vtpc_policy_ops vtpc_policy_lru = {
+    .name = "lru",
+    .create = vtpc_lru_create,
+    .destroy = vtpc_lru_destroy,
+    .hit = vtpc_lru_hit,
+    .miss = NULL,
+    .insert = vtpc_lru_insert,
+    .evict = vtpc_lru_evict,
+    .peek = vtpc_lru_peek,
+    .remove = vtpc_lru_remove,
+    .advise = NULL,
+};
@@ -0,0 +1,142 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ghost.h"
+#include "heap.h"
+#include "policy.h"
+
+/*
+ * LRU-K (O'Neil et al.): the victim is the page whose K-th most recent access
+ * is the oldest. Pages with fewer than K accesses go first, in LRU order.
+ * The last access time of evicted pages is retained, so with K = 2 a page
+ * that comes back keeps its full history.
+ *
+ * Unlike the list based policies the order is kept in a heap, so an access
+ * costs O(log n) instead of O(1).
+ */
+
+#ifndef VTPC_LRUK_K
+#define VTPC_LRUK_K 2
+#endif
+
+#define VTPC_LRUK_CORRELATED (1ULL << 62U)
+
+struct vtpc_lruk_history {
+  uint64_t times[VTPC_LRUK_K];
+  uint64_t key;
+  uint32_t refs;
+};
+
+struct vtpc_lruk {
+  struct vtpc_policy base;
+  struct vtpc_lruk_history* history;
+  struct vtpc_heap heap;
+  struct vtpc_ghost retained;
+  uint64_t now;
+};
+
+static struct vtpc_lruk* vtpc_lruk(struct vtpc_policy* policy) {
+  return (struct vtpc_lruk*)policy;
+}
+
+static void vtpc_lruk_destroy(struct vtpc_policy* policy) {
+  struct vtpc_lruk* lruk = vtpc_lruk(policy);
+  free(lruk->history);
+  vtpc_heap_destroy(&lruk->heap);
+  vtpc_ghost_destroy(&lruk->retained);
+  free(lruk);
+}
+
+static struct vtpc_policy* vtpc_lruk_create(size_t capacity) {
+  struct vtpc_lruk* lruk = calloc(1, sizeof(struct vtpc_lruk));
+  if (lruk == NULL) {
+    return NULL;
+  }
+
+  lruk->history = calloc(capacity, sizeof(struct vtpc_lruk_history));
+  if (lruk->history == NULL ||
+      vtpc_heap_init(&lruk->heap, capacity) == -1 ||
+      vtpc_ghost_init(&lruk->retained, capacity) == -1) {
+    vtpc_lruk_destroy(&lruk->base);
+    return NULL;
+  }
+  return &lruk->base;
+}
+
+static uint64_t vtpc_lruk_priority(const struct vtpc_lruk_history* history) {
+  if (history->refs < VTPC_LRUK_K) {
+    return history->times[0];
+  }
+  return VTPC_LRUK_CORRELATED + history->times[VTPC_LRUK_K - 1];
+}
+
+static void vtpc_lruk_hit(struct vtpc_policy* policy, uint32_t frame) {
+  struct vtpc_lruk* lruk = vtpc_lruk(policy);
+  struct vtpc_lruk_history* history = &lruk->history[frame];
+
+  memmove(
+      &history->times[1],
+      &history->times[0],
+      (VTPC_LRUK_K - 1) * sizeof(uint64_t)
+  );
+  history->times[0] = ++lruk->now;
+  if (history->refs < VTPC_LRUK_K) {
+    history->refs += 1;
+  }
+  vtpc_heap_update(&lruk->heap, frame, vtpc_lruk_priority(history));
+}
+
+static void vtpc_lruk_insert(
+    struct vtpc_policy* policy, uint32_t frame, uint64_t key
+) {
+  struct vtpc_lruk* lruk = vtpc_lruk(policy);
+  struct vtpc_lruk_history* history = &lruk->history[frame];
+
+  *history = (struct vtpc_lruk_history){.key = key, .refs = 1};
+  history->times[0] = ++lruk->now;
+
+  const uint32_t node = vtpc_ghost_find(&lruk->retained, key);
+  if (node != VTPC_NIL) {
+    if (VTPC_LRUK_K > 1) {
+      history->times[1] = lruk->retained.values[node];
+      history->refs = 2;
+    }
+    vtpc_ghost_erase(&lruk->retained, node);
+  }
+
+  vtpc_heap_push(&lruk->heap, frame, vtpc_lruk_priority(history));
+}
+
+static void vtpc_lruk_remove(struct vtpc_policy* policy, uint32_t frame) {
+  vtpc_heap_erase(&vtpc_lruk(policy)->heap, frame);
+}
+
+static uint32_t vtpc_lruk_peek(struct vtpc_policy* policy) {
+  return vtpc_policy_heap_victim(policy, &vtpc_lruk(policy)->heap);
+}
+
+static uint32_t vtpc_lruk_evict(struct vtpc_policy* policy) {
+  struct vtpc_lruk* lruk = vtpc_lruk(policy);
+  const uint32_t frame = vtpc_lruk_peek(policy);
+  if (frame != VTPC_NIL) {
+    const struct vtpc_lruk_history* history = &lruk->history[frame];
+    vtpc_ghost_push(&lruk->retained, history->key, history->times[0]);
+    vtpc_heap_erase(&lruk->heap, frame);
+  }
+  return frame;
+}
+
+const struct vtpc_policy_ops vtpc_policy_lruk = {
+    .name = "lru-k",
+    .create = vtpc_lruk_create,
+    .destroy = vtpc_lruk_destroy,
+    .hit = vtpc_lruk_hit,
+    .miss = NULL,
+    .insert = vtpc_lruk_insert,
+    .evict = vtpc_lruk_evict,
+    .peek = vtpc_lruk_peek,
+    .remove = vtpc_lruk_remove,
+    .advise = NULL,
+};
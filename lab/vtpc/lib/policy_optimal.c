@@ -0,0 +1,243 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "heap.h"
+#include "list.h"
+#include "policy.h"
+
+/*
+ * Optimal (Belady) driven by access hints: among hinted pages the one whose
+ * next access is the furthest away is evicted. A hint is consumed by the
+ * next access to its page. Pages without a hint have no known next access,
+ * so they are evicted first, in LRU order.
+ *
+ * Hints for pages that are not cached wait in a hash table until the page is
+ * inserted.
+ */
+
+struct vtpc_optimal_hints {
+  uint64_t* keys;
+  uint64_t* times;
+  bool* used;
+  size_t mask;
+  size_t size;
+};
+
+struct vtpc_optimal {
+  struct vtpc_policy base;
+  struct vtpc_link* links;
+  struct vtpc_list lru;
+  struct vtpc_heap heap;
+  struct vtpc_optimal_hints hints;
+};
+
+static struct vtpc_optimal* vtpc_optimal(struct vtpc_policy* policy) {
+  return (struct vtpc_optimal*)policy;
+}
+
+static void vtpc_hints_destroy(struct vtpc_optimal_hints* hints) {
+  free(hints->keys);
+  free(hints->times);
+  free(hints->used);
+  *hints = (struct vtpc_optimal_hints){0};
+}
+
+static int vtpc_hints_init(struct vtpc_optimal_hints* hints, size_t slots) {
+  *hints = (struct vtpc_optimal_hints){
+      .keys = malloc(slots * sizeof(uint64_t)),
+      .times = malloc(slots * sizeof(uint64_t)),
+      .used = calloc(slots, sizeof(bool)),
+      .mask = slots - 1,
+      .size = 0,
+  };
+  if (hints->keys == NULL || hints->times == NULL || hints->used == NULL) {
+    vtpc_hints_destroy(hints);
+    errno = ENOMEM;
+    return -1;
+  }
+  return 0;
+}
+
+static size_t vtpc_hints_slot(
+    const struct vtpc_optimal_hints* hints, uint64_t key
+) {
+  size_t slot = (key ^ (key >> 31U)) & hints->mask;
+  while (hints->used[slot] && hints->keys[slot] != key) {
+    slot = (slot + 1) & hints->mask;
+  }
+  return slot;
+}
+
+static int vtpc_hints_put(
+    struct vtpc_optimal_hints* hints, uint64_t key, uint64_t when
+);
+
+static int vtpc_hints_grow(struct vtpc_optimal_hints* hints) {
+  struct vtpc_optimal_hints grown;
+  if (vtpc_hints_init(&grown, 2 * (hints->mask + 1)) == -1) {
+    return -1;
+  }
+  for (size_t i = 0; i <= hints->mask; ++i) {
+    if (hints->used[i]) {
+      vtpc_hints_put(&grown, hints->keys[i], hints->times[i]);
+    }
+  }
+  vtpc_hints_destroy(hints);
+  *hints = grown;
+  return 0;
+}
+
+static int vtpc_hints_put(
+    struct vtpc_optimal_hints* hints, uint64_t key, uint64_t when
+) {
+  if (2 * (hints->size + 1) > hints->mask + 1 && vtpc_hints_grow(hints) == -1) {
+    return -1;
+  }
+
+  const size_t slot = vtpc_hints_slot(hints, key);
+  if (!hints->used[slot]) {
+    hints->used[slot] = true;
+    hints->keys[slot] = key;
+    hints->size += 1;
+  }
+  hints->times[slot] = when;
+  return 0;
+}
+
+static void vtpc_hints_erase(struct vtpc_optimal_hints* hints, uint64_t key) {
+  size_t slot = vtpc_hints_slot(hints, key);
+  if (!hints->used[slot]) {
+    return;
+  }
+
+  size_t next = (slot + 1) & hints->mask;
+  while (hints->used[next]) {
+    const uint64_t other = hints->keys[next];
+    const size_t home = (other ^ (other >> 31U)) & hints->mask;
+    if (((next - home) & hints->mask) >= ((next - slot) & hints->mask)) {
+      hints->keys[slot] = other;
+      hints->times[slot] = hints->times[next];
+      slot = next;
+    }
+    next = (next + 1) & hints->mask;
+  }
+  hints->used[slot] = false;
+  hints->size -= 1;
+}
+
+static void vtpc_optimal_destroy(struct vtpc_policy* policy) {
+  struct vtpc_optimal* opt = vtpc_optimal(policy);
+  free(opt->links);
+  vtpc_heap_destroy(&opt->heap);
+  vtpc_hints_destroy(&opt->hints);
+  free(opt);
+}
+
+static struct vtpc_policy* vtpc_optimal_create(size_t capacity) {
+  struct vtpc_optimal* opt = calloc(1, sizeof(struct vtpc_optimal));
+  if (opt == NULL) {
+    return NULL;
+  }
+
+  size_t slots = 16;
+  while (slots < 2 * capacity) {
+    slots <<= 1U;
+  }
+
+  opt->links = malloc(capacity * sizeof(struct vtpc_link));
+  if (opt->links == NULL ||
+      vtpc_heap_init(&opt->heap, capacity) == -1 ||
+      vtpc_hints_init(&opt->hints, slots) == -1) {
+    vtpc_optimal_destroy(&opt->base);
+    return NULL;
+  }
+  vtpc_list_init(&opt->lru);
+  return &opt->base;
+}
+
+/* Heap is a min-heap, so the furthest access gets the smallest key. */
+static void vtpc_optimal_hint(
+    struct vtpc_optimal* opt, uint32_t frame, uint64_t when
+) {
+  if (vtpc_heap_contains(&opt->heap, frame)) {
+    vtpc_heap_update(&opt->heap, frame, UINT64_MAX - when);
+    return;
+  }
+  vtpc_list_remove(&opt->lru, opt->links, frame);
+  vtpc_heap_push(&opt->heap, frame, UINT64_MAX - when);
+}
+
+static void vtpc_optimal_hit(struct vtpc_policy* policy, uint32_t frame) {
+  struct vtpc_optimal* opt = vtpc_optimal(policy);
+  if (vtpc_heap_contains(&opt->heap, frame)) {
+    vtpc_heap_erase(&opt->heap, frame);
+    vtpc_list_push_front(&opt->lru, opt->links, frame);
+    return;
+  }
+  vtpc_list_move_front(&opt->lru, opt->links, frame);
+}
+
+static void vtpc_optimal_insert(
+    struct vtpc_policy* policy, uint32_t frame, uint64_t key
+) {
+  struct vtpc_optimal* opt = vtpc_optimal(policy);
+  vtpc_list_push_front(&opt->lru, opt->links, frame);
+  vtpc_hints_erase(&opt->hints, key);
+}
+
+static void vtpc_optimal_remove(struct vtpc_policy* policy, uint32_t frame) {
+  struct vtpc_optimal* opt = vtpc_optimal(policy);
+  if (vtpc_heap_contains(&opt->heap, frame)) {
+    vtpc_heap_erase(&opt->heap, frame);
+  } else {
+    vtpc_list_remove(&opt->lru, opt->links, frame);
+  }
+}
+
+/*
+ * Pages without a hint go first, least recently used first, then the page
+ * accessed furthest in the future.
+ */
+static uint32_t vtpc_optimal_peek(struct vtpc_policy* policy) {
+  struct vtpc_optimal* opt = vtpc_optimal(policy);
+  const uint32_t frame = vtpc_policy_victim(policy, &opt->lru, opt->links);
+  if (frame != VTPC_NIL) {
+    return frame;
+  }
+  return vtpc_policy_heap_victim(policy, &opt->heap);
+}
+
+static uint32_t vtpc_optimal_evict(struct vtpc_policy* policy) {
+  const uint32_t frame = vtpc_optimal_peek(policy);
+  if (frame != VTPC_NIL) {
+    vtpc_optimal_remove(policy, frame);
+  }
+  return frame;
+}
+
+static int vtpc_optimal_advise(
+    struct vtpc_policy* policy, uint32_t frame, uint64_t key, uint64_t when
+) {
+  struct vtpc_optimal* opt = vtpc_optimal(policy);
+  if (frame == VTPC_NIL) {
+    return vtpc_hints_put(&opt->hints, key, when);
+  }
+  vtpc_optimal_hint(opt, frame, when);
+  return 0;
+}
+
+const struct vtpc_policy_ops vtpc_policy_optimal = {
+    .name = "optimal",
+    .create = vtpc_optimal_create,
+    .destroy = vtpc_optimal_destroy,
+    .hit = vtpc_optimal_hit,
+    .miss = NULL,
+    .insert = vtpc_optimal_insert,
+    .evict = vtpc_optimal_evict,
+    .peek = vtpc_optimal_peek,
+    .remove = vtpc_optimal_remove,
+    .advise = vtpc_optimal_advise,
+};
@@ -0,0 +1,221 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "list.h"
+#include "policy.h"
+#include "sketch.h"
+
+/*
+ * W-TinyLFU admission (Einziger et al.) in front of another policy. New
+ * pages enter a small LRU window. When the cache is full, the oldest page of
+ * the window is only admitted to the main policy if the sketch has seen it
+ * more often than the victim the main policy offers; otherwise it is the one
+ * evicted. A scan of pages seen once thus cycles through the window and
+ * leaves the frequently used pages of the main policy alone.
+ *
+ * The main policy is created for the whole capacity, since frames of either
+ * part are indexed over all of it, but never holds more than its share.
+ */
+
+enum vtpc_tinylfu_place {
+  VTPC_TINYLFU_NONE,
+  VTPC_TINYLFU_WINDOW,
+  VTPC_TINYLFU_MAIN,
+};
+
+/*
+ * The window takes this share of the capacity. Readahead inserts its pages
+ * into the window before they are read, so it holds at least a couple of
+ * readahead windows, unless that is more than a quarter of the capacity.
+ */
+#define VTPC_TINYLFU_WINDOW_SHARE 100
+#define VTPC_TINYLFU_WINDOW_MIN 64
+
+struct vtpc_tinylfu {
+  struct vtpc_policy base;
+  struct vtpc_policy* main;
+  struct vtpc_sketch sketch;
+  struct vtpc_link* links;
+  uint64_t* keys;
+  uint8_t* places;
+  struct vtpc_list window;
+  size_t window_capacity;
+  size_t main_size;
+  size_t main_capacity;
+};
+
+static struct vtpc_tinylfu* vtpc_tinylfu(struct vtpc_policy* policy) {
+  return (struct vtpc_tinylfu*)policy;
+}
+
+static void vtpc_tinylfu_destroy(struct vtpc_policy* policy) {
+  struct vtpc_tinylfu* lfu = vtpc_tinylfu(policy);
+  if (lfu->main != NULL) {
+    vtpc_policy_destroy(lfu->main);
+  }
+  vtpc_sketch_destroy(&lfu->sketch);
+  free(lfu->links);
+  free(lfu->keys);
+  free(lfu->places);
+  free(lfu);
+}
+
+/* Moves a frame from the window to the main policy. */
+static void vtpc_tinylfu_promote(struct vtpc_tinylfu* lfu, uint32_t frame) {
+  vtpc_list_remove(&lfu->window, lfu->links, frame);
+  vtpc_policy_miss(lfu->main, lfu->keys[frame]);
+  vtpc_policy_insert(lfu->main, frame, lfu->keys[frame]);
+  lfu->places[frame] = VTPC_TINYLFU_MAIN;
+  lfu->main_size += 1;
+}
+
+static void vtpc_tinylfu_hit(struct vtpc_policy* policy, uint32_t frame) {
+  struct vtpc_tinylfu* lfu = vtpc_tinylfu(policy);
+  vtpc_sketch_add(&lfu->sketch, lfu->keys[frame]);
+  if (lfu->places[frame] == VTPC_TINYLFU_WINDOW) {
+    vtpc_list_move_front(&lfu->window, lfu->links, frame);
+  } else {
+    vtpc_policy_hit(lfu->main, frame);
+  }
+}
+
+static void vtpc_tinylfu_miss(struct vtpc_policy* policy, uint64_t key) {
+  vtpc_sketch_add(&vtpc_tinylfu(policy)->sketch, key);
+}
+
+static void vtpc_tinylfu_insert(
+    struct vtpc_policy* policy, uint32_t frame, uint64_t key
+) {
+  struct vtpc_tinylfu* lfu = vtpc_tinylfu(policy);
+  lfu->keys[frame] = key;
+  lfu->places[frame] = VTPC_TINYLFU_WINDOW;
+  vtpc_list_push_front(&lfu->window, lfu->links, frame);
+
+  /* While the cache fills up, the main policy takes pages unfiltered. */
+  while (lfu->window.size > lfu->window_capacity &&
+         lfu->main_size < lfu->main_capacity) {
+    vtpc_tinylfu_promote(lfu, lfu->window.tail);
+  }
+}
+
+static uint32_t vtpc_tinylfu_take(struct vtpc_tinylfu* lfu, uint32_t frame) {
+  vtpc_list_remove(&lfu->window, lfu->links, frame);
+  lfu->places[frame] = VTPC_TINYLFU_NONE;
+  return frame;
+}
+
+/*
+ * The main policy only evicts its victim once the candidate has beaten it, so
+ * a victim that stays is left exactly as it was.
+ */
+static uint32_t vtpc_tinylfu_evict(struct vtpc_policy* policy) {
+  struct vtpc_tinylfu* lfu = vtpc_tinylfu(policy);
+  while (lfu->window.size > lfu->window_capacity &&
+         lfu->main_size < lfu->main_capacity) {
+    vtpc_tinylfu_promote(lfu, lfu->window.tail);
+  }
+
+  const uint32_t candidate =
+      vtpc_policy_victim(policy, &lfu->window, lfu->links);
+  if (lfu->window.size < lfu->window_capacity || candidate == VTPC_NIL) {
+    const uint32_t victim = vtpc_policy_evict(lfu->main);
+    if (victim != VTPC_NIL) {
+      lfu->places[victim] = VTPC_TINYLFU_NONE;
+      lfu->main_size -= 1;
+      return victim;
+    }
+    return (candidate != VTPC_NIL) ? vtpc_tinylfu_take(lfu, candidate)
+                                   : VTPC_NIL;
+  }
+
+  /* Ties keep the victim, which has proven itself in the main policy. */
+  const uint32_t victim = vtpc_policy_peek(lfu->main);
+  if (victim == VTPC_NIL ||
+      vtpc_sketch_estimate(&lfu->sketch, lfu->keys[candidate]) <=
+          vtpc_sketch_estimate(&lfu->sketch, lfu->keys[victim])) {
+    return vtpc_tinylfu_take(lfu, candidate);
+  }
+
+  const uint32_t evicted = vtpc_policy_evict(lfu->main);
+  lfu->places[evicted] = VTPC_TINYLFU_NONE;
+  lfu->main_size -= 1;
+  vtpc_tinylfu_promote(lfu, candidate);
+  return evicted;
+}
+
+static void vtpc_tinylfu_remove(struct vtpc_policy* policy, uint32_t frame) {
+  struct vtpc_tinylfu* lfu = vtpc_tinylfu(policy);
+  if (lfu->places[frame] == VTPC_TINYLFU_WINDOW) {
+    vtpc_list_remove(&lfu->window, lfu->links, frame);
+  } else if (lfu->places[frame] == VTPC_TINYLFU_MAIN) {
+    vtpc_policy_remove(lfu->main, frame);
+    lfu->main_size -= 1;
+  }
+  lfu->places[frame] = VTPC_TINYLFU_NONE;
+}
+
+static int vtpc_tinylfu_advise(
+    struct vtpc_policy* policy, uint32_t frame, uint64_t key, uint64_t when
+) {
+  struct vtpc_tinylfu* lfu = vtpc_tinylfu(policy);
+  const bool main =
+      (frame != VTPC_NIL && lfu->places[frame] == VTPC_TINYLFU_MAIN);
+  return vtpc_policy_advise(lfu->main, main ? frame : VTPC_NIL, key, when);
+}
+
+const struct vtpc_policy_ops vtpc_policy_tinylfu = {
+    .name = "tinylfu",
+    .create = NULL,
+    .destroy = vtpc_tinylfu_destroy,
+    .hit = vtpc_tinylfu_hit,
+    .miss = vtpc_tinylfu_miss,
+    .insert = vtpc_tinylfu_insert,
+    .evict = vtpc_tinylfu_evict,
+    .peek = NULL,
+    .remove = vtpc_tinylfu_remove,
+    .advise = vtpc_tinylfu_advise,
+};
+
+struct vtpc_policy* vtpc_policy_admit(
+    const struct vtpc_policy_ops* ops,
+    size_t capacity,
+    vtpc_evictable_fn evictable,
+    void* ctx
+) {
+  struct vtpc_tinylfu* lfu = calloc(1, sizeof(struct vtpc_tinylfu));
+  if (lfu == NULL) {
+    return NULL;
+  }
+  lfu->base = (struct vtpc_policy){
+      .ops = &vtpc_policy_tinylfu,
+      .evictable = evictable,
+      .ctx = ctx,
+  };
+
+  lfu->window_capacity = capacity / VTPC_TINYLFU_WINDOW_SHARE;
+  if (lfu->window_capacity < VTPC_TINYLFU_WINDOW_MIN) {
+    lfu->window_capacity = VTPC_TINYLFU_WINDOW_MIN;
+  }
+  if (lfu->window_capacity > capacity / 4) {
+    lfu->window_capacity = capacity / 4;
+  }
+  if (lfu->window_capacity == 0) {
+    lfu->window_capacity = 1;
+  }
+  lfu->main_capacity =
+      (capacity > lfu->window_capacity) ? capacity - lfu->window_capacity : 0;
+  vtpc_list_init(&lfu->window);
+
+  lfu->main = vtpc_policy_create(ops, capacity, evictable, ctx);
+  lfu->links = malloc(capacity * sizeof(struct vtpc_link));
+  lfu->keys = malloc(capacity * sizeof(uint64_t));
+  lfu->places = calloc(capacity, sizeof(uint8_t));
+  if (lfu->main == NULL || lfu->links == NULL || lfu->keys == NULL ||
+      lfu->places == NULL || vtpc_sketch_init(&lfu->sketch, capacity) == -1) {
+    vtpc_tinylfu_destroy(&lfu->base);
+    return NULL;
+  }
+  return &lfu->base;
+}
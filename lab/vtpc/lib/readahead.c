@@ -0,0 +1,240 @@
+#include "readahead.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "cache.h"
+#include "file.h"
+#include "io.h"
+
+#define VTPC_READAHEAD_QUEUE 64
+#define VTPC_READAHEAD_MAX VTPC_RUN_MAX
+
+struct vtpc_readahead_request {
+  struct vtpc_file* file;
+  uint64_t start;
+  size_t count;
+};
+
+/*
+ * The lock protects the queue and the file being served, which close waits
+ * to change before the file goes away.
+ */
+static struct {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wakeup;
+  pthread_cond_t served;
+  struct vtpc_readahead_request queue[VTPC_READAHEAD_QUEUE];
+  size_t head;
+  size_t size;
+  size_t max;
+  struct vtpc_file* current;
+} prefetcher = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wakeup = PTHREAD_COND_INITIALIZER,
+    .served = PTHREAD_COND_INITIALIZER,
+};
+
+static size_t vtpc_readahead_min(size_t lhs, size_t rhs) {
+  return lhs < rhs ? lhs : rhs;
+}
+
+/* Reads the runs of reserved frames of a window with one batch. */
+static void vtpc_readahead_read(
+    struct vtpc_cache* cache,
+    struct vtpc_io* batch,
+    size_t count,
+    struct vtpc_frame* const* frames
+) {
+  vtpc_io_submit(batch, count);
+
+  /* Pages that fail verification are dropped for the reader to fail on. */
+  bool bad[VTPC_READAHEAD_MAX] = {false};
+  size_t at = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const struct vtpc_io* io = &batch[i];
+    size_t done = (io->result < 0) ? 0 : (size_t)io->result;
+    for (size_t j = 0; j < io->count; ++j) {
+      const size_t got = (done < VTPC_PAGE_SIZE) ? done : VTPC_PAGE_SIZE;
+      memset((char*)io->iov[j].iov_base + got, 0, VTPC_PAGE_SIZE - got);
+      done -= got;
+    }
+    if (io->result >= 0) {
+      (void)vtpc_cache_verify(
+          frames[at]->file, frames + at, io->count, bad + at
+      );
+    }
+    for (size_t j = 0; j < io->count; ++j) {
+      const bool ok = io->result >= 0 && !bad[at + j];
+      vtpc_cache_complete(cache, frames[at + j], ok);
+    }
+    at += io->count;
+  }
+}
+
+static void vtpc_readahead_serve(
+    struct vtpc_cache* cache, const struct vtpc_readahead_request* request
+) {
+  struct vtpc_file* file = request->file;
+  const uint64_t pages =
+      ((uint64_t)atomic_load(&file->disk_size) + VTPC_PAGE_SIZE - 1) /
+      VTPC_PAGE_SIZE;
+  const uint64_t end =
+      vtpc_readahead_min(request->start + request->count, pages);
+
+  struct vtpc_frame* frames[VTPC_READAHEAD_MAX];
+  struct iovec iov[VTPC_READAHEAD_MAX];
+  struct vtpc_io batch[VTPC_READAHEAD_MAX];
+  size_t total = 0;
+  size_t count = 0;
+  bool run = false;
+  for (uint64_t page = request->start; page < end; ++page) {
+    struct vtpc_frame* frame = vtpc_cache_reserve(cache, file, page);
+    if (frame == NULL) {
+      run = false;
+      continue;
+    }
+
+    frames[total] = frame;
+    iov[total] = (struct iovec){
+        .iov_base = frame->data,
+        .iov_len = VTPC_PAGE_SIZE,
+    };
+    if (!run) {
+      batch[count++] = (struct vtpc_io){
+          .fd = file->fd,
+          .offset = (off_t)(page * VTPC_PAGE_SIZE),
+          .iov = &iov[total],
+      };
+      run = true;
+    }
+    batch[count - 1].count += 1;
+    total += 1;
+  }
+
+  vtpc_readahead_read(cache, batch, count, frames);
+}
+
+static void* vtpc_readahead_main(void* arg) {
+  struct vtpc_cache* cache = arg;
+
+  pthread_mutex_lock(&prefetcher.lock);
+  for (;;) {
+    while (prefetcher.size == 0) {
+      pthread_cond_wait(&prefetcher.wakeup, &prefetcher.lock);
+    }
+
+    const struct vtpc_readahead_request request =
+        prefetcher.queue[prefetcher.head];
+    prefetcher.head = (prefetcher.head + 1) % VTPC_READAHEAD_QUEUE;
+    prefetcher.size -= 1;
+    prefetcher.current = request.file;
+    pthread_mutex_unlock(&prefetcher.lock);
+
+    vtpc_readahead_serve(cache, &request);
+
+    pthread_mutex_lock(&prefetcher.lock);
+    prefetcher.current = NULL;
+    pthread_cond_broadcast(&prefetcher.served);
+  }
+  return NULL;
+}
+
+int vtpc_readahead_init(struct vtpc_cache* cache, size_t max) {
+  prefetcher.max = vtpc_readahead_min(max, VTPC_READAHEAD_MAX);
+  if (prefetcher.max == 0) {
+    return 0;
+  }
+
+  const int error =
+      pthread_create(&prefetcher.thread, NULL, vtpc_readahead_main, cache);
+  if (error != 0) {
+    prefetcher.max = 0;
+    errno = error;
+    return -1;
+  }
+  pthread_detach(prefetcher.thread);
+  return 0;
+}
+
+static void vtpc_readahead_submit(
+    struct vtpc_file* file, uint64_t start, size_t count
+) {
+  pthread_mutex_lock(&prefetcher.lock);
+  if (prefetcher.size == VTPC_READAHEAD_QUEUE) {
+    pthread_mutex_unlock(&prefetcher.lock);
+    return;
+  }
+
+  const size_t tail =
+      (prefetcher.head + prefetcher.size) % VTPC_READAHEAD_QUEUE;
+  prefetcher.queue[tail] = (struct vtpc_readahead_request){
+      .file = file,
+      .start = start,
+      .count = count,
+  };
+  prefetcher.size += 1;
+  pthread_cond_signal(&prefetcher.wakeup);
+  pthread_mutex_unlock(&prefetcher.lock);
+}
+
+void vtpc_readahead_access(
+    struct vtpc_file* file, struct vtpc_stream* stream, uint64_t page, bool hit
+) {
+  if (prefetcher.max == 0 || page == stream->prev) {
+    return;
+  }
+
+  const bool sequential = (page == stream->prev + 1);
+  stream->prev = page;
+  if (!sequential) {
+    stream->size /= 2;
+    stream->marker = UINT64_MAX;
+    return;
+  }
+
+  if (!hit) {
+    stream->start = page + 1;
+    stream->size = (stream->size == 0) ? VTPC_READAHEAD_MIN : 2 * stream->size;
+  } else if (page == stream->marker) {
+    stream->start += stream->size;
+    stream->size *= 2;
+  } else {
+    return;
+  }
+
+  stream->size = vtpc_readahead_min(stream->size, prefetcher.max);
+  stream->marker = stream->start;
+  vtpc_readahead_submit(file, stream->start, stream->size);
+}
+
+void vtpc_readahead_cancel(struct vtpc_file* file) {
+  if (prefetcher.max == 0) {
+    return;
+  }
+
+  pthread_mutex_lock(&prefetcher.lock);
+  size_t kept = 0;
+  for (size_t i = 0; i < prefetcher.size; ++i) {
+    const size_t from = (prefetcher.head + i) % VTPC_READAHEAD_QUEUE;
+    if (prefetcher.queue[from].file != file) {
+      const size_t to = (prefetcher.head + kept) % VTPC_READAHEAD_QUEUE;
+      prefetcher.queue[to] = prefetcher.queue[from];
+      kept += 1;
+    }
+  }
+  prefetcher.size = kept;
+
+  while (prefetcher.current == file) {
+    pthread_cond_wait(&prefetcher.served, &prefetcher.lock);
+  }
+  pthread_mutex_unlock(&prefetcher.lock);
+}
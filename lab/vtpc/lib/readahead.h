@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cache.h"
+#include "file.h"
+
+#define VTPC_READAHEAD_MIN 4
+#define VTPC_READAHEAD_DEFAULT 32
+
+/*
+ * Sequential readahead. Reads of consecutive pages open a window of pages
+ * that a background thread reads into LOADING frames. Entering the window
+ * fetches the next one, twice as large up to the maximum; a random access
+ * halves the window.
+ *
+ * Every handle has its own stream, protected by the stream lock of the
+ * handle.
+ */
+
+/* Starts the I/O thread. A maximum window of 0 disables readahead. */
+int vtpc_readahead_init(struct vtpc_cache* cache, size_t max);
+
+/* Feeds a page read of the file through a handle into its stream detector. */
+void vtpc_readahead_access(
+    struct vtpc_file* file, struct vtpc_stream* stream, uint64_t page, bool hit
+);
+
+/* Drops queued readahead of the file and waits for the in-flight one. */
+void vtpc_readahead_cancel(struct vtpc_file* file);
@@ -0,0 +1,90 @@
+#include "sketch.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define VTPC_SKETCH_MAX 15
+#define VTPC_SKETCH_PERIOD 10
+
+/*
+ * Counters per row for every key the sketch is sized for. With fewer, the
+ * keys seen once collide so often that they look as popular as the cached
+ * ones.
+ */
+#define VTPC_SKETCH_WIDTH 4
+
+static const uint64_t seeds[VTPC_SKETCH_DEPTH] = {
+    0x9E3779B97F4A7C15ULL,
+    0xC2B2AE3D27D4EB4FULL,
+    0x165667B19E3779F9ULL,
+    0xD6E8FEB86659FD93ULL,
+};
+
+static uint8_t* vtpc_sketch_counter(
+    const struct vtpc_sketch* sketch, uint64_t key, size_t row
+) {
+  uint64_t hash = (key + row) * seeds[row];
+  hash ^= hash >> 32U;
+  return &sketch->counters[(row * (sketch->mask + 1)) + (hash & sketch->mask)];
+}
+
+int vtpc_sketch_init(struct vtpc_sketch* sketch, size_t capacity) {
+  if (capacity < 16) {
+    capacity = 16;
+  }
+  size_t width = 1;
+  while (width < VTPC_SKETCH_WIDTH * capacity) {
+    width <<= 1U;
+  }
+
+  *sketch = (struct vtpc_sketch){
+      .counters = calloc(VTPC_SKETCH_DEPTH * width, sizeof(uint8_t)),
+      .mask = width - 1,
+      .added = 0,
+      .period = VTPC_SKETCH_PERIOD * capacity,
+  };
+  if (sketch->counters == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+  return 0;
+}
+
+void vtpc_sketch_destroy(struct vtpc_sketch* sketch) {
+  free(sketch->counters);
+  sketch->counters = NULL;
+}
+
+static void vtpc_sketch_age(struct vtpc_sketch* sketch) {
+  const size_t count = VTPC_SKETCH_DEPTH * (sketch->mask + 1);
+  for (size_t i = 0; i < count; ++i) {
+    sketch->counters[i] >>= 1U;
+  }
+  sketch->added /= 2;
+}
+
+void vtpc_sketch_add(struct vtpc_sketch* sketch, uint64_t key) {
+  for (size_t row = 0; row < VTPC_SKETCH_DEPTH; ++row) {
+    uint8_t* counter = vtpc_sketch_counter(sketch, key, row);
+    if (*counter < VTPC_SKETCH_MAX) {
+      *counter += 1;
+    }
+  }
+  sketch->added += 1;
+  if (sketch->added >= sketch->period) {
+    vtpc_sketch_age(sketch);
+  }
+}
+
+unsigned vtpc_sketch_estimate(const struct vtpc_sketch* sketch, uint64_t key) {
+  unsigned estimate = VTPC_SKETCH_MAX;
+  for (size_t row = 0; row < VTPC_SKETCH_DEPTH; ++row) {
+    const unsigned counter = *vtpc_sketch_counter(sketch, key, row);
+    if (counter < estimate) {
+      estimate = counter;
+    }
+  }
+  return estimate;
+}
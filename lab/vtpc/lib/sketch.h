@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define VTPC_SKETCH_DEPTH 4
+
+/*
+ * Count-min sketch of how often keys were seen, as used by TinyLFU
+ * (Einziger et al.). Each key has a counter in every row and its estimate
+ * is the smallest of them. Counters saturate at 15, and once period keys
+ * have been added all counters are halved, so old popularity fades.
+ */
+struct vtpc_sketch {
+  uint8_t* counters;
+  size_t mask;
+  size_t added;
+  size_t period;
+};
+
+/* Sizes the rows for about capacity distinct keys. */
+int vtpc_sketch_init(struct vtpc_sketch* sketch, size_t capacity);
+void vtpc_sketch_destroy(struct vtpc_sketch* sketch);
+
+void vtpc_sketch_add(struct vtpc_sketch* sketch, uint64_t key);
+unsigned vtpc_sketch_estimate(const struct vtpc_sketch* sketch, uint64_t key);
@@ -0,0 +1,275 @@
+#include "stats.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vtpc.h"
+
+/* The counters of a live thread, linked into the registry. */
+struct vtpc_stats_thread {
+  _Alignas(64) struct vtpc_counters counters;
+  size_t slot;
+  struct vtpc_stats_thread* prev;
+  struct vtpc_stats_thread* next;
+};
+
+/*
+ * The counters of the live threads and the sum of those of the exited ones.
+ * The lock protects the list and the slot numbers; readers hold it only to
+ * keep the counters of a thread from being freed while they sum them.
+ * Threads whose counters cannot be allocated add to the retired ones.
+ */
+static struct {
+  pthread_mutex_t lock;
+  struct vtpc_stats_thread* threads;
+  size_t slots;
+  struct vtpc_counters retired;
+  pthread_once_t once;
+  pthread_key_t key;
+  atomic_bool keyed;
+} registry = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .once = PTHREAD_ONCE_INIT,
+};
+
+static _Thread_local struct vtpc_stats_thread* local;
+
+/* Adds to a counter that other threads may write as well. */
+static void vtpc_counter_add(atomic_uint_fast64_t* counter, uint64_t n) {
+  atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+}
+
+/* Adds to a counter that only the calling thread writes. */
+static void vtpc_counter_bump(atomic_uint_fast64_t* counter, uint64_t n) {
+  const uint64_t value = atomic_load_explicit(counter, memory_order_relaxed);
+  atomic_store_explicit(counter, value + n, memory_order_relaxed);
+}
+
+static uint64_t vtpc_counter_get(const atomic_uint_fast64_t* counter) {
+  return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static void vtpc_counters_fold(
+    struct vtpc_counters* into, const struct vtpc_counters* from
+) {
+  for (size_t i = 0; i < VTPC_COUNTERS; ++i) {
+    vtpc_counter_add(&into->values[i], vtpc_counter_get(&from->values[i]));
+  }
+  for (size_t i = 0; i < VTPC_TIMERS; ++i) {
+    vtpc_counter_add(&into->totals[i], vtpc_counter_get(&from->totals[i]));
+    for (size_t j = 0; j < VTPC_LATENCY_BUCKETS; ++j) {
+      vtpc_counter_add(
+          &into->buckets[i][j], vtpc_counter_get(&from->buckets[i][j])
+      );
+    }
+  }
+}
+
+static void vtpc_stats_exit(void* arg) {
+  struct vtpc_stats_thread* thread = arg;
+
+  pthread_mutex_lock(&registry.lock);
+  vtpc_counters_fold(&registry.retired, &thread->counters);
+  if (thread->prev != NULL) {
+    thread->prev->next = thread->next;
+  } else {
+    registry.threads = thread->next;
+  }
+  if (thread->next != NULL) {
+    thread->next->prev = thread->prev;
+  }
+  pthread_mutex_unlock(&registry.lock);
+
+  local = NULL;
+  free(thread);
+}
+
+static void vtpc_stats_once(void) {
+  if (pthread_key_create(&registry.key, vtpc_stats_exit) == 0) {
+    atomic_store(&registry.keyed, true);
+  }
+}
+
+/*
+ * Returns the counters of the calling thread, registering them on first
+ * use. Without a key to fold them back on exit they would leak with every
+ * thread, so then all threads share the retired counters instead.
+ */
+static struct vtpc_stats_thread* vtpc_stats_thread(void) {
+  if (local != NULL) {
+    return local;
+  }
+
+  pthread_once(&registry.once, vtpc_stats_once);
+  if (!atomic_load(&registry.keyed)) {
+    return NULL;
+  }
+
+  struct vtpc_stats_thread* thread =
+      aligned_alloc(_Alignof(struct vtpc_stats_thread), sizeof(*thread));
+  if (thread == NULL) {
+    return NULL;
+  }
+  memset(thread, 0, sizeof(*thread));
+
+  pthread_mutex_lock(&registry.lock);
+  thread->slot = registry.slots++;
+  thread->next = registry.threads;
+  if (registry.threads != NULL) {
+    registry.threads->prev = thread;
+  }
+  registry.threads = thread;
+  pthread_mutex_unlock(&registry.lock);
+
+  pthread_setspecific(registry.key, thread);
+  local = thread;
+  return local;
+}
+
+static struct vtpc_counters* vtpc_stats_stripe(
+    struct vtpc_stripe* stripes, const struct vtpc_stats_thread* thread
+) {
+  const size_t slot = (thread != NULL) ? thread->slot : 0;
+  return &stripes[slot % VTPC_STATS_STRIPES].counters;
+}
+
+struct vtpc_stripe* vtpc_stats_create(void) {
+  const size_t size = VTPC_STATS_STRIPES * sizeof(struct vtpc_stripe);
+  struct vtpc_stripe* stripes =
+      aligned_alloc(_Alignof(struct vtpc_stripe), size);
+  if (stripes != NULL) {
+    memset(stripes, 0, size);
+  }
+  return stripes;
+}
+
+void vtpc_stats_destroy(struct vtpc_stripe* stripes) {
+  free(stripes);
+}
+
+void vtpc_stats_add(
+    struct vtpc_stripe* stripes, enum vtpc_counter counter, uint64_t n
+) {
+  struct vtpc_stats_thread* thread = vtpc_stats_thread();
+  if (thread != NULL) {
+    vtpc_counter_bump(&thread->counters.values[counter], n);
+  } else {
+    vtpc_counter_add(&registry.retired.values[counter], n);
+  }
+  if (stripes != NULL) {
+    vtpc_counter_add(&vtpc_stats_stripe(stripes, thread)->values[counter], n);
+  }
+}
+
+uint64_t vtpc_stats_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec * 1000000000) + (uint64_t)now.tv_nsec;
+}
+
+/* Bucket i holds latencies in [2^i, 2^(i + 1)), bucket 0 also 0 and 1. */
+static size_t vtpc_latency_bucket(uint64_t nanoseconds) {
+  size_t bucket = 0;
+  while (nanoseconds > 1 && bucket + 1 < VTPC_LATENCY_BUCKETS) {
+    nanoseconds >>= 1U;
+    bucket += 1;
+  }
+  return bucket;
+}
+
+void vtpc_stats_time(
+    struct vtpc_stripe* stripes, enum vtpc_timer timer, uint64_t start
+) {
+  const uint64_t now = vtpc_stats_now();
+  const uint64_t elapsed = (now > start) ? now - start : 0;
+  const size_t bucket = vtpc_latency_bucket(elapsed);
+
+  struct vtpc_stats_thread* thread = vtpc_stats_thread();
+  if (thread != NULL) {
+    vtpc_counter_bump(&thread->counters.totals[timer], elapsed);
+    vtpc_counter_bump(&thread->counters.buckets[timer][bucket], 1);
+  } else {
+    vtpc_counter_add(&registry.retired.totals[timer], elapsed);
+    vtpc_counter_add(&registry.retired.buckets[timer][bucket], 1);
+  }
+  if (stripes != NULL) {
+    struct vtpc_counters* stripe = vtpc_stats_stripe(stripes, thread);
+    vtpc_counter_add(&stripe->totals[timer], elapsed);
+    vtpc_counter_add(&stripe->buckets[timer][bucket], 1);
+  }
+}
+
+static void vtpc_stats_sum(
+    struct vtpc_stats* stats, const struct vtpc_counters* counters
+) {
+  const atomic_uint_fast64_t* values = counters->values;
+  stats->hits += vtpc_counter_get(&values[VTPC_COUNTER_HITS]);
+  stats->misses += vtpc_counter_get(&values[VTPC_COUNTER_MISSES]);
+  stats->evictions += vtpc_counter_get(&values[VTPC_COUNTER_EVICTIONS]);
+  stats->prefetched += vtpc_counter_get(&values[VTPC_COUNTER_PREFETCHED]);
+  stats->prefetch_hits +=
+      vtpc_counter_get(&values[VTPC_COUNTER_PREFETCH_HITS]);
+  stats->prefetch_wasted +=
+      vtpc_counter_get(&values[VTPC_COUNTER_PREFETCH_WASTED]);
+  stats->writes += vtpc_counter_get(&values[VTPC_COUNTER_WRITES]);
+  stats->written += vtpc_counter_get(&values[VTPC_COUNTER_WRITTEN]);
+  stats->written_bytes +=
+      vtpc_counter_get(&values[VTPC_COUNTER_WRITTEN_BYTES]);
+  stats->checksum_errors +=
+      vtpc_counter_get(&values[VTPC_COUNTER_CHECKSUM_ERRORS]);
+
+  struct vtpc_latency* latencies[VTPC_TIMERS] = {
+      [VTPC_TIMER_MISS] = &stats->miss_latency,
+      [VTPC_TIMER_FLUSH] = &stats->flush_latency,
+  };
+  for (size_t i = 0; i < VTPC_TIMERS; ++i) {
+    struct vtpc_latency* latency = latencies[i];
+    latency->total += vtpc_counter_get(&counters->totals[i]);
+    for (size_t j = 0; j < VTPC_LATENCY_BUCKETS; ++j) {
+      const uint64_t count = vtpc_counter_get(&counters->buckets[i][j]);
+      latency->buckets[j] += count;
+      latency->count += count;
+    }
+  }
+}
+
+void vtpc_stats_global(struct vtpc_stats* stats) {
+  *stats = (struct vtpc_stats){0};
+  pthread_mutex_lock(&registry.lock);
+  vtpc_stats_sum(stats, &registry.retired);
+  for (const struct vtpc_stats_thread* thread = registry.threads;
+       thread != NULL;
+       thread = thread->next) {
+    vtpc_stats_sum(stats, &thread->counters);
+  }
+  pthread_mutex_unlock(&registry.lock);
+}
+
+void vtpc_stats_file(
+    const struct vtpc_stripe* stripes, struct vtpc_stats* stats
+) {
+  *stats = (struct vtpc_stats){0};
+  for (size_t i = 0; i < VTPC_STATS_STRIPES; ++i) {
+    vtpc_stats_sum(stats, &stripes[i].counters);
+  }
+}
+
+uint64_t vtpc_stats_percentile(
+    const struct vtpc_latency* latency, double percentile
+) {
+  const double rank = percentile / 100.0 * (double)latency->count;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < VTPC_LATENCY_BUCKETS; ++i) {
+    seen += latency->buckets[i];
+    if (seen != 0 && (double)seen >= rank) {
+      return UINT64_C(1) << (i + 1);
+    }
+  }
+  return 0;
+}
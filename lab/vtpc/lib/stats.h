@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vtpc.h"
+
+/* Stripes of the counters of a file; threads pick one by their slot. */
+#define VTPC_STATS_STRIPES 8
+
+enum vtpc_counter {
+  VTPC_COUNTER_HITS,
+  VTPC_COUNTER_MISSES,
+  VTPC_COUNTER_EVICTIONS,
+  VTPC_COUNTER_PREFETCHED,
+  VTPC_COUNTER_PREFETCH_HITS,
+  VTPC_COUNTER_PREFETCH_WASTED,
+  VTPC_COUNTER_WRITES,
+  VTPC_COUNTER_WRITTEN,
+  VTPC_COUNTER_WRITTEN_BYTES,
+  VTPC_COUNTER_CHECKSUM_ERRORS,
+  VTPC_COUNTERS,
+};
+
+enum vtpc_timer {
+  VTPC_TIMER_MISS,
+  VTPC_TIMER_FLUSH,
+  VTPC_TIMERS,
+};
+
+/* Event counts and latency histograms of one thread or one file stripe. */
+struct vtpc_counters {
+  atomic_uint_fast64_t values[VTPC_COUNTERS];
+  atomic_uint_fast64_t totals[VTPC_TIMERS];
+  atomic_uint_fast64_t buckets[VTPC_TIMERS][VTPC_LATENCY_BUCKETS];
+};
+
+/*
+ * One stripe of the counters of a file, on cache lines of its own so that
+ * threads with different slots do not share them.
+ */
+struct vtpc_stripe {
+  _Alignas(64) struct vtpc_counters counters;
+};
+
+/* Allocates and frees the zeroed stripes of a file. */
+struct vtpc_stripe* vtpc_stats_create(void);
+void vtpc_stats_destroy(struct vtpc_stripe* stripes);
+
+/*
+ * Adds n to a counter of the calling thread and of the file. A thread only
+ * ever writes its own counters, so updates take no lock and no atomic
+ * read-modify-write; the file stripes are shared by the threads whose slots
+ * map to them and are updated atomically.
+ */
+void vtpc_stats_add(
+    struct vtpc_stripe* stripes, enum vtpc_counter counter, uint64_t n
+);
+
+/* Returns the monotonic time in nanoseconds. */
+uint64_t vtpc_stats_now(void);
+
+/* Records an operation that started at start into a latency histogram. */
+void vtpc_stats_time(
+    struct vtpc_stripe* stripes, enum vtpc_timer timer, uint64_t start
+);
+
+/*
+ * Sums the counters of all threads, including those that have exited, or
+ * of all stripes of a file. The dirty page count is left for the cache.
+ */
+void vtpc_stats_global(struct vtpc_stats* stats);
+void vtpc_stats_file(
+    const struct vtpc_stripe* stripes, struct vtpc_stats* stats
+);
+
+/* Returns the upper bound of the bucket holding the given percentile. */
+uint64_t vtpc_stats_percentile(
+    const struct vtpc_latency* latency, double percentile
+);
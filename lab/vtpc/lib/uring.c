@@ -0,0 +1,331 @@
+#include "uring.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "io.h"
+
+#define VTPC_URING_ENTRIES 64
+
+struct vtpc_ring {
+  int fd;
+  unsigned entries;
+  bool fixed;
+  unsigned* sq_tail;
+  unsigned* sq_mask;
+  unsigned* sq_array;
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned* cq_mask;
+  struct io_uring_sqe* sqes;
+  struct io_uring_cqe* cqes;
+  void* sq_ring;
+  size_t sq_size;
+  void* cq_ring;
+  size_t cq_size;
+  size_t sqes_size;
+};
+
+static struct {
+  char* memory;
+  size_t size;
+  pthread_once_t once;
+  pthread_key_t key;
+  atomic_bool broken;
+} uring = {
+    .once = PTHREAD_ONCE_INIT,
+};
+
+static _Thread_local struct vtpc_ring* local;
+
+static int vtpc_uring_setup(unsigned entries, struct io_uring_params* params) {
+  return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int vtpc_uring_enter(int fd, unsigned submit, unsigned wait) {
+  return (int)syscall(
+      __NR_io_uring_enter, fd, submit, wait, IORING_ENTER_GETEVENTS, NULL, 0
+  );
+}
+
+static int vtpc_uring_register(int fd, void* buffers, unsigned count) {
+  return (int)syscall(
+      __NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, buffers, count
+  );
+}
+
+static void vtpc_ring_destroy(struct vtpc_ring* ring) {
+  if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+    munmap(ring->sqes, ring->sqes_size);
+  }
+  if (ring->cq_ring != NULL && ring->cq_ring != MAP_FAILED &&
+      ring->cq_ring != ring->sq_ring) {
+    munmap(ring->cq_ring, ring->cq_size);
+  }
+  if (ring->sq_ring != NULL && ring->sq_ring != MAP_FAILED) {
+    munmap(ring->sq_ring, ring->sq_size);
+  }
+  if (ring->fd >= 0) {
+    close(ring->fd);
+  }
+  free(ring);
+}
+
+static void* vtpc_ring_map(int fd, size_t size, off_t offset) {
+  return mmap(
+      NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset
+  );
+}
+
+static struct vtpc_ring* vtpc_ring_create(void) {
+  struct vtpc_ring* ring = calloc(1, sizeof(struct vtpc_ring));
+  if (ring == NULL) {
+    return NULL;
+  }
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring->fd = vtpc_uring_setup(VTPC_URING_ENTRIES, &params);
+  if (ring->fd < 0) {
+    vtpc_ring_destroy(ring);
+    return NULL;
+  }
+
+  ring->sq_size = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+  ring->cq_size =
+      params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+  const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single) {
+    ring->sq_size = ring->cq_size =
+        (ring->sq_size > ring->cq_size) ? ring->sq_size : ring->cq_size;
+  }
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  ring->sq_ring = vtpc_ring_map(ring->fd, ring->sq_size, IORING_OFF_SQ_RING);
+  ring->cq_ring =
+      single ? ring->sq_ring
+             : vtpc_ring_map(ring->fd, ring->cq_size, IORING_OFF_CQ_RING);
+  ring->sqes = vtpc_ring_map(ring->fd, ring->sqes_size, IORING_OFF_SQES);
+  if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED ||
+      ring->sqes == MAP_FAILED) {
+    vtpc_ring_destroy(ring);
+    return NULL;
+  }
+
+  char* sq = ring->sq_ring;
+  char* cq = ring->cq_ring;
+  ring->entries = params.sq_entries;
+  ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+  ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+  ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+  ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+  ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+  /* Without the fixed buffer, e.g. over RLIMIT_MEMLOCK, plain readv works. */
+  if (uring.memory != NULL) {
+    struct iovec buffer = {.iov_base = uring.memory, .iov_len = uring.size};
+    ring->fixed = (vtpc_uring_register(ring->fd, &buffer, 1) == 0);
+  }
+  return ring;
+}
+
+static void vtpc_ring_release(void* ring) {
+  vtpc_ring_destroy(ring);
+}
+
+static void vtpc_uring_once(void) {
+  if (pthread_key_create(&uring.key, vtpc_ring_release) != 0) {
+    atomic_store(&uring.broken, true);
+  }
+}
+
+static struct vtpc_ring* vtpc_uring_ring(void) {
+  if (local != NULL) {
+    return local;
+  }
+
+  pthread_once(&uring.once, vtpc_uring_once);
+  if (atomic_load(&uring.broken)) {
+    return NULL;
+  }
+
+  local = vtpc_ring_create();
+  if (local == NULL) {
+    atomic_store(&uring.broken, true);
+    return NULL;
+  }
+  pthread_setspecific(uring.key, local);
+  return local;
+}
+
+/* Forgets a ring that failed, once nothing is in flight on it any more. */
+static void vtpc_uring_drop(void) {
+  pthread_setspecific(uring.key, NULL);
+  vtpc_ring_destroy(local);
+  local = NULL;
+}
+
+void vtpc_uring_init(void* memory, size_t size) {
+  uring.memory = memory;
+  uring.size = size;
+}
+
+bool vtpc_uring_available(void) {
+  return !atomic_load(&uring.broken);
+}
+
+/*
+ * Prepares one request for a whole run: a fixed read or write if its pages
+ * lie one after the other in the registered memory, readv or writev if not.
+ */
+static void vtpc_uring_prepare(
+    struct vtpc_ring* ring, unsigned slot, const struct vtpc_io* io
+) {
+  const unsigned tail = *ring->sq_tail + slot;
+  const unsigned index = tail & *ring->sq_mask;
+  struct io_uring_sqe* sqe = &ring->sqes[index];
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->fd = io->fd;
+  sqe->off = (uint64_t)io->offset;
+  sqe->user_data = slot;
+
+  const char* base = io->iov[0].iov_base;
+  size_t length = 0;
+  bool contiguous = true;
+  for (size_t i = 0; i < io->count; ++i) {
+    contiguous = contiguous && io->iov[i].iov_base == base + length;
+    length += io->iov[i].iov_len;
+  }
+  if (ring->fixed && contiguous && base >= uring.memory &&
+      base + length <= uring.memory + uring.size) {
+    sqe->opcode = io->write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+    sqe->addr = (uint64_t)(uintptr_t)base;
+    sqe->len = (uint32_t)length;
+    sqe->buf_index = 0;
+  } else {
+    sqe->opcode = io->write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->addr = (uint64_t)(uintptr_t)io->iov;
+    sqe->len = (uint32_t)io->count;
+  }
+  ring->sq_array[index] = index;
+}
+
+/* Collects the results of the completed entries by slot. */
+static unsigned vtpc_uring_reap(struct vtpc_ring* ring, int* results) {
+  unsigned reaped = 0;
+  unsigned head = *ring->cq_head;
+  while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+    const struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+    results[cqe->user_data] = cqe->res;
+    head += 1;
+    reaped += 1;
+  }
+  __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+  return reaped;
+}
+
+/*
+ * Submits the prepared entries and waits for them. If the ring fails, the
+ * entries already submitted are still waited for before it is given up, as
+ * they read into and write from the cache frames.
+ */
+static int vtpc_uring_run(
+    struct vtpc_ring* ring, unsigned queued, int* results
+) {
+  __atomic_store_n(ring->sq_tail, *ring->sq_tail + queued, __ATOMIC_RELEASE);
+
+  unsigned submitted = 0;
+  unsigned reaped = 0;
+  while (reaped < queued) {
+    const int n =
+        vtpc_uring_enter(ring->fd, queued - submitted, queued - reaped);
+    if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      const int error = errno;
+      while (reaped < submitted) {
+        /* Returning to user space runs the work that posts completions. */
+        if (vtpc_uring_enter(ring->fd, 0, submitted - reaped) < 0) {
+          sched_yield();
+        }
+        reaped += vtpc_uring_reap(ring, results);
+      }
+      errno = error;
+      return -1;
+    }
+    if (n > 0) {
+      submitted += (unsigned)n;
+    }
+    reaped += vtpc_uring_reap(ring, results);
+  }
+  return 0;
+}
+
+/* Stores the result of a run, doing the rest of it if it was cut short. */
+static void vtpc_uring_account(struct vtpc_io* io, int result) {
+  size_t length = 0;
+  for (size_t i = 0; i < io->count; ++i) {
+    length += io->iov[i].iov_len;
+  }
+
+  if (result == -EINTR || result == -EAGAIN ||
+      (result >= 0 && (size_t)result < length)) {
+    io->result = vtpc_io_sync(io, (result < 0) ? 0 : (size_t)result);
+    io->error = (io->result < 0) ? errno : 0;
+  } else if (result < 0) {
+    io->result = -1;
+    io->error = -result;
+  } else {
+    io->result = result;
+    io->error = 0;
+  }
+}
+
+int vtpc_uring_submit(struct vtpc_io* batch, size_t count) {
+  struct vtpc_ring* ring = vtpc_uring_ring();
+  if (ring == NULL) {
+    return -1;
+  }
+
+  int results[VTPC_URING_ENTRIES];
+  const unsigned limit =
+      (ring->entries < VTPC_URING_ENTRIES) ? ring->entries : VTPC_URING_ENTRIES;
+
+  size_t io = 0;
+  while (io < count) {
+    unsigned queued = 0;
+    while (io + queued < count && queued < limit) {
+      vtpc_uring_prepare(ring, queued, &batch[io + queued]);
+      queued += 1;
+    }
+
+    if (vtpc_uring_run(ring, queued, results) == -1) {
+      const int error = errno;
+      vtpc_uring_drop();
+      for (size_t i = io; i < count; ++i) {
+        batch[i].result = -1;
+        batch[i].error = error;
+      }
+      return 0;
+    }
+    for (unsigned i = 0; i < queued; ++i) {
+      vtpc_uring_account(&batch[io + i], results[i]);
+    }
+    io += queued;
+  }
+  return 0;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "io.h"
+
+/*
+ * io_uring backend. Every thread gets its own ring on first use, with the
+ * memory of the cache frames registered as a fixed buffer, and submits a
+ * whole batch with one request per run and one io_uring_enter per
+ * ring-full of runs.
+ */
+
+void vtpc_uring_init(void* memory, size_t size);
+
+/*
+ * Performs the batch. Returns -1 if io_uring cannot be used, in which case
+ * nothing has been done.
+ */
+int vtpc_uring_submit(struct vtpc_io* batch, size_t count);
+
+bool vtpc_uring_available(void);
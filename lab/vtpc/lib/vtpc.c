@@ -1,30 +1,1490 @@
 #include "vtpc.h"
 
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "arena.h"
+#include "cache.h"
+#include "checksum.h"
+#include "crc32c.h"
+#include "file.h"
+#include "flusher.h"
+#include "io.h"
+#include "journal.h"
+#include "policy.h"
+#include "readahead.h"
+#include "stats.h"
+
+#define VTPC_HANDLE_CLOSING (SIZE_MAX / 2 + 1)
+
+static struct vtpc_cache cache;
+static size_t cache_capacity;
+static size_t cache_shards;
+static const struct vtpc_policy_ops* cache_policy;
+static unsigned cache_dirty_ratio;
+static bool cache_dirty_ratio_set;
+static bool cache_admission;
+static bool cache_admission_set;
+static enum vtpc_journal_mode cache_journal;
+static bool cache_journal_set;
+static bool cache_checksums;
+static bool cache_checksums_set;
+
+/*
+ * The descriptor table, the list of open files and the configuration are
+ * protected by files_lock. An operation on a handle holds it shared only to
+ * look the handle up and count itself among its users; close takes the
+ * handle out of the table and waits on released until its users are done.
+ * Handles take the lowest free descriptor, which free_handle points below.
+ */
+static pthread_rwlock_t files_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t release_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t released = PTHREAD_COND_INITIALIZER;
+static struct vtpc_handle** handles;
+static size_t handles_count;
+static size_t free_handle;
+static struct vtpc_file* files;
+
+static size_t vtpc_min(size_t lhs, size_t rhs) {
+  return lhs < rhs ? lhs : rhs;
+}
+
+static double vtpc_percent(uint64_t part, uint64_t whole) {
+  return (whole == 0) ? 0.0 : 100.0 * (double)part / (double)whole;
+}
+
+static double vtpc_micros(const struct vtpc_latency* latency, double rank) {
+  return (double)vtpc_stats_percentile(latency, rank) / 1000.0;
+}
+
+static void vtpc_stats_dump_file(struct vtpc_file* file) {
+  struct vtpc_stats stats;
+  vtpc_cache_file_stats(&cache, file, &stats);
+  fprintf(
+      stderr,
+      "[vtpc] file %llu:%llu: hits %llu, misses %llu, hit ratio %.2f%%, "
+      "evictions %llu, dirty %llu, bytes written %llu, "
+      "miss latency p99 %.1f us\n",
+      (unsigned long long)file->dev,
+      (unsigned long long)file->ino,
+      (unsigned long long)stats.hits,
+      (unsigned long long)stats.misses,
+      vtpc_percent(stats.hits, stats.hits + stats.misses),
+      (unsigned long long)stats.evictions,
+      (unsigned long long)stats.dirty,
+      (unsigned long long)stats.written_bytes,
+      vtpc_micros(&stats.miss_latency, 99)
+  );
+}
+
+/*
+ * Prints the counters of the cache, followed by those of each open file.
+ * Latencies are given as the upper bounds of their histogram buckets.
+ */
+static void vtpc_stats_dump(void) {
+  struct vtpc_stats snapshot;
+  vtpc_cache_stats(&cache, &snapshot);
+  const struct vtpc_stats* stats = &snapshot;
+  const uint64_t total = stats->hits + stats->misses;
+  fprintf(
+      stderr,
+      "[vtpc] policy %s%s, io %s: hits %llu, misses %llu, evictions %llu, "
+      "hit ratio %.2f%%, prefetched %llu, prefetch hits %llu, "
+      "wasted prefetches %llu, writes %llu, pages written %llu\n",
+      cache_policy->name,
+      cache_admission ? "+tinylfu" : "",
+      vtpc_io_backend(),
+      (unsigned long long)stats->hits,
+      (unsigned long long)stats->misses,
+      (unsigned long long)stats->evictions,
+      (total == 0) ? 0.0 : 100.0 * (double)stats->hits / (double)total,
+      (unsigned long long)stats->prefetched,
+      (unsigned long long)stats->prefetch_hits,
+      (unsigned long long)stats->prefetch_wasted,
+      (unsigned long long)stats->writes,
+      (unsigned long long)stats->written
+  );
+  fprintf(
+      stderr,
+      "[vtpc] dirty %llu, bytes written %llu, readahead efficiency %.2f%%, "
+      "miss latency p50 %.1f us, p99 %.1f us, "
+      "flush latency p50 %.1f us, p99 %.1f us, "
+      "checksums %s, checksum errors %llu\n",
+      (unsigned long long)stats->dirty,
+      (unsigned long long)stats->written_bytes,
+      vtpc_percent(stats->prefetch_hits, stats->prefetched),
+      vtpc_micros(&stats->miss_latency, 50),
+      vtpc_micros(&stats->miss_latency, 99),
+      vtpc_micros(&stats->flush_latency, 50),
+      vtpc_micros(&stats->flush_latency, 99),
+      cache_checksums ? vtpc_crc32c_backend() : "off",
+      (unsigned long long)stats->checksum_errors
+  );
+
+  pthread_rwlock_rdlock(&files_lock);
+  for (struct vtpc_file* file = files; file != NULL; file = file->next) {
+    vtpc_stats_dump_file(file);
+  }
+  pthread_rwlock_unlock(&files_lock);
+}
+
+static void* vtpc_stats_main(void* arg) {
+  const struct timespec* interval = arg;
+  for (;;) {
+    nanosleep(interval, NULL);
+    vtpc_stats_dump();
+  }
+  return NULL;
+}
+
+/*
+ * Starts a thread that dumps the counters every given number of
+ * milliseconds. The dump is only a diagnostic, so if the thread cannot be
+ * started the cache goes on without it.
+ */
+static void vtpc_stats_start(unsigned long long milliseconds) {
+  static struct timespec interval;
+  if (milliseconds == 0) {
+    return;
+  }
+  interval.tv_sec = (time_t)(milliseconds / 1000);
+  interval.tv_nsec = (long)(milliseconds % 1000) * 1000000;
+
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, vtpc_stats_main, &interval) == 0) {
+    pthread_detach(thread);
+  }
+}
+
+static int vtpc_init(void) {
+  if (cache.frames != NULL) {
+    return 0;
+  }
+
+  size_t capacity = cache_capacity;
+  if (capacity == 0) {
+    const char* env = getenv("VTPC_CAPACITY");  // NOLINT(concurrency-mt-unsafe)
+    capacity = (env != NULL) ? strtoull(env, NULL, 0) : VTPC_DEFAULT_CAPACITY;
+  }
+
+  const struct vtpc_policy_ops* policy = cache_policy;
+  if (policy == NULL) {
+    const char* env = getenv("VTPC_POLICY");  // NOLINT(concurrency-mt-unsafe)
+    policy = (env != NULL) ? vtpc_policy_find(env) : &vtpc_policy_lru;
+    if (policy == NULL) {
+      errno = EINVAL;
+      return -1;
+    }
+  }
+
+  size_t shards = cache_shards;
+  if (shards == 0) {
+    const char* env = getenv("VTPC_SHARDS");  // NOLINT(concurrency-mt-unsafe)
+    shards = (env != NULL) ? strtoull(env, NULL, 0) : VTPC_DEFAULT_SHARDS;
+  }
+
+  const char* env = getenv("VTPC_READAHEAD");  // NOLINT(concurrency-mt-unsafe)
+  const size_t window =
+      (env != NULL) ? strtoull(env, NULL, 0) : VTPC_READAHEAD_DEFAULT;
+
+  unsigned ratio = cache_dirty_ratio;
+  if (!cache_dirty_ratio_set) {
+    env = getenv("VTPC_DIRTY_RATIO");  // NOLINT(concurrency-mt-unsafe)
+    ratio = (env != NULL) ? (unsigned)strtoul(env, NULL, 0) : 0;
+    if (ratio > 100) {
+      errno = EINVAL;
+      return -1;
+    }
+  }
+
+  bool admission = cache_admission;
+  if (!cache_admission_set) {
+    env = getenv("VTPC_ADMISSION");  // NOLINT(concurrency-mt-unsafe)
+    admission = (env != NULL && strcmp(env, "tinylfu") == 0);
+    if (env != NULL && !admission && strcmp(env, "none") != 0) {
+      errno = EINVAL;
+      return -1;
+    }
+  }
+
+  enum vtpc_journal_mode journal = cache_journal;
+  if (!cache_journal_set) {
+    env = getenv("VTPC_JOURNAL");  // NOLINT(concurrency-mt-unsafe)
+    const int found = (env != NULL) ? vtpc_journal_find(env) : 0;
+    if (found == -1) {
+      errno = EINVAL;
+      return -1;
+    }
+    journal = (enum vtpc_journal_mode)found;
+  }
+
+  bool checksums = cache_checksums;
+  if (!cache_checksums_set) {
+    env = getenv("VTPC_CHECKSUMS");  // NOLINT(concurrency-mt-unsafe)
+    checksums = (env != NULL && strcmp(env, "crc32c") == 0);
+    if (env != NULL && !checksums && strcmp(env, "none") != 0) {
+      errno = EINVAL;
+      return -1;
+    }
+  }
+
+  /* "thp" asks for transparent huge pages, anything else for hugetlbfs. */
+  enum vtpc_huge huge = VTPC_HUGE_NONE;
+  env = getenv("VTPC_HUGEPAGES");  // NOLINT(concurrency-mt-unsafe)
+  if (env != NULL) {
+    huge = (strcmp(env, "thp") == 0) ? VTPC_HUGE_THP : VTPC_HUGE_TLB;
+  }
+
+  if (vtpc_cache_init(&cache, capacity, shards, policy, admission, huge) ==
+      -1) {
+    return -1;
+  }
+  if (vtpc_flusher_init(&cache, ratio) == -1 ||
+      vtpc_readahead_init(&cache, window) == -1) {
+    const int error = errno;
+    vtpc_cache_destroy(&cache);
+    errno = error;
+    return -1;
+  }
+  cache_policy = policy;
+  cache_admission = admission;
+  cache_journal = journal;
+  cache_checksums = checksums;
+  if (getenv("VTPC_STATS") != NULL) {  // NOLINT(concurrency-mt-unsafe)
+    atexit(vtpc_stats_dump);
+  }
+  env = getenv("VTPC_STATS_INTERVAL");  // NOLINT(concurrency-mt-unsafe)
+  if (env != NULL) {
+    vtpc_stats_start(strtoull(env, NULL, 0));
+  }
+  return 0;
+}
+
+static struct vtpc_handle* vtpc_handle_get(int fd) {
+  if (fd < 0 || (size_t)fd >= handles_count || handles[fd] == NULL) {
+    errno = EBADF;
+    return NULL;
+  }
+  return handles[fd];
+}
+
+/*
+ * Looks up the handle and counts the caller among its users. The handle is
+ * not freed until it is released.
+ */
+static struct vtpc_handle* vtpc_handle_acquire(int fd) {
+  pthread_rwlock_rdlock(&files_lock);
+  struct vtpc_handle* handle = vtpc_handle_get(fd);
+  if (handle != NULL) {
+    atomic_fetch_add(&handle->users, 1);
+  }
+  pthread_rwlock_unlock(&files_lock);
+  return handle;
+}
+
+/* The last user of a closing handle may not touch it once it is counted out. */
+static void vtpc_handle_release(struct vtpc_handle* handle) {
+  if (atomic_fetch_sub(&handle->users, 1) == VTPC_HANDLE_CLOSING + 1) {
+    pthread_mutex_lock(&release_lock);
+    pthread_cond_broadcast(&released);
+    pthread_mutex_unlock(&release_lock);
+  }
+}
+
+/* Waits until a handle taken out of the table has no users and frees it. */
+static void vtpc_handle_free(struct vtpc_handle* handle) {
+  pthread_mutex_lock(&release_lock);
+  while (atomic_load(&handle->users) != VTPC_HANDLE_CLOSING) {
+    pthread_cond_wait(&released, &release_lock);
+  }
+  pthread_mutex_unlock(&release_lock);
+  pthread_mutex_destroy(&handle->stream_lock);
+  pthread_mutex_destroy(&handle->lock);
+  free(handle);
+}
+
+/* Puts the handle into the lowest free descriptor and returns it. */
+static int vtpc_handle_put(struct vtpc_handle* handle) {
+  size_t fd = free_handle;
+  while (fd < handles_count && handles[fd] != NULL) {
+    fd += 1;
+  }
+  if (fd >= INT_MAX) {
+    errno = EMFILE;
+    return -1;
+  }
+
+  if (fd == handles_count) {
+    const size_t count = (handles_count == 0) ? 64 : 2 * handles_count;
+    struct vtpc_handle** grown = realloc(handles, count * sizeof(*handles));
+    if (grown == NULL) {
+      errno = ENOMEM;
+      return -1;
+    }
+    memset(
+        grown + handles_count, 0, (count - handles_count) * sizeof(*handles)
+    );
+    handles = grown;
+    handles_count = count;
+  }
+
+  handles[fd] = handle;
+  free_handle = fd + 1;
+  return (int)fd;
+}
+
+static struct vtpc_file* vtpc_file_find(dev_t dev, ino_t ino) {
+  for (struct vtpc_file* file = files; file != NULL; file = file->next) {
+    if (file->dev == dev && file->ino == ino) {
+      return file;
+    }
+  }
+  return NULL;
+}
+
+static struct vtpc_file* vtpc_file_create(
+    int fd, bool writable, const struct stat* st
+) {
+  struct vtpc_file* file = calloc(1, sizeof(struct vtpc_file));
+  if (file == NULL) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  file->stats = vtpc_stats_create();
+  if (file->stats == NULL) {
+    free(file);
+    errno = ENOMEM;
+    return NULL;
+  }
+  if (vtpc_cache_attach(&cache, file) == -1) {
+    vtpc_stats_destroy(file->stats);
+    free(file);
+    return NULL;
+  }
+
+  pthread_rwlock_init(&file->lock, NULL);
+  pthread_rwlock_init(&file->io, NULL);
+  pthread_mutex_init(&file->maps.lock, NULL);
+  file->fd = fd;
+  file->writable = writable;
+  file->dev = st->st_dev;
+  file->ino = st->st_ino;
+  atomic_init(&file->size, st->st_size);
+  atomic_init(&file->disk_size, st->st_size);
+  atomic_init(&file->pages, 0);
+  atomic_init(&file->checksums, NULL);
+  file->next = files;
+  files = file;
+  return file;
+}
+
+/*
+ * Frees a file that is out of the list, without closing its descriptor. A
+ * journal still open is kept for the next open to replay, and checksums
+ * still open are left untrusted.
+ */
+static void vtpc_file_destroy(struct vtpc_file* file) {
+  if (file->journal != NULL) {
+    (void)vtpc_journal_close(file->journal, false);
+  }
+  if (file->checksums != NULL) {
+    (void)vtpc_checksums_close(file->checksums, NULL);
+  }
+  if (file->retired != NULL) {
+    (void)vtpc_checksums_close(file->retired, NULL);
+  }
+  vtpc_cache_drop(&cache, file);
+  vtpc_cache_detach(&cache, file);
+  free(file->maps.borrows);
+  pthread_mutex_destroy(&file->maps.lock);
+  pthread_rwlock_destroy(&file->io);
+  pthread_rwlock_destroy(&file->lock);
+  vtpc_stats_destroy(file->stats);
+  free(file);
+}
+
+static void vtpc_file_unlink(struct vtpc_file* file) {
+  struct vtpc_file** link = &files;
+  while (*link != file) {
+    link = &(*link)->next;
+  }
+  *link = file->next;
+}
+
+/* Tells whether pages of the file are borrowed by vtpc_map. */
+static bool vtpc_file_mapped(struct vtpc_file* file) {
+  pthread_mutex_lock(&file->maps.lock);
+  const bool mapped = (file->maps.count != 0);
+  pthread_mutex_unlock(&file->maps.lock);
+  return mapped;
+}
+
+/*
+ * Empties the file for an open with O_TRUNC, forgetting its cached pages
+ * once the readers in flight are done with them.
+ */
+static int vtpc_file_truncate(struct vtpc_file* file) {
+  pthread_rwlock_wrlock(&file->lock);
+  if (vtpc_file_mapped(file)) {
+    pthread_rwlock_unlock(&file->lock);
+    errno = EBUSY;
+    return -1;
+  }
+
+  vtpc_readahead_cancel(file);
+  vtpc_cache_drop(&cache, file);
+  pthread_rwlock_wrlock(&file->io);
+  /* The journal goes first, or its writes would come back after a crash. */
+  const int status =
+      ((file->journal != NULL && vtpc_journal_reset(file->journal) == -1) ||
+       (file->checksums != NULL &&
+        vtpc_checksums_reset(file->checksums) == -1))
+          ? -1
+          : ftruncate(file->fd, 0);
+  if (status == 0) {
+    atomic_store(&file->size, 0);
+    atomic_store(&file->disk_size, 0);
+  }
+  pthread_rwlock_unlock(&file->io);
+  /* Readers may have cached pages of the old contents meanwhile. */
+  vtpc_cache_drop(&cache, file);
+  pthread_rwlock_unlock(&file->lock);
+  return status;
+}
+
+static int vtpc_set_capacity_locked(size_t pages) {
+  if (cache.frames != NULL) {
+    errno = EBUSY;
+    return -1;
+  }
+  if (pages == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  cache_capacity = pages;
+  return 0;
+}
+
+static int vtpc_set_shards_locked(size_t shards) {
+  if (cache.frames != NULL) {
+    errno = EBUSY;
+    return -1;
+  }
+  if (shards == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  cache_shards = shards;
+  return 0;
+}
+
+static int vtpc_set_policy_locked(const char* name) {
+  if (cache.frames != NULL) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  const struct vtpc_policy_ops* policy = vtpc_policy_find(name);
+  if (policy == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  cache_policy = policy;
+  return 0;
+}
+
+static int vtpc_set_admission_locked(const char* name) {
+  if (cache.frames != NULL) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  const bool admission = (strcmp(name, "tinylfu") == 0);
+  if (!admission && strcmp(name, "none") != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  cache_admission = admission;
+  cache_admission_set = true;
+  return 0;
+}
+
+static int vtpc_set_journal_locked(const char* mode) {
+  if (cache.frames != NULL) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  const int journal = vtpc_journal_find(mode);
+  if (journal == -1) {
+    errno = EINVAL;
+    return -1;
+  }
+  cache_journal = (enum vtpc_journal_mode)journal;
+  cache_journal_set = true;
+  return 0;
+}
+
+static int vtpc_set_checksums_locked(const char* mode) {
+  if (cache.frames != NULL) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  const bool checksums = (strcmp(mode, "crc32c") == 0);
+  if (!checksums && strcmp(mode, "none") != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  cache_checksums = checksums;
+  cache_checksums_set = true;
+  return 0;
+}
+
+static int vtpc_set_dirty_ratio_locked(unsigned percent) {
+  if (cache.frames != NULL) {
+    errno = EBUSY;
+    return -1;
+  }
+  if (percent > 100) {
+    errno = EINVAL;
+    return -1;
+  }
+  cache_dirty_ratio = percent;
+  cache_dirty_ratio_set = true;
+  return 0;
+}
+
+/* Starts the journal of a file opened for writing, if writes are journaled. */
+static int vtpc_file_journal(struct vtpc_file* file, const char* path) {
+  if (cache_journal == VTPC_JOURNAL_NONE || file->journal != NULL) {
+    return 0;
+  }
+  file->journal = vtpc_journal_open(path, cache_journal);
+  return (file->journal != NULL) ? 0 : -1;
+}
+
+/*
+ * Opens the checksums of a file if pages are checksummed, in place of those
+ * opened before for reading, which are retired until the file is freed as
+ * readers may still be checking pages against them. A read-only file goes
+ * unchecked without them.
+ */
+static int vtpc_file_checksums(
+    struct vtpc_file* file,
+    bool writable,
+    const char* path,
+    const struct stat* st
+) {
+  if (!cache_checksums) {
+    return 0;
+  }
+  struct vtpc_checksums* checksums = vtpc_checksums_open(path, writable, st);
+  if (checksums == NULL) {
+    return writable ? -1 : 0;
+  }
+  file->retired = atomic_exchange(&file->checksums, checksums);
+  return 0;
+}
+
+/*
+ * Finds the file among the open ones or takes the descriptor for a new one,
+ * replaying the journal a crashed process may have left for it. A read-only
+ * file opened for writing gets the new descriptor in place of its own, so the
+ * pages of the file can be written back. Its checksums are swapped last, so
+ * they are retired at most once.
+ */
+static struct vtpc_file* vtpc_file_open(
+    int fd, bool writable, const char* path
+) {
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    return NULL;
+  }
+
+  struct vtpc_file* file = vtpc_file_find(st.st_dev, st.st_ino);
+  if (file == NULL) {
+    if (vtpc_journal_replay(path) == -1 || fstat(fd, &st) == -1) {
+      return NULL;
+    }
+    file = vtpc_file_create(fd, writable, &st);
+    if (file != NULL &&
+        ((writable && vtpc_file_journal(file, path) == -1) ||
+         vtpc_file_checksums(file, writable, path, &st) == -1)) {
+      const int error = errno;
+      vtpc_file_unlink(file);
+      vtpc_file_destroy(file);
+      errno = error;
+      return NULL;
+    }
+    return file;
+  }
+  if (writable && !file->writable) {
+    if (vtpc_file_journal(file, path) == -1 || dup2(fd, file->fd) == -1 ||
+        vtpc_file_checksums(file, true, path, &st) == -1) {
+      return NULL;
+    }
+    file->writable = true;
+  }
+  close(fd);
+  return file;
+}
+
+static int vtpc_open_locked(const char* path, int mode, int access) {
+  if (vtpc_init() == -1) {
+    return -1;
+  }
+
+  const bool writable = (mode & O_ACCMODE) != O_RDONLY;
+  int flags = mode & ~(O_ACCMODE | O_APPEND | O_TRUNC);
+  flags |= writable ? O_RDWR : O_RDONLY;
+
+  const int fd = open(path, flags | O_DIRECT, access);
+  const int os = (fd == -1 && errno == EINVAL) ? open(path, flags, access) : fd;
+  if (os == -1) {
+    return -1;
+  }
+
+  struct vtpc_file* file = vtpc_file_open(os, writable, path);
+  if (file == NULL) {
+    const int error = errno;
+    close(os);
+    errno = error;
+    return -1;
+  }
+
+  struct vtpc_handle* handle = calloc(1, sizeof(struct vtpc_handle));
+  if (handle == NULL) {
+    errno = ENOMEM;
+  }
+  const int result =
+      (handle == NULL ||
+       ((mode & O_TRUNC) && writable && vtpc_file_truncate(file) == -1))
+          ? -1
+          : vtpc_handle_put(handle);
+  if (result == -1) {
+    const int error = errno;
+    free(handle);
+    if (file->refs == 0) {
+      vtpc_file_unlink(file);
+      close(file->fd);
+      vtpc_file_destroy(file);
+    }
+    errno = error;
+    return -1;
+  }
+
+  *handle = (struct vtpc_handle){
+      .file = file,
+      .flags = mode,
+      .stream = {.prev = UINT64_MAX, .marker = UINT64_MAX},
+  };
+  pthread_mutex_init(&handle->lock, NULL);
+  pthread_mutex_init(&handle->stream_lock, NULL);
+  file->refs += 1;
+  return result;
+}
+
+/*
+ * Takes the handle out of the table and marks it closing, unless pages are
+ * borrowed through it. Maps check the mark under the same lock, so none of
+ * them can borrow pages through the handle afterwards.
+ */
+static struct vtpc_handle* vtpc_close_locked(int fd) {
+  struct vtpc_handle* handle = vtpc_handle_get(fd);
+  if (handle == NULL) {
+    return NULL;
+  }
+
+  struct vtpc_maps* maps = &handle->file->maps;
+  pthread_mutex_lock(&maps->lock);
+  const bool mapped = (handle->maps != 0);
+  if (!mapped) {
+    atomic_fetch_add(&handle->users, VTPC_HANDLE_CLOSING);
+  }
+  pthread_mutex_unlock(&maps->lock);
+  if (mapped) {
+    errno = EBUSY;
+    return NULL;
+  }
+
+  handles[fd] = NULL;
+  if ((size_t)fd < free_handle) {
+    free_handle = fd;
+  }
+  return handle;
+}
+
+/*
+ * Drops a handle reference of the file. Returns true if it was the last one,
+ * which is then kept for the caller to close the file with.
+ */
+static bool vtpc_file_release(struct vtpc_file* file) {
+  pthread_rwlock_wrlock(&files_lock);
+  const bool last = (file->refs == 1);
+  if (!last) {
+    file->refs -= 1;
+  }
+  pthread_rwlock_unlock(&files_lock);
+  return last;
+}
+
+/*
+ * Writes back a file whose last handle has been closed and frees it, unless
+ * it has been opened again in the meantime.
+ */
+static int vtpc_file_close(struct vtpc_file* file) {
+  vtpc_readahead_cancel(file);
+  int status = vtpc_cache_flush(&cache, file);
+  int error = errno;
+
+  pthread_rwlock_wrlock(&files_lock);
+  file->refs -= 1;
+  const bool gone = (file->refs == 0);
+  if (gone) {
+    vtpc_file_unlink(file);
+  }
+  pthread_rwlock_unlock(&files_lock);
+  if (!gone) {
+    errno = error;
+    return status;
+  }
+
+  /*
+   * The journal is only dropped, and the checksums only trusted, once the
+   * file holds all of its writes.
+   */
+  bool synced = false;
+  if (file->journal != NULL || (file->writable && file->checksums != NULL)) {
+    synced = (status == 0 && fsync(file->fd) == 0);
+    if (!synced && status == 0) {
+      status = -1;
+      error = errno;
+    }
+  }
+  if (file->journal != NULL) {
+    if (vtpc_journal_close(file->journal, synced) == -1 && status == 0) {
+      status = -1;
+      error = errno;
+    }
+    file->journal = NULL;
+  }
+  if (file->checksums != NULL) {
+    struct stat st;
+    const bool clean = synced && fstat(file->fd, &st) == 0;
+    if (vtpc_checksums_close(file->checksums, clean ? &st : NULL) == -1 &&
+        status == 0) {
+      status = -1;
+      error = errno;
+    }
+    file->checksums = NULL;
+  }
+
+  const int fd = file->fd;
+  vtpc_file_destroy(file);
+  if (close(fd) == -1 && status == 0) {
+    status = -1;
+    error = errno;
+  }
+  errno = error;
+  return status;
+}
+
+/* A position in a vector of buffers that data is copied from or into. */
+struct vtpc_cursor {
+  const struct iovec* iov;
+  size_t skip;
+};
+
+static void vtpc_cursor_copy(
+    struct vtpc_cursor* cursor, char* data, size_t count, bool out
+) {
+  while (count > 0) {
+    const struct iovec* iov = cursor->iov;
+    const size_t chunk = vtpc_min(iov->iov_len - cursor->skip, count);
+    char* base = (char*)iov->iov_base + cursor->skip;
+    if (out) {
+      memcpy(base, data, chunk);
+    } else {
+      memcpy(data, base, chunk);
+    }
+    data += chunk;
+    count -= chunk;
+    cursor->skip += chunk;
+    if (cursor->skip == iov->iov_len) {
+      cursor->iov += 1;
+      cursor->skip = 0;
+    }
+  }
+}
+
+/* Sums the lengths of the vectors, which readv caps like a single count. */
+static ssize_t vtpc_iov_size(const struct iovec* iov, int iovcnt) {
+  if (iovcnt < 0 || iovcnt > IOV_MAX) {
+    errno = EINVAL;
+    return -1;
+  }
+  size_t total = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    if (iov[i].iov_len > SSIZE_MAX - total) {
+      errno = EINVAL;
+      return -1;
+    }
+    total += iov[i].iov_len;
+  }
+  return (ssize_t)total;
+}
+
+/*
+ * Reads from the offset into the vectors and moves the offset past the
+ * bytes read, up to the size of the file when the read starts. Every pass
+ * pins the pages of a stretch of the range at once, so its misses are read
+ * with one batch.
+ */
+static ssize_t vtpc_readv_locked(
+    struct vtpc_handle* handle,
+    const struct iovec* iov,
+    int iovcnt,
+    off_t* offset
+) {
+  struct vtpc_file* file = handle->file;
+  if (!vtpc_handle_readable(handle)) {
+    errno = EBADF;
+    return -1;
+  }
+  const ssize_t count = vtpc_iov_size(iov, iovcnt);
+  if (count == -1) {
+    return -1;
+  }
+
+  atomic_fetch_add(&cache.clock, 1);
+
+  const off_t size = atomic_load(&file->size);
+  struct vtpc_cursor cursor = {.iov = iov};
+  struct vtpc_frame* frames[VTPC_RUN_MAX];
+  bool hits[VTPC_RUN_MAX];
+  size_t total = 0;
+  while (total < (size_t)count && *offset < size) {
+    const off_t end =
+        *offset +
+        (off_t)vtpc_min((size_t)count - total, (size_t)(size - *offset));
+    const ssize_t pinned = vtpc_cache_pin_range(
+        &cache, file, *offset, (size_t)(end - *offset), false, frames, hits
+    );
+    if (pinned == -1) {
+      return (total == 0) ? -1 : (ssize_t)total;
+    }
+
+    pthread_mutex_lock(&handle->stream_lock);
+    for (ssize_t i = 0; i < pinned; ++i) {
+      vtpc_readahead_access(file, &handle->stream, frames[i]->page, hits[i]);
+    }
+    pthread_mutex_unlock(&handle->stream_lock);
+
+    for (ssize_t i = 0; i < pinned; ++i) {
+      const size_t shift = *offset % VTPC_PAGE_SIZE;
+      const size_t chunk =
+          vtpc_min(VTPC_PAGE_SIZE - shift, (size_t)(end - *offset));
+      vtpc_cursor_copy(&cursor, frames[i]->data + shift, chunk, true);
+      vtpc_cache_unpin(&cache, frames[i], false);
+      *offset += (off_t)chunk;
+      total += chunk;
+    }
+  }
+  return (ssize_t)total;
+}
+
+/*
+ * Writes the dirty pages of the file and syncs it, emptying its journal.
+ * Writes wait meanwhile, so no record is emptied before its pages are in the
+ * cache.
+ */
+static int vtpc_file_sync(struct vtpc_file* file) {
+  pthread_rwlock_wrlock(&file->lock);
+  int status = 0;
+  if (vtpc_cache_flush(&cache, file) == -1 || fsync(file->fd) == -1 ||
+      (file->journal != NULL && vtpc_journal_reset(file->journal) == -1)) {
+    status = -1;
+  }
+  pthread_rwlock_unlock(&file->lock);
+  return status;
+}
+
+/* Grows the logical size of the file to at least size. */
+static void vtpc_file_grow(struct vtpc_file* file, off_t size) {
+  off_t current = atomic_load(&file->size);
+  while (current < size &&
+         !atomic_compare_exchange_weak(&file->size, &current, size)) {
+  }
+}
+
+/*
+ * Logs the write to the journal of the file and copies the bytes from the
+ * vectors into the cache at the offset, or at the end of the file in append
+ * mode, and moves the offset past them. The caller holds the lock of the
+ * file, exclusively in append mode so appends do not overlap. Stores in lsn
+ * the position the caller has to commit once it has let go of the file. The
+ * record goes first: pages of the write may be evicted to the file before
+ * it returns, and a crash must not leave them there without the rest. If
+ * the cache runs out of pages midway, the record still holds the whole
+ * write.
+ */
+static ssize_t vtpc_writev_locked(
+    struct vtpc_handle* handle,
+    const struct iovec* iov,
+    int iovcnt,
+    off_t* offset,
+    uint64_t* lsn
+) {
+  struct vtpc_file* file = handle->file;
+  if (!vtpc_handle_writable(handle)) {
+    errno = EBADF;
+    return -1;
+  }
+  const ssize_t size = vtpc_iov_size(iov, iovcnt);
+  if (size == -1) {
+    return -1;
+  }
+  const size_t count = (size_t)size;
+  if (handle->flags & O_APPEND) {
+    *offset = atomic_load(&file->size);
+  }
+
+  atomic_fetch_add(&cache.clock, 1);
+
+  struct vtpc_journal* journal = file->journal;
+  if (journal != NULL && count != 0) {
+    const off_t end = *offset + (off_t)count;
+    const off_t known = atomic_load(&file->size);
+    const off_t after = (end > known) ? end : known;
+    if (vtpc_journal_append(
+            journal, *offset, iov, iovcnt, count, after, lsn
+        ) == -1) {
+      return -1;
+    }
+  }
+
+  struct vtpc_cursor cursor = {.iov = iov};
+  struct vtpc_frame* frames[VTPC_RUN_MAX];
+  bool hits[VTPC_RUN_MAX];
+  size_t total = 0;
+  while (total < count) {
+    const ssize_t pinned = vtpc_cache_pin_range(
+        &cache, file, *offset, count - total, true, frames, hits
+    );
+    if (pinned == -1) {
+      break;
+    }
+
+    for (ssize_t i = 0; i < pinned; ++i) {
+      const size_t shift = *offset % VTPC_PAGE_SIZE;
+      const size_t chunk = vtpc_min(VTPC_PAGE_SIZE - shift, count - total);
+      vtpc_cursor_copy(&cursor, frames[i]->data + shift, chunk, false);
+      vtpc_cache_unpin(&cache, frames[i], true);
+      *offset += (off_t)chunk;
+      total += chunk;
+    }
+    vtpc_file_grow(file, *offset);
+  }
+  vtpc_flusher_poke(&cache);
+  if (total == 0 && count != 0) {
+    return -1;
+  }
+  return (ssize_t)total;
+}
+
+static off_t vtpc_lseek_locked(
+    struct vtpc_handle* handle, off_t offset, int whence
+) {
+  struct vtpc_file* file = handle->file;
+  off_t base = 0;
+  switch (whence) {
+    case SEEK_SET:
+      base = 0;
+      break;
+    case SEEK_CUR:
+      base = handle->offset;
+      break;
+    case SEEK_END:
+      base = atomic_load(&file->size);
+      break;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+
+  if (offset < -base) {
+    errno = EINVAL;
+    return -1;
+  }
+  handle->offset = base + offset;
+  return handle->offset;
+}
+
+static int vtpc_advice_locked(
+    struct vtpc_handle* handle, off_t offset, size_t count, access_hint_t hint
+) {
+  struct vtpc_file* file = handle->file;
+  if (offset < 0 ||
+      (hint.kind != VTPC_HINT_AT && hint.kind != VTPC_HINT_AFTER)) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (count == 0) {
+    return 0;
+  }
+
+  const uint64_t when =
+      (hint.kind == VTPC_HINT_AT) ? hint.time
+                                  : atomic_load(&cache.clock) + hint.time;
+  const uint64_t first = (uint64_t)offset / VTPC_PAGE_SIZE;
+  const uint64_t last = ((uint64_t)offset + count - 1) / VTPC_PAGE_SIZE;
+  for (uint64_t page = first; page <= last; ++page) {
+    if (vtpc_cache_advise(&cache, file, page, when) == -1) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static void vtpc_return_pages(void* const* pages, size_t count, bool dirty) {
+  for (size_t i = 0; i < count; ++i) {
+    vtpc_cache_return(&cache, vtpc_cache_frame(&cache, pages[i]), dirty);
+  }
+}
+
+/*
+ * Records the pages as borrowed through the handle, unless it is being
+ * closed, and returns -1 with errno if they cannot be.
+ */
+static int vtpc_maps_add(
+    struct vtpc_handle* handle, void* const* pages, size_t count
+) {
+  struct vtpc_maps* maps = &handle->file->maps;
+  int status = 0;
+  pthread_mutex_lock(&maps->lock);
+  if (atomic_load(&handle->users) & VTPC_HANDLE_CLOSING) {
+    errno = EBADF;
+    status = -1;
+  } else if (maps->count + count > maps->capacity) {
+    size_t capacity = (maps->capacity == 0) ? 64 : 2 * maps->capacity;
+    while (capacity < maps->count + count) {
+      capacity *= 2;
+    }
+    struct vtpc_borrow* grown =
+        realloc(maps->borrows, capacity * sizeof(*maps->borrows));
+    if (grown == NULL) {
+      errno = ENOMEM;
+      status = -1;
+    } else {
+      maps->borrows = grown;
+      maps->capacity = capacity;
+    }
+  }
+  if (status == 0) {
+    for (size_t i = 0; i < count; ++i) {
+      maps->borrows[maps->count++] = (struct vtpc_borrow){
+          .page = pages[i],
+          .handle = handle,
+      };
+    }
+    handle->maps += count;
+  }
+  pthread_mutex_unlock(&maps->lock);
+  return status;
+}
+
+/*
+ * Forgets a borrow of the page. A page mapped through several handles is
+ * counted out of the one that mapped it last.
+ */
+static void vtpc_maps_remove(struct vtpc_maps* maps, const void* page) {
+  pthread_mutex_lock(&maps->lock);
+  for (size_t i = maps->count; i > 0; --i) {
+    struct vtpc_borrow* borrow = &maps->borrows[i - 1];
+    if (borrow->page == page) {
+      borrow->handle->maps -= 1;
+      *borrow = maps->borrows[--maps->count];
+      break;
+    }
+  }
+  pthread_mutex_unlock(&maps->lock);
+}
+
+/*
+ * Returns borrowed pages. Their borrows keep the files alive until the
+ * pages are back.
+ */
+static void vtpc_unmap_pages(void* const* pages, size_t count, bool dirty) {
+  for (size_t i = 0; i < count; ++i) {
+    struct vtpc_frame* frame = vtpc_cache_frame(&cache, pages[i]);
+    struct vtpc_file* file = frame->file;
+    vtpc_cache_return(&cache, frame, dirty);
+    vtpc_maps_remove(&file->maps, pages[i]);
+  }
+}
+
+static ssize_t vtpc_map_locked(
+    struct vtpc_handle* handle,
+    off_t offset,
+    size_t count,
+    enum vtpc_map_mode mode,
+    void** pages
+) {
+  struct vtpc_file* file = handle->file;
+  const bool write = (mode == VTPC_MAP_WRITE);
+  if (offset < 0 || (mode != VTPC_MAP_READ && !write)) {
+    errno = EINVAL;
+    return -1;
+  }
+  const bool allowed =
+      write ? vtpc_handle_writable(handle) : vtpc_handle_readable(handle);
+  if (!allowed) {
+    errno = EBADF;
+    return -1;
+  }
+  if (!write) {
+    const off_t size = atomic_load(&file->size);
+    count = (offset < size) ? vtpc_min(count, (size_t)(size - offset)) : 0;
+  }
+  if (count == 0) {
+    return 0;
+  }
+
+  atomic_fetch_add(&cache.clock, 1);
+
+  const uint64_t first = (uint64_t)offset / VTPC_PAGE_SIZE;
+  const uint64_t last = ((uint64_t)offset + count - 1) / VTPC_PAGE_SIZE;
+  const enum vtpc_access access = write ? VTPC_ACCESS_WRITE : VTPC_ACCESS_READ;
+  for (uint64_t page = first; page <= last; ++page) {
+    bool hit = false;
+    struct vtpc_frame* frame =
+        vtpc_cache_borrow(&cache, file, page, access, &hit);
+    if (frame == NULL) {
+      const int error = errno;
+      vtpc_return_pages(pages, page - first, false);
+      errno = error;
+      return -1;
+    }
+    if (!write) {
+      pthread_mutex_lock(&handle->stream_lock);
+      vtpc_readahead_access(file, &handle->stream, page, hit);
+      pthread_mutex_unlock(&handle->stream_lock);
+    }
+    pages[page - first] = frame->data;
+  }
+
+  const size_t mapped = last - first + 1;
+  if (vtpc_maps_add(handle, pages, mapped) == -1) {
+    const int error = errno;
+    vtpc_return_pages(pages, mapped, false);
+    errno = error;
+    return -1;
+  }
+  if (write) {
+    vtpc_file_grow(file, offset + (off_t)count);
+  }
+  return (ssize_t)mapped;
+}
+
+int vtpc_set_capacity(size_t pages) {
+  pthread_rwlock_wrlock(&files_lock);
+  const int result = vtpc_set_capacity_locked(pages);
+  pthread_rwlock_unlock(&files_lock);
+  return result;
+}
+
+int vtpc_set_shards(size_t shards) {
+  pthread_rwlock_wrlock(&files_lock);
+  const int result = vtpc_set_shards_locked(shards);
+  pthread_rwlock_unlock(&files_lock);
+  return result;
+}
+
+int vtpc_set_policy(const char* name) {
+  pthread_rwlock_wrlock(&files_lock);
+  const int result = vtpc_set_policy_locked(name);
+  pthread_rwlock_unlock(&files_lock);
+  return result;
+}
+
+int vtpc_set_admission(const char* name) {
+  pthread_rwlock_wrlock(&files_lock);
+  const int result = vtpc_set_admission_locked(name);
+  pthread_rwlock_unlock(&files_lock);
+  return result;
+}
+
+int vtpc_set_journal(const char* mode) {
+  pthread_rwlock_wrlock(&files_lock);
+  const int result = vtpc_set_journal_locked(mode);
+  pthread_rwlock_unlock(&files_lock);
+  return result;
+}
+
+int vtpc_set_checksums(const char* mode) {
+  pthread_rwlock_wrlock(&files_lock);
+  const int result = vtpc_set_checksums_locked(mode);
+  pthread_rwlock_unlock(&files_lock);
+  return result;
+}
+
+int vtpc_set_dirty_ratio(unsigned percent) {
+  pthread_rwlock_wrlock(&files_lock);
+  const int result = vtpc_set_dirty_ratio_locked(percent);
+  pthread_rwlock_unlock(&files_lock);
+  return result;
+}
+
+void vtpc_stats(struct vtpc_stats* stats) {
+  pthread_rwlock_rdlock(&files_lock);
+  if (cache.frames != NULL) {
+    vtpc_cache_stats(&cache, stats);
+  } else {
+    *stats = (struct vtpc_stats){0};
+  }
+  pthread_rwlock_unlock(&files_lock);
+}
+
+int vtpc_file_stats(int fd, struct vtpc_stats* stats) {
+  struct vtpc_handle* handle = vtpc_handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  vtpc_cache_file_stats(&cache, handle->file, stats);
+  vtpc_handle_release(handle);
+  return 0;
+}
+
+uint64_t vtpc_clock(void) {
+  return atomic_load(&cache.clock);
+}
+
 int vtpc_open(const char* path, int mode, int access) {
-  return open(path, mode, access);
+  pthread_rwlock_wrlock(&files_lock);
+  const int result = vtpc_open_locked(path, mode, access);
+  pthread_rwlock_unlock(&files_lock);
+  return result;
 }
 
 int vtpc_close(int fd) {
-  return close(fd);
+  pthread_rwlock_wrlock(&files_lock);
+  struct vtpc_handle* handle = vtpc_close_locked(fd);
+  pthread_rwlock_unlock(&files_lock);
+  if (handle == NULL) {
+    return -1;
+  }
+
+  /* The file outlives the operations still in flight on the handle. */
+  struct vtpc_file* file = handle->file;
+  vtpc_handle_free(handle);
+  return vtpc_file_release(file) ? vtpc_file_close(file) : 0;
+}
+
+/*
+ * Reads at the offset, or at the offset of the handle if it is NULL. Only
+ * the latter locks the handle; a positional read relies on the pins of its
+ * pages alone.
+ */
+static ssize_t vtpc_readv_at(
+    int fd, const struct iovec* iov, int iovcnt, const off_t* offset
+) {
+  if (offset != NULL && *offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  struct vtpc_handle* handle = vtpc_handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  if (offset == NULL) {
+    pthread_mutex_lock(&handle->lock);
+  }
+  off_t at = (offset != NULL) ? *offset : handle->offset;
+  const ssize_t result = vtpc_readv_locked(handle, iov, iovcnt, &at);
+  if (offset == NULL) {
+    handle->offset = at;
+    pthread_mutex_unlock(&handle->lock);
+  }
+  vtpc_handle_release(handle);
+  return result;
+}
+
+/*
+ * Writes at the offset, or at the offset of the handle if it is NULL, which
+ * is the only case that locks the handle.
+ */
+static ssize_t vtpc_writev_at(
+    int fd, const struct iovec* iov, int iovcnt, const off_t* offset
+) {
+  if (offset != NULL && *offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  struct vtpc_handle* handle = vtpc_handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  struct vtpc_file* file = handle->file;
+  if (offset == NULL) {
+    pthread_mutex_lock(&handle->lock);
+  }
+  if (handle->flags & O_APPEND) {
+    pthread_rwlock_wrlock(&file->lock);
+  } else {
+    pthread_rwlock_rdlock(&file->lock);
+  }
+  off_t at = (offset != NULL) ? *offset : handle->offset;
+  uint64_t lsn = 0;
+  ssize_t result = vtpc_writev_locked(handle, iov, iovcnt, &at, &lsn);
+  pthread_rwlock_unlock(&file->lock);
+  if (offset == NULL) {
+    handle->offset = at;
+    pthread_mutex_unlock(&handle->lock);
+  }
+
+  /* A failed checkpoint only leaves the journal longer. */
+  struct vtpc_journal* journal = file->journal;
+  if (result > 0 && journal != NULL &&
+      vtpc_journal_size(journal) > VTPC_JOURNAL_LIMIT) {
+    (void)vtpc_file_sync(file);
+  }
+  /* Writers wait for the journal without the locks to share commits. */
+  if (result > 0 && journal != NULL &&
+      vtpc_journal_commit(journal, lsn) == -1) {
+    result = -1;
+  }
+  vtpc_handle_release(handle);
+  return result;
 }
 
 ssize_t vtpc_read(int fd, void* buf, size_t count) {
-  return read(fd, buf, count);
+  const struct iovec iov = {.iov_base = buf, .iov_len = count};
+  return vtpc_readv_at(fd, &iov, 1, NULL);
 }
 
 ssize_t vtpc_write(int fd, const void* buf, size_t count) {
-  return write(fd, buf, count);
+  const struct iovec iov = {.iov_base = (void*)buf, .iov_len = count};
+  return vtpc_writev_at(fd, &iov, 1, NULL);
+}
+
+ssize_t vtpc_pread(int fd, void* buf, size_t count, off_t offset) {
+  const struct iovec iov = {.iov_base = buf, .iov_len = count};
+  return vtpc_readv_at(fd, &iov, 1, &offset);
+}
+
+ssize_t vtpc_pwrite(int fd, const void* buf, size_t count, off_t offset) {
+  const struct iovec iov = {.iov_base = (void*)buf, .iov_len = count};
+  return vtpc_writev_at(fd, &iov, 1, &offset);
+}
+
+ssize_t vtpc_readv(int fd, const struct iovec* iov, int iovcnt) {
+  return vtpc_readv_at(fd, iov, iovcnt, NULL);
+}
+
+ssize_t vtpc_writev(int fd, const struct iovec* iov, int iovcnt) {
+  return vtpc_writev_at(fd, iov, iovcnt, NULL);
+}
+
+ssize_t vtpc_preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset) {
+  return vtpc_readv_at(fd, iov, iovcnt, &offset);
+}
+
+ssize_t vtpc_pwritev(
+    int fd, const struct iovec* iov, int iovcnt, off_t offset
+) {
+  return vtpc_writev_at(fd, iov, iovcnt, &offset);
 }
 
 off_t vtpc_lseek(int fd, off_t offset, int whence) {
-  return lseek(fd, offset, whence);
+  struct vtpc_handle* handle = vtpc_handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  pthread_mutex_lock(&handle->lock);
+  const off_t result = vtpc_lseek_locked(handle, offset, whence);
+  pthread_mutex_unlock(&handle->lock);
+  vtpc_handle_release(handle);
+  return result;
 }
 
 int vtpc_fsync(int fd) {
-  return fsync(fd);
+  struct vtpc_handle* handle = vtpc_handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  const int result = vtpc_file_sync(handle->file);
+  vtpc_handle_release(handle);
+  return result;
+}
+
+int vtpc_advice(int fd, off_t offset, size_t count, access_hint_t hint) {
+  struct vtpc_handle* handle = vtpc_handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  const int result = vtpc_advice_locked(handle, offset, count, hint);
+  vtpc_handle_release(handle);
+  return result;
+}
+
+ssize_t vtpc_map(
+    int fd, off_t offset, size_t count, enum vtpc_map_mode mode, void** pages
+) {
+  struct vtpc_handle* handle = vtpc_handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  pthread_rwlock_rdlock(&handle->file->lock);
+  const ssize_t result = vtpc_map_locked(handle, offset, count, mode, pages);
+  pthread_rwlock_unlock(&handle->file->lock);
+  vtpc_handle_release(handle);
+  return result;
+}
+
+int vtpc_unmap(void* const* pages, size_t count, enum vtpc_map_mode mode) {
+  if (mode != VTPC_MAP_READ && mode != VTPC_MAP_WRITE) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pthread_rwlock_rdlock(&files_lock);
+  for (size_t i = 0; i < count; ++i) {
+    if (vtpc_cache_frame(&cache, pages[i]) == NULL) {
+      pthread_rwlock_unlock(&files_lock);
+      errno = EINVAL;
+      return -1;
+    }
+  }
+  vtpc_unmap_pages(pages, count, mode == VTPC_MAP_WRITE);
+  pthread_rwlock_unlock(&files_lock);
+
+  if (mode == VTPC_MAP_WRITE && count != 0) {
+    vtpc_flusher_poke(&cache);
+  }
+  return 0;
+}
+
+int vtpc_usage(int fd, struct vtpc_usage* usage) {
+  struct vtpc_handle* handle = vtpc_handle_acquire(fd);
+  if (handle == NULL) {
+    return -1;
+  }
+  vtpc_cache_usage(&cache, handle->file, usage);
+  vtpc_handle_release(handle);
+  return 0;
 }
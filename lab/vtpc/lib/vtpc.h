@@ -1,10 +1,200 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
+/*
+ * Returns a vtpc descriptor, which is not an OS one. All opens of the same
+ * file, matched by device and inode, share its cached pages, size and dirty
+ * state, and all files draw their pages from one cache.
+ */
 int vtpc_open(const char* path, int mode, int access);
 int vtpc_close(int fd);
 ssize_t vtpc_read(int fd, void* buf, size_t count);
 ssize_t vtpc_write(int fd, const void* buf, size_t count);
+
+/*
+ * Like their libc counterparts. The positional ones leave the offset of the
+ * descriptor alone, except that pwrite appends in O_APPEND mode as on
+ * Linux. Each call looks up the pages of its range a stretch at a time and
+ * reads the missed ones together rather than page by page.
+ */
+ssize_t vtpc_pread(int fd, void* buf, size_t count, off_t offset);
+ssize_t vtpc_pwrite(int fd, const void* buf, size_t count, off_t offset);
+ssize_t vtpc_readv(int fd, const struct iovec* iov, int iovcnt);
+ssize_t vtpc_writev(int fd, const struct iovec* iov, int iovcnt);
+ssize_t vtpc_preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset);
+ssize_t vtpc_pwritev(
+    int fd, const struct iovec* iov, int iovcnt, off_t offset
+);
 off_t vtpc_lseek(int fd, off_t offset, int whence);
 int vtpc_fsync(int fd);
+
+/*
+ * Sets the number of pages in the cache. Must be called before the first
+ * vtpc_open, otherwise the VTPC_CAPACITY environment variable or the default
+ * capacity is used.
+ */
+int vtpc_set_capacity(size_t pages);
+
+/*
+ * Sets the number of cache shards, each with its own lock and policy
+ * instance. Like the capacity, it must be set before the first vtpc_open,
+ * otherwise the VTPC_SHARDS environment variable or the default is used.
+ */
+int vtpc_set_shards(size_t shards);
+
+/*
+ * Selects the eviction policy by name: "lru", "clock", "2q", "arc", "lru-k"
+ * or "optimal". Like the capacity, it must be set before the first vtpc_open,
+ * otherwise the VTPC_POLICY environment variable or LRU is used.
+ */
+int vtpc_set_policy(const char* name);
+
+/*
+ * Selects the admission filter in front of the policy: "tinylfu" only lets
+ * a new page displace a cached one if it has been accessed more often
+ * lately, which keeps a scan from flushing the pages in use; "none" admits
+ * every page. Like the policy, it must be set before the first vtpc_open,
+ * otherwise the VTPC_ADMISSION environment variable or "none" is used.
+ */
+int vtpc_set_admission(const char* name);
+
+/*
+ * Enables background writeback once dirty pages exceed the given percentage
+ * of the cache. Must be set before the first vtpc_open, otherwise the
+ * VTPC_DIRTY_RATIO environment variable is used; 0, the default, leaves
+ * dirty pages to fsync, close and eviction.
+ */
+int vtpc_set_dirty_ratio(unsigned percent);
+
+/*
+ * Journals writes so that dirty pages outlive a crash: "append" logs every
+ * vtpc_write to a file next to the written one before it returns, which
+ * survives the death of the process, and "sync" also waits for the log to
+ * reach the disk, sharing each disk flush among concurrent writers, which
+ * survives a crash of the machine. The next vtpc_open of the file replays
+ * the log; fsync and close empty it. Pages written through vtpc_map are not
+ * logged. Must be set before the first vtpc_open, otherwise the
+ * VTPC_JOURNAL environment variable or "none" is used.
+ */
+int vtpc_set_journal(const char* mode);
+
+/*
+ * With "crc32c", keeps the CRC32C of every page written back in a file next
+ * to the written one and checks pages read back against it, so that reads of
+ * corrupted pages fail with EIO and count in checksum_errors. The checksums
+ * of a file are only trusted after the last writable open of the file was
+ * closed, so a crash leaves the file unchecked until its next such close.
+ * Must be set before the first vtpc_open, otherwise the VTPC_CHECKSUMS
+ * environment variable or "none" is used.
+ */
+int vtpc_set_checksums(const char* mode);
+
+/*
+ * Access hints for the "optimal" policy. Time is measured in operations: the
+ * clock advances by one on every vtpc_read and vtpc_write. A hint either
+ * names the absolute clock value of the next access or the number of
+ * operations left until it.
+ */
+enum vtpc_hint_kind {
+  VTPC_HINT_AT,
+  VTPC_HINT_AFTER,
+};
+
+typedef struct {
+  enum vtpc_hint_kind kind;
+  uint64_t time;
+} access_hint_t;
+
+uint64_t vtpc_clock(void);
+
+/*
+ * Declares when the range [offset, offset + count) of the file is going to be
+ * accessed next. The hint is consumed by that access. Policies other than
+ * "optimal" ignore hints.
+ */
+int vtpc_advice(int fd, off_t offset, size_t count, access_hint_t hint);
+
+enum vtpc_map_mode {
+  VTPC_MAP_READ,
+  VTPC_MAP_WRITE,
+};
+
+/*
+ * Borrows the cached pages covering [offset, offset + count) of the file
+ * without copying them. Stores a pointer to each page in pages, which must
+ * have room for one per page; the first one points at the start of the page
+ * containing offset. A read mapping stops at the end of the file, while a
+ * write mapping extends the file to offset + count, and its pages are marked
+ * dirty once unmapped. The pages stay in the cache until vtpc_unmap; until
+ * then fsync skips them, vtpc_close of fd fails with EBUSY and so does an
+ * open with O_TRUNC of the file. Returns the number of pages, or -1 with
+ * errno set; ENOBUFS means that the cache has no more pages to lend.
+ */
+ssize_t vtpc_map(
+    int fd, off_t offset, size_t count, enum vtpc_map_mode mode, void** pages
+);
+
+/* Releases pages borrowed by vtpc_map with the same mode. */
+int vtpc_unmap(void* const* pages, size_t count, enum vtpc_map_mode mode);
+
+#define VTPC_LATENCY_BUCKETS 32
+
+/*
+ * A histogram of latencies in nanoseconds. Bucket i counts those in
+ * [2^i, 2^(i + 1)); the last bucket also counts all longer ones.
+ */
+struct vtpc_latency {
+  uint64_t count;
+  uint64_t total;
+  uint64_t buckets[VTPC_LATENCY_BUCKETS];
+};
+
+/*
+ * Written counts pages and written_bytes the bytes the writes returned.
+ * Checksum_errors counts pages read back that did not match their checksum.
+ * Dirty is the number of dirty pages at the time of the call. The miss
+ * latency covers the reads of missed pages, the flush latency every write
+ * of dirty pages.
+ */
+struct vtpc_stats {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t prefetched;
+  uint64_t prefetch_hits;
+  uint64_t prefetch_wasted;
+  uint64_t writes;
+  uint64_t written;
+  uint64_t written_bytes;
+  uint64_t checksum_errors;
+  uint64_t dirty;
+  struct vtpc_latency miss_latency;
+  struct vtpc_latency flush_latency;
+};
+
+/*
+ * Reports the counters of the whole cache. Every thread keeps counters of
+ * its own, which are summed here, so counting never contends; the sum is
+ * not a single snapshot while other threads keep going.
+ */
+void vtpc_stats(struct vtpc_stats* stats);
+
+/* Reports the counters of the file open as fd, shared by all its opens. */
+int vtpc_file_stats(int fd, struct vtpc_stats* stats);
+
+struct vtpc_usage {
+  uint64_t pages;
+  uint64_t dirty;
+  uint64_t hits;
+  uint64_t misses;
+};
+
+/*
+ * Reports the share of the cache taken by the file open as fd, which is
+ * shared with the other opens of the same file.
+ */
+int vtpc_usage(int fd, struct vtpc_usage* usage);
@@ -2,12 +2,16 @@
 
 #include <sys/types.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstring>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 
 #include "exception.hpp"
 #include "file.hpp"
@@ -48,6 +52,60 @@ void Compare(A lhs, B rhs) {
   }
 }
 
+namespace {
+
+/*
+ * Hands out the pages of the right view, and copies them into the left one
+ * before a writable view is released, so both files get the same changes.
+ */
+class cmp_view final : public view {
+public:
+  cmp_view(std::unique_ptr<view> lhs, std::unique_ptr<view> rhs, map_mode mode)
+      : lhs_(std::move(lhs)), rhs_(std::move(rhs)), mode_(mode) {
+  }
+
+  cmp_view(const cmp_view&) = delete;
+  cmp_view(cmp_view&&) = delete;
+  auto operator=(const cmp_view&) -> cmp_view& = delete;
+  auto operator=(cmp_view&&) -> cmp_view& = delete;
+
+  ~cmp_view() override {
+    if (mode_ != map_mode::write) {
+      return;
+    }
+    for (size_t i = 0; i < pages(); ++i) {
+      std::ranges::copy(rhs_->page(i), lhs_->page(i).begin());
+    }
+  }
+
+  [[nodiscard]] auto pages() const -> size_t override {
+    return rhs_->pages();
+  }
+
+  [[nodiscard]] auto page(size_t index) const -> std::span<char> override {
+    return rhs_->page(index);
+  }
+
+private:
+  std::unique_ptr<view> lhs_;
+  std::unique_ptr<view> rhs_;
+  map_mode mode_;
+};
+
+/* Cuts the text into spans as long as the buffers, one after another. */
+auto split(std::string& text, std::span<const std::span<char>> buffers)
+    -> std::vector<std::span<char>> {
+  std::vector<std::span<char>> spans;
+  size_t at = 0;
+  for (const auto& buffer : buffers) {
+    spans.emplace_back(text.data() + at, buffer.size());
+    at += buffer.size();
+  }
+  return spans;
+}
+
+}  // namespace
+
 cmp_file::cmp_file(std::unique_ptr<file> lhs, std::unique_ptr<file> rhs)
     : lhs_(std::move(lhs)), file_(std::move(rhs)) {
 }
@@ -71,6 +129,56 @@ auto cmp_file::write(const char* buffer, size_t count) -> void {
   );
 }
 
+auto cmp_file::pread(char* buffer, size_t count, off_t offset) -> void {
+  std::string lhs(count, ' ');
+  std::string rhs(count, ' ');
+  Compare(
+      [&] { lhs_->pread(lhs.data(), count, offset); },
+      [&] { file_->pread(rhs.data(), count, offset); }
+  );
+  if (lhs != rhs) {
+    throw vt::cmp_file_exception() << "'" << lhs << "' != '" << rhs << "'";
+  }
+  memcpy(buffer, lhs.data(), count);
+}
+
+auto cmp_file::pwrite(const char* buffer, size_t count, off_t offset) -> void {
+  Compare(
+      [&] { lhs_->pwrite(buffer, count, offset); },
+      [&] { file_->pwrite(buffer, count, offset); }
+  );
+}
+
+auto cmp_file::preadv(std::span<const std::span<char>> buffers, off_t offset)
+    -> void {
+  size_t count = 0;
+  for (const auto& buffer : buffers) {
+    count += buffer.size();
+  }
+  std::string lhs(count, ' ');
+  std::string rhs(count, ' ');
+  Compare(
+      [&] { lhs_->preadv(split(lhs, buffers), offset); },
+      [&] { file_->preadv(split(rhs, buffers), offset); }
+  );
+  if (lhs != rhs) {
+    throw vt::cmp_file_exception() << "'" << lhs << "' != '" << rhs << "'";
+  }
+  size_t at = 0;
+  for (const auto& buffer : buffers) {
+    std::ranges::copy_n(lhs.data() + at, buffer.size(), buffer.data());
+    at += buffer.size();
+  }
+}
+
+auto cmp_file::pwritev(std::span<const std::string_view> buffers, off_t offset)
+    -> void {
+  Compare(
+      [&] { lhs_->pwritev(buffers, offset); },
+      [&] { file_->pwritev(buffers, offset); }
+  );
+}
+
 auto cmp_file::seek(off_t offset) -> void {
   Compare([&] { lhs_->seek(offset); }, [&] { file_->seek(offset); });
 }
@@ -79,4 +187,29 @@ auto cmp_file::sync() -> void {
   Compare([&] { lhs_->sync(); }, [this] { file_->sync(); });
 }
 
+auto cmp_file::map(off_t offset, size_t count, map_mode mode)
+    -> std::unique_ptr<view> {
+  std::unique_ptr<view> lhs;
+  std::unique_ptr<view> rhs;
+  Compare(
+      [&] { lhs = lhs_->map(offset, count, mode); },
+      [&] { rhs = file_->map(offset, count, mode); }
+  );
+  if (lhs->pages() != rhs->pages()) {
+    throw vt::cmp_file_exception() << "mapped " << lhs->pages()
+                                   << " != " << rhs->pages() << " pages";
+  }
+  for (size_t i = 0; i < lhs->pages(); ++i) {
+    const std::span<char> lhs_page = lhs->page(i);
+    const std::span<char> rhs_page = rhs->page(i);
+    if (!std::ranges::equal(lhs_page, rhs_page)) {
+      throw vt::cmp_file_exception()
+          << "page " << i << " of the view differs: '"
+          << std::string_view(lhs_page.data(), lhs_page.size()) << "' != '"
+          << std::string_view(rhs_page.data(), rhs_page.size()) << "'";
+    }
+  }
+  return std::make_unique<cmp_view>(std::move(lhs), std::move(rhs), mode);
+}
+
 }  // namespace vt
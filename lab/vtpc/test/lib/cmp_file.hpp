@@ -4,6 +4,8 @@
 
 #include <cstddef>
 #include <memory>
+#include <span>
+#include <string_view>
 
 #include "exception.hpp"
 #include "file.hpp"
@@ -22,8 +24,16 @@ public:
 
   auto read(char* buffer, size_t count) -> void override;
   auto write(const char* buffer, size_t count) -> void override;
+  auto pread(char* buffer, size_t count, off_t offset) -> void override;
+  auto pwrite(const char* buffer, size_t count, off_t offset) -> void override;
+  auto preadv(std::span<const std::span<char>> buffers, off_t offset)
+      -> void override;
+  auto pwritev(std::span<const std::string_view> buffers, off_t offset)
+      -> void override;
   auto seek(off_t offset) -> void override;
   auto sync() -> void override;
+  auto map(off_t offset, size_t count, map_mode mode)
+      -> std::unique_ptr<view> override;
 
 private:
   std::unique_ptr<file> lhs_;
@@ -1,19 +1,25 @@
 #include "file.hpp"
 
+#include <algorithm>
 #include <cerrno>
 #include <cstddef>
 #include <cstdio>
 #include <cstring>
 #include <functional>
 #include <memory>
+#include <span>
+#include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 #include "exception.hpp"
 
 extern "C" {
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "vtpc.h"
@@ -31,13 +37,48 @@ auto file_exception::code() const -> ssize_t {
   return code_;
 }
 
+auto view::read(size_t offset, size_t count) const -> std::string {
+  std::string text;
+  text.reserve(count);
+  while (text.size() < count) {
+    const std::span<char> data = page(offset / page_size);
+    const size_t shift = offset % page_size;
+    const size_t chunk = std::min(page_size - shift, count - text.size());
+    text.append(data.data() + shift, chunk);
+    offset += chunk;
+  }
+  return text;
+}
+
+auto view::write(size_t offset, std::string_view text) -> void {
+  while (!text.empty()) {
+    const std::span<char> data = page(offset / page_size);
+    const size_t shift = offset % page_size;
+    const size_t chunk = std::min(page_size - shift, text.size());
+    std::copy_n(text.data(), chunk, data.data() + shift);
+    text.remove_prefix(chunk);
+    offset += chunk;
+  }
+}
+
 struct io {
   std::function<int(const char* path, int mode, int access)> open;
   std::function<int(int fd)> close;
   std::function<ssize_t(int fd, void* buf, size_t count)> read;
   std::function<ssize_t(int fd, const void* buf, size_t count)> write;
+  std::function<ssize_t(int fd, void* buf, size_t count, off_t offset)> pread;
+  std::function<ssize_t(int fd, const void* buf, size_t count, off_t offset)>
+      pwrite;
+  std::function<ssize_t(int fd, const iovec* iov, int count, off_t offset)>
+      preadv;
+  std::function<ssize_t(int fd, const iovec* iov, int count, off_t offset)>
+      pwritev;
   std::function<off_t(int fd, off_t offset, int whence)> lseek;
   std::function<int(int fd)> fsync;
+  std::function<std::unique_ptr<view>(
+      int fd, off_t offset, size_t count, map_mode mode
+  )>
+      map;
 };
 
 template <class A, class T>
@@ -67,6 +108,180 @@ void robust_do(A action, int fd, T* buf, size_t count) {
   }
 }
 
+/*
+ * Reads or writes all of the vectors from the offset like robust_do, moving
+ * past the ones done after a short transfer.
+ */
+template <class A>
+void robust_vector_do(A action, int fd, std::vector<iovec> iov, off_t offset) {
+  size_t total = 0;
+  size_t first = 0;
+  while (first < iov.size()) {
+    if (iov[first].iov_len == 0) {
+      ++first;
+      continue;
+    }
+    const auto count = static_cast<int>(iov.size() - first);
+    const off_t at = offset + static_cast<off_t>(total);
+    const ssize_t local = action(fd, iov.data() + first, count, at);
+    if (local < 0) {
+      throw vt::file_exception(local)
+          << "failed to read/write " << count << " vectors at offset " << at
+          << " of file with fd " << fd << ": "
+          << strerror(errno);  // NOLINT(concurrency-mt-unsafe);
+    }
+    if (local == 0) {
+      throw vt::file_exception(0)
+          << "failed to read/write " << count << " vectors at offset " << at
+          << " of file with fd " << fd << ": " << "EOF after reading "
+          << total << " bytes";
+    }
+
+    total += local;
+    auto left = static_cast<size_t>(local);
+    while (left > 0) {
+      const size_t chunk = std::min(left, iov[first].iov_len);
+      iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + chunk;
+      iov[first].iov_len -= chunk;
+      left -= chunk;
+      first += (iov[first].iov_len == 0) ? 1 : 0;
+    }
+  }
+}
+
+namespace {
+
+auto page_count(off_t offset, size_t count) -> size_t {
+  const size_t shift = static_cast<size_t>(offset) % view::page_size;
+  if (count == 0) {
+    return 0;
+  }
+  return (shift + count + view::page_size - 1) / view::page_size;
+}
+
+/*
+ * Emulates a mapping with a copy of the pages, written back on release up to
+ * the size the file would get from vtpc_map.
+ */
+class copy_view final : public view {
+public:
+  copy_view(int fd, off_t offset, size_t count, map_mode mode)
+      : fd_(fd), mode_(mode) {
+    struct stat st = {};
+    if (offset < 0 || fstat(fd, &st) == -1) {
+      throw vt::file_exception(-1)
+          << "failed to map " << count << " bytes at offset " << offset
+          << " of file with fd " << fd << ": "
+          << strerror(errno);  // NOLINT(concurrency-mt-unsafe)
+    }
+
+    const off_t size = st.st_size;
+    if (mode == map_mode::read) {
+      count = (offset < size)
+                  ? std::min(count, static_cast<size_t>(size - offset))
+                  : 0;
+    }
+    start_ = offset - (offset % static_cast<off_t>(page_size));
+    end_ = (mode == map_mode::write)
+               ? std::max(size, offset + static_cast<off_t>(count))
+               : size;
+    buffer_.assign(page_count(offset, count) * page_size, 0);
+
+    const size_t stored =
+        (size > start_)
+            ? std::min(buffer_.size(), static_cast<size_t>(size - start_))
+            : 0;
+    size_t total = 0;
+    while (total < stored) {
+      const off_t at = start_ + static_cast<off_t>(total);
+      const ssize_t n = pread(fd_, buffer_.data() + total, stored - total, at);
+      if (n <= 0) {
+        throw vt::file_exception(n)
+            << "failed to read " << stored << " bytes at offset " << start_
+            << " of file with fd " << fd_ << ": "
+            << strerror(errno);  // NOLINT(concurrency-mt-unsafe)
+      }
+      total += n;
+    }
+  }
+
+  copy_view(const copy_view&) = delete;
+  copy_view(copy_view&&) = delete;
+  auto operator=(const copy_view&) -> copy_view& = delete;
+  auto operator=(copy_view&&) -> copy_view& = delete;
+
+  ~copy_view() override {
+    if (mode_ != map_mode::write) {
+      return;
+    }
+    const size_t stored =
+        std::min(buffer_.size(), static_cast<size_t>(end_ - start_));
+    size_t total = 0;
+    while (total < stored) {
+      const off_t at = start_ + static_cast<off_t>(total);
+      const ssize_t n = pwrite(fd_, buffer_.data() + total, stored - total, at);
+      if (n <= 0) {
+        return;
+      }
+      total += n;
+    }
+  }
+
+  [[nodiscard]] auto pages() const -> size_t override {
+    return buffer_.size() / page_size;
+  }
+
+  [[nodiscard]] auto page(size_t index) const -> std::span<char> override {
+    return {buffer_.data() + (index * page_size), page_size};
+  }
+
+private:
+  int fd_;
+  map_mode mode_;
+  off_t start_ = 0;
+  off_t end_ = 0;
+  mutable std::vector<char> buffer_;
+};
+
+class vtpc_view final : public view {
+public:
+  vtpc_view(int fd, off_t offset, size_t count, map_mode mode)
+      : mode_(mode == map_mode::read ? VTPC_MAP_READ : VTPC_MAP_WRITE) {
+    pages_.resize((offset < 0) ? 0 : page_count(offset, count));
+    const ssize_t n = vtpc_map(fd, offset, count, mode_, pages_.data());
+    if (n < 0) {
+      throw vt::file_exception(n)
+          << "failed to map " << count << " bytes at offset " << offset
+          << " of file with fd " << fd << ": "
+          << strerror(errno);  // NOLINT(concurrency-mt-unsafe)
+    }
+    pages_.resize(n);
+  }
+
+  vtpc_view(const vtpc_view&) = delete;
+  vtpc_view(vtpc_view&&) = delete;
+  auto operator=(const vtpc_view&) -> vtpc_view& = delete;
+  auto operator=(vtpc_view&&) -> vtpc_view& = delete;
+
+  ~vtpc_view() override {
+    (void)vtpc_unmap(pages_.data(), pages_.size(), mode_);
+  }
+
+  [[nodiscard]] auto pages() const -> size_t override {
+    return pages_.size();
+  }
+
+  [[nodiscard]] auto page(size_t index) const -> std::span<char> override {
+    return {static_cast<char*>(pages_[index]), page_size};
+  }
+
+private:
+  vtpc_map_mode mode_;
+  std::vector<void*> pages_;
+};
+
+}  // namespace
+
 class io_file final : public file {
 public:
   explicit io_file(std::string_view path, io io)
@@ -90,6 +305,40 @@ public:
     robust_do(io_.write, fd_, buffer, count);
   }
 
+  void pread(char* buffer, size_t count, off_t offset) override {
+    auto action = [&](int fd, char* tail, size_t tail_count) {
+      return io_.pread(fd, tail, tail_count, offset + (tail - buffer));
+    };
+    robust_do(action, fd_, buffer, count);
+  }
+
+  void pwrite(const char* buffer, size_t count, off_t offset) override {
+    auto action = [&](int fd, const char* tail, size_t tail_count) {
+      return io_.pwrite(fd, tail, tail_count, offset + (tail - buffer));
+    };
+    robust_do(action, fd_, buffer, count);
+  }
+
+  void preadv(std::span<const std::span<char>> buffers, off_t offset) override {
+    std::vector<iovec> iov;
+    for (const auto& buffer : buffers) {
+      iov.push_back({.iov_base = buffer.data(), .iov_len = buffer.size()});
+    }
+    robust_vector_do(io_.preadv, fd_, std::move(iov), offset);
+  }
+
+  void pwritev(std::span<const std::string_view> buffers, off_t offset)
+      override {
+    std::vector<iovec> iov;
+    for (const auto& buffer : buffers) {
+      iov.push_back({
+          .iov_base = const_cast<char*>(buffer.data()),  // NOLINT
+          .iov_len = buffer.size(),
+      });
+    }
+    robust_vector_do(io_.pwritev, fd_, std::move(iov), offset);
+  }
+
   void seek(off_t offset) override {
     if (io_.lseek(fd_, offset, SEEK_SET) == -1) {
       throw vt::file_exception(-1)
@@ -106,6 +355,11 @@ public:
     }
   }
 
+  auto map(off_t offset, size_t count, map_mode mode)
+      -> std::unique_ptr<view> override {
+    return io_.map(fd_, offset, count, mode);
+  }
+
 private:
   int fd_;
   io io_;
@@ -117,8 +371,17 @@ auto file::open_libc(std::string_view path) -> std::unique_ptr<file> {
       .close = ::close,
       .read = ::read,
       .write = ::write,
+      .pread = ::pread,
+      .pwrite = ::pwrite,
+      .preadv = ::preadv,
+      .pwritev = ::pwritev,
       .lseek = ::lseek,
       .fsync = ::fsync,
+      .map = [](int fd, off_t offset, size_t count, map_mode mode) {
+        return std::unique_ptr<view>(
+            std::make_unique<copy_view>(fd, offset, count, mode)
+        );
+      },
   };
 
   return std::make_unique<io_file>(path, std::move(io));
@@ -130,8 +393,17 @@ auto file::open_vtpc(std::string_view path) -> std::unique_ptr<file> {
       .close = ::vtpc_close,
       .read = ::vtpc_read,
       .write = ::vtpc_write,
+      .pread = ::vtpc_pread,
+      .pwrite = ::vtpc_pwrite,
+      .preadv = ::vtpc_preadv,
+      .pwritev = ::vtpc_pwritev,
       .lseek = ::vtpc_lseek,
       .fsync = ::vtpc_fsync,
+      .map = [](int fd, off_t offset, size_t count, map_mode mode) {
+        return std::unique_ptr<view>(
+            std::make_unique<vtpc_view>(fd, offset, count, mode)
+        );
+      },
   };
 
   return std::make_unique<io_file>(path, std::move(io));
@@ -4,6 +4,7 @@
 
 #include <cstddef>
 #include <memory>
+#include <span>
 #include <string>
 #include <string_view>
 
@@ -21,13 +22,48 @@ private:
   ssize_t code_;
 };
 
+enum class map_mode {
+  read,
+  write,
+};
+
+/*
+ * Pages of a file borrowed with file::map, starting with the one containing
+ * the mapped offset. The pages are released when the view is destroyed, and
+ * those of a writable view are written.
+ */
+class view {
+public:
+  static constexpr size_t page_size = 4096;
+
+  virtual ~view() = default;
+  [[nodiscard]] virtual auto pages() const -> size_t = 0;
+  [[nodiscard]] virtual auto page(size_t index) const -> std::span<char> = 0;
+
+  /* Copies bytes at the offset from the start of the first page. */
+  [[nodiscard]] auto read(size_t offset, size_t count) const -> std::string;
+  auto write(size_t offset, std::string_view text) -> void;
+};
+
 class file {
 public:
   virtual ~file() = default;
   virtual auto read(char* buffer, size_t count) -> void = 0;
   virtual auto write(const char* buffer, size_t count) -> void = 0;
+
+  /* Positional ops leave the offset of the file where it is. */
+  virtual auto pread(char* buffer, size_t count, off_t offset) -> void = 0;
+  virtual auto pwrite(const char* buffer, size_t count, off_t offset)
+      -> void = 0;
+  virtual auto preadv(std::span<const std::span<char>> buffers, off_t offset)
+      -> void = 0;
+  virtual auto pwritev(std::span<const std::string_view> buffers, off_t offset)
+      -> void = 0;
+
   virtual auto seek(off_t offset) -> void = 0;
   virtual auto sync() -> void = 0;
+  virtual auto map(off_t offset, size_t count, map_mode mode)
+      -> std::unique_ptr<view> = 0;
 
   auto write(std::string_view text) -> void {
     write(text.data(), text.size());
@@ -5,6 +5,8 @@
 #include <cstddef>
 #include <iostream>
 #include <memory>
+#include <span>
+#include <string_view>
 #include <utility>
 
 #include "file.hpp"
@@ -24,6 +26,30 @@ auto log_file::write(const char* buffer, size_t count) -> void {
   file_->write(buffer, count);
 }
 
+auto log_file::pread(char* buffer, size_t count, off_t offset) -> void {
+  std::cerr << "[vt] pread offset " << offset << " count " << count << "\n";
+  file_->pread(buffer, count, offset);
+}
+
+auto log_file::pwrite(const char* buffer, size_t count, off_t offset) -> void {
+  std::cerr << "[vt] pwrite offset " << offset << " count " << count << "\n";
+  file_->pwrite(buffer, count, offset);
+}
+
+auto log_file::preadv(std::span<const std::span<char>> buffers, off_t offset)
+    -> void {
+  std::cerr << "[vt] preadv offset " << offset << " vectors "
+            << buffers.size() << "\n";
+  file_->preadv(buffers, offset);
+}
+
+auto log_file::pwritev(std::span<const std::string_view> buffers, off_t offset)
+    -> void {
+  std::cerr << "[vt] pwritev offset " << offset << " vectors "
+            << buffers.size() << "\n";
+  file_->pwritev(buffers, offset);
+}
+
 auto log_file::seek(off_t offset) -> void {
   std::cerr << "[vt] seek offset " << offset << "\n";
   file_->seek(offset);
@@ -34,4 +60,11 @@ auto log_file::sync() -> void {
   file_->sync();
 }
 
+auto log_file::map(off_t offset, size_t count, map_mode mode)
+    -> std::unique_ptr<view> {
+  std::cerr << "[vt] map offset " << offset << " count " << count
+            << (mode == map_mode::write ? " write" : " read") << "\n";
+  return file_->map(offset, count, mode);
+}
+
 }  // namespace vt
@@ -0,0 +1,165 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "exception.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+}
+
+namespace vt {
+
+namespace {
+
+constexpr char magic[8] = {'V', 'T', 'T', 'R', 'A', 'C', 'E', '\0'};  // NOLINT
+constexpr uint32_t version = 1;
+
+auto error_text() -> const char* {
+  return strerror(errno);  // NOLINT(concurrency-mt-unsafe)
+}
+
+}  // namespace
+
+struct trace::header {
+  char magic[8];  // NOLINT
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t capacity;
+  uint64_t head;
+  uint8_t reserved[32];  // NOLINT
+};
+
+trace::trace(void* memory, size_t size)
+    : header_(static_cast<header*>(memory)),
+      size_(size),
+      start_(std::chrono::steady_clock::now()) {
+  static_assert(sizeof(header) == 64);
+}
+
+trace::~trace() {
+  munmap(header_, size_);
+}
+
+auto trace::create(const std::string& path, size_t capacity)
+    -> std::shared_ptr<trace> {
+  if (capacity == 0) {
+    throw vt::exception() << "a trace needs room for at least one record";
+  }
+
+  const int flags = O_RDWR | O_CREAT | O_TRUNC;
+  const int fd = ::open(path.c_str(), flags, 0644);  // NOLINT
+  if (fd < 0) {
+    throw vt::exception() << "failed to create trace '" << path
+                          << "': " << error_text();
+  }
+  const size_t size = sizeof(header) + (capacity * sizeof(trace_record));
+  void* memory = MAP_FAILED;
+  if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  const int error = errno;
+  ::close(fd);
+  if (memory == MAP_FAILED) {
+    throw vt::exception() << "failed to map trace '" << path
+                          << "': " << strerror(error);  // NOLINT
+  }
+
+  auto result = std::shared_ptr<trace>(new trace(memory, size));
+  header& header = *result->header_;
+  std::copy_n(magic, sizeof(magic), header.magic);
+  header.version = version;
+  header.record_size = sizeof(trace_record);
+  header.capacity = capacity;
+  header.head = 0;
+  return result;
+}
+
+auto trace::open(const std::string& path) -> std::shared_ptr<trace> {
+  const int fd = ::open(path.c_str(), O_RDONLY);  // NOLINT
+  if (fd < 0) {
+    throw vt::exception() << "failed to open trace '" << path
+                          << "': " << error_text();
+  }
+  struct stat st = {};
+  void* memory = MAP_FAILED;
+  size_t size = 0;
+  if (fstat(fd, &st) == 0 &&
+      static_cast<size_t>(st.st_size) >= sizeof(header)) {
+    size = static_cast<size_t>(st.st_size);
+    /* A private mapping, so appending to an opened trace stays in memory. */
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  }
+  ::close(fd);
+  if (memory == MAP_FAILED) {
+    throw vt::exception() << "failed to map trace '" << path << "'";
+  }
+
+  auto result = std::shared_ptr<trace>(new trace(memory, size));
+  const header& header = *result->header_;
+  if (!std::equal(magic, magic + sizeof(magic), header.magic) ||
+      header.version != version ||
+      header.record_size != sizeof(trace_record) || header.capacity == 0 ||
+      header.capacity > (size - sizeof(header)) / sizeof(trace_record)) {
+    throw vt::exception() << "'" << path << "' is not a vt trace";
+  }
+  return result;
+}
+
+auto trace::slots() const -> trace_record* {
+  return reinterpret_cast<trace_record*>(header_ + 1);  // NOLINT
+}
+
+auto trace::append(trace_op op, off_t offset, size_t size) -> trace_record* {
+  const uint64_t index =
+      std::atomic_ref(header_->head).fetch_add(1, std::memory_order_relaxed);
+  const auto elapsed = std::chrono::steady_clock::now() - start_;
+
+  trace_record* record = &slots()[index % header_->capacity];
+  *record = {
+      .time = static_cast<uint64_t>(
+          std::chrono::nanoseconds(elapsed).count()
+      ),
+      .offset = offset,
+      .size = size,
+      .op = op,
+      .failed = 0,
+      .reserved = {},
+  };
+  return record;
+}
+
+auto trace::records() const -> std::vector<trace_record> {
+  const uint64_t head =
+      std::atomic_ref(header_->head).load(std::memory_order_relaxed);
+  const uint64_t capacity = header_->capacity;
+  const uint64_t first = head - std::min(head, capacity);
+
+  std::vector<trace_record> records;
+  records.reserve(head - first);
+  for (uint64_t i = first; i < head; ++i) {
+    records.push_back(slots()[i % capacity]);
+  }
+  return records;
+}
+
+auto trace::dropped() const -> uint64_t {
+  const uint64_t head =
+      std::atomic_ref(header_->head).load(std::memory_order_relaxed);
+  return head - std::min(head, header_->capacity);
+}
+
+}  // namespace vt
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vt {
+
+enum class trace_op : uint8_t {
+  read,
+  write,
+  seek,
+  sync,
+  map_read,
+  map_write,
+  pread,
+  pwrite,
+};
+
+/* One op on a file, with the time in nanoseconds since the trace began. */
+struct trace_record {
+  uint64_t time;
+  int64_t offset;
+  uint64_t size;
+  trace_op op;
+  uint8_t failed;
+  uint8_t reserved[6];  // NOLINT
+};
+
+static_assert(sizeof(trace_record) == 32);
+
+/*
+ * A binary trace kept in a memory-mapped file: a header followed by a ring
+ * of fixed-size records. Appending is a store into the mapping, so tracing
+ * costs no system calls, and once the ring is full the oldest records are
+ * overwritten. Threads may append to the same trace concurrently.
+ */
+class trace {
+public:
+  trace(const trace&) = delete;
+  trace(trace&&) = delete;
+  auto operator=(const trace&) -> trace& = delete;
+  auto operator=(trace&&) -> trace& = delete;
+  ~trace();
+
+  /* Creates an empty trace at path with room for capacity records. */
+  static auto create(const std::string& path, size_t capacity)
+      -> std::shared_ptr<trace>;
+
+  /* Opens a recorded trace for reading. */
+  static auto open(const std::string& path) -> std::shared_ptr<trace>;
+
+  /*
+   * Appends a record and returns its slot, which stays valid until the ring
+   * wraps around to it.
+   */
+  auto append(trace_op op, off_t offset, size_t size) -> trace_record*;
+
+  /* Returns the records kept by the ring, from the oldest to the newest. */
+  [[nodiscard]] auto records() const -> std::vector<trace_record>;
+
+  /* Returns the number of records overwritten after the ring filled up. */
+  [[nodiscard]] auto dropped() const -> uint64_t;
+
+private:
+  struct header;
+
+  trace(void* memory, size_t size);
+
+  [[nodiscard]] auto slots() const -> trace_record*;
+
+  header* header_;
+  size_t size_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace vt
@@ -0,0 +1,167 @@
+#include "trace_file.hpp"
+
+#include <sys/types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "file.hpp"
+#include "trace.hpp"
+
+namespace vt {
+
+namespace {
+
+/* Runs the op, marking its record as failed if the op throws. */
+template <class F>
+auto traced(trace_record* record, F op) -> decltype(op()) {
+  try {
+    return op();
+  } catch (...) {
+    record->failed = 1;
+    throw;
+  }
+}
+
+}  // namespace
+
+trace_file::trace_file(std::unique_ptr<file> file, std::shared_ptr<trace> trace)
+    : file_(std::move(file)), trace_(std::move(trace)) {
+}
+
+auto trace_file::read(char* buffer, size_t count) -> void {
+  auto* record = trace_->append(trace_op::read, offset_, count);
+  traced(record, [&] { file_->read(buffer, count); });
+  offset_ += static_cast<off_t>(count);
+}
+
+auto trace_file::write(const char* buffer, size_t count) -> void {
+  auto* record = trace_->append(trace_op::write, offset_, count);
+  traced(record, [&] { file_->write(buffer, count); });
+  offset_ += static_cast<off_t>(count);
+}
+
+auto trace_file::pread(char* buffer, size_t count, off_t offset) -> void {
+  auto* record = trace_->append(trace_op::pread, offset, count);
+  traced(record, [&] { file_->pread(buffer, count, offset); });
+}
+
+auto trace_file::pwrite(const char* buffer, size_t count, off_t offset)
+    -> void {
+  auto* record = trace_->append(trace_op::pwrite, offset, count);
+  traced(record, [&] { file_->pwrite(buffer, count, offset); });
+}
+
+/* Vectored ops are recorded as the positional op of their total size. */
+auto trace_file::preadv(std::span<const std::span<char>> buffers, off_t offset)
+    -> void {
+  size_t count = 0;
+  for (const auto& buffer : buffers) {
+    count += buffer.size();
+  }
+  auto* record = trace_->append(trace_op::pread, offset, count);
+  traced(record, [&] { file_->preadv(buffers, offset); });
+}
+
+auto trace_file::pwritev(
+    std::span<const std::string_view> buffers, off_t offset
+) -> void {
+  size_t count = 0;
+  for (const auto& buffer : buffers) {
+    count += buffer.size();
+  }
+  auto* record = trace_->append(trace_op::pwrite, offset, count);
+  traced(record, [&] { file_->pwritev(buffers, offset); });
+}
+
+auto trace_file::seek(off_t offset) -> void {
+  auto* record = trace_->append(trace_op::seek, offset, 0);
+  traced(record, [&] { file_->seek(offset); });
+  offset_ = offset;
+}
+
+auto trace_file::sync() -> void {
+  auto* record = trace_->append(trace_op::sync, offset_, 0);
+  traced(record, [&] { file_->sync(); });
+}
+
+auto trace_file::map(off_t offset, size_t count, map_mode mode)
+    -> std::unique_ptr<view> {
+  const trace_op op =
+      (mode == map_mode::write) ? trace_op::map_write : trace_op::map_read;
+  auto* record = trace_->append(op, offset, count);
+  return traced(record, [&] { return file_->map(offset, count, mode); });
+}
+
+auto replay(
+    const std::vector<trace_record>& records, file& file, replay_timing timing
+) -> replay_result {
+  size_t largest = 0;
+  for (const auto& record : records) {
+    if (record.op == trace_op::read || record.op == trace_op::write ||
+        record.op == trace_op::pread || record.op == trace_op::pwrite) {
+      largest = std::max(largest, record.size);
+    }
+  }
+  std::string buffer(largest, 'r');
+
+  replay_result result;
+  const auto start = std::chrono::steady_clock::now();
+  const uint64_t first = records.empty() ? 0 : records.front().time;
+  for (const auto& record : records) {
+    if (timing == replay_timing::original) {
+      std::this_thread::sleep_until(
+          start + std::chrono::nanoseconds(record.time - first)
+      );
+    }
+
+    bool failed = false;
+    try {
+      switch (record.op) {
+        case trace_op::read:
+          file.read(buffer.data(), record.size);
+          break;
+        case trace_op::write:
+          file.write(buffer.data(), record.size);
+          break;
+        case trace_op::pread:
+          file.pread(buffer.data(), record.size, record.offset);
+          break;
+        case trace_op::pwrite:
+          file.pwrite(buffer.data(), record.size, record.offset);
+          break;
+        case trace_op::seek:
+          file.seek(record.offset);
+          break;
+        case trace_op::sync:
+          file.sync();
+          break;
+        case trace_op::map_read:
+        case trace_op::map_write: {
+          const map_mode mode = (record.op == trace_op::map_write)
+                                    ? map_mode::write
+                                    : map_mode::read;
+          (void)file.map(record.offset, record.size, mode);
+          break;
+        }
+      }
+    } catch (const file_exception&) {
+      failed = true;
+    }
+
+    result.ops += 1;
+    result.failed += failed ? 1 : 0;
+    result.mismatched += (failed != (record.failed != 0)) ? 1 : 0;
+  }
+  return result;
+}
+
+}  // namespace vt
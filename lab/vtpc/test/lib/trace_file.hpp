@@ -0,0 +1,69 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "file.hpp"
+#include "trace.hpp"
+
+namespace vt {
+
+/*
+ * Records every op on the file into a binary trace, which unlike log_file
+ * costs no more than a store into the mapped ring and can be replayed.
+ */
+class trace_file final : public file {
+public:
+  using file::read;
+  using file::write;
+
+  trace_file(std::unique_ptr<file> file, std::shared_ptr<trace> trace);
+  ~trace_file() override = default;
+
+  auto read(char* buffer, size_t count) -> void override;
+  auto write(const char* buffer, size_t count) -> void override;
+  auto pread(char* buffer, size_t count, off_t offset) -> void override;
+  auto pwrite(const char* buffer, size_t count, off_t offset) -> void override;
+  auto preadv(std::span<const std::span<char>> buffers, off_t offset)
+      -> void override;
+  auto pwritev(std::span<const std::string_view> buffers, off_t offset)
+      -> void override;
+  auto seek(off_t offset) -> void override;
+  auto sync() -> void override;
+  auto map(off_t offset, size_t count, map_mode mode)
+      -> std::unique_ptr<view> override;
+
+private:
+  std::unique_ptr<file> file_;
+  std::shared_ptr<trace> trace_;
+  off_t offset_ = 0;
+};
+
+enum class replay_timing {
+  fast,
+  original,
+};
+
+struct replay_result {
+  size_t ops = 0;
+  size_t failed = 0;
+
+  /* Ops that failed in the trace but not in the replay, or the other way. */
+  size_t mismatched = 0;
+};
+
+/*
+ * Feeds the records into the file, either back to back or keeping the time
+ * between them. Writes carry filler bytes, since a trace keeps no data, and
+ * mappings are released right away.
+ */
+auto replay(
+    const std::vector<trace_record>& records, file& file, replay_timing timing
+) -> replay_result;
+
+}  // namespace vt
@@ -0,0 +1,138 @@
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "exception.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+
+/* The allocator of glibc under the names it keeps for interposers. */
+auto __libc_malloc(size_t size) -> void*;                 // NOLINT
+auto __libc_calloc(size_t count, size_t size) -> void*;   // NOLINT
+auto __libc_realloc(void* pointer, size_t size) -> void*;  // NOLINT
+auto __libc_memalign(size_t alignment, size_t size) -> void*;  // NOLINT
+}
+
+namespace {
+
+std::atomic<size_t> allocations{0};
+
+void count_allocation() {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+/* Every allocation of the process, vtpc's threads included, is counted. */
+extern "C" auto malloc(size_t size) noexcept -> void* {
+  count_allocation();
+  return __libc_malloc(size);
+}
+
+extern "C" auto calloc(size_t count, size_t size) noexcept -> void* {
+  count_allocation();
+  return __libc_calloc(count, size);
+}
+
+extern "C" auto realloc(void* pointer, size_t size) noexcept -> void* {
+  count_allocation();
+  return __libc_realloc(pointer, size);
+}
+
+extern "C" auto aligned_alloc(size_t alignment, size_t size) noexcept
+    -> void* {
+  count_allocation();
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" auto posix_memalign(
+    void** pointer, size_t alignment, size_t size
+) noexcept -> int {
+  count_allocation();
+  *pointer = __libc_memalign(alignment, size);
+  return (*pointer == nullptr) ? ENOMEM : 0;
+}
+
+namespace {
+
+constexpr size_t seed = 1;
+constexpr size_t steps = (1U << 16U);
+constexpr size_t page = 4096;
+constexpr size_t capacity = 64;
+constexpr size_t size = 4 * capacity * page;
+
+/*
+ * Runs the operation mix of test_random over a file four times the size of
+ * the cache, so reads and writes keep missing and evicting dirty pages.
+ */
+void run(int fd, std::default_random_engine& random, std::string& buffer) {
+  std::uniform_int_distribution<size_t> action_dist(0, 100);  // NOLINT
+  std::uniform_int_distribution<off_t> offset_dist(0, size);
+  std::uniform_int_distribution<size_t> batch_dist(0, buffer.size());
+
+  for (size_t i = 0; i < steps; ++i) {
+    const size_t point = action_dist(random);
+    if (point < 40) {  // NOLINT
+      vtpc_read(fd, buffer.data(), batch_dist(random));
+    } else if (point < 75) {  // NOLINT
+      vtpc_write(fd, buffer.data(), batch_dist(random));
+    } else if (point < 95) {  // NOLINT
+      vtpc_lseek(fd, offset_dist(random), SEEK_SET);
+    } else {
+      vtpc_fsync(fd);
+    }
+  }
+}
+
+}  // namespace
+
+/*
+ * Once the cache is warm, misses, evictions and write-back must not touch
+ * the heap: the cache lives in its arena and the dirty sets have grown to
+ * their largest size.
+ */
+auto main() -> int try {
+  if (vtpc_set_capacity(capacity) == -1) {
+    throw vt::exception() << "failed to set the capacity";
+  }
+  const int fd =
+      vtpc_open("/tmp/vtpc_alloc", O_RDWR | O_CREAT | O_TRUNC, 0777);  // NOLINT
+  if (fd < 0) {
+    throw vt::exception() << "failed to open the file";
+  }
+
+  std::string buffer(4 * page, 'a');
+  std::default_random_engine random(seed);  // NOLINT
+
+  /* Fills the file and reads it back, which also starts readahead. */
+  for (size_t offset = 0; offset < size; offset += buffer.size()) {
+    vtpc_write(fd, buffer.data(), buffer.size());
+  }
+  vtpc_lseek(fd, 0, SEEK_SET);
+  while (vtpc_read(fd, buffer.data(), buffer.size()) > 0) {
+  }
+  run(fd, random, buffer);
+
+  const size_t before = allocations.load();
+  run(fd, random, buffer);
+  const size_t after = allocations.load();
+
+  vtpc_close(fd);
+  if (after != before) {
+    throw vt::exception() << after - before << " allocations in " << steps
+                          << " steps on a warm cache";
+  }
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,237 @@
+#include <sys/types.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "exception.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+/* Only vtpc sees this file, so it is kept apart from the compared ones. */
+constexpr const char* path = "/tmp/vtpc_checksum";
+constexpr const char* sidecar = "/tmp/vtpc_checksum.vtpc-crc";
+constexpr size_t page = 4096;
+constexpr size_t pages = 32;
+constexpr size_t corrupt = 5;
+constexpr size_t capacity = 16;
+constexpr size_t readers = 4;
+constexpr size_t rounds = 1000;
+constexpr size_t overwritten = 3;
+
+auto open_vtpc(int flags) -> int {
+  const int fd = vtpc_open(path, flags, 0777);  // NOLINT
+  if (fd < 0) {
+    throw vt::exception() << "failed to open " << path;
+  }
+  return fd;
+}
+
+auto close_vtpc(int fd) -> void {
+  if (vtpc_close(fd) == -1) {
+    throw vt::exception() << "failed to close " << path;
+  }
+}
+
+auto checksum_errors() -> uint64_t {
+  struct vtpc_stats stats = {};
+  vtpc_stats(&stats);
+  return stats.checksum_errors;
+}
+
+/* Every page holds its own letter. */
+auto contents(size_t index) -> std::string {
+  return std::string(page, static_cast<char>('a' + (index % 26)));
+}
+
+/* Reads a page, returning the result of vtpc_pread and leaving errno. */
+auto read_page(int fd, size_t index, std::string* data) -> ssize_t {
+  data->assign(page, ' ');
+  return vtpc_pread(fd, data->data(), page, static_cast<off_t>(index * page));
+}
+
+/*
+ * Flips a byte of a page behind the back of vtpc and puts the modification
+ * time back, as a disk that rots the data would leave the file.
+ */
+auto rot(size_t index) -> void {
+  const int fd = open(path, O_RDWR);  // NOLINT
+  struct stat st = {};
+  if (fd == -1 || fstat(fd, &st) == -1) {
+    throw vt::exception() << "failed to open " << path << " with libc";
+  }
+  const off_t offset = static_cast<off_t>((index * page) + 100);
+  char byte = 0;
+  const struct timespec times[2] = {
+      {.tv_sec = 0, .tv_nsec = UTIME_OMIT},
+      {.tv_sec = st.st_mtim.tv_sec, .tv_nsec = st.st_mtim.tv_nsec},
+  };
+  if (pread(fd, &byte, 1, offset) != 1) {
+    throw vt::exception() << "failed to read the byte to corrupt";
+  }
+  byte = static_cast<char>(byte ^ 1);
+  if (pwrite(fd, &byte, 1, offset) != 1 || futimens(fd, times) == -1) {
+    throw vt::exception() << "failed to corrupt page " << index;
+  }
+  close(fd);
+}
+
+/* Expects the page to read back as written. */
+auto expect_page(int fd, size_t index) -> void {
+  std::string data;
+  if (read_page(fd, index, &data) != static_cast<ssize_t>(page) ||
+      data != contents(index)) {
+    throw vt::exception() << "page " << index << " did not read back";
+  }
+}
+
+/* Expects reads of the page to fail with EIO. */
+auto expect_corrupt(int fd, size_t index) -> void {
+  const uint64_t before = checksum_errors();
+  std::string data;
+  if (read_page(fd, index, &data) != -1 || errno != EIO) {
+    throw vt::exception() << "reading page " << index << " did not fail";
+  }
+  /* A longer read stops short of the page if it got anything before it. */
+  std::string all(pages * page, ' ');
+  const ssize_t got = vtpc_pread(fd, all.data(), all.size(), 0);
+  if ((got == -1 && errno != EIO) ||
+      got > static_cast<ssize_t>(index * page)) {
+    throw vt::exception() << "reading the file went past page " << index;
+  }
+  if (checksum_errors() == before) {
+    throw vt::exception() << "the checksum errors were not counted";
+  }
+}
+
+/*
+ * Writes from the middle of the corrupted page over the pages after it,
+ * which fails on the corrupted one after the others are pinned to be
+ * overwritten whole.
+ */
+auto run_writer() -> void {
+  const int fd = open_vtpc(O_RDWR);
+  const std::string data((page / 2) + (overwritten * page), '!');
+  const off_t offset = static_cast<off_t>((corrupt * page) + (page / 2));
+  for (size_t i = 0; i < rounds; ++i) {
+    if (vtpc_pwrite(fd, data.data(), data.size(), offset) != -1 ||
+        errno != EIO) {
+      close_vtpc(fd);
+      throw vt::exception() << "writing over page " << corrupt << " worked";
+    }
+  }
+  close_vtpc(fd);
+}
+
+/* Reads every page but the corrupted one, which are never written. */
+auto run_reader(const std::atomic<bool>& done) -> void {
+  const int fd = open_vtpc(O_RDONLY);
+  while (!done.load()) {
+    for (size_t i = 0; i < pages; ++i) {
+      if (i != corrupt) {
+        expect_page(fd, i);
+      }
+    }
+  }
+  close_vtpc(fd);
+}
+
+/*
+ * Fails writes over the corrupted page again and again while other threads
+ * read the pages they would have overwritten, through a cache too small for
+ * the file, and checks that the reads still find what is on the disk.
+ */
+auto expect_failed_writes() -> void {
+  std::atomic<bool> done = false;
+  std::mutex mutex;
+  std::exception_ptr error;
+  const auto guard = [&](auto run) {
+    try {
+      run();
+    } catch (...) {
+      const std::lock_guard lock(mutex);
+      error = std::current_exception();
+    }
+    done.store(true);
+  };
+  {
+    std::vector<std::jthread> threads;
+    for (size_t i = 0; i < readers; ++i) {
+      threads.emplace_back([&] { guard([&] { run_reader(done); }); });
+    }
+    threads.emplace_back([&] { guard(run_writer); });
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+}  // namespace
+
+/*
+ * Writes a file with checksums, corrupts a page of it on disk and checks
+ * that reads of that page fail while the others still succeed, and so do
+ * writes that need it read, until the page is written over.
+ */
+auto main() -> int try {
+  if (vtpc_set_capacity(capacity) == -1 || vtpc_set_shards(1) == -1 ||
+      vtpc_set_checksums("crc32c") == -1) {
+    throw vt::exception() << "failed to set up the cache";
+  }
+  std::remove(sidecar);  // NOLINT(cert-err33-c)
+
+  int fd = open_vtpc(O_RDWR | O_CREAT | O_TRUNC);
+  for (size_t i = 0; i < pages; ++i) {
+    const std::string data = contents(i);
+    if (vtpc_write(fd, data.data(), data.size()) !=
+        static_cast<ssize_t>(page)) {
+      throw vt::exception() << "failed to write page " << i;
+    }
+  }
+  close_vtpc(fd);
+  rot(corrupt);
+
+  fd = open_vtpc(O_RDONLY);
+  expect_page(fd, corrupt - 1);
+  expect_corrupt(fd, corrupt);
+  expect_page(fd, corrupt + 1);
+  close_vtpc(fd);
+
+  /* A writable open trusts the same checksums, until the page is rewritten. */
+  expect_failed_writes();
+
+  fd = open_vtpc(O_RDWR);
+  expect_corrupt(fd, corrupt);
+  const std::string data = contents(corrupt);
+  if (vtpc_pwrite(fd, data.data(), page, corrupt * page) !=
+      static_cast<ssize_t>(page)) {
+    throw vt::exception() << "failed to rewrite page " << corrupt;
+  }
+  close_vtpc(fd);
+
+  fd = open_vtpc(O_RDONLY);
+  for (size_t i = 0; i < pages; ++i) {
+    expect_page(fd, i);
+  }
+  close_vtpc(fd);
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
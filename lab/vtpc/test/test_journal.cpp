@@ -0,0 +1,230 @@
+#include <sys/types.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cmp_file.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+/* Only vtpc sees this file, so it is kept apart from the compared ones. */
+constexpr const char* path = "/tmp/vtpc_journal";
+constexpr const char* journal = "/tmp/vtpc_journal.vtpc-journal";
+constexpr const char* reference = "/tmp/vtpc_journal_ref";
+constexpr size_t seed = 1;
+constexpr size_t page = 4096;
+constexpr size_t size = 64 * page;
+constexpr size_t capacity = 16;
+constexpr size_t rounds = 30;
+constexpr size_t steps = 2000;
+constexpr size_t max_delay_us = 50000;
+
+/* A write of data at an offset, or an fsync if sync is set. */
+struct step {
+  off_t offset = 0;
+  std::string data;
+  bool sync = false;
+};
+
+auto generate(size_t round) -> std::vector<step> {
+  std::default_random_engine random(seed + round);  // NOLINT
+  std::uniform_int_distribution<size_t> action_dist(0, 100);  // NOLINT
+  std::uniform_int_distribution<off_t> offset_dist(0, size);
+  std::uniform_int_distribution<size_t> batch_dist(1, 3 * page);
+
+  std::vector<step> steps(::steps);
+  for (size_t i = 0; i < steps.size(); ++i) {
+    auto& step = steps[i];
+    if (action_dist(random) < 5) {  // NOLINT
+      step.sync = true;
+      continue;
+    }
+    /* Steps close to each other write different bytes. */
+    step.offset = offset_dist(random);
+    step.data.assign(batch_dist(random), static_cast<char>('!' + (i % 90)));
+  }
+  return steps;
+}
+
+/* Returns the contents of the file after the first count steps. */
+auto expect(const std::vector<step>& steps, size_t count) -> std::string {
+  std::string contents;
+  for (size_t i = 0; i < count; ++i) {
+    const auto& step = steps[i];
+    if (step.sync) {
+      continue;
+    }
+    const size_t end = step.offset + step.data.size();
+    contents.resize(std::max(contents.size(), end), '\0');
+    std::ranges::copy(step.data, contents.begin() + step.offset);
+  }
+  return contents;
+}
+
+/*
+ * Runs the steps through vtpc with a small cache, so dirty pages are evicted
+ * in between, and reports each one done once it returns. Never closes the
+ * file: the parent kills it.
+ */
+[[noreturn]] void write_steps(
+    const std::vector<step>& steps, const char* mode, std::atomic<size_t>* done
+) {
+  if (vtpc_set_capacity(capacity) == -1 || vtpc_set_journal(mode) == -1) {
+    std::_Exit(2);
+  }
+  const int fd = vtpc_open(path, O_RDWR | O_CREAT, 0777);  // NOLINT
+  if (fd < 0) {
+    std::_Exit(2);
+  }
+  for (size_t i = 0; i < steps.size(); ++i) {
+    const auto& step = steps[i];
+    if (step.sync) {
+      vtpc_fsync(fd);
+    } else {
+      vtpc_lseek(fd, step.offset, SEEK_SET);
+      vtpc_write(fd, step.data.data(), step.data.size());
+    }
+    done->store(i + 1);
+  }
+  for (;;) {
+    pause();
+  }
+}
+
+/*
+ * Opens the file with vtpc, which replays its journal, and compares it with
+ * a reference holding the expected contents.
+ */
+auto matches(const std::string& contents) -> bool {
+  std::remove(reference);  // NOLINT(cert-err33-c)
+  vt::file::open_libc(reference)->write(contents);
+
+  vt::cmp_file file(vt::file::open_libc(reference), vt::file::open_vtpc(path));
+  try {
+    file.seek(0);
+    file.read(contents.size());
+  } catch (const vt::cmp_file_exception& e) {
+    return false;
+  }
+  /* Both have to end there; an error on one side only is a mismatch. */
+  try {
+    file.read(1);
+  } catch (const vt::cmp_file_exception& e) {
+    return false;
+  } catch (const vt::file_exception& e) {
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Checks the file in a process of its own, so the parent never starts vtpc
+ * and forks the writers with a clean cache. The step in flight when the
+ * writer was killed may or may not have made it.
+ */
+auto check(const std::vector<step>& steps, size_t done) -> bool {
+  const pid_t pid = fork();
+  if (pid == -1) {
+    throw vt::exception() << "failed to fork the checker";
+  }
+  if (pid == 0) {
+    try {
+      const bool ok = matches(expect(steps, done)) ||
+                      (done < steps.size() && matches(expect(steps, done + 1)));
+      std::_Exit(ok ? 0 : 1);
+    } catch (const std::exception& e) {
+      std::cerr << "exception: " << e.what() << '\n';
+      std::_Exit(1);
+    }
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+}  // namespace
+
+/*
+ * Kills a writer at random points and checks that every write it returned
+ * from is in the file once the journal has been replayed.
+ */
+auto main() -> int try {
+  void* shared = mmap(
+      nullptr,
+      sizeof(std::atomic<size_t>),
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_ANONYMOUS,
+      -1,
+      0
+  );
+  if (shared == MAP_FAILED) {
+    throw vt::exception() << "failed to map the progress counter";
+  }
+  auto* done = new (shared) std::atomic<size_t>(0);
+
+  std::default_random_engine random(seed);  // NOLINT
+  std::uniform_int_distribution<size_t> delay_dist(0, max_delay_us);
+  for (size_t round = 0; round < rounds; ++round) {
+    const char* mode = (round % 2 == 0) ? "append" : "sync";
+    const auto steps = generate(round);
+    std::remove(path);     // NOLINT(cert-err33-c)
+    std::remove(journal);  // NOLINT(cert-err33-c)
+    done->store(0);
+
+    const pid_t writer = fork();
+    if (writer == -1) {
+      throw vt::exception() << "failed to fork the writer";
+    }
+    if (writer == 0) {
+      write_steps(steps, mode, done);
+    }
+    /* The delay starts once the writer is past its setup. */
+    for (size_t i = 0; i < max_delay_us && done->load() == 0; ++i) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(delay_dist(random)));
+    kill(writer, SIGKILL);
+    int status = 0;
+    waitpid(writer, &status, 0);
+    if (WIFEXITED(status)) {
+      throw vt::exception() << "the writer failed to start";
+    }
+
+    const size_t written = done->load();
+    if (!check(steps, written)) {
+      throw vt::exception() << "round " << round << " in " << mode
+                            << " mode lost writes after " << written
+                            << " steps";
+    }
+    std::cerr << "round " << round << ": " << mode << ", killed after "
+              << written << " steps\n";
+  }
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,130 @@
+#include <sys/types.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "cmp_file.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+auto open_cmp() -> std::unique_ptr<vt::file> {
+  auto libc = vt::file::open_libc("/tmp/a");
+  auto vtpc = vt::file::open_vtpc("/tmp/b");
+  return std::make_unique<vt::cmp_file>(std::move(libc), std::move(vtpc));
+}
+
+auto expect(const std::string& expected, const std::string& actual) -> void {
+  if (expected != actual) {
+    throw vt::exception() << "'" << expected << "' != '" << actual << "'";
+  }
+}
+
+}  // namespace
+
+/* Pages borrowed through one descriptor keep only that one from closing. */
+auto test_close() -> void {
+  const int mapped = vtpc_open("/tmp/b", O_RDONLY, 0);
+  const int other = vtpc_open("/tmp/b", O_RDONLY, 0);
+  if (mapped == -1 || other == -1) {
+    throw vt::exception() << "failed to open /tmp/b";
+  }
+
+  void* page = nullptr;
+  if (vtpc_map(mapped, 0, 1, VTPC_MAP_READ, &page) != 1) {
+    throw vt::exception() << "failed to map a page";
+  }
+  if (vtpc_close(other) == -1) {
+    throw vt::exception() << "closing another descriptor failed";
+  }
+  if (vtpc_close(mapped) != -1 || errno != EBUSY) {
+    throw vt::exception() << "closed a descriptor with a page mapped";
+  }
+  if (vtpc_unmap(&page, 1, VTPC_MAP_READ) == -1 || vtpc_close(mapped) == -1) {
+    throw vt::exception() << "failed to close after unmapping";
+  }
+}
+
+auto main() -> int try {
+  constexpr size_t count = 4096;
+  constexpr size_t page = vt::view::page_size;
+
+  std::string text;
+  for (size_t i = 0; i < count; ++i) {
+    text += std::to_string(i) + ' ';
+  }
+
+  auto file = open_cmp();
+  file->seek(0);
+  file->write(text);
+
+  {
+    const auto view = file->map(0, text.size(), vt::map_mode::read);
+    expect(text, view->read(0, text.size()));
+  }
+
+  {
+    constexpr off_t offset = 5000;
+    constexpr size_t size = 10000;
+    const auto view = file->map(offset, size, vt::map_mode::read);
+    expect(text.substr(offset, size), view->read(offset % page, size));
+  }
+
+  {
+    constexpr off_t offset = static_cast<off_t>(1) << 40U;
+    const auto view = file->map(offset, page, vt::map_mode::read);
+    if (view->pages() != 0) {
+      throw vt::exception() << "mapped " << view->pages() << " pages past EOF";
+    }
+  }
+
+  {
+    constexpr off_t offset = 3 * page - 7;
+    const std::string patch(2 * page, 'x');
+    {
+      const auto view = file->map(offset, patch.size(), vt::map_mode::write);
+      view->write(offset % page, patch);
+    }
+    text.replace(offset, patch.size(), patch);
+    file->seek(0);
+    expect(text, file->read(text.size()));
+  }
+
+  {
+    const off_t offset = static_cast<off_t>(text.size()) + 100;
+    const std::string tail(3 * page, 'y');
+    {
+      const auto view = file->map(offset, tail.size(), vt::map_mode::write);
+      view->write(offset % page, tail);
+    }
+    file->seek(offset);
+    expect(tail, file->read(tail.size()));
+
+    file->seek(0);
+    text = file->read(offset + tail.size());
+  }
+
+  file->sync();
+  file = open_cmp();
+  file->seek(0);
+  expect(text, file->read(text.size()));
+
+  test_close();
+
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,148 @@
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cmp_file.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t files = 256;
+constexpr size_t steps = (1U << 14U);
+constexpr size_t size = (1U << 14U);
+
+auto open_cmp(const std::string& suffix) -> std::unique_ptr<vt::file> {
+  auto libc = vt::file::open_libc("/tmp/a" + suffix);
+  auto vtpc = vt::file::open_vtpc("/tmp/b" + suffix);
+  return std::make_unique<vt::cmp_file>(std::move(libc), std::move(vtpc));
+}
+
+auto usage_of(int fd) -> struct vtpc_usage {
+  struct vtpc_usage usage = {};
+  if (vtpc_usage(fd, &usage) == -1) {
+    throw vt::exception() << "failed to get the usage of fd " << fd;
+  }
+  return usage;
+}
+
+/* Works on many files at once, all of them sharing the cache. */
+auto test_many() -> void {
+  std::vector<std::unique_ptr<vt::file>> opened;
+  for (size_t i = 0; i < files; ++i) {
+    opened.push_back(open_cmp("." + std::to_string(i)));
+    opened.back()->seek(0);
+    opened.back()->write(std::string(size, static_cast<char>('a' + i % 26)));
+  }
+
+  std::default_random_engine random(1);  // NOLINT
+  std::uniform_int_distribution<size_t> file_dist(0, files - 1);
+  std::uniform_int_distribution<size_t> action_dist(0, 100);  // NOLINT
+  std::uniform_int_distribution<off_t> offset_dist(0, size);
+  std::uniform_int_distribution<size_t> batch_dist(0, size / 4);
+  std::uniform_int_distribution<uint8_t> char_dist(0);
+
+  for (size_t i = 0; i < steps; ++i) {
+    auto& file = opened[file_dist(random)];
+    const off_t offset = offset_dist(random);
+    const size_t batch =
+        std::min(batch_dist(random), size - static_cast<size_t>(offset));
+    file->seek(offset);
+    if (action_dist(random) < 50) {  // NOLINT
+      file->read(batch);
+    } else {
+      std::string text(batch, ' ');
+      for (char& c : text) {
+        c = static_cast<char>(char_dist(random));
+      }
+      file->write(text);
+    }
+  }
+
+  for (auto& file : opened) {
+    file->sync();
+    file = nullptr;
+  }
+  for (size_t i = 0; i < files; ++i) {
+    auto file = open_cmp("." + std::to_string(i));
+    file->seek(0);
+    file->read(size);
+  }
+}
+
+/* Two opens of the same file see each other's writes through the cache. */
+auto test_shared() -> void {
+  auto lhs = open_cmp("");
+  auto rhs = open_cmp("");
+
+  const std::string text(3 * size, 'x');
+  lhs->seek(0);
+  lhs->write(text);
+  rhs->seek(0);
+  rhs->read(text.size());
+
+  rhs->seek(size);
+  rhs->write(std::string(size, 'y'));
+  lhs->seek(0);
+  lhs->read(text.size());
+}
+
+/* Both descriptors of a file report the same usage of the cache. */
+auto test_usage() -> void {
+  const int lhs = vtpc_open("/tmp/b", O_RDWR | O_CREAT, 0777);  // NOLINT
+  const int rhs = vtpc_open("/tmp/b", O_RDONLY, 0);
+  const int other = vtpc_open("/tmp/b.0", O_RDONLY, 0);
+  if (lhs < 0 || rhs < 0 || other < 0 || lhs == rhs) {
+    throw vt::exception() << "failed to open files: " << lhs << ", " << rhs
+                          << ", " << other;
+  }
+
+  std::string buffer(size, ' ');
+  if (vtpc_read(rhs, buffer.data(), buffer.size()) < 0 ||
+      vtpc_read(other, buffer.data(), buffer.size()) < 0) {
+    throw vt::exception() << "failed to read";
+  }
+
+  const struct vtpc_usage lhs_usage = usage_of(lhs);
+  const struct vtpc_usage rhs_usage = usage_of(rhs);
+  if (lhs_usage.pages != rhs_usage.pages || lhs_usage.hits != rhs_usage.hits ||
+      lhs_usage.misses != rhs_usage.misses) {
+    throw vt::exception() << "shared usage differs: " << lhs_usage.pages
+                          << " != " << rhs_usage.pages << " pages";
+  }
+  if (lhs_usage.hits + lhs_usage.misses < size / 4096 ||
+      usage_of(other).hits + usage_of(other).misses < size / 4096) {
+    throw vt::exception() << "reads are missing from the usage";
+  }
+
+  vtpc_close(other);
+  vtpc_close(rhs);
+  vtpc_close(lhs);
+}
+
+}  // namespace
+
+auto main() -> int try {
+  test_many();
+  test_shared();
+  test_usage();
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
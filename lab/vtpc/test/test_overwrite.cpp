@@ -0,0 +1,139 @@
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "exception.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+/* Only vtpc sees these files, so they are kept apart from the compared ones. */
+constexpr const char* path = "/tmp/vtpc_overwrite";
+constexpr const char* other_path = "/tmp/vtpc_overwrite_other";
+constexpr size_t page = 4096;
+constexpr size_t capacity = 16;
+constexpr size_t other_pages = 2 * capacity;
+constexpr size_t pages = capacity / 2;
+constexpr size_t readers = 2;
+constexpr size_t rounds = 1000;
+
+auto open_vtpc(const char* name) -> int {
+  const int fd = vtpc_open(name, O_RDWR | O_CREAT | O_TRUNC, 0777);  // NOLINT
+  if (fd < 0) {
+    throw vt::exception() << "failed to open " << name;
+  }
+  return fd;
+}
+
+auto close_vtpc(int fd) -> void {
+  if (vtpc_close(fd) == -1) {
+    throw vt::exception() << "failed to close a file";
+  }
+}
+
+auto write_pages(int fd, char letter, size_t index, size_t count) -> void {
+  const std::string data(count * page, letter);
+  const off_t offset = static_cast<off_t>(index * page);
+  if (vtpc_pwrite(fd, data.data(), data.size(), offset) !=
+      static_cast<ssize_t>(data.size())) {
+    throw vt::exception() << "failed to write page " << index;
+  }
+}
+
+/*
+ * Overwrites the first pages of the file whole with one write, with the
+ * cache emptied of them in between by reading the other file, so that the
+ * write misses and pins them all before it copies the first one.
+ */
+auto run_writer(int fd, int other) -> void {
+  std::string data(page, ' ');
+  for (size_t i = 0; i < rounds; ++i) {
+    write_pages(fd, (i % 2 == 0) ? 'B' : 'A', 0, pages);
+    for (size_t j = 0; j < other_pages; ++j) {
+      const off_t offset = static_cast<off_t>(j * page);
+      if (vtpc_pread(other, data.data(), page, offset) !=
+              static_cast<ssize_t>(page) ||
+          data != std::string(page, 'Z')) {
+        throw vt::exception() << "page " << j << " of the other file is off";
+      }
+    }
+  }
+}
+
+/*
+ * Expects every read of the pages to find what the writes put there. A write
+ * that hits may still be copying, so a page can mix the two letters, but
+ * nothing else.
+ */
+auto run_reader(int fd, const std::atomic<bool>& done) -> void {
+  std::string data(pages * page, ' ');
+  while (!done.load()) {
+    if (vtpc_pread(fd, data.data(), data.size(), 0) !=
+        static_cast<ssize_t>(data.size())) {
+      throw vt::exception() << "failed to read the pages";
+    }
+    if (data.find_first_not_of("AB") != std::string::npos) {
+      throw vt::exception() << "read a page that was never written";
+    }
+  }
+}
+
+}  // namespace
+
+/*
+ * Reads pages while another thread overwrites them whole on misses, in a
+ * cache small enough that its frames keep changing files, and checks that
+ * no read sees a frame before the write has filled it.
+ */
+auto main() -> int try {
+  if (vtpc_set_capacity(capacity) == -1 || vtpc_set_shards(1) == -1) {
+    throw vt::exception() << "failed to set up the cache";
+  }
+
+  const int fd = open_vtpc(path);
+  const int other = open_vtpc(other_path);
+  write_pages(fd, 'A', 0, pages);
+  write_pages(other, 'Z', 0, other_pages);
+
+  std::atomic<bool> done = false;
+  std::mutex mutex;
+  std::exception_ptr error;
+  const auto guard = [&](auto run) {
+    try {
+      run();
+    } catch (...) {
+      const std::lock_guard lock(mutex);
+      error = std::current_exception();
+    }
+    done.store(true);
+  };
+  {
+    std::vector<std::jthread> threads;
+    for (size_t i = 0; i < readers; ++i) {
+      threads.emplace_back([&] { guard([&] { run_reader(fd, done); }); });
+    }
+    threads.emplace_back([&] { guard([&] { run_writer(fd, other); }); });
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  close_vtpc(other);
+  close_vtpc(fd);
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,112 @@
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "cmp_file.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+
+extern "C" {
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t seed = 1;
+constexpr size_t steps = (1U << 12U);
+constexpr size_t page = 4096;
+constexpr size_t capacity = 64;
+constexpr size_t size = 512 * page;
+constexpr size_t max_batch = 16 * page;
+constexpr size_t max_vectors = 8;
+
+}  // namespace
+
+/*
+ * Compares positional and vectored reads and writes with libc's on a file
+ * several times the size of the cache, with ranges long enough to span
+ * shards, so most calls pin stretches of hits and misses. Plain reads in
+ * between check that the positional ops leave the offset alone.
+ */
+auto main() -> int try {
+  if (vtpc_set_capacity(capacity) == -1) {
+    throw vt::exception() << "failed to set the capacity";
+  }
+  vt::cmp_file file(
+      vt::file::open_libc("/tmp/a"), vt::file::open_vtpc("/tmp/b")
+  );
+
+  std::default_random_engine random(seed);  // NOLINT
+  std::uniform_int_distribution<size_t> action_dist(0, 100);  // NOLINT
+  std::uniform_int_distribution<off_t> offset_dist(0, size);
+  std::uniform_int_distribution<size_t> batch_dist(0, max_batch);
+  std::uniform_int_distribution<size_t> vectors_dist(1, max_vectors);
+  std::uniform_int_distribution<size_t> vector_dist(0, 2 * page);
+  std::uniform_int_distribution<uint8_t> char_dist(0);
+
+  const auto random_string = [&](size_t size) {
+    std::string string(size, ' ');
+    for (char& c : string) {
+      c = static_cast<char>(char_dist(random));
+    }
+    return string;
+  };
+
+  const auto random_vectors = [&] {
+    std::vector<std::string> vectors(vectors_dist(random));
+    for (auto& vector : vectors) {
+      vector = random_string(vector_dist(random));
+    }
+    return vectors;
+  };
+
+  file.seek(0);
+  file.write(std::string(size / 2, ' '));
+  file.seek(0);
+
+  std::string buffer(max_batch, ' ');
+  for (size_t i = 0; i < steps; ++i) {
+    try {
+      const size_t point = action_dist(random);
+      if (point < 25) {  // NOLINT
+        file.pread(buffer.data(), batch_dist(random), offset_dist(random));
+      } else if (point < 45) {  // NOLINT
+        const std::string data = random_string(batch_dist(random));
+        file.pwrite(data.data(), data.size(), offset_dist(random));
+      } else if (point < 60) {  // NOLINT
+        auto vectors = random_vectors();
+        std::vector<std::span<char>> buffers(vectors.begin(), vectors.end());
+        file.preadv(buffers, offset_dist(random));
+      } else if (point < 75) {  // NOLINT
+        const auto vectors = random_vectors();
+        const std::vector<std::string_view> buffers(
+            vectors.begin(), vectors.end()
+        );
+        file.pwritev(buffers, offset_dist(random));
+      } else if (point < 85) {  // NOLINT
+        file.read(buffer.data(), batch_dist(random) / 4);
+      } else if (point < 95) {  // NOLINT
+        file.seek(offset_dist(random));
+      } else {
+        file.sync();
+      }
+    } catch (vt::file_exception& e) {  // NOLINT
+      // Reads past the end fail on both sides.
+    }
+  }
+
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
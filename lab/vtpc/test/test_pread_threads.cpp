@@ -0,0 +1,137 @@
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "cmp_file.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+
+extern "C" {
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t threads = 8;
+constexpr size_t steps = (1U << 11U);
+constexpr size_t page = 4096;
+constexpr size_t capacity = 128;
+constexpr size_t region = 64 * page;
+constexpr size_t shared = 4 * region;
+constexpr size_t size = shared + (threads * region);
+constexpr size_t max_batch = 8 * page;
+constexpr size_t max_vectors = 4;
+
+/*
+ * Reads anywhere in the shared part of the file, which nobody writes, and
+ * reads and writes within the region of the thread, so libc gives the same
+ * results regardless of the interleaving.
+ */
+auto run(vt::file& file, size_t index) -> void {
+  std::default_random_engine random(index);  // NOLINT
+  std::uniform_int_distribution<size_t> action_dist(0, 100);  // NOLINT
+  std::uniform_int_distribution<off_t> shared_dist(0, shared - max_batch);
+  std::uniform_int_distribution<off_t> region_dist(0, region - max_batch);
+  std::uniform_int_distribution<size_t> batch_dist(0, max_batch);
+  std::uniform_int_distribution<size_t> vectors_dist(1, max_vectors);
+  std::uniform_int_distribution<uint8_t> char_dist(0);
+
+  const auto random_string = [&](size_t size) {
+    std::string string(size, ' ');
+    for (char& c : string) {
+      c = static_cast<char>(char_dist(random));
+    }
+    return string;
+  };
+
+  const off_t begin = static_cast<off_t>(shared + (index * region));
+  std::string buffer(max_batch, ' ');
+  for (size_t i = 0; i < steps; ++i) {
+    const size_t point = action_dist(random);
+    const off_t own = begin + region_dist(random);
+    if (point < 30) {  // NOLINT
+      file.pread(buffer.data(), batch_dist(random), shared_dist(random));
+    } else if (point < 50) {  // NOLINT
+      file.pread(buffer.data(), batch_dist(random), own);
+    } else if (point < 75) {  // NOLINT
+      const std::string data = random_string(batch_dist(random));
+      file.pwrite(data.data(), data.size(), own);
+    } else if (point < 85) {  // NOLINT
+      std::vector<std::string> vectors(vectors_dist(random));
+      for (auto& vector : vectors) {
+        vector = random_string(max_batch / max_vectors);
+      }
+      std::vector<std::span<char>> buffers(vectors.begin(), vectors.end());
+      file.preadv(buffers, own);
+    } else {
+      std::vector<std::string> vectors(vectors_dist(random));
+      for (auto& vector : vectors) {
+        vector = random_string(max_batch / max_vectors);
+      }
+      const std::vector<std::string_view> buffers(
+          vectors.begin(), vectors.end()
+      );
+      file.pwritev(buffers, own);
+    }
+  }
+}
+
+}  // namespace
+
+/*
+ * Compares positional reads and writes with libc's from several threads
+ * sharing one descriptor of each file, on a file many times the size of the
+ * cache, so the threads miss on the same file at once.
+ */
+auto main() -> int try {
+  if (vtpc_set_capacity(capacity) == -1) {
+    throw vt::exception() << "failed to set the capacity";
+  }
+  vt::cmp_file file(
+      vt::file::open_libc("/tmp/a"), vt::file::open_vtpc("/tmp/b")
+  );
+
+  std::string text(size, ' ');
+  for (size_t i = 0; i < size; ++i) {
+    text[i] = static_cast<char>('a' + (i / page) % 26);
+  }
+  file.seek(0);
+  file.write(text);
+
+  std::mutex mutex;
+  std::exception_ptr error;
+  {
+    std::vector<std::jthread> workers;
+    for (size_t i = 0; i < threads; ++i) {
+      workers.emplace_back([&, i] {
+        try {
+          run(file, i);
+        } catch (...) {
+          const std::lock_guard lock(mutex);
+          error = std::current_exception();
+        }
+      });
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  file.seek(0);
+  file.read(size);
+
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -2,6 +2,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <exception>
 #include <iostream>
 #include <memory>
@@ -12,6 +13,8 @@
 #include "cmp_file.hpp"
 #include "file.hpp"
 #include "log_file.hpp"
+#include "trace.hpp"
+#include "trace_file.hpp"
 
 auto main() -> int try {
   constexpr size_t seed = 1;
@@ -19,10 +22,15 @@ auto main() -> int try {
   constexpr size_t size = (1U << 12U);
   constexpr size_t interval = 100;
 
-  std::unique_ptr<vt::file> file = [] {
+  std::unique_ptr<vt::file> file = []() -> std::unique_ptr<vt::file> {
     auto libc = vt::file::open_libc("/tmp/a");
     auto vtpc = vt::file::open_vtpc("/tmp/b");
     auto cmp = std::make_unique<vt::cmp_file>(std::move(libc), std::move(vtpc));
+    /* VT_TRACE records the run into a binary trace for vtpc_replay. */
+    if (const char* path = std::getenv("VT_TRACE")) {  // NOLINT
+      auto trace = vt::trace::create(path, 2 * steps);
+      return std::make_unique<vt::trace_file>(std::move(cmp), std::move(trace));
+    }
     auto log = std::make_unique<vt::log_file>(std::move(cmp));
     return log;
   }();
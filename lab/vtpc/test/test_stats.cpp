@@ -0,0 +1,155 @@
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "exception.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+/* Only vtpc sees this file, so it is kept apart from the compared ones. */
+constexpr const char* path = "/tmp/vtpc_stats";
+constexpr size_t page = 4096;
+constexpr size_t threads = 4;
+constexpr size_t pages = 64;
+constexpr size_t rounds = 3;
+constexpr size_t capacity = 2 * threads * pages;
+
+auto global_stats() -> struct vtpc_stats {
+  struct vtpc_stats stats = {};
+  vtpc_stats(&stats);
+  return stats;
+}
+
+auto file_stats(int fd) -> struct vtpc_stats {
+  struct vtpc_stats stats = {};
+  if (vtpc_file_stats(fd, &stats) == -1) {
+    throw vt::exception() << "failed to get the stats of fd " << fd;
+  }
+  return stats;
+}
+
+auto open_vtpc(const char* path, int flags) -> int {
+  const int fd = vtpc_open(path, flags, 0777);  // NOLINT
+  if (fd < 0) {
+    throw vt::exception() << "failed to open " << path;
+  }
+  return fd;
+}
+
+/*
+ * Threads read their own pages of a file a few times and exit, and the
+ * counters they leave behind add up to their accesses.
+ */
+auto test_threads() -> void {
+  const int fd = open_vtpc(path, O_RDWR | O_CREAT | O_TRUNC);
+  const std::string text(threads * pages * page, 's');
+  if (vtpc_write(fd, text.data(), text.size()) !=
+          static_cast<ssize_t>(text.size()) ||
+      vtpc_fsync(fd) == -1) {
+    throw vt::exception() << "failed to fill the file";
+  }
+
+  const struct vtpc_stats before = global_stats();
+  const struct vtpc_stats file_before = file_stats(fd);
+
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < threads; ++i) {
+    workers.emplace_back([i] {
+      const int own = vtpc_open(path, O_RDONLY, 0);
+      std::string buffer(page, ' ');
+      for (size_t round = 0; round < rounds; ++round) {
+        vtpc_lseek(own, static_cast<off_t>(i * pages * page), SEEK_SET);
+        for (size_t j = 0; j < pages; ++j) {
+          vtpc_read(own, buffer.data(), buffer.size());
+        }
+      }
+      vtpc_close(own);
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  const struct vtpc_stats after = global_stats();
+  const struct vtpc_stats file_after = file_stats(fd);
+  const uint64_t accesses = threads * pages * rounds;
+  const uint64_t global = (after.hits - before.hits) +
+                          (after.misses - before.misses);
+  const uint64_t local = (file_after.hits - file_before.hits) +
+                         (file_after.misses - file_before.misses);
+  if (global != accesses || local != accesses) {
+    throw vt::exception() << "expected " << accesses << " accesses, got "
+                          << global << " in total and " << local
+                          << " of the file";
+  }
+
+  const uint64_t misses = after.misses - before.misses;
+  const uint64_t timed = after.miss_latency.count - before.miss_latency.count;
+  if (timed != misses) {
+    throw vt::exception() << "timed " << timed << " of " << misses
+                          << " misses";
+  }
+  vtpc_close(fd);
+}
+
+/* Dirty pages are counted until fsync writes them and counts the bytes. */
+auto test_writes() -> void {
+  const int fd = open_vtpc(path, O_RDWR | O_CREAT | O_TRUNC);
+  const struct vtpc_stats before = file_stats(fd);
+
+  const std::string text(pages * page, 'w');
+  if (vtpc_write(fd, text.data(), text.size()) !=
+      static_cast<ssize_t>(text.size())) {
+    throw vt::exception() << "failed to write";
+  }
+  const struct vtpc_stats dirty = file_stats(fd);
+  if (dirty.dirty != pages || global_stats().dirty < pages) {
+    throw vt::exception() << "expected " << pages << " dirty pages, got "
+                          << dirty.dirty;
+  }
+
+  if (vtpc_fsync(fd) == -1) {
+    throw vt::exception() << "failed to sync";
+  }
+  const struct vtpc_stats after = file_stats(fd);
+  const uint64_t written = after.written - before.written;
+  const uint64_t bytes = after.written_bytes - before.written_bytes;
+  if (after.dirty != 0 || written != pages || bytes != pages * page) {
+    throw vt::exception() << "after fsync " << after.dirty << " pages are "
+                          << "dirty and " << written << " pages, " << bytes
+                          << " bytes were written";
+  }
+  if (after.flush_latency.count == before.flush_latency.count ||
+      after.flush_latency.count - before.flush_latency.count >
+          after.writes - before.writes) {
+    throw vt::exception() << "flushes are not timed once per batch";
+  }
+  vtpc_close(fd);
+}
+
+}  // namespace
+
+auto main() -> int try {
+  /* The counts below rely on all pages staying cached. */
+  if (vtpc_set_capacity(capacity) == -1) {
+    throw vt::exception() << "failed to set the capacity";
+  }
+  test_threads();
+  test_writes();
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,113 @@
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cmp_file.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+
+namespace {
+
+constexpr size_t threads = 4;
+constexpr size_t steps = (1U << 12U);
+constexpr size_t region = (1U << 20U);
+constexpr size_t size = threads * region;
+
+auto open_cmp() -> std::unique_ptr<vt::file> {
+  auto libc = vt::file::open_libc("/tmp/a");
+  auto vtpc = vt::file::open_vtpc("/tmp/b");
+  return std::make_unique<vt::cmp_file>(std::move(libc), std::move(vtpc));
+}
+
+/*
+ * Every thread opens the files on its own and works within its own region,
+ * so libc gives the same results regardless of the interleaving, while the
+ * threads still share the vtpc cache.
+ */
+auto run(size_t index) -> void {
+  auto file = open_cmp();
+
+  std::default_random_engine random(index);  // NOLINT
+
+  const off_t begin = static_cast<off_t>(index * region);
+  std::uniform_int_distribution<size_t> action_dist(0, 100);  // NOLINT
+  std::uniform_int_distribution<size_t> offset_dist(0, region);
+  std::uniform_int_distribution<size_t> batch_dist(0, region / 16);
+  std::uniform_int_distribution<uint8_t> char_dist(0);
+
+  const auto random_string = [&](size_t size) {
+    std::string string(size, ' ');
+    for (char& c : string) {
+      c = static_cast<char>(char_dist(random));
+    }
+    return string;
+  };
+
+  size_t offset = 0;
+  file->seek(begin);
+  for (size_t i = 0; i < steps; ++i) {
+    const size_t point = action_dist(random);
+    const size_t batch = std::min(batch_dist(random), region - offset);
+    if (point < 40) {  // NOLINT
+      file->read(batch);
+      offset += batch;
+    } else if (point < 75) {  // NOLINT
+      file->write(random_string(batch));
+      offset += batch;
+    } else if (point < 95) {  // NOLINT
+      offset = offset_dist(random);
+      file->seek(begin + static_cast<off_t>(offset));
+    } else {
+      file->sync();
+    }
+  }
+}
+
+}  // namespace
+
+auto main() -> int try {
+  {
+    auto file = open_cmp();
+    file->seek(0);
+    file->write(std::string(size, ' '));
+  }
+
+  std::mutex mutex;
+  std::exception_ptr error;
+  {
+    std::vector<std::jthread> workers;
+    for (size_t i = 0; i < threads; ++i) {
+      workers.emplace_back([&, i] {
+        try {
+          run(i);
+        } catch (...) {
+          const std::lock_guard lock(mutex);
+          error = std::current_exception();
+        }
+      });
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  auto file = open_cmp();
+  file->seek(0);
+  file->read(size);
+
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
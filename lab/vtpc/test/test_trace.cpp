@@ -0,0 +1,117 @@
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+
+#include "cmp_file.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+#include "trace.hpp"
+#include "trace_file.hpp"
+
+namespace {
+
+constexpr size_t steps = (1U << 12U);
+constexpr size_t size = (1U << 16U);
+const std::string path = "/tmp/vt.trace";
+
+auto open_cmp() -> std::unique_ptr<vt::file> {
+  auto libc = vt::file::open_libc("/tmp/a");
+  auto vtpc = vt::file::open_vtpc("/tmp/b");
+  return std::make_unique<vt::cmp_file>(std::move(libc), std::move(vtpc));
+}
+
+/* Records random ops, then replays the trace reopened from the disk. */
+auto test_record_replay() -> void {
+  {
+    auto trace = vt::trace::create(path, steps);
+    auto file = std::make_unique<vt::trace_file>(open_cmp(), std::move(trace));
+
+    std::default_random_engine random(1);  // NOLINT
+    std::uniform_int_distribution<size_t> action_dist(0, 100);  // NOLINT
+    std::uniform_int_distribution<off_t> offset_dist(0, size);
+    std::uniform_int_distribution<size_t> batch_dist(0, size / 16);
+
+    file->seek(0);
+    file->write(std::string(size, ' '));
+    for (size_t i = 2; i < steps; ++i) {
+      const size_t point = action_dist(random);
+      try {
+        if (point < 40) {  // NOLINT
+          file->read(batch_dist(random));
+        } else if (point < 75) {  // NOLINT
+          file->write(std::string(batch_dist(random), 'w'));
+        } else if (point < 90) {  // NOLINT
+          file->seek(offset_dist(random));
+        } else if (point < 95) {  // NOLINT
+          const off_t offset = offset_dist(random);
+          (void)file->map(offset, batch_dist(random), vt::map_mode::read);
+        } else {
+          file->sync();
+        }
+      } catch (const vt::file_exception&) {  // NOLINT
+        // Reads past the end fail the same way on both sides
+      }
+    }
+  }
+
+  const auto trace = vt::trace::open(path);
+  const auto records = trace->records();
+  if (records.size() != steps || trace->dropped() != 0) {
+    throw vt::exception() << "recorded " << records.size() << " ops, dropped "
+                          << trace->dropped() << ", expected " << steps;
+  }
+  for (size_t i = 1; i < records.size(); ++i) {
+    if (records[i].time < records[i - 1].time) {
+      throw vt::exception() << "record " << i << " goes back in time";
+    }
+  }
+
+  auto file = open_cmp();
+  const auto result = vt::replay(records, *file, vt::replay_timing::fast);
+  if (result.ops != steps || result.mismatched != 0) {
+    throw vt::exception() << "replayed " << result.ops << " ops with "
+                          << result.mismatched << " mismatched";
+  }
+}
+
+/* A full ring keeps the newest records. */
+auto test_wrap() -> void {
+  constexpr size_t capacity = 8;
+  constexpr size_t count = 20;
+
+  const auto trace = vt::trace::create(path, capacity);
+  for (size_t i = 0; i < count; ++i) {
+    trace->append(vt::trace_op::seek, static_cast<off_t>(i), 0);
+  }
+
+  const auto records = trace->records();
+  if (records.size() != capacity || trace->dropped() != count - capacity) {
+    throw vt::exception() << "kept " << records.size() << " records, dropped "
+                          << trace->dropped();
+  }
+  for (size_t i = 0; i < capacity; ++i) {
+    const auto expected = static_cast<int64_t>(count - capacity + i);
+    if (records[i].offset != expected) {
+      throw vt::exception() << "record " << i << " has offset "
+                            << records[i].offset << " != " << expected;
+    }
+  }
+}
+
+}  // namespace
+
+auto main() -> int try {
+  test_record_replay();
+  test_wrap();
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
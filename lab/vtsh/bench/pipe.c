@@ -0,0 +1,171 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "units.h"
+#include "vtsh.h"
+
+#define BENCH_SIZE (4UL << 30U)
+#define BENCH_ROUNDS 3
+#define BENCH_LINE 4096
+#define BENCH_NS_PER_S 1000000000.0
+#define BENCH_BYTES_PER_GB 1000000000.0
+
+static const char* const usage =
+    "usage: vtsh_pipe_bench [options]\n"
+    "  -s, --size SIZE    size of the stream, with an optional K, M or G,\n"
+    "                     4G by default\n"
+    "  -f, --file FILE    stream an existing file instead of a sparse one\n"
+    "  -r, --rounds N     rounds per pipeline, the best is reported, 3 by\n"
+    "                     default\n"
+    "\n"
+    "Runs pipelines that stream a file through vtsh with cat and with the\n"
+    "relay builtin, which moves the data with splice, and reports the\n"
+    "throughput of each. The holes of a sparse file may be served from a\n"
+    "shared zero page, so -f with a real file gives the more honest\n"
+    "numbers for relay.\n";
+
+/* The pipelines, with %1$s for the file. */
+static const char* const pipelines[] = {
+    "cat %1$s | cat > /dev/null",
+    "relay %1$s | cat > /dev/null",
+    "cat %1$s | relay > /dev/null",
+    "relay %1$s | relay > /dev/null",
+    "relay %1$s | relay | relay > /dev/null",
+    "cat %1$s | wc -c > /dev/null",
+    "relay %1$s | wc -c > /dev/null",
+};
+
+struct bench_options {
+  size_t size;
+  const char* file;
+  size_t rounds;
+};
+
+static int bench_parse(int argc, char** argv, struct bench_options* options) {
+  static const struct option long_options[] = {
+      {"size", required_argument, NULL, 's'},
+      {"file", required_argument, NULL, 'f'},
+      {"rounds", required_argument, NULL, 'r'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0},
+  };
+
+  *options = (struct bench_options){
+      .size = BENCH_SIZE,
+      .rounds = BENCH_ROUNDS,
+  };
+  int option = 0;
+  while ((option = getopt_long(argc, argv, "s:f:r:h", long_options, NULL)) !=
+         -1) {
+    switch (option) {
+      case 's':
+        if (vtsh_parse_size(optarg, &options->size) == -1 ||
+            options->size == 0) {
+          fprintf(stderr, "bad size %s\n", optarg);
+          return -1;
+        }
+        break;
+      case 'f':
+        options->file = optarg;
+        break;
+      case 'r':
+        if (vtsh_parse_size(optarg, &options->rounds) == -1 ||
+            options->rounds == 0) {
+          fprintf(stderr, "bad round count %s\n", optarg);
+          return -1;
+        }
+        break;
+      default:
+        fputs(usage, stderr);
+        return -1;
+    }
+  }
+  return 0;
+}
+
+/* Makes a sparse file of the given size, which reads as zeros. */
+static int bench_file(char* path, size_t size) {
+  const int fd = mkstemp(path);
+  if (fd == -1) {
+    return -1;
+  }
+  const int status = ftruncate(fd, (off_t)size);
+  close(fd);
+  return status;
+}
+
+int main(int argc, char** argv) {
+  struct bench_options options;
+  if (bench_parse(argc, argv, &options) == -1) {
+    return EXIT_FAILURE;
+  }
+
+  char sparse[] = "/tmp/vtsh_pipe_bench.XXXXXX";
+  const char* file = options.file;
+  if (file == NULL) {
+    if (bench_file(sparse, options.size) == -1) {
+      fprintf(stderr, "%s: %s\n", sparse, strerror(errno));
+      return EXIT_FAILURE;
+    }
+    file = sparse;
+  } else {
+    const int fd = open(file, O_RDONLY | O_CLOEXEC);
+    const off_t size = (fd != -1) ? lseek(fd, 0, SEEK_END) : -1;
+    if (fd != -1) {
+      close(fd);
+    }
+    if (size == -1) {
+      fprintf(stderr, "%s: %s\n", file, strerror(errno));
+      return EXIT_FAILURE;
+    }
+    options.size = (size_t)size;
+  }
+
+  struct vtsh shell;
+  if (vtsh_init(&shell, false) == -1) {
+    perror("VTSH_LAUNCHER");
+    return EXIT_FAILURE;
+  }
+
+  printf("%-44s %10s %10s\n", "pipeline", "seconds", "GB/s");
+  int status = EXIT_SUCCESS;
+  char line[BENCH_LINE];
+  char label[BENCH_LINE];
+  for (size_t i = 0; i < sizeof(pipelines) / sizeof(pipelines[0]); ++i) {
+    snprintf(label, sizeof(label), pipelines[i], "FILE");
+    uint64_t best = UINT64_MAX;
+    for (size_t round = 0; round < options.rounds; ++round) {
+      snprintf(line, sizeof(line), pipelines[i], file);
+      const uint64_t start = vtsh_now();
+      if (vtsh_run(&shell, line) != 0) {
+        status = EXIT_FAILURE;
+      }
+      const uint64_t elapsed = vtsh_now() - start;
+      if (elapsed < best) {
+        best = elapsed;
+      }
+    }
+    const double seconds = (double)best / BENCH_NS_PER_S;
+    printf(
+        "%-44s %10.3f %10.2f\n",
+        label,
+        seconds,
+        (double)options.size / BENCH_BYTES_PER_GB / seconds
+    );
+    fflush(stdout);
+  }
+
+  vtsh_destroy(&shell);
+  if (file == sparse) {
+    unlink(sparse);
+  }
+  return status;
+}
@@ -0,0 +1,242 @@
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "launch.h"
+#include "units.h"
+
+#define BENCH_SPAWNS 2000
+#define BENCH_WARMUP 20
+#define BENCH_HEAP (1UL << 30U)
+#define BENCH_PAGE 4096
+#define BENCH_NS_PER_US 1000.0
+#define BENCH_NS_PER_S 1000000000.0
+
+static const char* const usage =
+    "usage: vtsh_spawn_bench [options] [program [args...]]\n"
+    "  -n, --spawns N        spawns per launcher and parent, 2000 by default\n"
+    "  -l, --launchers LIST  comma-separated fork, vfork, clone, clone3 and\n"
+    "                        posix_spawn, all of them by default\n"
+    "  -H, --heap SIZE       resident heap of the large parent, with an\n"
+    "                        optional K, M or G, 1G by default\n"
+    "\n"
+    "Starts the program, /bin/true by default, and waits for it over and\n"
+    "over with each launcher, first from a small parent and then from one\n"
+    "with a large resident heap, and reports spawns per second along with\n"
+    "the latency of the launch alone and of the whole round trip.\n";
+
+struct bench_options {
+  size_t spawns;
+  bool launchers[VTSH_LAUNCHERS];
+  size_t heap;
+  char* const* argv;
+};
+
+/* The latencies of one launcher from one parent, in nanoseconds. */
+struct bench_result {
+  uint64_t* launch;
+  uint64_t* round_trip;
+  uint64_t total;
+};
+
+static int bench_compare(const void* lhs, const void* rhs) {
+  const uint64_t left = *(const uint64_t*)lhs;
+  const uint64_t right = *(const uint64_t*)rhs;
+  return (left > right) - (left < right);
+}
+
+/* Returns the latency of the given rank in microseconds, sorting them. */
+static double bench_percentile(uint64_t* values, size_t count, double rank) {
+  qsort(values, count, sizeof(uint64_t), bench_compare);
+  size_t index = (size_t)((double)count * rank / 100.0);
+  if (index >= count) {
+    index = count - 1;
+  }
+  return (double)values[index] / BENCH_NS_PER_US;
+}
+
+static int bench_launchers(char* list, bool* launchers) {
+  memset(launchers, 0, VTSH_LAUNCHERS * sizeof(bool));
+  char* state = NULL;
+  for (char* name = strtok_r(list, ",", &state); name != NULL;
+       name = strtok_r(NULL, ",", &state)) {
+    const int launcher = vtsh_launcher_find(name);
+    if (launcher == -1) {
+      fprintf(stderr, "unknown launcher %s\n", name);
+      return -1;
+    }
+    launchers[launcher] = true;
+  }
+  return 0;
+}
+
+static int bench_parse(int argc, char** argv, struct bench_options* options) {
+  static char default_program[] = "/bin/true";
+  static char* default_argv[] = {default_program, NULL};
+  static const struct option long_options[] = {
+      {"spawns", required_argument, NULL, 'n'},
+      {"launchers", required_argument, NULL, 'l'},
+      {"heap", required_argument, NULL, 'H'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0},
+  };
+
+  *options = (struct bench_options){
+      .spawns = BENCH_SPAWNS,
+      .heap = BENCH_HEAP,
+      .argv = default_argv,
+  };
+  for (size_t i = 0; i < VTSH_LAUNCHERS; ++i) {
+    options->launchers[i] = true;
+  }
+
+  int option = 0;
+  while ((option = getopt_long(argc, argv, "+n:l:H:h", long_options, NULL)) !=
+         -1) {
+    switch (option) {
+      case 'n':
+        if (vtsh_parse_size(optarg, &options->spawns) == -1 ||
+            options->spawns == 0) {
+          fprintf(stderr, "bad spawn count %s\n", optarg);
+          return -1;
+        }
+        break;
+      case 'l':
+        if (bench_launchers(optarg, options->launchers) == -1) {
+          return -1;
+        }
+        break;
+      case 'H':
+        if (vtsh_parse_size(optarg, &options->heap) == -1) {
+          fprintf(stderr, "bad heap size %s\n", optarg);
+          return -1;
+        }
+        break;
+      default:
+        fputs(usage, stderr);
+        return -1;
+    }
+  }
+  if (optind < argc) {
+    options->argv = argv + optind;
+  }
+  return 0;
+}
+
+static int bench_run(
+    const struct bench_options* options,
+    enum vtsh_launcher launcher,
+    struct bench_result* result
+) {
+  const char* path = options->argv[0];
+  for (size_t i = 0; i < BENCH_WARMUP + options->spawns; ++i) {
+    const uint64_t start = vtsh_now();
+    const pid_t pid = vtsh_launch(launcher, path, options->argv, environ, NULL);
+    const uint64_t launched = vtsh_now();
+    if (pid == -1) {
+      fprintf(stderr, "%s: %s\n", path, strerror(errno));
+      return -1;
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {
+    }
+    const uint64_t done = vtsh_now();
+
+    if (i >= BENCH_WARMUP) {
+      result->launch[i - BENCH_WARMUP] = launched - start;
+      result->round_trip[i - BENCH_WARMUP] = done - start;
+      result->total += done - start;
+    }
+  }
+  return 0;
+}
+
+static void bench_report(
+    const char* parent,
+    enum vtsh_launcher launcher,
+    struct bench_result* result,
+    size_t spawns
+) {
+  printf(
+      "%-6s %-12s %10.0f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+      parent,
+      vtsh_launcher_name(launcher),
+      (double)spawns * BENCH_NS_PER_S / (double)result->total,
+      bench_percentile(result->launch, spawns, 50),
+      bench_percentile(result->launch, spawns, 99),
+      bench_percentile(result->launch, spawns, 100),
+      bench_percentile(result->round_trip, spawns, 50),
+      bench_percentile(result->round_trip, spawns, 99)
+  );
+  fflush(stdout);
+}
+
+/* Runs every chosen launcher from the current parent. */
+static int bench_parent(
+    const struct bench_options* options,
+    const char* parent,
+    struct bench_result* result
+) {
+  for (size_t i = 0; i < VTSH_LAUNCHERS; ++i) {
+    if (!options->launchers[i]) {
+      continue;
+    }
+    result->total = 0;
+    if (bench_run(options, (enum vtsh_launcher)i, result) == -1) {
+      return -1;
+    }
+    bench_report(parent, (enum vtsh_launcher)i, result, options->spawns);
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  struct bench_options options;
+  if (bench_parse(argc, argv, &options) == -1) {
+    return EXIT_FAILURE;
+  }
+
+  struct bench_result result = {
+      .launch = calloc(options.spawns, sizeof(uint64_t)),
+      .round_trip = calloc(options.spawns, sizeof(uint64_t)),
+  };
+  if (result.launch == NULL || result.round_trip == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return EXIT_FAILURE;
+  }
+
+  printf(
+      "%-6s %-12s %10s %10s %10s %10s %10s %10s\n",
+      "parent",
+      "launcher",
+      "spawns/s",
+      "launch p50",
+      "p99 us",
+      "max us",
+      "trip p50",
+      "p99 us"
+  );
+  int status = bench_parent(&options, "small", &result);
+
+  /* Every page of the heap is touched, so fork has to copy its mappings. */
+  char* heap = (status == 0 && options.heap != 0) ? malloc(options.heap) : NULL;
+  if (heap != NULL) {
+    for (size_t i = 0; i < options.heap; i += BENCH_PAGE) {
+      heap[i] = (char)i;
+    }
+    status = bench_parent(&options, "large", &result);
+  }
+
+  free(heap);
+  free(result.launch);
+  free(result.round_trip);
+  return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
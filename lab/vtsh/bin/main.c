@@ -1,7 +1,101 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
 #include <vtsh.h>
 
-int main() {
-  printf("%s", vtsh_prompt());
-  printf("Hello, world!\n");
+#define VTSH_NS_PER_S 1000000000.0
+
+static const char* const usage =
+    "usage: vtsh [-t] [script]\n"
+    "  -t  report the commands run per second on exit\n"
+    "\n"
+    "Runs the commands of the script, or of the standard input with a\n"
+    "prompt if there is no script.\n";
+
+static double vtsh_seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + ((double)now.tv_nsec / VTSH_NS_PER_S);
+}
+
+/*
+ * Reads the next line of the script, which the commands do not read from, so
+ * it is buffered; the standard input is read with vtsh_read_line instead,
+ * once the background jobs that finish in the meantime are reaped.
+ */
+static ssize_t vtsh_next(
+    struct vtsh* shell, FILE* script, char** line, size_t* capacity
+) {
+  if (script == NULL) {
+    printf("%s", vtsh_prompt());
+    fflush(stdout);
+    vtsh_wait_input(shell, STDIN_FILENO);
+    return vtsh_read_line(STDIN_FILENO, line, capacity);
+  }
+  vtsh_wait_input(shell, -1);
+  ssize_t length = getline(line, capacity, script);
+  if (length > 0 && (*line)[length - 1] == '\n') {
+    (*line)[--length] = '\0';
+  }
+  return length;
+}
+
+int main(int argc, char** argv) {
+  bool throughput = false;
+  int option = 0;
+  while ((option = getopt(argc, argv, "th")) != -1) {
+    if (option != 't') {
+      fputs(usage, stderr);
+      return EXIT_FAILURE;
+    }
+    throughput = true;
+  }
+  FILE* script = NULL;
+  if (optind < argc) {
+    script = fopen(argv[optind], "re");
+    if (script == NULL) {
+      fprintf(stderr, "vtsh: %s: %s\n", argv[optind], strerror(errno));
+      return EXIT_FAILURE;
+    }
+  }
+
+  struct vtsh shell;
+  if (vtsh_init(&shell, script == NULL) == -1) {
+    perror("vtsh: VTSH_LAUNCHER");
+    return EXIT_FAILURE;
+  }
+
+  char* line = NULL;
+  size_t capacity = 0;
+  uint64_t commands = 0;
+  const double start = vtsh_seconds();
+  while (!shell.done && vtsh_next(&shell, script, &line, &capacity) != -1) {
+    vtsh_run(&shell, line);
+    commands += 1;
+  }
+  fflush(stdout);
+  if (throughput) {
+    const double elapsed = vtsh_seconds() - start;
+    fprintf(
+        stderr,
+        "vtsh: %llu commands in %.3f s, %.0f commands/s\n",
+        (unsigned long long)commands,
+        elapsed,
+        (elapsed > 0) ? (double)commands / elapsed : 0.0
+    );
+  }
+
+  free(line);
+  vtsh_destroy(&shell);
+  if (script != NULL) {
+    fclose(script);
+  }
+  return shell.done ? shell.status : EXIT_SUCCESS;
 }
@@ -0,0 +1,170 @@
+#include "builtin.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "relay.h"
+#include "vtsh.h"
+
+#define VTSH_DECIMAL 10
+#define VTSH_STATUS_RANGE 256U
+#define VTSH_STATUS_USAGE 2
+
+struct vtsh_builtin_entry {
+  const char* name;
+  vtsh_builtin run;
+};
+
+/* Prints its arguments, and a newline unless the first one is -n. */
+static int vtsh_builtin_echo(struct vtsh* shell, size_t argc, char** argv) {
+  (void)shell;
+  size_t first = 1;
+  bool newline = true;
+  if (argc > 1 && strcmp(argv[1], "-n") == 0) {
+    first = 2;
+    newline = false;
+  }
+  for (size_t i = first; i < argc; ++i) {
+    if (i > first) {
+      putchar(' ');
+    }
+    fputs(argv[i], stdout);
+  }
+  if (newline) {
+    putchar('\n');
+  }
+  return (ferror(stdout) != 0) ? 1 : 0;
+}
+
+/* Changes the directory of the shell, to HOME if none is given. */
+static int vtsh_builtin_cd(struct vtsh* shell, size_t argc, char** argv) {
+  (void)shell;
+  if (argc > 2) {
+    fprintf(stderr, "cd: too many arguments\n");
+    return 1;
+  }
+  const char* dir = argv[1];
+  if (argc == 1) {
+    dir = getenv("HOME");  // NOLINT(concurrency-mt-unsafe)
+  }
+  if (dir == NULL) {
+    fprintf(stderr, "cd: HOME not set\n");
+    return 1;
+  }
+  if (chdir(dir) == -1) {
+    fprintf(stderr, "cd: %s: %s\n", dir, strerror(errno));
+    return 1;
+  }
+  return 0;
+}
+
+static int vtsh_builtin_true(struct vtsh* shell, size_t argc, char** argv) {
+  (void)shell;
+  (void)argc;
+  (void)argv;
+  return 0;
+}
+
+static int vtsh_builtin_false(struct vtsh* shell, size_t argc, char** argv) {
+  (void)shell;
+  (void)argc;
+  (void)argv;
+  return 1;
+}
+
+/* Stops the shell with the given status, or with that of the last command. */
+static int vtsh_builtin_exit(struct vtsh* shell, size_t argc, char** argv) {
+  int status = shell->status;
+  if (argc > 1) {
+    char* end = NULL;
+    const long value = strtol(argv[1], &end, VTSH_DECIMAL);
+    if (end == argv[1] || *end != '\0') {
+      fprintf(stderr, "exit: %s: numeric argument required\n", argv[1]);
+      status = VTSH_STATUS_USAGE;
+    } else {
+      status = (int)((unsigned long)value % VTSH_STATUS_RANGE);
+    }
+  }
+  shell->done = true;
+  return status;
+}
+
+/*
+ * Copies the files, or the standard input if there are none, to the standard
+ * output, and to the file after -t as well, with vtsh_relay, so that a
+ * pipeline like relay big | tool > out moves the data without copying it.
+ */
+static int vtsh_builtin_relay(struct vtsh* shell, size_t argc, char** argv) {
+  (void)shell;
+  size_t first = 1;
+  int copy = -1;
+  if (argc > 1 && strcmp(argv[1], "-t") == 0) {
+    if (argc == 2) {
+      fprintf(stderr, "relay: -t needs a file\n");
+      return VTSH_STATUS_USAGE;
+    }
+    copy = open(
+        argv[2], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, VTSH_FILE_MODE
+    );
+    if (copy == -1) {
+      fprintf(stderr, "relay: %s: %s\n", argv[2], strerror(errno));
+      return 1;
+    }
+    first = 3;
+  }
+
+  /* The data goes straight to the descriptor, after what stdio holds. */
+  fflush(stdout);
+  int status = 0;
+  if (first == argc && vtsh_relay(STDIN_FILENO, STDOUT_FILENO, copy) == -1) {
+    fprintf(stderr, "relay: %s\n", strerror(errno));
+    status = 1;
+  }
+  for (size_t i = first; i < argc; ++i) {
+    const int in = open(argv[i], O_RDONLY | O_CLOEXEC);
+    if (in == -1 || vtsh_relay(in, STDOUT_FILENO, copy) == -1) {
+      fprintf(stderr, "relay: %s: %s\n", argv[i], strerror(errno));
+      status = 1;
+    }
+    if (in != -1) {
+      close(in);
+    }
+  }
+  if (copy != -1) {
+    close(copy);
+  }
+  return status;
+}
+
+/* Waits for every background job to finish. */
+static int vtsh_builtin_wait(struct vtsh* shell, size_t argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  vtsh_wait_jobs(shell);
+  return 0;
+}
+
+static const struct vtsh_builtin_entry builtins[] = {
+    {"echo", vtsh_builtin_echo},
+    {"cd", vtsh_builtin_cd},
+    {"true", vtsh_builtin_true},
+    {"false", vtsh_builtin_false},
+    {"exit", vtsh_builtin_exit},
+    {"relay", vtsh_builtin_relay},
+    {"wait", vtsh_builtin_wait},
+};
+
+vtsh_builtin vtsh_builtin_find(const char* name) {
+  for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); ++i) {
+    if (strcmp(name, builtins[i].name) == 0) {
+      return builtins[i].run;
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stddef.h>
+
+struct vtsh;
+
+/*
+ * A command the shell runs itself rather than starting a program for it.
+ * Returns the exit status of the command.
+ */
+typedef int (*vtsh_builtin)(struct vtsh* shell, size_t argc, char** argv);
+
+/* Returns the builtin with the given name, or NULL if there is none. */
+vtsh_builtin vtsh_builtin_find(const char* name);
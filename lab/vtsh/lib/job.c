@@ -0,0 +1,212 @@
+#include "job.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/pidfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "parse.h"
+#include "profile.h"
+
+#define VTSH_JOBS_MIN 16
+#define VTSH_EVENTS 64
+#define VTSH_STATUS_SIGNALED 128
+
+int vtsh_jobs_init(struct vtsh_jobs* jobs) {
+  *jobs = (struct vtsh_jobs){
+      .epoll = epoll_create1(EPOLL_CLOEXEC),
+      .input = -1,
+  };
+  return (jobs->epoll == -1) ? -1 : 0;
+}
+
+/* Forgets a job without waiting for it, leaving its processes to init. */
+static void vtsh_jobs_free(struct vtsh_job* job) {
+  for (size_t i = 0; i < job->count; ++i) {
+    if (job->processes[i].pidfd != -1) {
+      close(job->processes[i].pidfd);
+    }
+  }
+  if (job->profile != NULL) {
+    vtsh_profile_cancel(job->profile);
+    free(job->profile);
+  }
+  free(job->processes);
+  vtsh_line_release(job->line);
+  free(job);
+}
+
+void vtsh_jobs_destroy(struct vtsh_jobs* jobs) {
+  for (size_t i = 0; i < jobs->capacity; ++i) {
+    if (jobs->table[i] != NULL) {
+      vtsh_jobs_free(jobs->table[i]);
+    }
+  }
+  free(jobs->table);
+  if (jobs->epoll != -1) {
+    close(jobs->epoll);
+  }
+  *jobs = (struct vtsh_jobs){.epoll = -1, .input = -1};
+}
+
+int vtsh_jobs_add(struct vtsh_jobs* jobs, struct vtsh_job* job) {
+  size_t slot = 0;
+  while (slot < jobs->capacity && jobs->table[slot] != NULL) {
+    slot += 1;
+  }
+  if (slot == jobs->capacity) {
+    const size_t capacity =
+        (jobs->capacity == 0) ? VTSH_JOBS_MIN : 2 * jobs->capacity;
+    struct vtsh_job** table =
+        realloc(jobs->table, capacity * sizeof(struct vtsh_job*));
+    if (table == NULL) {
+      errno = ENOMEM;
+      return -1;
+    }
+    for (size_t i = jobs->capacity; i < capacity; ++i) {
+      table[i] = NULL;
+    }
+    jobs->table = table;
+    jobs->capacity = capacity;
+  }
+  jobs->table[slot] = job;
+  jobs->count += 1;
+  job->id = slot + 1;
+  return 0;
+}
+
+void vtsh_jobs_remove(struct vtsh_jobs* jobs, struct vtsh_job* job) {
+  jobs->table[job->id - 1] = NULL;
+  jobs->count -= 1;
+  vtsh_jobs_free(job);
+}
+
+/* Records the exit of a process, queueing its job once none is left. */
+static void vtsh_jobs_exit(
+    struct vtsh_jobs* jobs, struct vtsh_process* process, int status
+) {
+  process->status = status;
+  struct vtsh_job* job = process->job;
+  job->running -= 1;
+  if (job->running == 0) {
+    job->finished = jobs->finished;
+    jobs->finished = job;
+  }
+}
+
+static int vtsh_jobs_status(const siginfo_t* info) {
+  if (info->si_code == CLD_KILLED || info->si_code == CLD_DUMPED) {
+    return VTSH_STATUS_SIGNALED + info->si_status;
+  }
+  return info->si_status;
+}
+
+/*
+ * Reaps a process that exited, or waits for it to, with the rusage that
+ * only the system call gives when its job is timed.
+ */
+static void vtsh_jobs_collect(
+    struct vtsh_jobs* jobs,
+    struct vtsh_process* process,
+    idtype_t type,
+    id_t id
+) {
+  struct vtsh_profile* profile = process->job->profile;
+  siginfo_t info = {0};
+  struct rusage usage = {0};
+  struct rusage* wanted = (profile != NULL) ? &usage : NULL;
+  while (syscall(SYS_waitid, type, id, &info, WEXITED, wanted) == -1 &&
+         errno == EINTR) {
+  }
+  if (profile != NULL) {
+    vtsh_profile_add(profile, &usage);
+  }
+  vtsh_jobs_exit(jobs, process, vtsh_jobs_status(&info));
+}
+
+void vtsh_jobs_watch(struct vtsh_jobs* jobs, struct vtsh_process* process) {
+  process->pidfd = pidfd_open(process->pid, 0);
+  if (process->pidfd != -1) {
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = process};
+    if (epoll_ctl(jobs->epoll, EPOLL_CTL_ADD, process->pidfd, &event) == 0) {
+      return;
+    }
+    close(process->pidfd);
+    process->pidfd = -1;
+  }
+
+  vtsh_jobs_collect(jobs, process, P_PID, (id_t)process->pid);
+}
+
+/* Reaps a process whose pidfd became readable, which it does on exit. */
+static void vtsh_jobs_reap(
+    struct vtsh_jobs* jobs, struct vtsh_process* process
+) {
+  vtsh_jobs_collect(jobs, process, P_PIDFD, (id_t)process->pidfd);
+  close(process->pidfd);
+  process->pidfd = -1;
+}
+
+/*
+ * Watches input, or stops watching it for -1, which the foreground jobs
+ * might read from. Returns 1 if input is a regular file, which epoll does
+ * not take and which is always readable.
+ */
+static int vtsh_jobs_input(struct vtsh_jobs* jobs, int input) {
+  if (input == jobs->input) {
+    return 0;
+  }
+  if (jobs->input != -1) {
+    epoll_ctl(jobs->epoll, EPOLL_CTL_DEL, jobs->input, NULL);
+    jobs->input = -1;
+  }
+  if (input == -1) {
+    return 0;
+  }
+  struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+  if (epoll_ctl(jobs->epoll, EPOLL_CTL_ADD, input, &event) == -1) {
+    return (errno == EPERM) ? 1 : -1;
+  }
+  jobs->input = input;
+  return 0;
+}
+
+int vtsh_jobs_poll(struct vtsh_jobs* jobs, int input, int timeout) {
+  const int always = vtsh_jobs_input(jobs, input);
+  if (always == -1) {
+    return -1;
+  }
+
+  struct epoll_event events[VTSH_EVENTS];
+  const int count =
+      epoll_wait(jobs->epoll, events, VTSH_EVENTS, always ? 0 : timeout);
+  if (count == -1) {
+    return (errno == EINTR) ? 0 : -1;
+  }
+  int readable = always;
+  for (int i = 0; i < count; ++i) {
+    if (events[i].data.ptr == NULL) {
+      readable = 1;
+    } else {
+      vtsh_jobs_reap(jobs, events[i].data.ptr);
+    }
+  }
+  return readable;
+}
+
+struct vtsh_job* vtsh_jobs_finished(struct vtsh_jobs* jobs) {
+  struct vtsh_job* job = jobs->finished;
+  if (job != NULL) {
+    jobs->finished = job->finished;
+    job->finished = NULL;
+  }
+  return job;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "parse.h"
+#include "profile.h"
+
+struct vtsh_job;
+
+/*
+ * A process of the pipeline a job runs, watched through a pidfd until it
+ * exits with status, the way shells report it.
+ */
+struct vtsh_process {
+  pid_t pid;
+  int pidfd;
+  int status;
+  struct vtsh_job* job;
+};
+
+/*
+ * A chain of a line that runs one pipeline after another, as && and ||
+ * say, with next as the index of the pipeline to consider once the one
+ * that runs is done, and done set after the last. A background job has a
+ * number above 0 for the user and is one of the users of its line. Profile
+ * is set while a pipeline that is timed runs, and gets the rusage of its
+ * processes as they are reaped.
+ */
+struct vtsh_job {
+  size_t id;
+  struct vtsh_line* line;
+  const struct vtsh_chain* chain;
+  size_t next;
+  pid_t pgid;
+  struct vtsh_process* processes;
+  size_t count;
+  size_t running;
+  int status;
+  bool done;
+  struct vtsh_profile* profile;
+  struct vtsh_job* finished;
+};
+
+/*
+ * The background jobs of a shell and the epoll that watches the processes
+ * of all jobs, the foreground one too, and the input of the shell when it
+ * waits for a line. Jobs whose pipeline is done queue up in finished.
+ */
+struct vtsh_jobs {
+  int epoll;
+  struct vtsh_job** table;
+  size_t capacity;
+  size_t count;
+  int input;
+  struct vtsh_job* finished;
+};
+
+int vtsh_jobs_init(struct vtsh_jobs* jobs);
+
+void vtsh_jobs_destroy(struct vtsh_jobs* jobs);
+
+/* Gives the job the lowest free number and keeps it until it is removed. */
+int vtsh_jobs_add(struct vtsh_jobs* jobs, struct vtsh_job* job);
+
+/* Removes a background job that is done and frees it. */
+void vtsh_jobs_remove(struct vtsh_jobs* jobs, struct vtsh_job* job);
+
+/*
+ * Starts watching a process of the job that was just started. Without
+ * pidfds the process is waited for right away, which only a kernel before
+ * 5.3 lacks.
+ */
+void vtsh_jobs_watch(struct vtsh_jobs* jobs, struct vtsh_process* process);
+
+/*
+ * Waits up to timeout milliseconds, -1 for no limit, for processes to exit,
+ * reaping them, or for input to become readable, unless it is -1. Returns 1
+ * once input is readable, which it always is for a regular file, 0 if it is
+ * not, or -1 with errno.
+ */
+int vtsh_jobs_poll(struct vtsh_jobs* jobs, int input, int timeout);
+
+/* Returns a job whose pipeline is done, or NULL if there is none. */
+struct vtsh_job* vtsh_jobs_finished(struct vtsh_jobs* jobs);
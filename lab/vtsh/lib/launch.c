@@ -0,0 +1,403 @@
+#include "launch.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#ifndef VTSH_LAUNCHER_DEFAULT
+#define VTSH_LAUNCHER_DEFAULT "vfork"
+#endif
+
+/* Children started by clone and clone3 only need a stack until execve. */
+#define VTSH_CHILD_STACK (64 * 1024)
+
+/*
+ * Code that runs in a child on the private stack is left alone by the
+ * sanitizers, which do not know that stack.
+ */
+#define VTSH_CHILD_CODE __attribute__((no_sanitize("address", "undefined")))
+
+/* The exit status of a child that failed to execve, as in shells. */
+#define VTSH_EXEC_FAILED 127
+
+static const char* const launchers[VTSH_LAUNCHERS] = {
+    [VTSH_LAUNCH_FORK] = "fork",
+    [VTSH_LAUNCH_VFORK] = "vfork",
+    [VTSH_LAUNCH_CLONE] = "clone",
+    [VTSH_LAUNCH_CLONE3] = "clone3",
+    [VTSH_LAUNCH_POSIX_SPAWN] = "posix_spawn",
+};
+
+/*
+ * What a child needs to run the program. A child that shares the memory of
+ * the parent leaves the error of execve in error, which the parent reads once
+ * the child is gone or has replaced its memory; a forked child writes it to
+ * the report pipe instead.
+ */
+struct vtsh_child {
+  const char* path;
+  char* const* argv;
+  char* const* envp;
+  const struct vtsh_launch_attr* attr;
+  const sigset_t* mask;
+  int report;
+  volatile int error;
+};
+
+/* struct clone_args of linux/sched.h, as of CLONE_ARGS_SIZE_VER0. */
+struct vtsh_clone_args {
+  uint64_t flags;
+  uint64_t pidfd;
+  uint64_t child_tid;
+  uint64_t parent_tid;
+  uint64_t exit_signal;
+  uint64_t stack;
+  uint64_t stack_size;
+  uint64_t tls;
+};
+
+/* The stack shared by the children of a thread, which run one at a time. */
+static _Thread_local char* child_stack;
+
+int vtsh_launcher_find(const char* name) {
+  for (int i = 0; i < VTSH_LAUNCHERS; ++i) {
+    if (strcmp(name, launchers[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const char* vtsh_launcher_name(enum vtsh_launcher launcher) {
+  return launchers[launcher];
+}
+
+int vtsh_launcher_default(void) {
+  const char* name = getenv("VTSH_LAUNCHER");  // NOLINT(concurrency-mt-unsafe)
+  const int launcher =
+      vtsh_launcher_find((name != NULL) ? name : VTSH_LAUNCHER_DEFAULT);
+  if (launcher == -1) {
+    errno = EINVAL;
+  }
+  return launcher;
+}
+
+/*
+ * Sets the child up as its attributes say. Signals are still blocked, so
+ * taking the terminal from the background does not stop it with SIGTTOU.
+ */
+VTSH_CHILD_CODE static int vtsh_child_setup(
+    const struct vtsh_launch_attr* attr
+) {
+  if (attr == NULL) {
+    return 0;
+  }
+  if (attr->pgid != -1) {
+    setpgid(0, attr->pgid);
+    if (attr->terminal != -1) {
+      tcsetpgrp(attr->terminal, getpgrp());
+    }
+  }
+  if (attr->input != -1 && dup2(attr->input, STDIN_FILENO) == -1) {
+    return -1;
+  }
+  if (attr->output != -1 && dup2(attr->output, STDOUT_FILENO) == -1) {
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Runs the program in the child, returning the status to exit with if
+ * execve fails. Children on the private stack exit as the function that
+ * started them returns.
+ */
+VTSH_CHILD_CODE static int vtsh_child_exec(struct vtsh_child* child) {
+  if (vtsh_child_setup(child->attr) == 0) {
+    sigprocmask(SIG_SETMASK, child->mask, NULL);
+    execve(child->path, child->argv, child->envp);
+  }
+  child->error = errno;
+  if (child->report != -1) {
+    const int error = errno;
+    (void)!write(child->report, &error, sizeof(error));
+  }
+  return VTSH_EXEC_FAILED;
+}
+
+VTSH_CHILD_CODE static int vtsh_child_main(void* arg) {
+  return vtsh_child_exec(arg);
+}
+
+static char* vtsh_child_stack(void) {
+  if (child_stack == NULL) {
+    void* stack = mmap(
+        NULL,
+        VTSH_CHILD_STACK,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK,
+        -1,
+        0
+    );
+    if (stack == MAP_FAILED) {
+      return NULL;
+    }
+    child_stack = stack;
+  }
+  return child_stack;
+}
+
+static pid_t vtsh_launch_fork(struct vtsh_child* child) {
+  int report[2];
+  if (pipe2(report, O_CLOEXEC) == -1) {
+    return -1;
+  }
+  const pid_t pid = fork();
+  if (pid == 0) {
+    close(report[0]);
+    child->report = report[1];
+    _exit(vtsh_child_exec(child));
+  }
+  const int error = errno;
+  close(report[1]);
+
+  /* The pipe closes without a word once execve succeeds. */
+  if (pid != -1) {
+    int failure = 0;
+    ssize_t got = 0;
+    do {
+      got = read(report[0], &failure, sizeof(failure));
+    } while (got == -1 && errno == EINTR);
+    if (got == sizeof(failure)) {
+      child->error = failure;
+    }
+  }
+  close(report[0]);
+  errno = error;
+  return pid;
+}
+
+static pid_t vtsh_launch_vfork(struct vtsh_child* child) {
+  const pid_t pid = vfork();
+  if (pid == 0) {
+    _exit(vtsh_child_exec(child));
+  }
+  return pid;
+}
+
+static pid_t vtsh_launch_clone(struct vtsh_child* child) {
+  char* stack = vtsh_child_stack();
+  if (stack == NULL) {
+    return -1;
+  }
+  return clone(
+      vtsh_child_main,
+      stack + VTSH_CHILD_STACK,
+      CLONE_VM | CLONE_VFORK | SIGCHLD,
+      child
+  );
+}
+
+#if defined(__x86_64__)
+/*
+ * Calls clone3, which glibc does not wrap. The child starts on its own stack
+ * with nothing to return to, so it calls fn(arg) right from here and exits
+ * with its result, as clone does.
+ */
+static long vtsh_clone3(
+    struct vtsh_clone_args* args, int (*fn)(void*), void* arg
+) {
+  register long result __asm__("rax") = SYS_clone3;
+  register struct vtsh_clone_args* rdi __asm__("rdi") = args;
+  register size_t rsi __asm__("rsi") = sizeof(*args);
+  register int (*r12)(void*) __asm__("r12") = fn;
+  register void* r13 __asm__("r13") = arg;
+  __asm__ volatile(
+      "syscall\n\t"
+      "test %%rax, %%rax\n\t"
+      "jnz 1f\n\t"
+      "xor %%ebp, %%ebp\n\t"
+      "mov %%r13, %%rdi\n\t"
+      "call *%%r12\n\t"
+      "mov %%eax, %%edi\n\t"
+      "mov %[exit], %%eax\n\t"
+      "syscall\n\t"
+      "hlt\n"
+      "1:"
+      : "+r"(result)
+      : "r"(rdi), "r"(rsi), "r"(r12), "r"(r13), [exit] "i"(SYS_exit)
+      : "rcx", "r11", "memory"
+  );
+  return result;
+}
+#endif
+
+/* Falls back to clone where clone3 is not available. */
+static pid_t vtsh_launch_clone3(struct vtsh_child* child) {
+#if defined(__x86_64__)
+  char* stack = vtsh_child_stack();
+  if (stack == NULL) {
+    return -1;
+  }
+  struct vtsh_clone_args args = {
+      .flags = CLONE_VM | CLONE_VFORK,
+      .exit_signal = SIGCHLD,
+      .stack = (uint64_t)(uintptr_t)stack,
+      .stack_size = VTSH_CHILD_STACK,
+  };
+  const long result = vtsh_clone3(&args, vtsh_child_main, child);
+  if (result != -ENOSYS) {
+    if (result < 0) {
+      errno = (int)-result;
+      return -1;
+    }
+    return (pid_t)result;
+  }
+#endif
+  return vtsh_launch_clone(child);
+}
+
+/* The shell hands the terminal over itself once the child has started. */
+static pid_t vtsh_launch_posix_spawn(struct vtsh_child* child) {
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  posix_spawnattr_setsigmask(&attr, child->mask);
+  short flags = POSIX_SPAWN_SETSIGMASK;
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (child->attr != NULL) {
+    if (child->attr->pgid != -1) {
+      posix_spawnattr_setpgroup(&attr, child->attr->pgid);
+      flags |= POSIX_SPAWN_SETPGROUP;
+    }
+    if (child->attr->input != -1) {
+      posix_spawn_file_actions_adddup2(
+          &actions, child->attr->input, STDIN_FILENO
+      );
+    }
+    if (child->attr->output != -1) {
+      posix_spawn_file_actions_adddup2(
+          &actions, child->attr->output, STDOUT_FILENO
+      );
+    }
+  }
+  posix_spawnattr_setflags(&attr, flags);
+  pid_t pid = -1;
+  const int error = posix_spawn(
+      &pid, child->path, &actions, &attr, child->argv, child->envp
+  );
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+  /* It reaps a child that failed to execve itself. */
+  if (error != 0) {
+    errno = error;
+    return -1;
+  }
+  return pid;
+}
+
+/*
+ * Puts the child in its process group and hands it the terminal from the
+ * parent as well, as the parent may get to run first.
+ */
+static void vtsh_launch_join(const struct vtsh_launch_attr* attr, pid_t pid) {
+  if (attr == NULL || attr->pgid == -1 || pid == -1) {
+    return;
+  }
+  const pid_t pgid = (attr->pgid == 0) ? pid : attr->pgid;
+  setpgid(pid, pgid);
+  if (attr->terminal != -1) {
+    tcsetpgrp(attr->terminal, pgid);
+  }
+}
+
+pid_t vtsh_launch(
+    enum vtsh_launcher launcher,
+    const char* path,
+    char* const argv[],
+    char* const envp[],
+    const struct vtsh_launch_attr* attr
+) {
+  /* No signal handler may run in a child that borrows the parent's memory. */
+  sigset_t all;
+  sigset_t mask;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &mask);
+
+  struct vtsh_child child = {
+      .path = path,
+      .argv = argv,
+      .envp = envp,
+      .attr = attr,
+      .mask = &mask,
+      .report = -1,
+  };
+  pid_t pid = -1;
+  switch (launcher) {
+    case VTSH_LAUNCH_FORK:
+      pid = vtsh_launch_fork(&child);
+      break;
+    case VTSH_LAUNCH_VFORK:
+      pid = vtsh_launch_vfork(&child);
+      break;
+    case VTSH_LAUNCH_CLONE:
+      pid = vtsh_launch_clone(&child);
+      break;
+    case VTSH_LAUNCH_CLONE3:
+      pid = vtsh_launch_clone3(&child);
+      break;
+    case VTSH_LAUNCH_POSIX_SPAWN:
+      pid = vtsh_launch_posix_spawn(&child);
+      break;
+    default:
+      errno = EINVAL;
+      break;
+  }
+  const int error = errno;
+  vtsh_launch_join(attr, pid);
+  pthread_sigmask(SIG_SETMASK, &mask, NULL);
+
+  if (pid != -1 && child.error != 0) {
+    while (waitpid(pid, NULL, 0) == -1 && errno == EINTR) {
+    }
+    errno = child.error;
+    return -1;
+  }
+  errno = error;
+  return pid;
+}
+
+pid_t vtsh_launch_call(
+    const struct vtsh_launch_attr* attr, int (*fn)(void*), void* arg
+) {
+  sigset_t all;
+  sigset_t mask;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &mask);
+
+  const pid_t pid = fork();
+  if (pid == 0) {
+    if (vtsh_child_setup(attr) == -1) {
+      _exit(VTSH_EXEC_FAILED);
+    }
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+    _exit(fn(arg));
+  }
+  const int error = errno;
+  vtsh_launch_join(attr, pid);
+  pthread_sigmask(SIG_SETMASK, &mask, NULL);
+  errno = error;
+  return pid;
+}
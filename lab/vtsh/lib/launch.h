@@ -0,0 +1,68 @@
+#pragma once
+
+#include <sys/types.h>
+
+/*
+ * The ways to start a child process. Fork copies the page tables of the
+ * parent, which gets slower as the parent grows. The others share the
+ * memory of the parent with the child, which borrows it until it calls
+ * execve, so their cost does not depend on the size of the parent: vfork,
+ * clone and clone3 with CLONE_VM | CLONE_VFORK, and posix_spawn, which glibc
+ * builds on the same clone.
+ */
+enum vtsh_launcher {
+  VTSH_LAUNCH_FORK,
+  VTSH_LAUNCH_VFORK,
+  VTSH_LAUNCH_CLONE,
+  VTSH_LAUNCH_CLONE3,
+  VTSH_LAUNCH_POSIX_SPAWN,
+  VTSH_LAUNCHERS,
+};
+
+/*
+ * How a child is set up before it runs: the descriptors that become its
+ * standard input and output, or -1 to keep those of the shell, and the
+ * process group it joins, 0 for a new one it leads or -1 to stay in that of
+ * the shell. Unless terminal is -1, the child also makes its process group
+ * the foreground one of that terminal.
+ */
+struct vtsh_launch_attr {
+  int input;
+  int output;
+  pid_t pgid;
+  int terminal;
+};
+
+/* Returns the launcher with the given name, or -1 if there is none. */
+int vtsh_launcher_find(const char* name);
+
+const char* vtsh_launcher_name(enum vtsh_launcher launcher);
+
+/*
+ * Returns the launcher named by the VTSH_LAUNCHER environment variable, or
+ * the one chosen at build time if it is not set. Fails with EINVAL for an
+ * unknown name.
+ */
+int vtsh_launcher_default(void);
+
+/*
+ * Starts the program at path with the given arguments and environment, set
+ * up as attr says if it is not NULL, and returns its pid. Fails with the
+ * error of execve, like ENOENT, if the program could not be run, having
+ * reaped the child.
+ */
+pid_t vtsh_launch(
+    enum vtsh_launcher launcher,
+    const char* path,
+    char* const argv[],
+    char* const envp[],
+    const struct vtsh_launch_attr* attr
+);
+
+/*
+ * Forks a child set up as attr says, which exits with the status fn returns,
+ * and returns its pid. Used for builtins that run in a pipeline.
+ */
+pid_t vtsh_launch_call(
+    const struct vtsh_launch_attr* attr, int (*fn)(void*), void* arg
+);
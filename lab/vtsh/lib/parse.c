@@ -0,0 +1,299 @@
+#include "parse.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The words that stand for operators, told apart from others by address. */
+static char vtsh_pipe[] = "|";
+static char vtsh_and[] = "&&";
+static char vtsh_or[] = "||";
+static char vtsh_then[] = ";";
+static char vtsh_background[] = "&";
+
+static const char* const vtsh_separators = " \t|&;";
+
+/* Where the words go as the line is sorted into chains. */
+struct vtsh_parser {
+  struct vtsh_line* line;
+  struct vtsh_pipeline* pipelines;
+  struct vtsh_command* commands;
+  char** argv;
+  size_t pipeline_count;
+  size_t command_count;
+  size_t next;
+  struct vtsh_chain* chain;
+  struct vtsh_pipeline* pipeline;
+  struct vtsh_command* command;
+};
+
+static bool vtsh_blank(char c) {
+  return c == ' ' || c == '\t';
+}
+
+/* Returns the operator that starts at c, or NULL, with its length. */
+static char* vtsh_operator(const char* c, size_t* length) {
+  *length = 1;
+  switch (*c) {
+    case '|':
+      if (c[1] == '|') {
+        *length = 2;
+        return vtsh_or;
+      }
+      return vtsh_pipe;
+    case '&':
+      if (c[1] == '&') {
+        *length = 2;
+        return vtsh_and;
+      }
+      return vtsh_background;
+    case ';':
+      return vtsh_then;
+    default:
+      return NULL;
+  }
+}
+
+static bool vtsh_is_operator(const char* word) {
+  return word == vtsh_pipe || word == vtsh_and || word == vtsh_or ||
+         word == vtsh_then || word == vtsh_background;
+}
+
+/* Counts the words of the text, operators among them. */
+static size_t vtsh_count(const char* text, size_t* operators) {
+  size_t words = 0;
+  size_t length = 0;
+  for (const char* c = text; *c != '\0';) {
+    if (vtsh_blank(*c)) {
+      c += 1;
+    } else if (vtsh_operator(c, &length) != NULL) {
+      *operators += 1;
+      words += 1;
+      c += length;
+    } else {
+      words += 1;
+      c += strcspn(c, vtsh_separators);
+    }
+  }
+  return words;
+}
+
+/* Splits the text into words in place, with an operator for each one. */
+static void vtsh_split(char* text, char** words) {
+  size_t count = 0;
+  size_t length = 0;
+  for (char* c = text; *c != '\0';) {
+    if (vtsh_blank(*c)) {
+      c += 1;
+      continue;
+    }
+    char* separator = vtsh_operator(c, &length);
+    if (separator != NULL) {
+      words[count++] = separator;
+      c += length;
+      continue;
+    }
+    words[count++] = c;
+    c += strcspn(c, vtsh_separators);
+    if (*c == '\0') {
+      break;
+    }
+    separator = vtsh_operator(c, &length);
+    *c = '\0';
+    if (separator != NULL) {
+      words[count++] = separator;
+      c += length;
+    } else {
+      c += 1;
+    }
+  }
+}
+
+static void vtsh_begin_command(struct vtsh_parser* parser) {
+  parser->command = &parser->commands[parser->command_count];
+  *parser->command = (struct vtsh_command){
+      .argv = parser->argv + parser->next,
+  };
+}
+
+static void vtsh_begin_pipeline(
+    struct vtsh_parser* parser, enum vtsh_join join
+) {
+  parser->pipeline = &parser->pipelines[parser->pipeline_count];
+  *parser->pipeline = (struct vtsh_pipeline){
+      .commands = &parser->commands[parser->command_count],
+      .join = join,
+  };
+  vtsh_begin_command(parser);
+}
+
+static void vtsh_begin_chain(struct vtsh_parser* parser) {
+  parser->chain = &parser->line->chains[parser->line->count];
+  *parser->chain = (struct vtsh_chain){
+      .pipelines = &parser->pipelines[parser->pipeline_count],
+  };
+  vtsh_begin_pipeline(parser, VTSH_JOIN_NONE);
+}
+
+/*
+ * Ends the command with the NULL of its argv, which takes the slot of the
+ * operator or of a redirection, or the one past the last word. Only a
+ * command alone in its pipeline may have no words, if it has redirections.
+ */
+static int vtsh_end_command(struct vtsh_parser* parser, bool alone) {
+  const struct vtsh_command* command = parser->command;
+  if (command->argc == 0 &&
+      (!alone || (command->input == NULL && command->output == NULL))) {
+    return -1;
+  }
+  parser->argv[parser->next++] = NULL;
+  parser->command_count += 1;
+  parser->pipeline->count += 1;
+  return 0;
+}
+
+static int vtsh_end_pipeline(struct vtsh_parser* parser) {
+  if (vtsh_end_command(parser, parser->pipeline->count == 0) == -1) {
+    return -1;
+  }
+  parser->pipeline_count += 1;
+  parser->chain->count += 1;
+  return 0;
+}
+
+static int vtsh_end_chain(struct vtsh_parser* parser, bool background) {
+  if (vtsh_end_pipeline(parser) == -1) {
+    return -1;
+  }
+  parser->chain->background = background;
+  parser->line->count += 1;
+  return 0;
+}
+
+/* Adds a redirection that starts at word i, moving past its file. */
+static int vtsh_redirect(
+    struct vtsh_parser* parser, char** words, size_t count, size_t* i
+) {
+  const char* word = words[*i];
+  const char** target = (word[0] == '<') ? &parser->command->input
+                                         : &parser->command->output;
+  const char* file = word + 1;
+  if (*file == '\0') {
+    *i += 1;
+    if (*i == count || vtsh_is_operator(words[*i])) {
+      return -1;
+    }
+    file = words[*i];
+  }
+  if (*target != NULL || *file == '<' || *file == '>') {
+    return -1;
+  }
+  *target = file;
+  return 0;
+}
+
+/* Takes time, and -j after it, ahead of the first command of a pipeline. */
+static bool vtsh_time_prefix(struct vtsh_parser* parser, const char* word) {
+  struct vtsh_pipeline* pipeline = parser->pipeline;
+  const struct vtsh_command* command = parser->command;
+  if (pipeline->count != 0 || command->argc != 0 || command->input != NULL ||
+      command->output != NULL) {
+    return false;
+  }
+  if (pipeline->time == VTSH_TIME_OFF && strcmp(word, "time") == 0) {
+    pipeline->time = VTSH_TIME_TEXT;
+    return true;
+  }
+  if (pipeline->time == VTSH_TIME_TEXT && strcmp(word, "-j") == 0) {
+    pipeline->time = VTSH_TIME_JSON;
+    return true;
+  }
+  return false;
+}
+
+/* Sorts the words into chains, moving those of each command down in place. */
+static int vtsh_sort(struct vtsh_parser* parser, char** words, size_t count) {
+  bool open = true;
+  vtsh_begin_chain(parser);
+  for (size_t i = 0; i < count; ++i) {
+    char* word = words[i];
+    int status = 0;
+    if (word == vtsh_pipe) {
+      status = vtsh_end_command(parser, false);
+      vtsh_begin_command(parser);
+    } else if (word == vtsh_and || word == vtsh_or) {
+      status = vtsh_end_pipeline(parser);
+      vtsh_begin_pipeline(
+          parser, (word == vtsh_and) ? VTSH_JOIN_AND : VTSH_JOIN_OR
+      );
+    } else if (word == vtsh_then || word == vtsh_background) {
+      status = vtsh_end_chain(parser, word == vtsh_background);
+      open = i + 1 < count;
+      if (open) {
+        vtsh_begin_chain(parser);
+      }
+    } else if (word[0] == '<' || word[0] == '>') {
+      status = vtsh_redirect(parser, words, count, &i);
+    } else if (!vtsh_time_prefix(parser, word)) {
+      parser->argv[parser->next++] = word;
+      parser->command->argc += 1;
+    }
+    if (status == -1) {
+      return -1;
+    }
+  }
+
+  /* Nothing at all is an empty line rather than an empty chain. */
+  if (!open || (count == 0 && parser->line->count == 0)) {
+    return 0;
+  }
+  return vtsh_end_chain(parser, false);
+}
+
+struct vtsh_line* vtsh_parse(const char* text) {
+  size_t operators = 0;
+  const size_t count = vtsh_count(text, &operators);
+  const size_t length = strlen(text);
+
+  /* The line, its chains, pipelines, commands, words and text, in order. */
+  const size_t parts = operators + 1;
+  const size_t size = sizeof(struct vtsh_line) +
+                      (parts * sizeof(struct vtsh_chain)) +
+                      (parts * sizeof(struct vtsh_pipeline)) +
+                      (parts * sizeof(struct vtsh_command)) +
+                      ((count + 1) * sizeof(char*)) + length + 1;
+  struct vtsh_line* line = malloc(size);
+  if (line == NULL) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  *line = (struct vtsh_line){
+      .chains = (struct vtsh_chain*)(line + 1),
+      .users = 1,
+  };
+  struct vtsh_parser parser = {
+      .line = line,
+      .pipelines = (struct vtsh_pipeline*)(line->chains + parts),
+  };
+  parser.commands = (struct vtsh_command*)(parser.pipelines + parts);
+  parser.argv = (char**)(parser.commands + parts);
+  char* copy = (char*)(parser.argv + count + 1);
+  memcpy(copy, text, length + 1);
+
+  vtsh_split(copy, parser.argv);
+  if (vtsh_sort(&parser, parser.argv, count) == -1) {
+    free(line);
+    errno = EINVAL;
+    return NULL;
+  }
+  return line;
+}
+
+void vtsh_line_release(struct vtsh_line* line) {
+  line->users -= 1;
+  if (line->users == 0) {
+    free(line);
+  }
+}
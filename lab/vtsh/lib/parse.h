@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "profile.h"
+
+/*
+ * A command of a pipeline: its words and the files its standard input and
+ * output are redirected to, or NULL.
+ */
+struct vtsh_command {
+  char** argv;
+  size_t argc;
+  const char* input;
+  const char* output;
+};
+
+/* How a pipeline is joined to the one before it in a chain. */
+enum vtsh_join {
+  VTSH_JOIN_NONE,
+  VTSH_JOIN_AND,
+  VTSH_JOIN_OR,
+};
+
+/*
+ * The commands of a pipeline, joined with |, and how to report what it
+ * cost if it starts with time.
+ */
+struct vtsh_pipeline {
+  struct vtsh_command* commands;
+  size_t count;
+  enum vtsh_join join;
+  enum vtsh_time time;
+};
+
+/*
+ * Pipelines joined with && and ||, ended by ; or by & for a chain that runs
+ * in the background.
+ */
+struct vtsh_chain {
+  struct vtsh_pipeline* pipelines;
+  size_t count;
+  bool background;
+};
+
+/*
+ * The chains of a line, parsed from a copy of it that the line owns, along
+ * with everything else, in one block. The line is shared by the jobs that
+ * run its chains, the last of which frees it.
+ */
+struct vtsh_line {
+  struct vtsh_chain* chains;
+  size_t count;
+  size_t users;
+};
+
+/*
+ * Parses a copy of text. A word that starts with < or > redirects the input
+ * or the output of its command to the rest of the word, or to the next word
+ * if there is no rest, while |, &&, ||, ; and & separate words wherever they
+ * appear. A pipeline may start with time, or with time -j for JSON. Returns
+ * a line with one user, or NULL with EINVAL on a syntax error: a
+ * redirection without a file or repeated in one command, or an empty
+ * command, pipeline or chain.
+ */
+struct vtsh_line* vtsh_parse(const char* text);
+
+/* Drops a user of the line, freeing it when there are none left. */
+void vtsh_line_release(struct vtsh_line* line);
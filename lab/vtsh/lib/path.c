@@ -0,0 +1,226 @@
+#include "path.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* The search path of execvp when PATH is not set. */
+#define VTSH_DEFAULT_PATH "/bin:/usr/bin"
+
+#define VTSH_PATH_MIN 64
+
+#define VTSH_FNV_OFFSET 14695981039346656037ULL
+#define VTSH_FNV_PRIME 1099511628211ULL
+
+static bool vtsh_path_executable(const char* path) {
+  struct stat st;
+  return stat(path, &st) == 0 && S_ISREG(st.st_mode) &&
+         access(path, X_OK) == 0;
+}
+
+static uint64_t vtsh_path_hash(const char* name) {
+  uint64_t hash = VTSH_FNV_OFFSET;
+  for (const unsigned char* c = (const unsigned char*)name; *c != '\0';
+       ++c) {
+    hash = (hash ^ *c) * VTSH_FNV_PRIME;
+  }
+  return hash;
+}
+
+void vtsh_path_init(struct vtsh_path* cache) {
+  *cache = (struct vtsh_path){0};
+}
+
+static void vtsh_path_clear(struct vtsh_path* cache) {
+  for (size_t i = 0; i < cache->capacity; ++i) {
+    free(cache->entries[i].name);
+    free(cache->entries[i].path);
+    cache->entries[i] = (struct vtsh_path_entry){0};
+  }
+  cache->count = 0;
+}
+
+void vtsh_path_destroy(struct vtsh_path* cache) {
+  vtsh_path_clear(cache);
+  free(cache->entries);
+  free(cache->dirs);
+  free(cache->found);
+  vtsh_path_init(cache);
+}
+
+/* Returns the slot of the name, or the empty slot where it would go. */
+static size_t vtsh_path_slot(const struct vtsh_path* cache, const char* name) {
+  size_t slot = vtsh_path_hash(name) & (cache->capacity - 1);
+  while (cache->entries[slot].name != NULL &&
+         strcmp(cache->entries[slot].name, name) != 0) {
+    slot = (slot + 1) & (cache->capacity - 1);
+  }
+  return slot;
+}
+
+static int vtsh_path_grow(struct vtsh_path* cache) {
+  const size_t capacity =
+      (cache->capacity == 0) ? VTSH_PATH_MIN : 2 * cache->capacity;
+  struct vtsh_path_entry* entries =
+      calloc(capacity, sizeof(struct vtsh_path_entry));
+  if (entries == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  struct vtsh_path old = *cache;
+  cache->entries = entries;
+  cache->capacity = capacity;
+  for (size_t i = 0; i < old.capacity; ++i) {
+    if (old.entries[i].name != NULL) {
+      cache->entries[vtsh_path_slot(cache, old.entries[i].name)] =
+          old.entries[i];
+    }
+  }
+  free(old.entries);
+  return 0;
+}
+
+/* Empties the cache if PATH is no longer the one it was filled with. */
+static int vtsh_path_check(struct vtsh_path* cache, const char* dirs) {
+  if (cache->dirs != NULL && strcmp(cache->dirs, dirs) == 0) {
+    return 0;
+  }
+  char* copy = strdup(dirs);
+  if (copy == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+  vtsh_path_clear(cache);
+  free(cache->dirs);
+  cache->dirs = copy;
+  return 0;
+}
+
+/* Caches a path found for the name, which is not cached yet. */
+static int vtsh_path_insert(
+    struct vtsh_path* cache, const char* name, char* path
+) {
+  if (4 * (cache->count + 1) > 3 * cache->capacity &&
+      vtsh_path_grow(cache) == -1) {
+    return -1;
+  }
+  char* key = strdup(name);
+  if (key == NULL) {
+    return -1;
+  }
+  cache->entries[vtsh_path_slot(cache, name)] =
+      (struct vtsh_path_entry){.name = key, .path = path};
+  cache->count += 1;
+  return 0;
+}
+
+/* Looks the name up in the directories of PATH. */
+static char* vtsh_path_search(const char* dirs, const char* name) {
+  const size_t length = strlen(name);
+  for (;;) {
+    const char* end = strchrnul(dirs, ':');
+    const size_t size = (size_t)(end - dirs);
+
+    /* An empty entry stands for the current directory. */
+    char* path = malloc(size + length + 3);
+    if (path == NULL) {
+      errno = ENOMEM;
+      return NULL;
+    }
+    if (size == 0) {
+      path[0] = '.';
+      path[1] = '/';
+      memcpy(path + 2, name, length + 1);
+    } else {
+      memcpy(path, dirs, size);
+      path[size] = '/';
+      memcpy(path + size + 1, name, length + 1);
+    }
+    if (vtsh_path_executable(path)) {
+      return path;
+    }
+    free(path);
+
+    if (*end == '\0') {
+      break;
+    }
+    dirs = end + 1;
+  }
+  errno = ENOENT;
+  return NULL;
+}
+
+const char* vtsh_path_find(struct vtsh_path* cache, const char* name) {
+  free(cache->found);
+  cache->found = NULL;
+  if (*name == '\0') {
+    errno = ENOENT;
+    return NULL;
+  }
+  if (strchr(name, '/') != NULL) {
+    if (!vtsh_path_executable(name)) {
+      errno = ENOENT;
+      return NULL;
+    }
+    cache->found = strdup(name);
+    return cache->found;
+  }
+
+  const char* dirs = getenv("PATH");  // NOLINT(concurrency-mt-unsafe)
+  if (dirs == NULL) {
+    dirs = VTSH_DEFAULT_PATH;
+  }
+  if (vtsh_path_check(cache, dirs) == -1) {
+    return NULL;
+  }
+  if (cache->count != 0) {
+    const struct vtsh_path_entry* entry =
+        &cache->entries[vtsh_path_slot(cache, name)];
+    if (entry->name != NULL) {
+      return entry->path;
+    }
+  }
+
+  char* path = vtsh_path_search(dirs, name);
+  if (path == NULL) {
+    return NULL;
+  }
+  /* A program the cache has no room for is still found. */
+  if (path[0] != '/' || vtsh_path_insert(cache, name, path) == -1) {
+    cache->found = path;
+  }
+  return path;
+}
+
+void vtsh_path_forget(struct vtsh_path* cache, const char* name) {
+  if (cache->count == 0) {
+    return;
+  }
+  size_t slot = vtsh_path_slot(cache, name);
+  if (cache->entries[slot].name == NULL) {
+    return;
+  }
+  free(cache->entries[slot].name);
+  free(cache->entries[slot].path);
+  cache->entries[slot] = (struct vtsh_path_entry){0};
+  cache->count -= 1;
+
+  /* Entries after the hole move back into it if they hash to it or before. */
+  const size_t mask = cache->capacity - 1;
+  size_t next = (slot + 1) & mask;
+  while (cache->entries[next].name != NULL) {
+    const size_t home = vtsh_path_hash(cache->entries[next].name) & mask;
+    if (((next - home) & mask) >= ((next - slot) & mask)) {
+      cache->entries[slot] = cache->entries[next];
+      cache->entries[next] = (struct vtsh_path_entry){0};
+      slot = next;
+    }
+    next = (next + 1) & mask;
+  }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+
+/* A program found in PATH under the name it was looked up with. */
+struct vtsh_path_entry {
+  char* name;
+  char* path;
+};
+
+/*
+ * The programs found in the directories of PATH so far, hashed by name with
+ * linear probing. The cache belongs to the value of PATH it was filled with
+ * and is emptied when PATH changes. Programs found through a relative entry
+ * of PATH depend on the current directory and are never cached, and neither
+ * are paths with a slash: found holds the last of them.
+ */
+struct vtsh_path {
+  char* dirs;
+  char* found;
+  struct vtsh_path_entry* entries;
+  size_t capacity;
+  size_t count;
+};
+
+void vtsh_path_init(struct vtsh_path* cache);
+
+void vtsh_path_destroy(struct vtsh_path* cache);
+
+/*
+ * Finds the program a command names: a name with a slash is taken as a path,
+ * any other is looked up in the cache and then in the directories of PATH.
+ * Returns the path of the program, which stays valid until the next call, or
+ * NULL with ENOENT.
+ */
+const char* vtsh_path_find(struct vtsh_path* cache, const char* name);
+
+/* Drops the cached path of a program that turned out to be gone. */
+void vtsh_path_forget(struct vtsh_path* cache, const char* name);
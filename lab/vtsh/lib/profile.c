@@ -0,0 +1,296 @@
+#include "profile.h"
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "units.h"
+
+#define VTSH_NS_PER_S 1000000000.0
+#define VTSH_NS_PER_MS 1000000.0
+#define VTSH_US_PER_S 1000000.0
+#define VTSH_PERCENT 100.0
+
+struct vtsh_counter_info {
+  const char* name;
+  uint32_t type;
+  uint64_t config;
+};
+
+static const struct vtsh_counter_info counters[VTSH_COUNTERS] = {
+    [VTSH_COUNTER_CYCLES] =
+        {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [VTSH_COUNTER_INSTRUCTIONS] =
+        {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    [VTSH_COUNTER_CACHE_MISSES] =
+        {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    [VTSH_COUNTER_BRANCH_MISSES] =
+        {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    [VTSH_COUNTER_TASK_CLOCK] =
+        {"task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    [VTSH_COUNTER_CONTEXT_SWITCHES] =
+        {"context-switches",
+         PERF_TYPE_SOFTWARE,
+         PERF_COUNT_SW_CONTEXT_SWITCHES},
+    [VTSH_COUNTER_MIGRATIONS] =
+        {"cpu-migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+    [VTSH_COUNTER_PAGE_FAULTS] =
+        {"page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+/* What a counter reads as with the times it was enabled and running. */
+struct vtsh_counter_value {
+  uint64_t value;
+  uint64_t enabled;
+  uint64_t running;
+};
+
+/*
+ * Opens a counter of the shell that its children inherit and enable as
+ * they execve. Counts only user space if the system allows no more.
+ */
+static int vtsh_counter_open(const struct vtsh_counter_info* info) {
+  struct perf_event_attr attr = {
+      .type = info->type,
+      .size = sizeof(struct perf_event_attr),
+      .config = info->config,
+      .read_format =
+          PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING,
+      .disabled = 1,
+      .inherit = 1,
+      .enable_on_exec = 1,
+  };
+  int fd = (int)syscall(
+      SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC
+  );
+  if (fd == -1 && errno == EACCES) {
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = (int)syscall(
+        SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC
+    );
+  }
+  return fd;
+}
+
+void vtsh_profile_start(struct vtsh_profile* profile, enum vtsh_time format) {
+  *profile = (struct vtsh_profile){.format = format};
+  for (size_t i = 0; i < VTSH_COUNTERS; ++i) {
+    profile->counters[i] = vtsh_counter_open(&counters[i]);
+  }
+  profile->start = vtsh_now();
+}
+
+void vtsh_profile_self(struct vtsh_profile* profile) {
+  profile->self = true;
+  for (size_t i = 0; i < VTSH_COUNTERS; ++i) {
+    if (profile->counters[i] != -1) {
+      ioctl(profile->counters[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+  profile->start = vtsh_now();
+  getrusage(RUSAGE_SELF, &profile->usage);
+}
+
+static void vtsh_timeval_add(struct timeval* sum, const struct timeval* add) {
+  timeradd(sum, add, sum);
+}
+
+/*
+ * Leaves what the rusage of the shell grew by since the profile was turned
+ * to it, but for the largest resident set, which is that of the shell.
+ */
+static void vtsh_profile_delta(struct rusage* usage) {
+  struct rusage now = {0};
+  getrusage(RUSAGE_SELF, &now);
+  timersub(&now.ru_utime, &usage->ru_utime, &usage->ru_utime);
+  timersub(&now.ru_stime, &usage->ru_stime, &usage->ru_stime);
+  usage->ru_maxrss = now.ru_maxrss;
+  usage->ru_minflt = now.ru_minflt - usage->ru_minflt;
+  usage->ru_majflt = now.ru_majflt - usage->ru_majflt;
+  usage->ru_inblock = now.ru_inblock - usage->ru_inblock;
+  usage->ru_oublock = now.ru_oublock - usage->ru_oublock;
+  usage->ru_nvcsw = now.ru_nvcsw - usage->ru_nvcsw;
+  usage->ru_nivcsw = now.ru_nivcsw - usage->ru_nivcsw;
+}
+
+void vtsh_profile_add(
+    struct vtsh_profile* profile, const struct rusage* usage
+) {
+  struct rusage* sum = &profile->usage;
+  vtsh_timeval_add(&sum->ru_utime, &usage->ru_utime);
+  vtsh_timeval_add(&sum->ru_stime, &usage->ru_stime);
+  if (usage->ru_maxrss > sum->ru_maxrss) {
+    sum->ru_maxrss = usage->ru_maxrss;
+  }
+  sum->ru_minflt += usage->ru_minflt;
+  sum->ru_majflt += usage->ru_majflt;
+  sum->ru_inblock += usage->ru_inblock;
+  sum->ru_oublock += usage->ru_oublock;
+  sum->ru_nvcsw += usage->ru_nvcsw;
+  sum->ru_nivcsw += usage->ru_nivcsw;
+}
+
+/* Counters that had to share the hardware are scaled up to the whole run. */
+void vtsh_profile_stop(struct vtsh_profile* profile) {
+  if (profile->self) {
+    vtsh_profile_delta(&profile->usage);
+  }
+  profile->real = vtsh_now() - profile->start;
+  for (size_t i = 0; i < VTSH_COUNTERS; ++i) {
+    if (profile->counters[i] == -1) {
+      continue;
+    }
+    struct vtsh_counter_value read_value = {0};
+    profile->counted[i] =
+        read(profile->counters[i], &read_value, sizeof(read_value)) ==
+        (ssize_t)sizeof(read_value);
+    close(profile->counters[i]);
+    profile->counters[i] = -1;
+
+    uint64_t value = read_value.value;
+    if (read_value.running != 0 && read_value.running < read_value.enabled) {
+      value = (uint64_t)((double)value * (double)read_value.enabled /
+                         (double)read_value.running);
+      profile->scaled = true;
+    }
+    profile->values[i] = value;
+  }
+}
+
+void vtsh_profile_cancel(struct vtsh_profile* profile) {
+  for (size_t i = 0; i < VTSH_COUNTERS; ++i) {
+    if (profile->counters[i] != -1) {
+      close(profile->counters[i]);
+      profile->counters[i] = -1;
+    }
+  }
+}
+
+static double vtsh_seconds(const struct timeval* time) {
+  return (double)time->tv_sec + ((double)time->tv_usec / VTSH_US_PER_S);
+}
+
+static double vtsh_percent(double part, double whole) {
+  return (whole > 0) ? VTSH_PERCENT * part / whole : 0.0;
+}
+
+static void vtsh_profile_text(const struct vtsh_profile* profile, FILE* out) {
+  const struct rusage* usage = &profile->usage;
+  const double real = (double)profile->real / VTSH_NS_PER_S;
+  const double user = vtsh_seconds(&usage->ru_utime);
+  const double sys = vtsh_seconds(&usage->ru_stime);
+  fprintf(
+      out,
+      "real %.3f s  user %.3f s (%.1f%%)  sys %.3f s (%.1f%%)\n"
+      "switches %ld voluntary, %ld involuntary  faults %ld minor, %ld major"
+      "  max rss %ld KiB  blocks %ld in, %ld out\n",
+      real,
+      user,
+      vtsh_percent(user, real),
+      sys,
+      vtsh_percent(sys, real),
+      usage->ru_nvcsw,
+      usage->ru_nivcsw,
+      usage->ru_minflt,
+      usage->ru_majflt,
+      usage->ru_maxrss,
+      usage->ru_inblock,
+      usage->ru_oublock
+  );
+
+  const char* separator = "";
+  for (size_t i = 0; i < VTSH_COUNTERS; ++i) {
+    if (!profile->counted[i]) {
+      continue;
+    }
+    if (i == VTSH_COUNTER_TASK_CLOCK) {
+      fprintf(
+          out,
+          "%s%s %.3f ms",
+          separator,
+          counters[i].name,
+          (double)profile->values[i] / VTSH_NS_PER_MS
+      );
+    } else {
+      fprintf(
+          out,
+          "%s%s %llu",
+          separator,
+          counters[i].name,
+          (unsigned long long)profile->values[i]
+      );
+    }
+    separator = "  ";
+  }
+  if (profile->counted[VTSH_COUNTER_CYCLES] &&
+      profile->counted[VTSH_COUNTER_INSTRUCTIONS] &&
+      profile->values[VTSH_COUNTER_CYCLES] != 0) {
+    fprintf(
+        out,
+        "  ipc %.2f",
+        (double)profile->values[VTSH_COUNTER_INSTRUCTIONS] /
+            (double)profile->values[VTSH_COUNTER_CYCLES]
+    );
+  }
+  if (*separator != '\0') {
+    fprintf(out, "%s\n", profile->scaled ? "  (scaled)" : "");
+  }
+}
+
+static void vtsh_profile_json(const struct vtsh_profile* profile, FILE* out) {
+  const struct rusage* usage = &profile->usage;
+  const double real = (double)profile->real / VTSH_NS_PER_S;
+  const double user = vtsh_seconds(&usage->ru_utime);
+  const double sys = vtsh_seconds(&usage->ru_stime);
+  fprintf(
+      out,
+      "{\"real\": %.6f, \"user\": %.6f, \"sys\": %.6f, "
+      "\"user_percent\": %.1f, \"sys_percent\": %.1f, "
+      "\"voluntary_switches\": %ld, \"involuntary_switches\": %ld, "
+      "\"minor_faults\": %ld, \"major_faults\": %ld, \"max_rss_kib\": %ld, "
+      "\"blocks_in\": %ld, \"blocks_out\": %ld, \"counters\": {",
+      real,
+      user,
+      sys,
+      vtsh_percent(user, real),
+      vtsh_percent(sys, real),
+      usage->ru_nvcsw,
+      usage->ru_nivcsw,
+      usage->ru_minflt,
+      usage->ru_majflt,
+      usage->ru_maxrss,
+      usage->ru_inblock,
+      usage->ru_oublock
+  );
+  const char* separator = "";
+  for (size_t i = 0; i < VTSH_COUNTERS; ++i) {
+    if (profile->counted[i]) {
+      fprintf(
+          out,
+          "%s\"%s\": %llu",
+          separator,
+          counters[i].name,
+          (unsigned long long)profile->values[i]
+      );
+      separator = ", ";
+    }
+  }
+  fprintf(out, "}, \"scaled\": %s}\n", profile->scaled ? "true" : "false");
+}
+
+void vtsh_profile_report(const struct vtsh_profile* profile, FILE* out) {
+  if (profile->format == VTSH_TIME_JSON) {
+    vtsh_profile_json(profile, out);
+  } else {
+    vtsh_profile_text(profile, out);
+  }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/resource.h>
+
+/* How the time prefix reports a pipeline, if at all. */
+enum vtsh_time {
+  VTSH_TIME_OFF,
+  VTSH_TIME_TEXT,
+  VTSH_TIME_JSON,
+};
+
+/* The perf_event_open counters a profile asks for. */
+enum vtsh_counter {
+  VTSH_COUNTER_CYCLES,
+  VTSH_COUNTER_INSTRUCTIONS,
+  VTSH_COUNTER_CACHE_MISSES,
+  VTSH_COUNTER_BRANCH_MISSES,
+  VTSH_COUNTER_TASK_CLOCK,
+  VTSH_COUNTER_CONTEXT_SWITCHES,
+  VTSH_COUNTER_MIGRATIONS,
+  VTSH_COUNTER_PAGE_FAULTS,
+  VTSH_COUNTERS,
+};
+
+/*
+ * What a pipeline cost: its wall time, the rusage of its processes as
+ * wait4 gives it, summed but for the largest resident set, and whatever
+ * counters the system lets the shell open, with counted set for those
+ * read once the pipeline is done and -1 for those it cannot open. The
+ * counters are opened in the shell before the pipeline starts, disabled,
+ * inherited by the children and enabled as they execve, so they count the
+ * programs of the pipeline and anything else the shell starts meanwhile,
+ * but not the shell itself. A builtin that runs in the shell is measured
+ * in the shell instead, with self set: the counters are enabled right
+ * away and the rusage is what that of the shell grew by.
+ */
+struct vtsh_profile {
+  enum vtsh_time format;
+  uint64_t start;
+  uint64_t real;
+  bool self;
+  struct rusage usage;
+  int counters[VTSH_COUNTERS];
+  uint64_t values[VTSH_COUNTERS];
+  bool counted[VTSH_COUNTERS];
+  bool scaled;
+};
+
+/* Starts profiling a pipeline that is about to start. */
+void vtsh_profile_start(struct vtsh_profile* profile, enum vtsh_time format);
+
+/* Turns the profile to the shell itself, for a builtin about to run in it. */
+void vtsh_profile_self(struct vtsh_profile* profile);
+
+/* Adds the rusage of a process of the pipeline as it is reaped. */
+void vtsh_profile_add(
+    struct vtsh_profile* profile, const struct rusage* usage
+);
+
+/* Stops profiling once the pipeline is done and reads the counters. */
+void vtsh_profile_stop(struct vtsh_profile* profile);
+
+/* Closes the counters of a pipeline that failed to start. */
+void vtsh_profile_cancel(struct vtsh_profile* profile);
+
+/* Prints the profile as text or as a line of JSON. */
+void vtsh_profile_report(const struct vtsh_profile* profile, FILE* out);
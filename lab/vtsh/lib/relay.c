@@ -0,0 +1,170 @@
+#include "relay.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/* As much as one call moves, past any pipe buffer the shell sets up. */
+#define VTSH_RELAY_CHUNK (1UL << 20U)
+#define VTSH_RELAY_BUFFER (128UL * 1024)
+
+static bool vtsh_relay_pipe(int fd) {
+  struct stat st;
+  return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+static bool vtsh_relay_file(int fd) {
+  struct stat st;
+  return fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+/* Tells whether splice can write to fd, which it cannot in append mode. */
+static bool vtsh_relay_sink(int fd) {
+  if (vtsh_relay_pipe(fd)) {
+    return true;
+  }
+  const int flags = fcntl(fd, F_GETFL);
+  return vtsh_relay_file(fd) && flags != -1 &&
+         ((unsigned)flags & (unsigned)O_APPEND) == 0;
+}
+
+static int vtsh_relay_write(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    const ssize_t wrote = write(fd, data, size);
+    if (wrote == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    data += wrote;
+    size -= (size_t)wrote;
+  }
+  return 0;
+}
+
+static int vtsh_relay_copy(int in, int out, int copy) {
+  char* buffer = malloc(VTSH_RELAY_BUFFER);
+  if (buffer == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+  int status = 0;
+  for (;;) {
+    const ssize_t got = read(in, buffer, VTSH_RELAY_BUFFER);
+    if (got == -1 && errno == EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      status = (int)got;
+      break;
+    }
+    if (vtsh_relay_write(out, buffer, (size_t)got) == -1 ||
+        (copy != -1 && vtsh_relay_write(copy, buffer, (size_t)got) == -1)) {
+      status = -1;
+      break;
+    }
+  }
+  free(buffer);
+  return status;
+}
+
+/*
+ * Moves data with one of the calls below until the end of in. Returns 0, or
+ * 1 if the call does not work for these files and nothing was moved by it,
+ * or -1 on an error.
+ */
+static int vtsh_relay_loop(
+    ssize_t (*move)(int, int, size_t), int in, int out
+) {
+  bool moved = false;
+  for (;;) {
+    const ssize_t done = move(in, out, VTSH_RELAY_CHUNK);
+    if (done == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (!moved && (errno == EINVAL || errno == ENOSYS ||
+                     errno == EXDEV || errno == EOPNOTSUPP)) {
+        return 1;
+      }
+      return -1;
+    }
+    if (done == 0) {
+      return 0;
+    }
+    moved = true;
+  }
+}
+
+static ssize_t vtsh_relay_splice(int in, int out, size_t size) {
+  return splice(in, NULL, out, NULL, size, SPLICE_F_MOVE | SPLICE_F_MORE);
+}
+
+static ssize_t vtsh_relay_copy_range(int in, int out, size_t size) {
+  return copy_file_range(in, NULL, out, NULL, size, 0);
+}
+
+static ssize_t vtsh_relay_sendfile(int in, int out, size_t size) {
+  return sendfile(out, in, NULL, size);
+}
+
+/*
+ * Duplicates what is in the pipe in into the pipe out and then moves the
+ * same bytes from in to copy, so the data never leaves the pipe buffers.
+ */
+static int vtsh_relay_tee(int in, int out, int copy) {
+  bool moved = false;
+  for (;;) {
+    const ssize_t teed = tee(in, out, VTSH_RELAY_CHUNK, 0);
+    if (teed == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return (!moved && errno == EINVAL) ? 1 : -1;
+    }
+    if (teed == 0) {
+      return 0;
+    }
+    for (size_t left = (size_t)teed; left > 0;) {
+      const ssize_t done = splice(in, NULL, copy, NULL, left, SPLICE_F_MOVE);
+      if (done == -1 && errno == EINTR) {
+        continue;
+      }
+      if (done <= 0) {
+        return -1;
+      }
+      left -= (size_t)done;
+    }
+    moved = true;
+  }
+}
+
+int vtsh_relay(int in, int out, int copy) {
+  const bool in_pipe = vtsh_relay_pipe(in);
+  const bool out_pipe = vtsh_relay_pipe(out);
+  int status = 1;
+  if (copy != -1) {
+    if (in_pipe && out_pipe && vtsh_relay_sink(copy)) {
+      status = vtsh_relay_tee(in, out, copy);
+    }
+    return (status == 1) ? vtsh_relay_copy(in, out, copy) : status;
+  }
+
+  if (in_pipe || out_pipe) {
+    status = vtsh_relay_loop(vtsh_relay_splice, in, out);
+  }
+  if (status == 1 && vtsh_relay_file(in)) {
+    status = vtsh_relay_loop(vtsh_relay_copy_range, in, out);
+    if (status == 1) {
+      status = vtsh_relay_loop(vtsh_relay_sendfile, in, out);
+    }
+  }
+  return (status == 1) ? vtsh_relay_copy(in, out, -1) : status;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+/*
+ * Moves everything from in to out, and to copy as well unless it is -1,
+ * without bringing the data into user space where the kernel allows:
+ * splice when either end is a pipe, tee and splice to fill copy from a pipe
+ * to a pipe, and copy_file_range or sendfile from a file. Falls back to read
+ * and write for anything else. Returns 0 or -1 with errno.
+ */
+int vtsh_relay(int in, int out, int copy);
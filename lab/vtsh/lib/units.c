@@ -0,0 +1,69 @@
+#include "units.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define VTSH_NANO 1000000000ULL
+
+uint64_t vtsh_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec * VTSH_NANO) + (uint64_t)now.tv_nsec;
+}
+
+int vtsh_parse_size(const char* text, size_t* size) {
+  while (isspace((unsigned char)*text)) {
+    text += 1;
+  }
+  if (*text == '-') {
+    errno = EINVAL;
+    return -1;
+  }
+
+  char* end = NULL;
+  errno = 0;
+  const unsigned long long value = strtoull(text, &end, 0);
+  if (end == text) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (errno != 0 || value > SIZE_MAX) {
+    errno = ERANGE;
+    return -1;
+  }
+
+  unsigned shift = 0;
+  switch (*end) {
+    case 'K':
+    case 'k':
+      shift = 10U;
+      end += 1;
+      break;
+    case 'M':
+    case 'm':
+      shift = 20U;
+      end += 1;
+      break;
+    case 'G':
+    case 'g':
+      shift = 30U;
+      end += 1;
+      break;
+    default:
+      break;
+  }
+  if (*end != '\0') {
+    errno = EINVAL;
+    return -1;
+  }
+  if (value > (SIZE_MAX >> shift)) {
+    errno = ERANGE;
+    return -1;
+  }
+  *size = (size_t)value << shift;
+  return 0;
+}
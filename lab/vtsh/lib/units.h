@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Returns the monotonic clock in nanoseconds. */
+uint64_t vtsh_now(void);
+
+/*
+ * Parses a count or a size in bytes with an optional K, M or G suffix, in
+ * any base strtoull takes. Returns -1 with EINVAL if the text is not one,
+ * negative numbers included, or with ERANGE if it does not fit a size_t.
+ */
+int vtsh_parse_size(const char* text, size_t* size);
@@ -1,5 +1,623 @@
 #include "vtsh.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "builtin.h"
+#include "job.h"
+#include "launch.h"
+#include "parse.h"
+#include "path.h"
+#include "profile.h"
+
+#define VTSH_LINE_MIN 128
+#define VTSH_READ_BLOCK 4096
+#define VTSH_PIPE_SIZE (1024 * 1024)
+#define VTSH_STATUS_FAILED 1
+#define VTSH_STATUS_SYNTAX 2
+#define VTSH_STATUS_NOT_FOUND 127
+
+/* A builtin run in a child of the shell as a stage of a pipeline. */
+struct vtsh_call {
+  struct vtsh* shell;
+  vtsh_builtin builtin;
+  const struct vtsh_command* command;
+};
+
 const char* vtsh_prompt() {
   return "vtsh> ";
 }
+
+/* Reads how to time every pipeline from VTSH_TIME, if at all. */
+static enum vtsh_time vtsh_time_default(void) {
+  const char* time = getenv("VTSH_TIME");  // NOLINT(concurrency-mt-unsafe)
+  if (time == NULL) {
+    return VTSH_TIME_OFF;
+  }
+  if (strcmp(time, "text") == 0) {
+    return VTSH_TIME_TEXT;
+  }
+  if (strcmp(time, "json") == 0) {
+    return VTSH_TIME_JSON;
+  }
+  return VTSH_TIME_OFF;
+}
+
+int vtsh_init(struct vtsh* shell, bool job_control) {
+  const int launcher = vtsh_launcher_default();
+  if (launcher == -1) {
+    return -1;
+  }
+  *shell = (struct vtsh){
+      .launcher = (enum vtsh_launcher)launcher,
+      .job_control = job_control,
+      .terminal = (job_control && isatty(STDIN_FILENO)) ? STDIN_FILENO : -1,
+      .null = -1,
+      .time = vtsh_time_default(),
+  };
+  vtsh_path_init(&shell->paths);
+  return vtsh_jobs_init(&shell->jobs);
+}
+
+void vtsh_destroy(struct vtsh* shell) {
+  vtsh_jobs_destroy(&shell->jobs);
+  vtsh_path_destroy(&shell->paths);
+  if (shell->null != -1) {
+    close(shell->null);
+  }
+}
+
+/* Makes room for size bytes of the line and the null after them. */
+static int vtsh_line_reserve(char** line, size_t* capacity, size_t size) {
+  size_t grown = (*capacity == 0) ? VTSH_LINE_MIN : *capacity;
+  while (size + 1 > grown) {
+    grown *= 2;
+  }
+  if (grown == *capacity) {
+    return 0;
+  }
+  char* buffer = realloc(*line, grown);
+  if (buffer == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+  *line = buffer;
+  *capacity = grown;
+  return 0;
+}
+
+ssize_t vtsh_read_line(int fd, char** line, size_t* capacity) {
+  struct stat st;
+  const bool seekable = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+  const off_t start = seekable ? lseek(fd, 0, SEEK_CUR) : -1;
+  const size_t block = (start != -1) ? VTSH_READ_BLOCK : 1;
+
+  size_t length = 0;
+  for (;;) {
+    if (vtsh_line_reserve(line, capacity, length + block) == -1) {
+      return -1;
+    }
+    const ssize_t got = read(fd, *line + length, block);
+    if (got == -1 && errno == EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      if (length == 0) {
+        return -1;
+      }
+      break;
+    }
+    const char* newline = memchr(*line + length, '\n', (size_t)got);
+    if (newline != NULL) {
+      length = (size_t)(newline - *line);
+      if (start != -1) {
+        lseek(fd, start + (off_t)length + 1, SEEK_SET);
+      }
+      break;
+    }
+    length += (size_t)got;
+  }
+  (*line)[length] = '\0';
+  return (ssize_t)length;
+}
+
+/* Starts the program, looking it up again if its cached path is gone. */
+static pid_t vtsh_start(
+    struct vtsh* shell, char** argv, const struct vtsh_launch_attr* attr
+) {
+  const char* path = vtsh_path_find(&shell->paths, argv[0]);
+  if (path == NULL) {
+    return -1;
+  }
+  pid_t pid = vtsh_launch(shell->launcher, path, argv, environ, attr);
+  if (pid == -1 && errno == ENOENT && strchr(argv[0], '/') == NULL) {
+    vtsh_path_forget(&shell->paths, argv[0]);
+    path = vtsh_path_find(&shell->paths, argv[0]);
+    pid = (path != NULL)
+              ? vtsh_launch(shell->launcher, path, argv, environ, attr)
+              : -1;
+  }
+  return pid;
+}
+
+/* Takes the terminal back for the shell once a pipeline is done. */
+static void vtsh_take_terminal(const struct vtsh* shell) {
+  if (shell->terminal == -1) {
+    return;
+  }
+  sigset_t ttou;
+  sigset_t mask;
+  sigemptyset(&ttou);
+  sigaddset(&ttou, SIGTTOU);
+  pthread_sigmask(SIG_BLOCK, &ttou, &mask);
+  tcsetpgrp(shell->terminal, getpgrp());
+  pthread_sigmask(SIG_SETMASK, &mask, NULL);
+}
+
+/*
+ * Opens the files the command is redirected to, the input first so that a
+ * missing one does not leave an empty output behind.
+ */
+static int vtsh_redirect(
+    const struct vtsh_command* command, int* input, int* output
+) {
+  *input = -1;
+  *output = -1;
+  if (command->input != NULL) {
+    *input = open(command->input, O_RDONLY | O_CLOEXEC);
+    if (*input == -1) {
+      return -1;
+    }
+  }
+  if (command->output != NULL) {
+    *output = open(
+        command->output,
+        O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+        VTSH_FILE_MODE
+    );
+    if (*output == -1) {
+      if (*input != -1) {
+        close(*input);
+      }
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static void vtsh_close(int fd) {
+  if (fd != -1) {
+    close(fd);
+  }
+}
+
+/* Points a standard descriptor at fd, returning a copy of the old one. */
+static int vtsh_swap(int fd, int target) {
+  if (fd == -1) {
+    return -1;
+  }
+  const int saved = fcntl(target, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+  dup2(fd, target);
+  return saved;
+}
+
+static void vtsh_restore(int saved, int target) {
+  if (saved != -1) {
+    dup2(saved, target);
+    close(saved);
+  }
+}
+
+/* Runs a builtin in the shell itself, with its redirections in place. */
+static int vtsh_run_builtin(
+    struct vtsh* shell,
+    vtsh_builtin builtin,
+    const struct vtsh_command* command
+) {
+  int input = -1;
+  int output = -1;
+  if (vtsh_redirect(command, &input, &output) == -1) {
+    printf("I/O error\n");
+    return VTSH_STATUS_FAILED;
+  }
+  /* Output stays buffered unless it has to go to another file. */
+  const bool redirected = input != -1 || output != -1;
+  if (redirected) {
+    fflush(stdout);
+  }
+  const int saved_input = vtsh_swap(input, STDIN_FILENO);
+  const int saved_output = vtsh_swap(output, STDOUT_FILENO);
+  const int status = builtin(shell, command->argc, command->argv);
+  if (redirected) {
+    fflush(stdout);
+  }
+  vtsh_restore(saved_input, STDIN_FILENO);
+  vtsh_restore(saved_output, STDOUT_FILENO);
+  vtsh_close(input);
+  vtsh_close(output);
+  return status;
+}
+
+/* The children that run builtins have no jobs of their own to wait for. */
+static int vtsh_call(void* arg) {
+  const struct vtsh_call* call = arg;
+  call->shell->subshell = true;
+  const int status =
+      call->builtin(call->shell, call->command->argc, call->command->argv);
+  fflush(stdout);
+  return status;
+}
+
+/*
+ * Starts a stage of a pipeline set up as attr says, unless its redirections
+ * replace the ends of its pipes. Returns its pid, or -1 with the status it
+ * failed with.
+ */
+static pid_t vtsh_stage(
+    struct vtsh* shell,
+    const struct vtsh_command* command,
+    struct vtsh_launch_attr attr,
+    int* status
+) {
+  int input = -1;
+  int output = -1;
+  if (vtsh_redirect(command, &input, &output) == -1) {
+    printf("I/O error\n");
+    fflush(stdout);
+    *status = VTSH_STATUS_FAILED;
+    return -1;
+  }
+  if (command->argc == 0) {
+    vtsh_close(input);
+    vtsh_close(output);
+    *status = 0;
+    return -1;
+  }
+
+  attr.input = (input != -1) ? input : attr.input;
+  attr.output = (output != -1) ? output : attr.output;
+  const vtsh_builtin builtin = vtsh_builtin_find(command->argv[0]);
+  struct vtsh_call call = {
+      .shell = shell,
+      .builtin = builtin,
+      .command = command,
+  };
+  const pid_t pid = (builtin != NULL)
+                        ? vtsh_launch_call(&attr, vtsh_call, &call)
+                        : vtsh_start(shell, command->argv, &attr);
+  const int error = errno;
+  vtsh_close(input);
+  vtsh_close(output);
+
+  if (pid == -1 && (error == ENOENT || error == EACCES || error == ENOEXEC)) {
+    printf("Command not found\n");
+    *status = VTSH_STATUS_NOT_FOUND;
+  } else if (pid == -1) {
+    errno = error;
+    perror("vtsh");
+    *status = VTSH_STATUS_NOT_FOUND;
+  }
+  /* Builtins forked for the next stages must not print it again. */
+  fflush(stdout);
+  return pid;
+}
+
+/*
+ * Returns what a background job reads unless redirected: /dev/null without
+ * a terminal, as the input of the shell is for the foreground, and the
+ * terminal otherwise, which stops a background job that reads from it.
+ */
+static int vtsh_background_input(struct vtsh* shell) {
+  if (shell->terminal != -1) {
+    return -1;
+  }
+  if (shell->null == -1) {
+    shell->null = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  }
+  return shell->null;
+}
+
+/*
+ * Starts every stage of the pipeline for the job before it waits for any,
+ * so they run at once, in a process group of their own with job control,
+ * which the first stage to start leads. The pipes between them are made as
+ * large as the system lets them be, so the stages switch less.
+ */
+static void vtsh_start_pipeline(
+    struct vtsh* shell,
+    struct vtsh_job* job,
+    const struct vtsh_pipeline* pipeline
+) {
+  const bool foreground = job->id == 0;
+  job->pgid = 0;
+  /* Output buffered so far goes before that of the commands. */
+  fflush(stdout);
+  for (size_t i = 0; i < pipeline->count; ++i) {
+    job->processes[i] =
+        (struct vtsh_process){.pid = -1, .pidfd = -1, .job = job};
+  }
+
+  int input = foreground ? -1 : vtsh_background_input(shell);
+  for (size_t i = 0; i < pipeline->count; ++i) {
+    struct vtsh_process* process = &job->processes[i];
+    int output = -1;
+    int next = -1;
+    if (i + 1 < pipeline->count) {
+      int ends[2];
+      if (pipe2(ends, O_CLOEXEC) == -1) {
+        perror("vtsh");
+        process->status = VTSH_STATUS_FAILED;
+        job->processes[pipeline->count - 1].status = VTSH_STATUS_FAILED;
+        break;
+      }
+      fcntl(ends[1], F_SETPIPE_SZ, VTSH_PIPE_SIZE);
+      output = ends[1];
+      next = ends[0];
+    }
+
+    const struct vtsh_launch_attr attr = {
+        .input = input,
+        .output = output,
+        .pgid = shell->job_control ? job->pgid : -1,
+        .terminal = foreground ? shell->terminal : -1,
+    };
+    process->pid =
+        vtsh_stage(shell, &pipeline->commands[i], attr, &process->status);
+    if (process->pid != -1) {
+      job->running += 1;
+      if (job->pgid == 0) {
+        job->pgid = process->pid;
+      }
+    }
+    if (input != shell->null) {
+      vtsh_close(input);
+    }
+    vtsh_close(output);
+    input = next;
+  }
+  if (input != shell->null) {
+    vtsh_close(input);
+  }
+
+  /* Watched once all are started, so the job cannot finish halfway. */
+  for (size_t i = 0; i < pipeline->count; ++i) {
+    if (job->processes[i].pid != -1) {
+      vtsh_jobs_watch(&shell->jobs, &job->processes[i]);
+    }
+  }
+}
+
+/*
+ * Stops timing the pipeline of the job that is done and tells the user
+ * what it cost, after what it printed.
+ */
+static void vtsh_job_report(struct vtsh_job* job) {
+  if (job->profile == NULL) {
+    return;
+  }
+  vtsh_profile_stop(job->profile);
+  fflush(stdout);
+  vtsh_profile_report(job->profile, stderr);
+  free(job->profile);
+  job->profile = NULL;
+}
+
+/* Starts timing a pipeline, unless it is not timed or there is no memory. */
+static void vtsh_job_profile(
+    const struct vtsh* shell,
+    struct vtsh_job* job,
+    const struct vtsh_pipeline* pipeline
+) {
+  const enum vtsh_time time =
+      (pipeline->time != VTSH_TIME_OFF) ? pipeline->time : shell->time;
+  if (time == VTSH_TIME_OFF) {
+    return;
+  }
+  job->profile = malloc(sizeof(struct vtsh_profile));
+  if (job->profile != NULL) {
+    vtsh_profile_start(job->profile, time);
+  }
+}
+
+/*
+ * Starts a pipeline of the job. A lone builtin of the foreground job runs
+ * in the shell right away, so cd and exit work, and is timed as the shell,
+ * as it is not a process of its own.
+ */
+static int vtsh_job_start(
+    struct vtsh* shell,
+    struct vtsh_job* job,
+    const struct vtsh_pipeline* pipeline
+) {
+  const struct vtsh_command* command = &pipeline->commands[0];
+  const vtsh_builtin builtin =
+      (job->id == 0 && pipeline->count == 1 && command->argc != 0)
+          ? vtsh_builtin_find(command->argv[0])
+          : NULL;
+  job->count = 0;
+  vtsh_job_profile(shell, job, pipeline);
+  if (builtin != NULL) {
+    if (job->profile != NULL) {
+      vtsh_profile_self(job->profile);
+    }
+    job->status = vtsh_run_builtin(shell, builtin, command);
+    vtsh_job_report(job);
+    return 0;
+  }
+
+  struct vtsh_process* processes =
+      realloc(job->processes, pipeline->count * sizeof(struct vtsh_process));
+  if (processes == NULL) {
+    errno = ENOMEM;
+    perror("vtsh");
+    job->status = VTSH_STATUS_FAILED;
+    vtsh_job_report(job);
+    return -1;
+  }
+  job->processes = processes;
+  job->count = pipeline->count;
+  vtsh_start_pipeline(shell, job, pipeline);
+  return 0;
+}
+
+/*
+ * Moves the job on once its pipeline is done: takes the status of the last
+ * stage and starts the next pipeline that && and || let run, and so on
+ * while they finish at once. Returns whether the chain is done.
+ */
+static bool vtsh_job_step(struct vtsh* shell, struct vtsh_job* job) {
+  while (job->running == 0) {
+    if (job->count != 0) {
+      job->status = job->processes[job->count - 1].status;
+      job->count = 0;
+      vtsh_job_report(job);
+      if (job->id == 0 && job->pgid != 0 && shell->job_control) {
+        vtsh_take_terminal(shell);
+      }
+    }
+
+    const struct vtsh_pipeline* pipeline = NULL;
+    while (pipeline == NULL && job->next < job->chain->count) {
+      const struct vtsh_pipeline* candidate =
+          &job->chain->pipelines[job->next++];
+      if ((candidate->join == VTSH_JOIN_AND && job->status != 0) ||
+          (candidate->join == VTSH_JOIN_OR && job->status == 0)) {
+        continue;
+      }
+      pipeline = candidate;
+    }
+    if (pipeline == NULL || shell->done) {
+      job->done = true;
+      return true;
+    }
+    vtsh_job_start(shell, job, pipeline);
+  }
+  return false;
+}
+
+/* Tells the user about a background job that is done and forgets it. */
+static void vtsh_job_finish(struct vtsh* shell, struct vtsh_job* job) {
+  if (shell->terminal != -1) {
+    if (job->status == 0) {
+      fprintf(stderr, "[%zu] Done\n", job->id);
+    } else {
+      fprintf(stderr, "[%zu] Exit %d\n", job->id, job->status);
+    }
+  }
+  vtsh_jobs_remove(&shell->jobs, job);
+}
+
+/* Moves on every job whose pipeline is done. */
+static void vtsh_dispatch(struct vtsh* shell) {
+  struct vtsh_job* job = NULL;
+  while ((job = vtsh_jobs_finished(&shell->jobs)) != NULL) {
+    if (vtsh_job_step(shell, job) && job->id != 0) {
+      vtsh_job_finish(shell, job);
+    }
+  }
+}
+
+/* Waits for events until the job is done, moving the others on as well. */
+static void vtsh_job_wait(struct vtsh* shell, const struct vtsh_job* job) {
+  while (!job->done) {
+    if (vtsh_jobs_poll(&shell->jobs, -1, -1) == -1) {
+      perror("vtsh");
+      return;
+    }
+    vtsh_dispatch(shell);
+  }
+}
+
+static void vtsh_run_foreground(
+    struct vtsh* shell, struct vtsh_line* line, const struct vtsh_chain* chain
+) {
+  struct vtsh_job job = {.line = line, .chain = chain};
+  if (!vtsh_job_step(shell, &job)) {
+    vtsh_job_wait(shell, &job);
+  }
+  if (job.profile != NULL) {
+    vtsh_profile_cancel(job.profile);
+    free(job.profile);
+  }
+  free(job.processes);
+  shell->status = job.status;
+}
+
+static void vtsh_run_background(
+    struct vtsh* shell, struct vtsh_line* line, const struct vtsh_chain* chain
+) {
+  struct vtsh_job* job = calloc(1, sizeof(struct vtsh_job));
+  if (job == NULL || vtsh_jobs_add(&shell->jobs, job) == -1) {
+    free(job);
+    errno = ENOMEM;
+    perror("vtsh");
+    shell->status = VTSH_STATUS_FAILED;
+    return;
+  }
+  job->line = line;
+  job->chain = chain;
+  line->users += 1;
+
+  if (vtsh_job_step(shell, job)) {
+    vtsh_job_finish(shell, job);
+  } else if (shell->terminal != -1) {
+    fprintf(stderr, "[%zu] %d\n", job->id, (int)job->pgid);
+  }
+  shell->status = 0;
+}
+
+void vtsh_wait_input(struct vtsh* shell, int fd) {
+  if (fd == -1 && shell->jobs.count == 0) {
+    return;
+  }
+  int readable = 0;
+  do {
+    readable = vtsh_jobs_poll(&shell->jobs, fd, (fd == -1) ? 0 : -1);
+    vtsh_dispatch(shell);
+  } while (readable == 0 && fd != -1);
+}
+
+void vtsh_wait_jobs(struct vtsh* shell) {
+  while (!shell->subshell && shell->jobs.count > 0) {
+    if (vtsh_jobs_poll(&shell->jobs, -1, -1) == -1) {
+      perror("vtsh");
+      return;
+    }
+    vtsh_dispatch(shell);
+  }
+}
+
+int vtsh_run(struct vtsh* shell, char* line) {
+  struct vtsh_line* parsed = vtsh_parse(line);
+  if (parsed == NULL) {
+    if (errno == EINVAL) {
+      printf("Syntax error\n");
+      shell->status = VTSH_STATUS_SYNTAX;
+    } else {
+      perror("vtsh");
+    }
+    return shell->status;
+  }
+
+  for (size_t i = 0; i < parsed->count && !shell->done; ++i) {
+    const struct vtsh_chain* chain = &parsed->chains[i];
+    if (chain->background) {
+      vtsh_run_background(shell, parsed, chain);
+    } else {
+      vtsh_run_foreground(shell, parsed, chain);
+    }
+  }
+  vtsh_line_release(parsed);
+  return shell->status;
+}
@@ -1,3 +1,75 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "job.h"
+#include "launch.h"
+#include "path.h"
+#include "profile.h"
+
+/* The mode of the files the shell creates, before the umask. */
+#define VTSH_FILE_MODE 0666
+
+/*
+ * The state a shell keeps from one command to the next. With job control,
+ * every pipeline runs in a process group of its own, which gets the
+ * terminal while it runs in the foreground if there is one. Null is
+ * /dev/null once opened for background jobs. Time reports every pipeline
+ * as if it started with time, when VTSH_TIME is text or json. Subshell is
+ * set in the children that run builtins. Done is set once a command asks
+ * the shell to stop, with status as its exit status.
+ */
+struct vtsh {
+  enum vtsh_launcher launcher;
+  struct vtsh_path paths;
+  struct vtsh_jobs jobs;
+  bool job_control;
+  int terminal;
+  int null;
+  enum vtsh_time time;
+  int status;
+  bool subshell;
+  bool done;
+};
+
 const char* vtsh_prompt();
+
+/*
+ * Sets up a shell with the launcher chosen by vtsh_launcher_default, with
+ * job control for an interactive one.
+ */
+int vtsh_init(struct vtsh* shell, bool job_control);
+
+void vtsh_destroy(struct vtsh* shell);
+
+/*
+ * Reads a line from fd without reading past its end, which the commands the
+ * shell runs would miss otherwise: a file that can seek is read a block at a
+ * time and sought back to the end of the line, anything else byte by byte.
+ * Returns the length of the line without its newline, or -1 at the end of
+ * the input.
+ */
+ssize_t vtsh_read_line(int fd, char** line, size_t* capacity);
+
+/*
+ * Runs the chains of a line, each made of pipelines of commands that are
+ * builtins or programs found in PATH, telling the user about errors, and
+ * returns the exit status of the last foreground pipeline, also kept as the
+ * status of the shell. A chain that ends with & runs in the background and
+ * the rest in the foreground, which the shell waits for while it moves the
+ * background jobs on. A builtin runs in the shell itself unless it is part
+ * of a longer pipeline or of a background job.
+ */
+int vtsh_run(struct vtsh* shell, char* line);
+
+/*
+ * Moves the background jobs on until fd is readable, or only for the jobs
+ * that are done already if fd is -1. A line that comes in part may still
+ * block the read that follows until the rest of it comes.
+ */
+void vtsh_wait_input(struct vtsh* shell, int fd);
+
+/* Waits until every background job is done. */
+void vtsh_wait_jobs(struct vtsh* shell);
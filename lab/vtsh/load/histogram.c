@@ -0,0 +1,92 @@
+#include "histogram.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOAD_HISTOGRAM_BITS_MAX 63U
+#define LOAD_PERCENT 100.0
+
+void load_histogram_init(struct load_histogram* histogram) {
+  *histogram = (struct load_histogram){.min = UINT64_MAX};
+}
+
+/*
+ * Values below LOAD_HISTOGRAM_SUB get a bucket each. Above, the top
+ * LOAD_HISTOGRAM_BITS bits after the highest one pick the bucket among
+ * those of the power of two.
+ */
+static size_t load_histogram_index(uint64_t value) {
+  if (value < LOAD_HISTOGRAM_SUB) {
+    return (size_t)value;
+  }
+  const unsigned high =
+      LOAD_HISTOGRAM_BITS_MAX - (unsigned)__builtin_clzll(value);
+  const unsigned shift = high - LOAD_HISTOGRAM_BITS;
+  return ((size_t)(shift + 1) * LOAD_HISTOGRAM_SUB) +
+         (size_t)((value >> shift) - LOAD_HISTOGRAM_SUB);
+}
+
+/* Returns the middle of the values that fall in the bucket. */
+static uint64_t load_histogram_value(size_t index) {
+  if (index < LOAD_HISTOGRAM_SUB) {
+    return index;
+  }
+  const unsigned shift = (unsigned)(index / LOAD_HISTOGRAM_SUB) - 1;
+  const uint64_t low = (uint64_t)((index % LOAD_HISTOGRAM_SUB) +
+                                  LOAD_HISTOGRAM_SUB)
+                       << shift;
+  return low + ((1ULL << shift) / 2);
+}
+
+void load_histogram_add(struct load_histogram* histogram, uint64_t value) {
+  histogram->buckets[load_histogram_index(value)] += 1;
+  histogram->count += 1;
+  histogram->total += value;
+  if (value < histogram->min) {
+    histogram->min = value;
+  }
+  if (value > histogram->max) {
+    histogram->max = value;
+  }
+}
+
+void load_histogram_merge(
+    struct load_histogram* histogram, const struct load_histogram* other
+) {
+  for (size_t i = 0; i < LOAD_HISTOGRAM_BUCKETS; ++i) {
+    histogram->buckets[i] += other->buckets[i];
+  }
+  histogram->count += other->count;
+  histogram->total += other->total;
+  if (other->min < histogram->min) {
+    histogram->min = other->min;
+  }
+  if (other->max > histogram->max) {
+    histogram->max = other->max;
+  }
+}
+
+uint64_t load_histogram_percentile(
+    const struct load_histogram* histogram, double percent
+) {
+  if (histogram->count == 0) {
+    return 0;
+  }
+  uint64_t rank =
+      (uint64_t)((double)histogram->count * percent / LOAD_PERCENT);
+  if (rank >= histogram->count) {
+    rank = histogram->count - 1;
+  }
+  uint64_t seen = 0;
+  for (size_t i = 0; i < LOAD_HISTOGRAM_BUCKETS; ++i) {
+    seen += histogram->buckets[i];
+    if (seen > rank) {
+      const uint64_t value = load_histogram_value(i);
+      if (value < histogram->min) {
+        return histogram->min;
+      }
+      return (value > histogram->max) ? histogram->max : value;
+    }
+  }
+  return histogram->max;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+/* The sub-buckets each power of two is split into, as a power of two. */
+#define LOAD_HISTOGRAM_BITS 5U
+#define LOAD_HISTOGRAM_SUB (1U << LOAD_HISTOGRAM_BITS)
+#define LOAD_HISTOGRAM_BUCKETS \
+  ((64U - LOAD_HISTOGRAM_BITS + 1U) * LOAD_HISTOGRAM_SUB)
+
+/*
+ * Latencies in nanoseconds, counted in buckets whose width grows with the
+ * power of two they fall in, so that any percentile is off by no more than
+ * one part in LOAD_HISTOGRAM_SUB while adding one costs a few instructions.
+ */
+struct load_histogram {
+  uint64_t count;
+  uint64_t total;
+  uint64_t min;
+  uint64_t max;
+  uint64_t buckets[LOAD_HISTOGRAM_BUCKETS];
+};
+
+void load_histogram_init(struct load_histogram* histogram);
+
+void load_histogram_add(struct load_histogram* histogram, uint64_t value);
+
+void load_histogram_merge(
+    struct load_histogram* histogram, const struct load_histogram* other
+);
+
+/* Returns the latency below which the given percent of them fall. */
+uint64_t load_histogram_percentile(
+    const struct load_histogram* histogram, double percent
+);
@@ -0,0 +1,448 @@
+#include "io.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "histogram.h"
+#include "units.h"
+
+#define LOAD_BLOCK_SIZE 4096
+#define LOAD_BLOCK_COUNT 65536
+#define LOAD_SECTOR 512
+#define LOAD_NS_PER_S 1000000000.0
+#define LOAD_NS_PER_US 1000.0
+#define LOAD_BYTES_PER_MB 1000000.0
+#define LOAD_SEED 0x9E3779B97F4A7C15ULL
+#define LOAD_MULTIPLIER 0x2545F4914F6CDD1DULL
+#define LOAD_PATTERN 0x5A
+
+static const char* const usage =
+    "usage: vtsh_io_load --file FILE [options]\n"
+    "  --rw read|write          what to do with the blocks, read by default\n"
+    "  --block-size SIZE        bytes per block, with an optional K, M or G,\n"
+    "                           4K by default\n"
+    "  --block-count N          blocks to move in all, 64K by default\n"
+    "  --file PATH              the file or device to move them to or from\n"
+    "  --range START-END        the bytes of the file to use, 0-0 for the\n"
+    "                           whole file, the default; a write to a file\n"
+    "                           too small for a block uses as much as it\n"
+    "                           writes\n"
+    "  --direct on|off          open the file with O_DIRECT, off by default\n"
+    "  --type sequence|random   the order of the blocks, sequence by default\n"
+    "  --threads N              threads that share the blocks, 1 by default\n"
+    "  --iodepth N              requests in flight per thread with the uring\n"
+    "                           engine, 1 by default\n"
+    "  --engine psync|uring|vtpc\n"
+    "                           pread and pwrite, io_uring, or the vtpc page\n"
+    "                           cache, psync by default\n"
+    "\n"
+    "The options are also taken with underscores, as in --block_size. Each\n"
+    "thread opens the file on its own and moves its share of the blocks,\n"
+    "starting at its own part of the range for a sequence. The report gives\n"
+    "the IOPS and MB/s of every thread and of the whole run, along with the\n"
+    "percentiles of the latency of a block, from its submission to its\n"
+    "completion.\n";
+
+/* The percentiles of the latency that are reported. */
+static const double percentiles[] = {50.0, 90.0, 99.0, 99.9};
+
+/* Steps the xorshift64* generator of the worker. */
+static uint64_t load_random(struct load_worker* worker) {
+  uint64_t x = worker->random;
+  x ^= x >> 12U;
+  x ^= x << 25U;
+  x ^= x >> 27U;
+  worker->random = x;
+  return x * LOAD_MULTIPLIER;
+}
+
+off_t load_next(struct load_worker* worker) {
+  size_t slot = 0;
+  if (worker->options->type == LOAD_RANDOM) {
+    slot = (size_t)(load_random(worker) % worker->slots);
+  } else {
+    slot = worker->slot;
+    worker->slot = (slot + 1 == worker->slots) ? 0 : slot + 1;
+  }
+  return worker->options->start +
+         (off_t)(slot * worker->options->block_size);
+}
+
+int load_flags(const struct load_options* options) {
+  int flags = O_CLOEXEC;
+  flags |= (options->rw == LOAD_WRITE) ? O_WRONLY | O_CREAT : O_RDONLY;
+  if (options->direct) {
+    flags |= O_DIRECT;
+  }
+  return flags;
+}
+
+int load_short(const struct load_options* options) {
+  return (options->rw == LOAD_WRITE) ? ENOSPC : ENODATA;
+}
+
+void* load_buffer(size_t size) {
+  const size_t aligned =
+      (size + LOAD_ALIGNMENT - 1) / LOAD_ALIGNMENT * LOAD_ALIGNMENT;
+  void* buffer = NULL;
+  if (posix_memalign(&buffer, LOAD_ALIGNMENT, aligned) != 0) {
+    return NULL;
+  }
+  memset(buffer, LOAD_PATTERN, aligned);
+  return buffer;
+}
+
+static int load_range(char* text, struct load_options* options) {
+  char* dash = strchr(text, '-');
+  if (dash == NULL) {
+    return -1;
+  }
+  *dash = '\0';
+  size_t start = 0;
+  size_t end = 0;
+  const int status = (vtsh_parse_size(text, &start) == 0 &&
+                      vtsh_parse_size(dash + 1, &end) == 0)
+                         ? 0
+                         : -1;
+  *dash = '-';
+  if (status == -1 || (end != 0 && end <= start)) {
+    return -1;
+  }
+  options->start = (off_t)start;
+  options->end = (off_t)end;
+  return 0;
+}
+
+/* Returns the index of the word in the NULL-terminated list, or -1. */
+static int load_word(const char* word, const char* const* words) {
+  for (int i = 0; words[i] != NULL; ++i) {
+    if (strcmp(word, words[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int load_option(int option, struct load_options* options) {
+  static const char* const rws[] = {"read", "write", NULL};
+  static const char* const switches[] = {"off", "on", NULL};
+  static const char* const types[] = {"sequence", "random", NULL};
+  static const char* const engines[] = {"psync", "uring", "vtpc", NULL};
+  int word = 0;
+  switch (option) {
+    case 'w':
+      word = load_word(optarg, rws);
+      options->rw = (enum load_rw)word;
+      return (word == -1) ? -1 : 0;
+    case 'b':
+      return (vtsh_parse_size(optarg, &options->block_size) == -1 ||
+              options->block_size == 0)
+                 ? -1
+                 : 0;
+    case 'c':
+      return (vtsh_parse_size(optarg, &options->block_count) == -1) ? -1 : 0;
+    case 'f':
+      options->file = optarg;
+      return 0;
+    case 'r':
+      return load_range(optarg, options);
+    case 'd':
+      word = load_word(optarg, switches);
+      options->direct = word == 1;
+      return (word == -1) ? -1 : 0;
+    case 't':
+      word = load_word(optarg, types);
+      options->type = (enum load_type)word;
+      return (word == -1) ? -1 : 0;
+    case 'n':
+      return (vtsh_parse_size(optarg, &options->threads) == -1 ||
+              options->threads == 0)
+                 ? -1
+                 : 0;
+    case 'q':
+      return (vtsh_parse_size(optarg, &options->iodepth) == -1 ||
+              options->iodepth == 0 || options->iodepth > UINT16_MAX)
+                 ? -1
+                 : 0;
+    case 'e':
+      word = load_word(optarg, engines);
+      options->engine = (enum load_engine)word;
+      return (word == -1) ? -1 : 0;
+    default:
+      return -1;
+  }
+}
+
+/* Checks what the options cannot say on their own. */
+static int load_check(const struct load_options* options) {
+  if (options->file == NULL) {
+    fputs(usage, stderr);
+    return -1;
+  }
+#ifndef VTSH_VTPC
+  if (options->engine == LOAD_VTPC) {
+    fprintf(stderr, "vtsh_io_load: built without vtpc\n");
+    return -1;
+  }
+#endif
+  if (options->iodepth > 1 && options->engine != LOAD_URING) {
+    fprintf(stderr, "vtsh_io_load: an iodepth above 1 needs uring\n");
+    return -1;
+  }
+  if (options->direct && (options->block_size % LOAD_SECTOR != 0 ||
+                          options->start % LOAD_SECTOR != 0)) {
+    fprintf(
+        stderr,
+        "vtsh_io_load: direct blocks must be aligned to %d bytes\n",
+        LOAD_SECTOR
+    );
+    return -1;
+  }
+  return 0;
+}
+
+static int load_parse(int argc, char** argv, struct load_options* options) {
+  static const struct option long_options[] = {
+      {"rw", required_argument, NULL, 'w'},
+      {"block-size", required_argument, NULL, 'b'},
+      {"block_size", required_argument, NULL, 'b'},
+      {"block-count", required_argument, NULL, 'c'},
+      {"block_count", required_argument, NULL, 'c'},
+      {"file", required_argument, NULL, 'f'},
+      {"range", required_argument, NULL, 'r'},
+      {"direct", required_argument, NULL, 'd'},
+      {"type", required_argument, NULL, 't'},
+      {"threads", required_argument, NULL, 'n'},
+      {"iodepth", required_argument, NULL, 'q'},
+      {"engine", required_argument, NULL, 'e'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0},
+  };
+
+  *options = (struct load_options){
+      .rw = LOAD_READ,
+      .block_size = LOAD_BLOCK_SIZE,
+      .block_count = LOAD_BLOCK_COUNT,
+      .type = LOAD_SEQUENCE,
+      .threads = 1,
+      .iodepth = 1,
+      .engine = LOAD_PSYNC,
+  };
+  int option = 0;
+  while ((option = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+    if (option == 'h' || option == '?') {
+      fputs(usage, stderr);
+      return -1;
+    }
+    if (load_option(option, options) == -1) {
+      fprintf(stderr, "vtsh_io_load: bad value %s\n", optarg);
+      return -1;
+    }
+  }
+  if (optind != argc) {
+    fputs(usage, stderr);
+    return -1;
+  }
+  return load_check(options);
+}
+
+/*
+ * Turns an open range into the whole file, which a write that would find
+ * no block in it extends by the blocks it writes. The size comes from the
+ * end of the file, as that of a block device does.
+ */
+static int load_resolve(struct load_options* options) {
+  if (options->end == 0) {
+    off_t size = 0;
+    const int fd = open(options->file, O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+      size = lseek(fd, 0, SEEK_END);
+      close(fd);
+    } else if (errno != ENOENT || options->rw != LOAD_WRITE) {
+      perror(options->file);
+      return -1;
+    }
+    const off_t block = (off_t)options->block_size;
+    if (options->rw == LOAD_WRITE && size < options->start + block) {
+      size = options->start + (block * (off_t)options->block_count);
+    }
+    options->end = size;
+  }
+  if (options->end - options->start < (off_t)options->block_size) {
+    fprintf(stderr, "vtsh_io_load: the range holds no block\n");
+    return -1;
+  }
+  return 0;
+}
+
+static void* load_thread(void* arg) {
+  struct load_worker* worker = arg;
+  if (worker->options->engine == LOAD_URING) {
+    load_uring(worker);
+  } else {
+    load_sync(worker);
+  }
+  return NULL;
+}
+
+static double load_mb(uint64_t bytes, uint64_t ns) {
+  return (ns == 0) ? 0.0
+                   : (double)bytes / LOAD_BYTES_PER_MB /
+                         ((double)ns / LOAD_NS_PER_S);
+}
+
+static double load_iops(uint64_t ops, uint64_t ns) {
+  return (ns == 0) ? 0.0 : (double)ops / ((double)ns / LOAD_NS_PER_S);
+}
+
+static double load_us(uint64_t ns) {
+  return (double)ns / LOAD_NS_PER_US;
+}
+
+static void load_report(
+    const struct load_options* options,
+    const struct load_worker* workers,
+    uint64_t elapsed
+) {
+  static const char* const rws[] = {"read", "write"};
+  static const char* const types[] = {"sequence", "random"};
+  static const char* const engines[] = {"psync", "uring", "vtpc"};
+  printf(
+      "%s %zu blocks of %zu bytes, %s, %s, direct %s, %zu threads, "
+      "iodepth %zu\n",
+      rws[options->rw],
+      options->block_count,
+      options->block_size,
+      types[options->type],
+      engines[options->engine],
+      options->direct ? "on" : "off",
+      options->threads,
+      options->iodepth
+  );
+
+  struct load_histogram latency;
+  load_histogram_init(&latency);
+  uint64_t ops = 0;
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < options->threads; ++i) {
+    const struct load_worker* worker = &workers[i];
+    printf(
+        "thread %zu: %.0f IOPS, %.1f MB/s, %.3f s\n",
+        i,
+        load_iops(worker->ops, worker->elapsed),
+        load_mb(worker->bytes, worker->elapsed),
+        (double)worker->elapsed / LOAD_NS_PER_S
+    );
+    load_histogram_merge(&latency, &worker->latency);
+    ops += worker->ops;
+    bytes += worker->bytes;
+  }
+  printf(
+      "total: %llu blocks, %llu bytes in %.3f s, %.0f IOPS, %.1f MB/s\n",
+      (unsigned long long)ops,
+      (unsigned long long)bytes,
+      (double)elapsed / LOAD_NS_PER_S,
+      load_iops(ops, elapsed),
+      load_mb(bytes, elapsed)
+  );
+  if (latency.count == 0) {
+    return;
+  }
+  printf(
+      "latency us: min %.1f, mean %.1f",
+      load_us(latency.min),
+      load_us(latency.total / latency.count)
+  );
+  for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i) {
+    printf(
+        ", p%g %.1f",
+        percentiles[i],
+        load_us(load_histogram_percentile(&latency, percentiles[i]))
+    );
+  }
+  printf(", max %.1f\n", load_us(latency.max));
+}
+
+int main(int argc, char** argv) {
+  struct load_options options;
+  if (load_parse(argc, argv, &options) == -1 || load_resolve(&options) == -1) {
+    return EXIT_FAILURE;
+  }
+
+  struct load_worker* workers =
+      calloc(options.threads, sizeof(struct load_worker));
+  pthread_t* threads = calloc(options.threads, sizeof(pthread_t));
+  if (workers == NULL || threads == NULL) {
+    perror("vtsh_io_load");
+    return EXIT_FAILURE;
+  }
+  const size_t slots =
+      (size_t)(options.end - options.start) / options.block_size;
+  for (size_t i = 0; i < options.threads; ++i) {
+    struct load_worker* worker = &workers[i];
+    *worker = (struct load_worker){
+        .options = &options,
+        .index = i,
+        .blocks = (options.block_count / options.threads) +
+                  ((i < options.block_count % options.threads) ? 1 : 0),
+        .slots = slots,
+        .slot = i * slots / options.threads,
+        .random = LOAD_SEED * (i + 1),
+    };
+    load_histogram_init(&worker->latency);
+  }
+
+  /* A write creates the file once, so the threads need not race for it. */
+  if (options.rw == LOAD_WRITE) {
+    const int fd = open(
+        options.file, O_WRONLY | O_CREAT | O_CLOEXEC, LOAD_FILE_MODE
+    );
+    if (fd == -1) {
+      perror(options.file);
+      return EXIT_FAILURE;
+    }
+    close(fd);
+  }
+
+  const uint64_t start = vtsh_now();
+  size_t started = 0;
+  for (; started < options.threads; ++started) {
+    const int error =
+        pthread_create(&threads[started], NULL, load_thread, &workers[started]);
+    if (error != 0) {
+      workers[started].error = error;
+      break;
+    }
+  }
+  for (size_t i = 0; i < started; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  const uint64_t elapsed = vtsh_now() - start;
+
+  int status = EXIT_SUCCESS;
+  for (size_t i = 0; i < options.threads; ++i) {
+    if (workers[i].error != 0) {
+      fprintf(
+          stderr,
+          "vtsh_io_load: thread %zu: %s\n",
+          i,
+          strerror(workers[i].error)  // NOLINT(concurrency-mt-unsafe)
+      );
+      status = EXIT_FAILURE;
+    }
+  }
+  load_report(&options, workers, elapsed);
+  free(threads);
+  free(workers);
+  return status;
+}
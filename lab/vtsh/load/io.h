@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "histogram.h"
+
+/* What the buffers of O_DIRECT I/O and the blocks it moves align to. */
+#define LOAD_ALIGNMENT 4096
+
+/* The mode of the file a write creates, before the umask. */
+#define LOAD_FILE_MODE 0666
+
+enum load_rw {
+  LOAD_READ,
+  LOAD_WRITE,
+};
+
+enum load_type {
+  LOAD_SEQUENCE,
+  LOAD_RANDOM,
+};
+
+/*
+ * How the blocks are moved: pread and pwrite, io_uring with up to iodepth
+ * requests in flight per thread, or the vtpc page cache.
+ */
+enum load_engine {
+  LOAD_PSYNC,
+  LOAD_URING,
+  LOAD_VTPC,
+};
+
+/*
+ * The parameters of a run. Block_count blocks are split among the threads,
+ * each of which moves them at offsets in [start, end) that are multiples
+ * of block_size from start.
+ */
+struct load_options {
+  enum load_rw rw;
+  size_t block_size;
+  size_t block_count;
+  const char* file;
+  off_t start;
+  off_t end;
+  bool direct;
+  enum load_type type;
+  size_t threads;
+  size_t iodepth;
+  enum load_engine engine;
+};
+
+/*
+ * A thread of the run: the blocks it has to move, where the next one is
+ * and what it measured. Error is the errno of the first failure, after
+ * which the thread stops.
+ */
+struct load_worker {
+  const struct load_options* options;
+  size_t index;
+  size_t blocks;
+  size_t slots;
+  size_t slot;
+  uint64_t random;
+  uint64_t ops;
+  uint64_t bytes;
+  uint64_t elapsed;
+  int error;
+  struct load_histogram latency;
+};
+
+/* Returns the offset of the next block the worker moves. */
+off_t load_next(struct load_worker* worker);
+
+/* Returns the flags to open the file of the run with. */
+int load_flags(const struct load_options* options);
+
+/*
+ * Returns the errno a block that moved short stops the worker with: a read
+ * ran into the end of the file, and a write most likely out of space.
+ */
+int load_short(const struct load_options* options);
+
+/* Allocates an aligned buffer of size bytes that holds something to write. */
+void* load_buffer(size_t size);
+
+/* Runs the worker with pread and pwrite, or with vtpc for LOAD_VTPC. */
+void load_sync(struct load_worker* worker);
+
+/* Runs the worker with a ring of its own. */
+void load_uring(struct load_worker* worker);
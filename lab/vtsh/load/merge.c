@@ -0,0 +1,421 @@
+#include "sort.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "ring.h"
+
+/* The key of a run that is done, above those of any other. */
+#define LOAD_MERGE_DONE UINT64_MAX
+
+/* What the buffer of a run that is not being merged from holds. */
+enum load_buffer_state {
+  LOAD_BUFFER_EMPTY,
+  LOAD_BUFFER_READING,
+  LOAD_BUFFER_READY,
+};
+
+/*
+ * A run being merged: the keys of the current buffer from position on,
+ * while the other buffer is being read ahead with the next wanted bytes,
+ * which start at offset.
+ */
+struct load_source {
+  off_t offset;
+  off_t left;
+  uint32_t* buffers[2];
+  size_t current;
+  size_t position;
+  size_t count;
+  enum load_buffer_state state;
+  size_t wanted;
+};
+
+/*
+ * A merge in progress: its runs, the loser tree over their keys, whose
+ * node 0 holds the winner, and the output that is filled while the other
+ * output buffer is being written.
+ */
+struct load_merger {
+  struct load_merge* merge;
+  struct load_ring ring;
+  char* memory;
+  struct load_source* sources;
+  uint64_t* keys;
+  size_t* tree;
+  uint32_t* out[2];
+  bool out_busy[2];
+  size_t out_size[2];
+  size_t out_current;
+  size_t out_position;
+  size_t out_capacity;
+  off_t out_offset;
+  int error;
+};
+
+ssize_t load_transfer(
+    int fd, void* buffer, size_t size, off_t offset, bool write
+) {
+  char* bytes = buffer;
+  size_t done = 0;
+  while (done < size) {
+    const ssize_t moved =
+        write ? pwrite(fd, bytes + done, size - done, offset + (off_t)done)
+              : pread(fd, bytes + done, size - done, offset + (off_t)done);
+    if (moved == -1 && errno == EINTR) {
+      continue;
+    }
+    if (moved == -1) {
+      return -1;
+    }
+    if (moved == 0) {
+      break;
+    }
+    done += (size_t)moved;
+  }
+  return (ssize_t)done;
+}
+
+static void load_merge_fail(struct load_merger* merger, int error) {
+  if (merger->error == 0) {
+    merger->error = error;
+  }
+}
+
+/* Queues a read or a write of one of the buffers of the merge. */
+static void load_merge_queue(
+    struct load_merger* merger,
+    bool write,
+    int fd,
+    void* buffer,
+    size_t size,
+    off_t offset,
+    uint64_t tag
+) {
+  struct io_uring_sqe* sqe = load_ring_sqe(&merger->ring, 0);
+  if (merger->ring.fixed) {
+    sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+  } else {
+    sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+  }
+  sqe->fd = fd;
+  sqe->off = (uint64_t)offset;
+  sqe->addr = (uint64_t)(uintptr_t)buffer;
+  sqe->len = (uint32_t)size;
+  sqe->user_data = tag;
+  load_ring_queue(&merger->ring, 1);
+  if (load_ring_submit(&merger->ring, 0) == -1) {
+    load_merge_fail(merger, errno);
+  }
+}
+
+/* Takes the result of a request, tagged by run or by output buffer. */
+static void load_merge_complete(
+    struct load_merger* merger, uint64_t tag, ssize_t result
+) {
+  const size_t count = merger->merge->count;
+  if (tag < count) {
+    struct load_source* source = &merger->sources[tag];
+    source->state = LOAD_BUFFER_READY;
+    if (result < 0 || (size_t)result < source->wanted) {
+      load_merge_fail(merger, (result < 0) ? (int)-result : EIO);
+    }
+    return;
+  }
+  const size_t buffer = tag - count;
+  merger->out_busy[buffer] = false;
+  if (result < 0 || (size_t)result < merger->out_size[buffer]) {
+    load_merge_fail(merger, (result < 0) ? (int)-result : EIO);
+  }
+}
+
+/* Waits for at least one request to complete and takes all that did. */
+static void load_merge_wait(struct load_merger* merger) {
+  if (load_ring_submit(&merger->ring, 1) == -1) {
+    load_merge_fail(merger, errno);
+    return;
+  }
+  const struct io_uring_cqe* cqe = NULL;
+  while ((cqe = load_ring_peek(&merger->ring)) != NULL) {
+    load_merge_complete(merger, cqe->user_data, cqe->res);
+    load_ring_advance(&merger->ring);
+  }
+}
+
+/* Starts reading the next block of the run into its other buffer. */
+static void load_merge_read(struct load_merger* merger, size_t index) {
+  const struct load_merge* merge = merger->merge;
+  struct load_source* source = &merger->sources[index];
+  if (source->left == 0) {
+    source->state = LOAD_BUFFER_EMPTY;
+    return;
+  }
+  source->wanted = ((off_t)merge->block < source->left) ? merge->block
+                                                        : (size_t)source->left;
+  const size_t size =
+      merge->direct ? load_align(source->wanted) : source->wanted;
+  uint32_t* buffer = source->buffers[1 - source->current];
+  const off_t offset = source->offset;
+  source->offset += (off_t)source->wanted;
+  source->left -= (off_t)source->wanted;
+  source->state = LOAD_BUFFER_READING;
+
+  if (merge->uring) {
+    load_merge_queue(
+        merger, false, merge->input, buffer, size, offset, (uint64_t)index
+    );
+  } else {
+    const ssize_t result =
+        load_transfer(merge->input, buffer, size, offset, false);
+    load_merge_complete(merger, index, (result < 0) ? -errno : result);
+  }
+}
+
+/*
+ * Moves on to the other buffer of a run once its keys are merged, waiting
+ * for it to be read if it is not yet, and starts reading the one after.
+ */
+static int load_merge_refill(struct load_merger* merger, size_t index) {
+  struct load_source* source = &merger->sources[index];
+  while (source->state == LOAD_BUFFER_READING && merger->error == 0) {
+    load_merge_wait(merger);
+  }
+  if (merger->error != 0) {
+    return -1;
+  }
+  source->position = 0;
+  source->count = 0;
+  if (source->state == LOAD_BUFFER_EMPTY) {
+    return 0;
+  }
+  source->current = 1 - source->current;
+  source->count = source->wanted / sizeof(uint32_t);
+  source->state = LOAD_BUFFER_EMPTY;
+  load_merge_read(merger, index);
+  return (merger->error != 0) ? -1 : 0;
+}
+
+/*
+ * Writes the output buffer that is full, or the last one, and moves on to
+ * the other once its own write is done.
+ */
+static int load_merge_flush(struct load_merger* merger) {
+  struct load_merge* merge = merger->merge;
+  const size_t buffer = merger->out_current;
+  const size_t bytes = merger->out_position * sizeof(uint32_t);
+  if (bytes == 0) {
+    return 0;
+  }
+  const size_t size = merge->direct ? load_align(bytes) : bytes;
+  merger->out_size[buffer] = size;
+  if (merge->uring) {
+    merger->out_busy[buffer] = true;
+    load_merge_queue(
+        merger,
+        true,
+        merge->output,
+        merger->out[buffer],
+        size,
+        merger->out_offset,
+        merge->count + buffer
+    );
+  } else {
+    const ssize_t result = load_transfer(
+        merge->output, merger->out[buffer], size, merger->out_offset, true
+    );
+    load_merge_complete(
+        merger, merge->count + buffer, (result < 0) ? -errno : result
+    );
+  }
+  merger->out_offset += (off_t)bytes;
+  merger->out_current = 1 - buffer;
+  merger->out_position = 0;
+  while (merger->out_busy[merger->out_current] && merger->error == 0) {
+    load_merge_wait(merger);
+  }
+  return (merger->error != 0) ? -1 : 0;
+}
+
+static uint64_t load_merge_key(const struct load_source* source) {
+  return (source->position < source->count)
+             ? source->buffers[source->current][source->position]
+             : LOAD_MERGE_DONE;
+}
+
+/*
+ * Builds the loser tree bottom up, with the runs as the leaves k to 2k - 1
+ * of an implicit binary tree and the loser of every match kept at its
+ * node, using winners as room for the winners.
+ */
+static void load_merge_build(struct load_merger* merger, size_t* winners) {
+  const size_t count = merger->merge->count;
+  const uint64_t* keys = merger->keys;
+  for (size_t i = 0; i < count; ++i) {
+    winners[count + i] = i;
+  }
+  for (size_t node = count - 1; node > 0; --node) {
+    const size_t left = winners[2 * node];
+    const size_t right = winners[(2 * node) + 1];
+    const bool right_wins = keys[right] < keys[left];
+    winners[node] = right_wins ? right : left;
+    merger->tree[node] = right_wins ? left : right;
+  }
+  merger->tree[0] = winners[1];
+}
+
+/*
+ * Replays the matches on the way from the leaf of the run that just moved
+ * on to the root, which takes a comparison a level.
+ */
+static void load_merge_replay(struct load_merger* merger, size_t index) {
+  const uint64_t* keys = merger->keys;
+  size_t* tree = merger->tree;
+  size_t winner = index;
+  for (size_t node = (index + merger->merge->count) / 2; node > 0;
+       node /= 2) {
+    const size_t loser = tree[node];
+    if (keys[loser] < keys[winner]) {
+      tree[node] = winner;
+      winner = loser;
+    }
+  }
+  tree[0] = winner;
+}
+
+static int load_merge_run(struct load_merger* merger) {
+  const size_t count = merger->merge->count;
+  for (size_t i = 0; i < count; ++i) {
+    load_merge_read(merger, i);
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (load_merge_refill(merger, i) == -1) {
+      return -1;
+    }
+    merger->keys[i] = load_merge_key(&merger->sources[i]);
+  }
+
+  size_t* winners = malloc(2 * count * sizeof(size_t));
+  if (winners == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+  load_merge_build(merger, winners);
+  free(winners);
+
+  uint32_t* out = merger->out[merger->out_current];
+  for (;;) {
+    const size_t index = merger->tree[0];
+    const uint64_t key = merger->keys[index];
+    if (key == LOAD_MERGE_DONE) {
+      break;
+    }
+    out[merger->out_position++] = (uint32_t)key;
+    if (merger->out_position == merger->out_capacity) {
+      if (load_merge_flush(merger) == -1) {
+        return -1;
+      }
+      out = merger->out[merger->out_current];
+    }
+
+    struct load_source* source = &merger->sources[index];
+    source->position += 1;
+    if (source->position == source->count &&
+        load_merge_refill(merger, index) == -1) {
+      return -1;
+    }
+    merger->keys[index] = load_merge_key(source);
+    load_merge_replay(merger, index);
+  }
+
+  if (load_merge_flush(merger) == -1) {
+    return -1;
+  }
+  while ((merger->out_busy[0] || merger->out_busy[1]) && merger->error == 0) {
+    load_merge_wait(merger);
+  }
+  return (merger->error != 0) ? -1 : 0;
+}
+
+/* Lays the buffers of the runs and of the output out in one block. */
+static int load_merge_init(
+    struct load_merger* merger, struct load_merge* merge
+) {
+  const size_t count = merge->count;
+  const size_t buffers = (2 * count) + 2;
+  *merger = (struct load_merger){
+      .merge = merge,
+      .ring = {.fd = -1},
+      .sources = calloc(count, sizeof(struct load_source)),
+      .keys = calloc(count, sizeof(uint64_t)),
+      .tree = calloc(count, sizeof(size_t)),
+      .out_capacity = merge->block / sizeof(uint32_t),
+      .out_offset = merge->offset,
+  };
+  void* memory = NULL;
+  if (posix_memalign(&memory, LOAD_SORT_ALIGNMENT, buffers * merge->block) !=
+      0) {
+    memory = NULL;
+  }
+  merger->memory = memory;
+  if (merger->memory == NULL || merger->sources == NULL ||
+      merger->keys == NULL || merger->tree == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    struct load_source* source = &merger->sources[i];
+    source->offset = merge->runs[i].offset;
+    source->left = merge->runs[i].length;
+    for (size_t j = 0; j < 2; ++j) {
+      source->buffers[j] =
+          (uint32_t*)(merger->memory + (((2 * i) + j) * merge->block));
+    }
+  }
+  for (size_t j = 0; j < 2; ++j) {
+    merger->out[j] =
+        (uint32_t*)(merger->memory + (((2 * count) + j) * merge->block));
+  }
+
+  merge->uring = load_ring_init(&merger->ring, (unsigned)(count + 2)) == 0;
+  if (merge->uring) {
+    load_ring_register(&merger->ring, merger->memory, buffers * merge->block);
+  }
+  return 0;
+}
+
+static void load_merge_destroy(struct load_merger* merger) {
+  if (merger->ring.fd >= 0) {
+    load_ring_destroy(&merger->ring);
+  }
+  free(merger->memory);
+  free(merger->sources);
+  free(merger->keys);
+  free(merger->tree);
+}
+
+/*
+ * Merges with a loser tree, which finds the next key with one comparison
+ * for each level of the tree rather than two as a heap does. Every run
+ * reads a block ahead, as does the output behind, so that the merge waits
+ * for the disk only when it is faster than it.
+ */
+int load_merge(struct load_merge* merge) {
+  struct load_merger merger;
+  int status = load_merge_init(&merger, merge);
+  if (status == 0) {
+    status = load_merge_run(&merger);
+  }
+  const int error = (merger.error != 0) ? merger.error : errno;
+  load_merge_destroy(&merger);
+  if (status == -1) {
+    errno = error;
+  }
+  return status;
+}
@@ -0,0 +1,52 @@
+#include "sort.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define LOAD_RADIX_BITS 8U
+#define LOAD_RADIX_DIGITS (1U << LOAD_RADIX_BITS)
+#define LOAD_RADIX_MASK (LOAD_RADIX_DIGITS - 1)
+#define LOAD_RADIX_PASSES (32U / LOAD_RADIX_BITS)
+
+/*
+ * Counts every digit of every key in one pass over them, then moves the
+ * keys by each digit from the lowest, skipping the digits all keys share,
+ * as the high ones of small keys do.
+ */
+uint32_t* load_radix_sort(uint32_t* keys, uint32_t* scratch, size_t count) {
+  size_t counts[LOAD_RADIX_PASSES][LOAD_RADIX_DIGITS];
+  memset(counts, 0, sizeof(counts));
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t key = keys[i];
+    for (unsigned pass = 0; pass < LOAD_RADIX_PASSES; ++pass) {
+      counts[pass][key & LOAD_RADIX_MASK] += 1;
+      key >>= LOAD_RADIX_BITS;
+    }
+  }
+
+  uint32_t* from = keys;
+  uint32_t* to = scratch;
+  for (unsigned pass = 0; pass < LOAD_RADIX_PASSES; ++pass) {
+    const unsigned shift = pass * LOAD_RADIX_BITS;
+    size_t* digits = counts[pass];
+    if (count == 0 || digits[(from[0] >> shift) & LOAD_RADIX_MASK] == count) {
+      continue;
+    }
+    size_t offset = 0;
+    for (size_t digit = 0; digit < LOAD_RADIX_DIGITS; ++digit) {
+      const size_t digit_count = digits[digit];
+      digits[digit] = offset;
+      offset += digit_count;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      const uint32_t key = from[i];
+      to[digits[(key >> shift) & LOAD_RADIX_MASK]++] = key;
+    }
+    uint32_t* swap = from;
+    from = to;
+    to = swap;
+  }
+  return from;
+}
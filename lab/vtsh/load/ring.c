@@ -0,0 +1,141 @@
+#include "ring.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static int load_ring_setup(unsigned entries, struct io_uring_params* params) {
+  return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int load_ring_enter(int fd, unsigned submit, unsigned wait) {
+  return (int)syscall(
+      __NR_io_uring_enter, fd, submit, wait, IORING_ENTER_GETEVENTS, NULL, 0
+  );
+}
+
+static void* load_ring_map(int fd, size_t size, off_t offset) {
+  return mmap(
+      NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset
+  );
+}
+
+void load_ring_destroy(struct load_ring* ring) {
+  if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+    munmap(ring->sqes, ring->sqes_size);
+  }
+  if (ring->cq_ring != NULL && ring->cq_ring != MAP_FAILED &&
+      ring->cq_ring != ring->sq_ring) {
+    munmap(ring->cq_ring, ring->cq_size);
+  }
+  if (ring->sq_ring != NULL && ring->sq_ring != MAP_FAILED) {
+    munmap(ring->sq_ring, ring->sq_size);
+  }
+  if (ring->fd >= 0) {
+    close(ring->fd);
+  }
+  *ring = (struct load_ring){.fd = -1};
+}
+
+int load_ring_init(struct load_ring* ring, unsigned entries) {
+  *ring = (struct load_ring){.fd = -1};
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring->fd = load_ring_setup(entries, &params);
+  if (ring->fd < 0) {
+    return -1;
+  }
+
+  ring->sq_size = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+  ring->cq_size =
+      params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+  const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single) {
+    ring->sq_size = ring->cq_size =
+        (ring->sq_size > ring->cq_size) ? ring->sq_size : ring->cq_size;
+  }
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  ring->sq_ring = load_ring_map(ring->fd, ring->sq_size, IORING_OFF_SQ_RING);
+  ring->cq_ring =
+      single ? ring->sq_ring
+             : load_ring_map(ring->fd, ring->cq_size, IORING_OFF_CQ_RING);
+  ring->sqes = load_ring_map(ring->fd, ring->sqes_size, IORING_OFF_SQES);
+  if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED ||
+      ring->sqes == MAP_FAILED) {
+    const int error = errno;
+    load_ring_destroy(ring);
+    errno = error;
+    return -1;
+  }
+
+  char* sq = ring->sq_ring;
+  char* cq = ring->cq_ring;
+  ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+  ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+  ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+  ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+  ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+  return 0;
+}
+
+void load_ring_register(struct load_ring* ring, void* memory, size_t size) {
+  struct iovec buffer = {.iov_base = memory, .iov_len = size};
+  ring->fixed = syscall(
+                    __NR_io_uring_register,
+                    ring->fd,
+                    IORING_REGISTER_BUFFERS,
+                    &buffer,
+                    1
+                ) == 0;
+}
+
+struct io_uring_sqe* load_ring_sqe(struct load_ring* ring, unsigned queued) {
+  const unsigned index = (*ring->sq_tail + queued) & *ring->sq_mask;
+  struct io_uring_sqe* sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  ring->sq_array[index] = index;
+  return sqe;
+}
+
+void load_ring_queue(struct load_ring* ring, unsigned queued) {
+  __atomic_store_n(ring->sq_tail, *ring->sq_tail + queued, __ATOMIC_RELEASE);
+  ring->pending += queued;
+}
+
+int load_ring_submit(struct load_ring* ring, unsigned wait) {
+  const int submitted = load_ring_enter(ring->fd, ring->pending, wait);
+  if (submitted < 0) {
+    return (errno == EINTR || errno == EAGAIN || errno == EBUSY) ? 0 : -1;
+  }
+  ring->pending -= (unsigned)submitted;
+  return 0;
+}
+
+int load_ring_wait(struct load_ring* ring, unsigned wait) {
+  if (load_ring_enter(ring->fd, 0, wait) < 0) {
+    return (errno == EINTR || errno == EAGAIN || errno == EBUSY) ? 0 : -1;
+  }
+  return 0;
+}
+
+const struct io_uring_cqe* load_ring_peek(const struct load_ring* ring) {
+  const unsigned head = *ring->cq_head;
+  if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+  return &ring->cqes[head & *ring->cq_mask];
+}
+
+void load_ring_advance(struct load_ring* ring) {
+  __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * The rings of an io_uring instance, mapped into the process and driven
+ * with raw system calls. Pending counts the entries queued but not yet
+ * taken by the kernel, and fixed is set once a buffer is registered.
+ */
+struct load_ring {
+  int fd;
+  bool fixed;
+  unsigned pending;
+  unsigned* sq_tail;
+  unsigned* sq_mask;
+  unsigned* sq_array;
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned* cq_mask;
+  struct io_uring_sqe* sqes;
+  struct io_uring_cqe* cqes;
+  void* sq_ring;
+  size_t sq_size;
+  void* cq_ring;
+  size_t cq_size;
+  size_t sqes_size;
+};
+
+int load_ring_init(struct load_ring* ring, unsigned entries);
+
+void load_ring_destroy(struct load_ring* ring);
+
+/*
+ * Registers the memory as the one fixed buffer of the ring, so the kernel
+ * does not pin its pages for every request, unless it fails, as it does
+ * over RLIMIT_MEMLOCK.
+ */
+void load_ring_register(struct load_ring* ring, void* memory, size_t size);
+
+/* Returns the cleared entry that comes queued entries after the tail. */
+struct io_uring_sqe* load_ring_sqe(struct load_ring* ring, unsigned queued);
+
+/* Hands the queued entries after the tail over to the kernel. */
+void load_ring_queue(struct load_ring* ring, unsigned queued);
+
+/*
+ * Submits the pending entries and waits for wait completions. Returns -1
+ * with errno on an error other than an interruption.
+ */
+int load_ring_submit(struct load_ring* ring, unsigned wait);
+
+/*
+ * Waits for wait completions without submitting the pending entries. Returns
+ * -1 with errno on an error other than an interruption.
+ */
+int load_ring_wait(struct load_ring* ring, unsigned wait);
+
+/* Returns the oldest completion, or NULL if there is none yet. */
+const struct io_uring_cqe* load_ring_peek(const struct load_ring* ring);
+
+/* Frees the completion load_ring_peek returned. */
+void load_ring_advance(struct load_ring* ring);
@@ -0,0 +1,697 @@
+#include "sort.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "units.h"
+
+#define LOAD_SORT_MEMORY (256UL << 20U)
+#define LOAD_SORT_BLOCK (1UL << 20U)
+#define LOAD_SORT_CHUNK_MIN (64UL << 10U)
+#define LOAD_SORT_PATH 4096
+#define LOAD_SORT_MODE 0600
+#define LOAD_FILE_MODE 0666
+#define LOAD_NS_PER_S 1000000000.0
+#define LOAD_BYTES_PER_GB 1000000000.0
+#define LOAD_BYTES_PER_MIB (1024.0 * 1024.0)
+#define LOAD_SEED 0x9E3779B97F4A7C15ULL
+#define LOAD_MIX_FIRST 0xBF58476D1CE4E5B9ULL
+#define LOAD_MIX_SECOND 0x94D049BB133111EBULL
+#define LOAD_CHECK_BITS 16U
+#define LOAD_CHECK_BUCKETS (1UL << LOAD_CHECK_BITS)
+
+static const char* const usage =
+    "usage: vtsh_sort_load --file FILE [options]\n"
+    "  --file PATH          the file of 32-bit integers to sort\n"
+    "  --output PATH        where the sorted integers go, FILE.sorted by\n"
+    "                       default\n"
+    "  --generate SIZE      fill FILE with SIZE bytes of random integers\n"
+    "                       first, with an optional K, M or G\n"
+    "  --memory SIZE        the memory the sort may use, 256M by default\n"
+    "  --threads N          threads that sort runs and merge them, one per\n"
+    "                       processor by default\n"
+    "  --block-size SIZE    bytes per read and write of the merge, 1M by\n"
+    "                       default\n"
+    "  --direct on|off      open the files with O_DIRECT, off by default\n"
+    "  --temp DIR           where the runs go, the directory of the output\n"
+    "                       by default\n"
+    "  --repeat N           times to sort the file, 1 by default\n"
+    "  --check              check that the output ascends and holds the\n"
+    "                       keys of the input, by their count and hash in\n"
+    "                       each of 64K buckets\n"
+    "\n"
+    "Sorts a file larger than the memory it may use. The threads read it a\n"
+    "chunk each at a time, sort the chunk with a radix sort and write it\n"
+    "back as a run, holding two chunks each. The runs are merged with a\n"
+    "loser tree, reading a block ahead of each run with io_uring, in as\n"
+    "many passes as the memory takes to hold two blocks of every run. The\n"
+    "report gives the time of both phases and the throughput of the sort\n"
+    "in GB/s of the file.\n";
+
+struct load_options {
+  const char* file;
+  const char* output;
+  size_t generate;
+  size_t memory;
+  size_t threads;
+  size_t block;
+  bool direct;
+  const char* temp;
+  size_t repeat;
+  bool check;
+};
+
+/* The runs of a sort and where each thread takes the next one from. */
+struct load_sort {
+  const struct load_options* options;
+  int input;
+  int runs_file;
+  off_t size;
+  size_t chunk;
+  struct load_run* runs;
+  size_t count;
+  atomic_size_t next;
+  atomic_int error;
+};
+
+/* The merges of a pass, which its threads take one group at a time. */
+struct load_pass {
+  const struct load_sort* sort;
+  int input;
+  int output;
+  const struct load_run* runs;
+  size_t count;
+  size_t fan_in;
+  struct load_run* merged;
+  size_t block;
+  atomic_size_t next;
+  atomic_int error;
+  atomic_bool uring;
+};
+
+/* What a sort took. */
+struct load_report {
+  off_t bytes;
+  uint64_t runs_time;
+  uint64_t merge_time;
+  size_t runs;
+  size_t passes;
+  size_t fan_in;
+  bool uring;
+};
+
+static int load_option(int option, struct load_options* options) {
+  switch (option) {
+    case 'f':
+      options->file = optarg;
+      return 0;
+    case 'o':
+      options->output = optarg;
+      return 0;
+    case 'g':
+      return vtsh_parse_size(optarg, &options->generate);
+    case 'm':
+      return vtsh_parse_size(optarg, &options->memory);
+    case 'n':
+      return (vtsh_parse_size(optarg, &options->threads) == -1 ||
+              options->threads == 0)
+                 ? -1
+                 : 0;
+    case 'b':
+      return (vtsh_parse_size(optarg, &options->block) == -1 ||
+              options->block == 0 ||
+              options->block % LOAD_SORT_ALIGNMENT != 0 ||
+              options->block > INT32_MAX)
+                 ? -1
+                 : 0;
+    case 'd':
+      options->direct = strcmp(optarg, "on") == 0;
+      return (options->direct || strcmp(optarg, "off") == 0) ? 0 : -1;
+    case 't':
+      options->temp = optarg;
+      return 0;
+    case 'r':
+      return (vtsh_parse_size(optarg, &options->repeat) == -1 ||
+              options->repeat == 0)
+                 ? -1
+                 : 0;
+    case 'c':
+      options->check = true;
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+static int load_parse(int argc, char** argv, struct load_options* options) {
+  static const struct option long_options[] = {
+      {"file", required_argument, NULL, 'f'},
+      {"output", required_argument, NULL, 'o'},
+      {"generate", required_argument, NULL, 'g'},
+      {"memory", required_argument, NULL, 'm'},
+      {"threads", required_argument, NULL, 'n'},
+      {"block-size", required_argument, NULL, 'b'},
+      {"block_size", required_argument, NULL, 'b'},
+      {"direct", required_argument, NULL, 'd'},
+      {"temp", required_argument, NULL, 't'},
+      {"repeat", required_argument, NULL, 'r'},
+      {"check", no_argument, NULL, 'c'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0},
+  };
+
+  const long processors = sysconf(_SC_NPROCESSORS_ONLN);
+  *options = (struct load_options){
+      .memory = LOAD_SORT_MEMORY,
+      .threads = (processors > 0) ? (size_t)processors : 1,
+      .block = LOAD_SORT_BLOCK,
+      .repeat = 1,
+  };
+  int option = 0;
+  while ((option = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+    if (option == 'h' || option == '?') {
+      fputs(usage, stderr);
+      return -1;
+    }
+    if (load_option(option, options) == -1) {
+      fprintf(stderr, "vtsh_sort_load: bad value %s\n", optarg);
+      return -1;
+    }
+  }
+  if (optind != argc || options->file == NULL) {
+    fputs(usage, stderr);
+    return -1;
+  }
+  return 0;
+}
+
+/* Fills the file with random keys, a block at a time. */
+static int load_generate(const struct load_options* options) {
+  const int fd = open(
+      options->file,
+      O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+      LOAD_FILE_MODE
+  );
+  uint32_t* buffer = malloc(LOAD_SORT_BLOCK);
+  if (fd == -1 || buffer == NULL) {
+    free(buffer);
+    if (fd != -1) {
+      close(fd);
+    }
+    return -1;
+  }
+  uint64_t random = LOAD_SEED;
+  const size_t size = options->generate / sizeof(uint32_t) * sizeof(uint32_t);
+  int status = 0;
+  for (size_t done = 0; done < size && status == 0;) {
+    const size_t bytes =
+        (size - done < LOAD_SORT_BLOCK) ? size - done : LOAD_SORT_BLOCK;
+    for (size_t i = 0; i < bytes / sizeof(uint32_t); ++i) {
+      random ^= random << 13U;
+      random ^= random >> 7U;
+      random ^= random << 17U;
+      buffer[i] = (uint32_t)(random >> 32U);
+    }
+    if (load_transfer(fd, buffer, bytes, (off_t)done, true) !=
+        (ssize_t)bytes) {
+      status = -1;
+    }
+    done += bytes;
+  }
+  free(buffer);
+  close(fd);
+  return status;
+}
+
+/*
+ * Opens an unnamed file for runs in the directory, or a named one that is
+ * removed at once where O_TMPFILE is not supported.
+ */
+static int load_temp(const char* directory, bool direct) {
+  const int flags = O_RDWR | O_CLOEXEC | (direct ? O_DIRECT : 0);
+  int fd = open(directory, O_TMPFILE | flags, LOAD_SORT_MODE);
+  if (fd != -1 || (errno != EOPNOTSUPP && errno != EISDIR)) {
+    return fd;
+  }
+  char path[LOAD_SORT_PATH];
+  snprintf(path, sizeof(path), "%s/vtsh_sort.XXXXXX", directory);
+  fd = mkostemp(path, O_CLOEXEC);
+  if (fd == -1) {
+    return -1;
+  }
+  unlink(path);
+  if (direct && fcntl(fd, F_SETFL, O_DIRECT) == -1) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* Sorts the chunks the thread takes into runs, two chunks at a time. */
+static void* load_runs_thread(void* arg) {
+  struct load_sort* sort = arg;
+  const size_t chunk = sort->chunk;
+  void* memory = NULL;
+  if (posix_memalign(&memory, LOAD_SORT_ALIGNMENT, 2 * chunk) != 0) {
+    atomic_store(&sort->error, ENOMEM);
+    return NULL;
+  }
+  uint32_t* keys = memory;
+  uint32_t* scratch = keys + (chunk / sizeof(uint32_t));
+
+  size_t index = 0;
+  while (atomic_load(&sort->error) == 0 &&
+         (index = atomic_fetch_add(&sort->next, 1)) < sort->count) {
+    const struct load_run* run = &sort->runs[index];
+    const size_t length = (size_t)run->length;
+    const size_t size =
+        sort->options->direct ? load_align(length) : length;
+    if (load_transfer(sort->input, keys, size, run->offset, false) <
+        (ssize_t)length) {
+      atomic_store(&sort->error, (errno != 0) ? errno : EIO);
+      break;
+    }
+    const uint32_t* sorted =
+        load_radix_sort(keys, scratch, length / sizeof(uint32_t));
+    if (load_transfer(
+            sort->runs_file, (void*)sorted, size, run->offset, true
+        ) != (ssize_t)size) {
+      atomic_store(&sort->error, (errno != 0) ? errno : EIO);
+      break;
+    }
+  }
+  free(memory);
+  return NULL;
+}
+
+/* Merges the groups of runs of a pass the thread takes. */
+static void* load_pass_thread(void* arg) {
+  struct load_pass* pass = arg;
+  const size_t groups = (pass->count + pass->fan_in - 1) / pass->fan_in;
+  size_t group = 0;
+  while (atomic_load(&pass->error) == 0 &&
+         (group = atomic_fetch_add(&pass->next, 1)) < groups) {
+    const size_t first = group * pass->fan_in;
+    const size_t count = (pass->count - first < pass->fan_in)
+                             ? pass->count - first
+                             : pass->fan_in;
+    struct load_merge merge = {
+        .input = pass->input,
+        .output = pass->output,
+        .runs = &pass->runs[first],
+        .count = count,
+        .offset = pass->runs[first].offset,
+        .block = pass->block,
+        .direct = pass->sort->options->direct,
+    };
+    if (load_merge(&merge) == -1) {
+      atomic_store(&pass->error, errno);
+      break;
+    }
+    atomic_store(&pass->uring, merge.uring);
+    off_t length = 0;
+    for (size_t i = 0; i < count; ++i) {
+      length += pass->runs[first + i].length;
+    }
+    pass->merged[group] = (struct load_run){
+        .offset = merge.offset,
+        .length = length,
+    };
+  }
+  return NULL;
+}
+
+/* Runs the function on the threads, returning how many were started. */
+static size_t load_spawn(
+    pthread_t* threads, size_t count, void* (*function)(void*), void* arg
+) {
+  size_t started = 0;
+  while (started < count &&
+         pthread_create(&threads[started], NULL, function, arg) == 0) {
+    started += 1;
+  }
+  for (size_t i = 0; i < started; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  return started;
+}
+
+/*
+ * Splits the file into chunks of at most half of the memory of each
+ * thread, and into at least one for every thread when it is smaller.
+ */
+static int load_make_runs(struct load_sort* sort, pthread_t* threads) {
+  const struct load_options* options = sort->options;
+  size_t chunk = options->memory / (2 * options->threads) /
+                 LOAD_SORT_ALIGNMENT * LOAD_SORT_ALIGNMENT;
+  const size_t share =
+      load_align(((size_t)sort->size + options->threads - 1) /
+                 options->threads);
+  chunk = (share < chunk) ? share : chunk;
+  if (chunk < LOAD_SORT_CHUNK_MIN &&
+      chunk < load_align((size_t)sort->size)) {
+    fprintf(stderr, "vtsh_sort_load: too little memory for the threads\n");
+    errno = ENOMEM;
+    return -1;
+  }
+
+  sort->chunk = chunk;
+  sort->count = ((size_t)sort->size + chunk - 1) / chunk;
+  sort->runs = calloc(sort->count, sizeof(struct load_run));
+  if (sort->runs == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+  for (size_t i = 0; i < sort->count; ++i) {
+    const off_t offset = (off_t)(i * chunk);
+    const off_t left = sort->size - offset;
+    sort->runs[i] = (struct load_run){
+        .offset = offset,
+        .length = (left < (off_t)chunk) ? left : (off_t)chunk,
+    };
+  }
+  const size_t workers =
+      (sort->count < options->threads) ? sort->count : options->threads;
+  if (load_spawn(threads, workers, load_runs_thread, sort) == 0) {
+    return -1;
+  }
+  if (atomic_load(&sort->error) != 0) {
+    errno = atomic_load(&sort->error);
+    return -1;
+  }
+  return 0;
+}
+
+/* Returns how many runs a merge can take with the memory it has. */
+static size_t load_fan_in(size_t memory, size_t block) {
+  const size_t blocks = memory / block;
+  return (blocks < 4) ? 0 : (blocks / 2) - 1;
+}
+
+/*
+ * Merges the runs into fewer in every pass but the last, which merges
+ * them into the output. A pass that has to leave more than one run splits
+ * the memory among as many threads as can each merge two runs or more.
+ */
+static int load_merge_runs(
+    struct load_sort* sort,
+    int output,
+    pthread_t* threads,
+    struct load_report* report
+) {
+  const struct load_options* options = sort->options;
+  const size_t fan_in = load_fan_in(options->memory, options->block);
+  if (fan_in < 2) {
+    fprintf(stderr, "vtsh_sort_load: too little memory for the blocks\n");
+    errno = ENOMEM;
+    return -1;
+  }
+  report->fan_in = fan_in;
+
+  int input = sort->runs_file;
+  int spare = -1;
+  struct load_run* runs = sort->runs;
+  size_t count = sort->count;
+  int status = 0;
+  while (status == 0) {
+    const bool last = count <= fan_in;
+    size_t workers = last ? 1 : options->threads;
+    while (workers > 1 &&
+           load_fan_in(options->memory / workers, options->block) < 2) {
+      workers -= 1;
+    }
+    const size_t group =
+        last ? count : load_fan_in(options->memory / workers, options->block);
+    const size_t groups = (count + group - 1) / group;
+    if (!last && spare == -1) {
+      spare = load_temp(options->temp, options->direct);
+      if (spare == -1) {
+        status = -1;
+        break;
+      }
+    }
+
+    struct load_pass pass = {
+        .sort = sort,
+        .input = input,
+        .output = last ? output : spare,
+        .runs = runs,
+        .count = count,
+        .fan_in = group,
+        .merged = calloc(groups, sizeof(struct load_run)),
+        .block = options->block,
+    };
+    if (pass.merged == NULL) {
+      errno = ENOMEM;
+      status = -1;
+      break;
+    }
+    workers = (groups < workers) ? groups : workers;
+    if (load_spawn(threads, workers, load_pass_thread, &pass) == 0 ||
+        atomic_load(&pass.error) != 0) {
+      errno = atomic_load(&pass.error);
+      status = -1;
+    }
+    report->passes += 1;
+    report->uring = atomic_load(&pass.uring);
+    if (runs != sort->runs) {
+      free(runs);
+    }
+    runs = pass.merged;
+    count = groups;
+    if (last || status == -1) {
+      break;
+    }
+    const int swap = input;
+    input = spare;
+    spare = swap;
+  }
+  if (runs != sort->runs) {
+    free(runs);
+  }
+  if (spare != -1 && spare != sort->runs_file) {
+    close(spare);
+  }
+  if (input != sort->runs_file) {
+    close(input);
+  }
+  return status;
+}
+
+/* Sorts the file into the output once. */
+static int load_sort_file(
+    const struct load_options* options, struct load_report* report
+) {
+  const int flags = O_CLOEXEC | (options->direct ? O_DIRECT : 0);
+  struct load_sort sort = {
+      .options = options,
+      .input = open(options->file, O_RDONLY | flags),
+      .runs_file = -1,
+  };
+  const int output = open(
+      options->output, O_RDWR | O_CREAT | O_TRUNC | flags, LOAD_FILE_MODE
+  );
+  pthread_t* threads = calloc(options->threads, sizeof(pthread_t));
+  int status = (sort.input == -1 || output == -1 || threads == NULL) ? -1 : 0;
+  if (status == 0) {
+    sort.size = lseek(sort.input, 0, SEEK_END);
+    if (sort.size % (off_t)sizeof(uint32_t) != 0) {
+      fprintf(stderr, "vtsh_sort_load: the file is not of 32-bit keys\n");
+      errno = EINVAL;
+      status = -1;
+    }
+  }
+  if (status == 0 && sort.size > 0) {
+    sort.runs_file = load_temp(options->temp, options->direct);
+    const uint64_t start = vtsh_now();
+    status = (sort.runs_file == -1) ? -1 : load_make_runs(&sort, threads);
+    const uint64_t merged = vtsh_now();
+    if (status == 0) {
+      status = load_merge_runs(&sort, output, threads, report);
+    }
+    report->runs_time = merged - start;
+    report->merge_time = vtsh_now() - merged;
+    report->runs = sort.count;
+  }
+  report->bytes = sort.size;
+  /* Direct writes leave up to a block of padding after the keys. */
+  if (status == 0 && ftruncate(output, sort.size) == -1) {
+    status = -1;
+  }
+
+  const int error = errno;
+  free(threads);
+  free(sort.runs);
+  if (sort.runs_file != -1) {
+    close(sort.runs_file);
+  }
+  if (output != -1) {
+    close(output);
+  }
+  if (sort.input != -1) {
+    close(sort.input);
+  }
+  errno = error;
+  return status;
+}
+
+/*
+ * The keys of a file as a multiset: how many fall in each bucket of their
+ * top bits and the sum of a 64-bit mix of them. A key dropped and another
+ * repeated changes the bucket counts or the sums, but for the one chance in
+ * 2^64 that the mixes collide.
+ */
+struct load_digest {
+  uint64_t counts[LOAD_CHECK_BUCKETS];
+  uint64_t hashes[LOAD_CHECK_BUCKETS];
+};
+
+/* The finalizer of splitmix64. */
+static uint64_t load_mix(uint64_t x) {
+  x ^= x >> 30U;
+  x *= LOAD_MIX_FIRST;
+  x ^= x >> 27U;
+  x *= LOAD_MIX_SECOND;
+  x ^= x >> 31U;
+  return x;
+}
+
+/*
+ * Takes the digest of the keys of a file. Returns 1 if sorted is set and
+ * they do not ascend.
+ */
+static int load_scan(
+    const char* path, bool sorted, struct load_digest* digest
+) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  uint32_t* buffer = malloc(LOAD_SORT_BLOCK);
+  int status = (fd == -1 || buffer == NULL) ? -1 : 0;
+  uint32_t last = 0;
+  for (off_t offset = 0; status == 0;) {
+    const ssize_t got =
+        load_transfer(fd, buffer, LOAD_SORT_BLOCK, offset, false);
+    if (got <= 0) {
+      status = (int)got;
+      break;
+    }
+    for (size_t i = 0; i < (size_t)got / sizeof(uint32_t); ++i) {
+      const uint32_t key = buffer[i];
+      if (sorted && key < last) {
+        status = 1;
+      }
+      last = key;
+      const size_t bucket = key >> (32U - LOAD_CHECK_BITS);
+      digest->counts[bucket] += 1;
+      digest->hashes[bucket] += load_mix(key);
+    }
+    offset += got;
+  }
+  free(buffer);
+  if (fd != -1) {
+    close(fd);
+  }
+  return status;
+}
+
+static int load_check(const struct load_options* options) {
+  struct load_digest* input = calloc(1, sizeof(struct load_digest));
+  struct load_digest* output = calloc(1, sizeof(struct load_digest));
+  if (input == NULL || output == NULL) {
+    free(input);
+    free(output);
+    return -1;
+  }
+  const int status = load_scan(options->file, false, input);
+  const int order = load_scan(options->output, true, output);
+  const bool same = memcmp(input, output, sizeof(struct load_digest)) == 0;
+  free(input);
+  free(output);
+  if (status == -1 || order == -1) {
+    return -1;
+  }
+  if (order != 0) {
+    fprintf(stderr, "vtsh_sort_load: the output is not sorted\n");
+    return 1;
+  }
+  if (!same) {
+    fprintf(stderr, "vtsh_sort_load: the output has other keys\n");
+    return 1;
+  }
+  printf("checked: sorted, with the keys of the input\n");
+  return 0;
+}
+
+static void load_print(
+    const struct load_options* options, const struct load_report* report
+) {
+  const off_t size = report->bytes;
+  const uint64_t total = report->runs_time + report->merge_time;
+  const double seconds = (double)total / LOAD_NS_PER_S;
+  printf(
+      "sorted %lld bytes in %.3f s, %.3f GB/s, %zu threads, %.1f MiB of "
+      "memory\n",
+      (long long)size,
+      seconds,
+      (seconds > 0) ? (double)size / LOAD_BYTES_PER_GB / seconds : 0.0,
+      options->threads,
+      (double)options->memory / LOAD_BYTES_PER_MIB
+  );
+  printf(
+      "  runs: %zu in %.3f s\n"
+      "  merge: %zu passes of up to %zu runs in %.3f s, %zu byte blocks, "
+      "%s\n",
+      report->runs,
+      (double)report->runs_time / LOAD_NS_PER_S,
+      report->passes,
+      report->fan_in,
+      (double)report->merge_time / LOAD_NS_PER_S,
+      options->block,
+      report->uring ? "io_uring" : "pread and pwrite"
+  );
+}
+
+int main(int argc, char** argv) {
+  struct load_options options;
+  if (load_parse(argc, argv, &options) == -1) {
+    return EXIT_FAILURE;
+  }
+  char output[LOAD_SORT_PATH];
+  if (options.output == NULL) {
+    snprintf(output, sizeof(output), "%s.sorted", options.file);
+    options.output = output;
+  }
+  char directory[LOAD_SORT_PATH];
+  if (options.temp == NULL) {
+    snprintf(directory, sizeof(directory), "%s", options.output);
+    options.temp = dirname(directory);
+  }
+  if (options.generate != 0 && load_generate(&options) == -1) {
+    perror(options.file);
+    return EXIT_FAILURE;
+  }
+
+  for (size_t i = 0; i < options.repeat; ++i) {
+    struct load_report report = {0};
+    if (load_sort_file(&options, &report) == -1) {
+      perror("vtsh_sort_load");
+      return EXIT_FAILURE;
+    }
+    load_print(&options, &report);
+  }
+  if (options.check && load_check(&options) != 0) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
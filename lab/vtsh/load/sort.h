@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* What the buffers and the offsets of O_DIRECT I/O align to. */
+#define LOAD_SORT_ALIGNMENT 4096
+
+/* A sorted run of keys in a file, in bytes. */
+struct load_run {
+  off_t offset;
+  off_t length;
+};
+
+/*
+ * A merge of the runs of input into one run of output at offset, with two
+ * buffers of block bytes for every run and two for the output, through
+ * io_uring unless it cannot be set up, which uring tells once done. The
+ * files are read and written in whole aligned blocks when direct, so the
+ * output may get up to an alignment of padding after its end.
+ */
+struct load_merge {
+  int input;
+  int output;
+  const struct load_run* runs;
+  size_t count;
+  off_t offset;
+  size_t block;
+  bool direct;
+  bool uring;
+};
+
+/*
+ * Sorts count keys with a radix sort of a byte at a time, using scratch of
+ * as many keys, and returns the one of the two that holds them.
+ */
+uint32_t* load_radix_sort(uint32_t* keys, uint32_t* scratch, size_t count);
+
+/* Merges the runs, returning -1 with errno if it fails. */
+int load_merge(struct load_merge* merge);
+
+/*
+ * Reads or writes size bytes at offset, going on after a short transfer,
+ * and returns how many were moved, fewer only at the end of a file, or -1
+ * with errno.
+ */
+ssize_t load_transfer(
+    int fd, void* buffer, size_t size, off_t offset, bool write
+);
+
+static inline size_t load_align(size_t size) {
+  return (size + LOAD_SORT_ALIGNMENT - 1) / LOAD_SORT_ALIGNMENT *
+         LOAD_SORT_ALIGNMENT;
+}
@@ -0,0 +1,105 @@
+#include "io.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "histogram.h"
+#include "units.h"
+
+#ifdef VTSH_VTPC
+#include "vtpc.h"
+#endif
+
+/* The calls of an engine that moves one block at a time. */
+struct load_calls {
+  int (*open)(const char* path, int flags, int mode);
+  ssize_t (*pread)(int fd, void* buffer, size_t count, off_t offset);
+  ssize_t (*pwrite)(int fd, const void* buffer, size_t count, off_t offset);
+  int (*close)(int fd);
+};
+
+static int load_libc_open(const char* path, int flags, int mode) {
+  return open(path, flags, (mode_t)mode);
+}
+
+static const struct load_calls libc_calls = {
+    .open = load_libc_open,
+    .pread = pread,
+    .pwrite = pwrite,
+    .close = close,
+};
+
+#ifdef VTSH_VTPC
+static const struct load_calls vtpc_calls = {
+    .open = vtpc_open,
+    .pread = vtpc_pread,
+    .pwrite = vtpc_pwrite,
+    .close = vtpc_close,
+};
+#endif
+
+static const struct load_calls* load_calls(enum load_engine engine) {
+#ifdef VTSH_VTPC
+  if (engine == LOAD_VTPC) {
+    return &vtpc_calls;
+  }
+#else
+  (void)engine;
+#endif
+  return &libc_calls;
+}
+
+/*
+ * Times every block on its own, and stops at one that moves less than a
+ * block, which only the bytes it moved count for. The close is part of
+ * the run, as vtpc writes its dirty pages back then.
+ */
+void load_sync(struct load_worker* worker) {
+  const struct load_options* options = worker->options;
+  const struct load_calls* calls = load_calls(options->engine);
+  char* buffer = load_buffer(options->block_size);
+  if (buffer == NULL) {
+    worker->error = ENOMEM;
+    return;
+  }
+
+  const uint64_t start = vtsh_now();
+  const int fd =
+      calls->open(options->file, load_flags(options), LOAD_FILE_MODE);
+  if (fd == -1) {
+    worker->error = errno;
+    free(buffer);
+    return;
+  }
+  const bool write = options->rw == LOAD_WRITE;
+  for (size_t i = 0; i < worker->blocks; ++i) {
+    const off_t offset = load_next(worker);
+    const uint64_t before = vtsh_now();
+    const ssize_t done =
+        write ? calls->pwrite(fd, buffer, options->block_size, offset)
+              : calls->pread(fd, buffer, options->block_size, offset);
+    const uint64_t after = vtsh_now();
+    if (done == -1) {
+      worker->error = errno;
+      break;
+    }
+    worker->bytes += (uint64_t)done;
+    if ((size_t)done < options->block_size) {
+      worker->error = load_short(options);
+      break;
+    }
+    load_histogram_add(&worker->latency, after - before);
+    worker->ops += 1;
+  }
+  if (calls->close(fd) == -1 && worker->error == 0) {
+    worker->error = errno;
+  }
+  worker->elapsed = vtsh_now() - start;
+  free(buffer);
+}
@@ -0,0 +1,201 @@
+#include "io.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "histogram.h"
+#include "ring.h"
+#include "units.h"
+
+/* The requests of a worker: their buffers and when each was submitted. */
+struct load_queue {
+  char* buffers;
+  uint64_t* submitted;
+  size_t* idle;
+  size_t idle_count;
+  size_t depth;
+};
+
+static void load_queue_destroy(struct load_queue* queue) {
+  free(queue->buffers);
+  free(queue->submitted);
+  free(queue->idle);
+}
+
+static int load_queue_init(
+    struct load_queue* queue, size_t depth, size_t block_size
+) {
+  *queue = (struct load_queue){
+      .buffers = load_buffer(depth * block_size),
+      .submitted = calloc(depth, sizeof(uint64_t)),
+      .idle = calloc(depth, sizeof(size_t)),
+      .idle_count = depth,
+      .depth = depth,
+  };
+  if (queue->buffers == NULL || queue->submitted == NULL ||
+      queue->idle == NULL) {
+    load_queue_destroy(queue);
+    errno = ENOMEM;
+    return -1;
+  }
+  for (size_t i = 0; i < depth; ++i) {
+    queue->idle[i] = depth - 1 - i;
+  }
+  return 0;
+}
+
+/* Queues a request of the slot, the queued one after the tail. */
+static void load_uring_prepare(
+    struct load_ring* ring,
+    struct load_worker* worker,
+    struct load_queue* queue,
+    int fd,
+    unsigned queued,
+    size_t slot
+) {
+  const struct load_options* options = worker->options;
+  struct io_uring_sqe* sqe = load_ring_sqe(ring, queued);
+  const bool write = options->rw == LOAD_WRITE;
+  if (ring->fixed) {
+    sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+  } else {
+    sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+  }
+  sqe->fd = fd;
+  sqe->off = (uint64_t)load_next(worker);
+  sqe->addr = (uint64_t)(uintptr_t)(queue->buffers +
+                                    (slot * options->block_size));
+  sqe->len = (uint32_t)options->block_size;
+  sqe->user_data = slot;
+  queue->submitted[slot] = vtsh_now();
+}
+
+/* Takes the completions there are, timing each from its submission. */
+static size_t load_uring_reap(
+    struct load_ring* ring, struct load_worker* worker, struct load_queue* queue
+) {
+  const uint64_t now = vtsh_now();
+  size_t reaped = 0;
+  const struct io_uring_cqe* cqe = NULL;
+  while ((cqe = load_ring_peek(ring)) != NULL) {
+    const size_t slot = (size_t)cqe->user_data;
+    if (cqe->res < 0) {
+      if (worker->error == 0) {
+        worker->error = -cqe->res;
+      }
+    } else {
+      worker->bytes += (uint64_t)cqe->res;
+      if ((size_t)cqe->res < worker->options->block_size) {
+        if (worker->error == 0) {
+          worker->error = load_short(worker->options);
+        }
+      } else {
+        load_histogram_add(&worker->latency, now - queue->submitted[slot]);
+        worker->ops += 1;
+      }
+    }
+    queue->idle[queue->idle_count++] = slot;
+    load_ring_advance(ring);
+    reaped += 1;
+  }
+  return reaped;
+}
+
+/*
+ * Waits for the requests the kernel has taken, as closing the ring does not
+ * wait for them and they read into or write from the buffers. Returns -1 if
+ * the ring cannot be waited on, in which case the buffers must be left.
+ */
+static int load_uring_drain(
+    struct load_ring* ring,
+    struct load_worker* worker,
+    struct load_queue* queue,
+    size_t inflight
+) {
+  size_t taken = inflight - ring->pending;
+  while (taken > 0) {
+    if (load_ring_wait(ring, 1) == -1) {
+      return -1;
+    }
+    taken -= load_uring_reap(ring, worker, queue);
+  }
+  return 0;
+}
+
+/*
+ * Keeps up to iodepth requests in flight: queues a request for every idle
+ * buffer, submits them and waits for at least one to complete, with one
+ * system call a round. Returns -1 if requests may still be in flight.
+ */
+static int load_uring_run(
+    struct load_ring* ring,
+    struct load_worker* worker,
+    struct load_queue* queue,
+    int fd
+) {
+  size_t issued = 0;
+  size_t inflight = 0;
+  while ((issued < worker->blocks && worker->error == 0) || inflight > 0) {
+    unsigned queued = 0;
+    while (issued < worker->blocks && worker->error == 0 &&
+           queue->idle_count > 0) {
+      const size_t slot = queue->idle[--queue->idle_count];
+      load_uring_prepare(ring, worker, queue, fd, queued, slot);
+      queued += 1;
+      issued += 1;
+    }
+    load_ring_queue(ring, queued);
+    inflight += queued;
+
+    if (load_ring_submit(ring, 1) == -1) {
+      if (worker->error == 0) {
+        worker->error = errno;
+      }
+      return load_uring_drain(ring, worker, queue, inflight);
+    }
+    inflight -= load_uring_reap(ring, worker, queue);
+  }
+  return 0;
+}
+
+void load_uring(struct load_worker* worker) {
+  const struct load_options* options = worker->options;
+  size_t depth = (options->iodepth < worker->blocks) ? options->iodepth
+                                                     : worker->blocks;
+  depth = (depth == 0) ? 1 : depth;
+
+  struct load_queue queue;
+  if (load_queue_init(&queue, depth, options->block_size) == -1) {
+    worker->error = errno;
+    return;
+  }
+  struct load_ring ring;
+  if (load_ring_init(&ring, (unsigned)depth) == -1) {
+    worker->error = errno;
+    load_queue_destroy(&queue);
+    return;
+  }
+  load_ring_register(&ring, queue.buffers, depth * options->block_size);
+
+  const uint64_t start = vtsh_now();
+  const int fd = open(options->file, load_flags(options), LOAD_FILE_MODE);
+  int drained = 0;
+  if (fd == -1) {
+    worker->error = errno;
+  } else {
+    drained = load_uring_run(&ring, worker, &queue, fd);
+    close(fd);
+  }
+  worker->elapsed = vtsh_now() - start;
+  load_ring_destroy(&ring);
+  /* The kernel may still use the buffers of requests never reaped. */
+  if (drained == 0) {
+    load_queue_destroy(&queue);
+  }
+}
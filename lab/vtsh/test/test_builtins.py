@@ -0,0 +1,68 @@
+import os
+import stat
+import subprocess
+import tempfile
+
+from base_test import BaseShellTest
+
+
+class TestShellBuiltins(BaseShellTest):
+    def test_echo(self):
+        self.execute("echo -n hello\necho world", "helloworld")
+        self.execute("echo", "")
+
+    def test_cd(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            self.execute(f"cd {tmp}\npwd", os.path.realpath(tmp))
+        self.execute("cd /nonexistent\necho still", "still")
+
+    def test_exit(self):
+        status, stdout = self.shell.execute("echo bye\nexit 3\necho no")
+        self.assertEqual(status, 3)
+        self.assertEqual(stdout, "bye")
+
+        status, _ = self.shell.execute("false\nexit")
+        self.assertEqual(status, 1)
+
+        status, _ = self.shell.execute("foobar\ntrue\nexit")
+        self.assertEqual(status, 0)
+
+    def test_path_cache(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            first = os.path.join(tmp, "first")
+            second = os.path.join(tmp, "second")
+            for dir, word in ((first, "one"), (second, "two")):
+                os.mkdir(dir)
+                program = os.path.join(dir, "vtsh-hi")
+                with open(program, "w") as file:
+                    file.write(f"#!/bin/sh\necho {word}\n")
+                os.chmod(program, stat.S_IRWXU)
+
+            env = dict(os.environ, PATH=f"{first}:{second}:/usr/bin:/bin")
+            shell = subprocess.run(
+                "../build/bin/vtsh",
+                input=f"vtsh-hi\nrm {first}/vtsh-hi\nvtsh-hi\n",
+                env=env,
+                capture_output=True,
+                encoding="utf8",
+                timeout=2,
+            )
+            self.assertEqual(shell.returncode, 0)
+            self.assertEqual(
+                shell.stdout.replace("vtsh> ", "").strip(), "one\ntwo"
+            )
+
+    def test_script(self):
+        with tempfile.NamedTemporaryFile("w", suffix=".vtsh") as script:
+            script.write("echo hello\n" * 1000 + "cat\n")
+            script.flush()
+            shell = subprocess.run(
+                ["../build/bin/vtsh", "-t", script.name],
+                input="from stdin\n",
+                capture_output=True,
+                encoding="utf8",
+                timeout=10,
+            )
+        self.assertEqual(shell.returncode, 0)
+        self.assertEqual(shell.stdout, "hello\n" * 1000 + "from stdin\n")
+        self.assertIn("1001 commands", shell.stderr)
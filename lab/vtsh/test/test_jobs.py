@@ -0,0 +1,76 @@
+import os
+import subprocess
+import time
+
+from base_test import BaseShellTest
+
+JOBS = 1000
+JOB_SECONDS = 1.0
+REAP_LATENCY = 1.0
+
+
+def children(pid: int):
+    """Returns the states of the processes whose parent is pid."""
+    states = []
+    for entry in os.listdir("/proc"):
+        if not entry.isdigit():
+            continue
+        try:
+            with open(f"/proc/{entry}/stat") as file:
+                stat = file.read()
+        except OSError:
+            continue
+        fields = stat[stat.rindex(")") + 2 :].split()
+        if int(fields[1]) == pid:
+            states.append(fields[0])
+    return states
+
+
+class TestShellJobs(BaseShellTest):
+    def test_chains(self):
+        self.execute("true && echo a || echo b", "a")
+        self.execute("false && echo a || echo b", "b")
+        self.execute("false || false && echo a; echo b", "b")
+        self.execute("echo a; echo b ;echo c", "a\nb\nc")
+
+    def test_background(self):
+        self.execute("sleep 0.2 && echo late &\necho early\nwait", "early\nlate")
+        self.execute("echo a && echo b &\nwait", "a\nb")
+
+    def test_syntax_errors(self):
+        self.execute(";", "Syntax error")
+        self.execute("echo a ;; echo b", "Syntax error")
+        self.execute("echo a &&", "Syntax error")
+        self.execute("|| echo a", "Syntax error")
+        self.execute("echo a & & echo b", "Syntax error")
+
+    def test_many_background_jobs(self):
+        shell = subprocess.Popen(
+            "../build/bin/vtsh",
+            stdin=subprocess.PIPE,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+            encoding="utf8",
+        )
+        try:
+            shell.stdin.write(f"sleep {JOB_SECONDS} &\n" * JOBS)
+            shell.stdin.write("echo started\n")
+            shell.stdin.flush()
+            self.assertIn("started", shell.stdout.readline())
+            started = time.monotonic()
+
+            # The prompt answers while the jobs run.
+            shell.stdin.write("echo ping\n")
+            shell.stdin.flush()
+            self.assertIn("ping", shell.stdout.readline())
+            self.assertLess(time.monotonic() - started, JOB_SECONDS)
+            self.assertEqual(len(children(shell.pid)), JOBS)
+
+            # Every job is reaped soon after it exits, with no zombies left.
+            deadline = started + JOB_SECONDS + REAP_LATENCY
+            while children(shell.pid) and time.monotonic() < deadline:
+                time.sleep(0.01)
+            self.assertEqual(children(shell.pid), [])
+        finally:
+            shell.communicate(timeout=5)
+        self.assertEqual(shell.returncode, 0)
@@ -0,0 +1,66 @@
+import hashlib
+import os
+
+from base_test import BaseShellTest
+
+
+class TestShellPipeline(BaseShellTest):
+    def test_simple_pipeline(self):
+        self.execute("echo hello world | wc -w", "2")
+        self.execute("echo b a c|tr a-z A-Z|rev|cat", "C A B")
+
+    def test_concurrent_stages(self):
+        # Neither stage finishes before the other one has started.
+        self.execute("yes | head -n 3", "y\ny\ny")
+
+    def test_pipeline_redirection(self):
+        self.add_test_file("aaa")
+        self.add_test_file("bbb")
+
+        self.execute("echo one two > aaa", "")
+        self.execute("< aaa tr a-z A-Z | wc -c > bbb", "")
+        self.execute("cat bbb", "8")
+
+    def test_missing_stage(self):
+        self.execute("foobar | echo hi", "Command not found\nhi")
+        self.execute("echo hi | foobar", "Command not found")
+
+    def test_syntax_errors(self):
+        self.execute("echo hi |", "Syntax error")
+        self.execute("| echo hi", "Syntax error")
+        self.execute("echo hi | | cat", "Syntax error")
+
+    def test_process_group(self):
+        status, stdout = self.shell.execute("ps -o pid=,pgid=,comm= | cat")
+        self.assertEqual(status, 0)
+        groups = {}
+        for line in stdout.splitlines():
+            pid, pgid, comm = line.split(None, 2)
+            groups[comm] = (int(pid), int(pgid))
+        self.assertEqual(groups["ps"][1], groups["cat"][1])
+        self.assertIn(groups["ps"][1], (groups["ps"][0], groups["cat"][0]))
+        self.assertNotEqual(groups["ps"][1], groups["vtsh"][1])
+
+    def test_relay(self):
+        for name in ("aaa", "bbb", "ccc"):
+            self.add_test_file(name)
+        data = os.urandom(3 * 1024 * 1024 + 17)
+        with open("aaa", "wb") as file:
+            file.write(data)
+
+        self.execute("relay aaa | relay -t bbb | relay > ccc", "")
+        for name in ("bbb", "ccc"):
+            with open(name, "rb") as file:
+                self.assertEqual(
+                    hashlib.sha256(file.read()).digest(),
+                    hashlib.sha256(data).digest(),
+                )
+        self.execute("echo hi | relay", "hi")
+        self.execute("relay aaa aaa | wc -c", str(2 * len(data)))
+
+    def test_relay_order(self):
+        self.add_test_file("aaa")
+        with open("aaa", "w") as file:
+            file.write("x\n")
+
+        self.execute("echo first; relay aaa; echo last", "first\nx\nlast")
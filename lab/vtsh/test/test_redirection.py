@@ -2,7 +2,7 @@ import unittest
 
 from base_test import BaseShellTest
 
-REQUIRED_REDIRECTION_FUNCTIONALITY = False
+REQUIRED_REDIRECTION_FUNCTIONALITY = True
 
 @unittest.skipIf(not REQUIRED_REDIRECTION_FUNCTIONALITY, 
                  ("Redirection functionality is not required in the task. "
@@ -48,6 +48,7 @@ class TestShellRedirection(BaseShellTest):
     def test_combined_redirection(self):
         self.add_test_file("lol")
         self.add_test_file("wut")
+        self.add_test_file("lol<wut")
 
         self.execute("echo >lol<wut alpha", "")
         self.execute("cat lol<wut", "alpha")
@@ -0,0 +1,56 @@
+import json
+import os
+import subprocess
+
+from base_test import BaseShellTest
+
+
+def run(script: str, time: str = ""):
+    """Runs the script in a shell, returning its stdout and stderr."""
+    env = dict(os.environ, VTSH_TIME=time)
+    result = subprocess.run(
+        "../build/bin/vtsh",
+        input=script,
+        capture_output=True,
+        encoding="utf8",
+        env=env,
+        timeout=10,
+    )
+    return result.stdout.replace("vtsh> ", ""), result.stderr
+
+
+class TestShellTime(BaseShellTest):
+    def test_text(self):
+        stdout, stderr = run("time echo a | cat\n")
+        self.assertEqual(stdout, "a\n")
+        self.assertRegex(stderr, r"^real [0-9.]+ s  user [0-9.]+ s")
+        self.assertIn("faults", stderr)
+
+    def test_json(self):
+        stdout, stderr = run("time -j cat /dev/null && echo a\n")
+        self.assertEqual(stdout, "a\n")
+        report = json.loads(stderr)
+        for key in ("real", "user", "sys", "voluntary_switches", "max_rss_kib"):
+            self.assertIn(key, report)
+        self.assertGreater(report["max_rss_kib"], 0)
+        self.assertIsInstance(report["counters"], dict)
+
+    def test_builtin(self):
+        stdout, stderr = run("time -j echo a\n")
+        self.assertEqual(stdout, "a\n")
+        report = json.loads(stderr)
+        self.assertGreater(report["max_rss_kib"], 0)
+        self.assertGreaterEqual(report["user"] + report["sys"], 0)
+
+    def test_every_pipeline(self):
+        stdout, stderr = run("true\nfalse | true\n", "json")
+        self.assertEqual(stdout, "")
+        self.assertEqual(len(stderr.splitlines()), 2)
+
+    def test_untimed(self):
+        _, stderr = run("echo a | cat\n")
+        self.assertEqual(stderr, "")
+
+    def test_syntax(self):
+        self.execute("time", "Syntax error")
+        self.execute("echo a && time -j", "Syntax error")